@@ -0,0 +1,100 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_ADMIN_H
+#define LEW_ADMIN_H
+
+#include    <cstdint>
+#include    <string>
+#include    <unordered_set>
+
+#include    "lew/wrapper.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   admin http listener of a wrapper, apart from its user traffic,
+ *          running in the loop of the wrapper. it serves
+ *
+ *          /metrics                Wrapper::metrics() and the gauges, in the
+ *                                  Prometheus text format.
+ *          /debug/connections      connections of every set of the wrapper,
+ *                                  in JSON.
+ *
+ *          the connection list is snapshotted at once, then rendered and
+ *          sent in chunks, one per loop iteration, so that a large list
+ *          does not stall the connections of the wrapper.
+ *
+ * */
+class   AdminServer{
+public:
+    AdminServer(    Wrapper*    owner );
+    virtual ~AdminServer();
+
+    /**
+     * \note    start to listen.
+     * \param   listenAddr  the listening address, e.g. 127.0.0.1.
+     * \param   port        the listening port.
+     * \return  true on success, or false on failure.
+     * */
+    bool        start(  const std::string&  listenAddr,
+                        uint16_t            port );
+    void        stop();
+
+    /**
+     * \note    prefix of metric names, default to "lew_".
+     * */
+    void        setPrefix(const std::string& prefix){ _prefix = prefix;};
+    /**
+     * \note    connections rendered per loop iteration, default to 256.
+     * */
+    void        setChunkSize(size_t chunk){ _chunk = chunk ? chunk : 1;};
+
+    /**
+     * \note    render the metrics in the Prometheus text format.
+     * */
+    std::string renderMetrics();
+
+    struct      Render;
+    friend void _admin_req_cb(  struct evhttp_request*  req,    void*   ctx);
+    friend void _admin_next_cb( evutil_socket_t fd, short what, void* arg);
+    friend void _admin_close_cb(struct evhttp_connection*   evcon, void* arg);
+protected:
+    Wrapper*                        _owner;
+    struct evhttp*                  _http;
+    std::string                     _prefix;
+    size_t                          _chunk;
+    std::unordered_set<Render*>     _renders;
+    void        serveConnections(   struct evhttp_request*  req );
+    void        finish( Render*     render,     bool    aborted );
+};  // class AdminServer
+
+NS_LEW_END();
+
+#endif
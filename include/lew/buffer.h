@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_BUFFER_H
+#define LEW_BUFFER_H
+
+#include    <atomic>
+#include    <cstddef>
+#include    <string>
+
+#include    <event2/buffer.h>
+
+#include    "lew/utildef.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   called when a buffer handed to the connection is no longer used,
+ *          the signature is the same as libevent's evbuffer_ref_cleanup_cb.
+ * */
+typedef void (*buffer_cleanup_t)(const void* data, size_t len, void* arg);
+
+/**
+ *  \note   a view of bytes owned by someone else, e.g. an evbuffer.<br>
+ *          it's valid until the owner is modified.
+ * */
+struct  Slice{
+    Slice(): data(nullptr), len(0){};
+    Slice(const char* d, size_t l): data(d), len(l){};
+    bool            empty() const { return 0 == len;};
+    std::string     str() const {   return std::string(data, len);};
+    const char*     data;
+    size_t          len;
+};
+
+/**
+ *  \note   reference counted immutable buffer.<br>
+ *          the same buffer may be appended to the output of many connections
+ *          without being copied, it's released when the last output using
+ *          it has been written and the creator has called unref().
+ *
+ * */
+class   SharedBuffer{
+public:
+    /**
+     * \note    create a shared buffer holding a copy of `data`.
+     * \return  a new buffer with one reference, or nullptr on failure.
+     * */
+    static SharedBuffer*    create( const void*     data,
+                                    size_t          len );
+    /**
+     * \note    create a shared buffer over `data` without copying it,
+     *          `cleanup` is called when the buffer is released.
+     * \return  a new buffer with one reference, or nullptr on failure.
+     * */
+    static SharedBuffer*    wrap(   const void*         data,
+                                    size_t              len,
+                                    buffer_cleanup_t    cleanup,
+                                    void*               arg );
+
+    void            ref(){      _refs.fetch_add(1, std::memory_order_relaxed);};
+    void            unref();
+    int             refs(){     return _refs.load(std::memory_order_relaxed);};
+    const void*     data(){     return _data;};
+    size_t          len(){      return _len;};
+
+    /**
+     * \note    append the content to `buf` by reference.
+     * \return  0 on success, or -1 on failure.
+     * */
+    int             appendTo(struct evbuffer*   buf);
+protected:
+    SharedBuffer(){};
+    ~SharedBuffer(){};
+    const void*         _data;
+    size_t              _len;
+    buffer_cleanup_t    _cleanup;
+    void*               _arg;
+    std::atomic<int>    _refs;
+    static  void        release(const void* data, size_t len, void* arg);
+};  // class SharedBuffer
+
+NS_LEW_END();
+
+#endif
+
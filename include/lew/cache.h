@@ -0,0 +1,154 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_CACHE_H
+#define LEW_CACHE_H
+
+#include    <cstdint>
+#include    <list>
+#include    <string>
+#include    <unordered_map>
+#include    <utility>
+#include    <vector>
+
+#include    <event2/http.h>
+
+#include    "lew/buffer.h"
+#include    "lew/metrics.h"
+
+NS_LEW_BEGIN();
+
+class   Wrapper;
+struct  HttpRequestContext;
+
+/**
+ *  \note   a miss of the cache being filled by the handler, which the other
+ *          requests for the same key wait for.
+ * */
+struct  HttpCacheFill{
+    std::string                         key;
+    HttpRequestContext*                 filler;     // the request handled.
+    std::vector<HttpRequestContext*>    waiters;    // the requests coalesced.
+};
+
+/**
+ *  \note   in memory cache of http responses, in front of the handlers of
+ *          a wrapper, see Wrapper::setHttpCache().
+ *          <br>
+ *          GET and HEAD requests are keyed by method, uri and the headers
+ *          set by vary(). a fresh entry is replied without calling the
+ *          handler, by reference to its body, or 304 if the request has an
+ *          If-None-Match with its ETag. on a miss only one request runs the
+ *          handler, the others for the same key wait for its reply.
+ *          <br>
+ *          only replies sent by Wrapper::sendHttpReply() are cached, those
+ *          with code 200 are stored unless their Cache-Control is private
+ *          or no-store. Set-Cookie is not stored. entries expire after the ttl, and the
+ *          least recently used ones are evicted above the size.
+ *
+ * */
+class   HttpCache{
+public:
+    /**
+     * \param   maxBytes    bound of the bodies, keys and headers stored.
+     * \param   ttlMs       time to live of an entry, in milliseconds.
+     * */
+    HttpCache(  size_t      maxBytes,
+                int         ttlMs );
+    virtual ~HttpCache();
+
+    /**
+     * \note    add a request header to the key, e.g. "Accept-Encoding".
+     * */
+    void        vary(   const std::string&  header ){ _vary.push_back(header);};
+    /**
+     * \note    remove the entries, fills in flight are kept.
+     * */
+    void        clear();
+    size_t      size() const {  return _map.size();};
+    size_t      bytes() const { return _bytes;};
+
+    Counter     hits;           // requests replied from the cache.
+    Counter     misses;         // requests handled to fill the cache.
+    Counter     coalesced;      // requests waiting for a fill.
+    Counter     notModified;    // requests replied 304.
+    Counter     evictions;      // entries evicted, or expired.
+
+    struct  Entry;
+protected:
+    friend class    Wrapper;
+    friend void     _http_req_cb(   struct evhttp_request*  req, void* ctx);
+    enum    Lookup {
+        SERVED  = 0,            // replied from the cache.
+        FILL,                   // to be handled, maybe filling the cache.
+        WAIT,                   // waiting for a fill.
+    };
+    /**
+     * \note    look the request of `rc` up, it joins a fill on a miss.
+     * */
+    int         lookup( HttpRequestContext*     rc );
+    /**
+     * \note    reply the fill of `rc`, to its waiters too, and store the
+     *          reply. `body` is drained.<br>
+     *          a reply with Cache-Control private or no-store is neither
+     *          stored nor replied to the waiters, they are moved to
+     *          `unshared` to be handled on their own.
+     * */
+    void        fill(   HttpRequestContext*     rc,
+                        int                     code,
+                        const char*             reason,
+                        struct evbuffer*        body,
+                        std::vector<HttpRequestContext*>&   unshared );
+    /**
+     * \note    `rc` leaves its fill, when released without filling it.
+     * \return  the waiter to handle in place of the filler, or nullptr.
+     * */
+    HttpRequestContext* leave(  HttpRequestContext* rc );
+    /**
+     * \note    drop the fills, their requests are not waiting any more.
+     * */
+    void        abort();
+    void        evict(  Entry*  entry );
+    std::string key(    struct evhttp_request*  req );
+
+    typedef std::list<Entry*>                           EntryList;
+    typedef std::unordered_map<std::string, Entry*>     EntryMap;
+    typedef std::unordered_map<std::string, HttpCacheFill*> FillMap;
+    size_t                      _maxBytes;
+    int64_t                     _ttlNs;
+    size_t                      _bytes;
+    std::vector<std::string>    _vary;
+    EntryList                   _lru;       // most recently used first.
+    EntryMap                    _map;
+    FillMap                     _fills;
+};  // class HttpCache
+
+NS_LEW_END();
+
+#endif
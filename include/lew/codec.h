@@ -0,0 +1,167 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_CODEC_H
+#define LEW_CODEC_H
+
+#include    <cstdint>
+#include    <string>
+
+#include    <event2/buffer.h>
+
+#include    "lew/utildef.h"
+#include    "lew/buffer.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   message framing over the byte stream of a tcp connection.<br>
+ *          a codec keeps no per connection state, so one codec may be
+ *          shared by all connections of a wrapper.
+ *
+ * */
+class   Codec{
+public:
+    Codec(): _maxFrameSize( 1024 * 1024 ){};
+    virtual ~Codec(){};
+
+    /**
+     * \note    find the first frame in `buf`.<br>
+     *          the payload is viewed in place when it's contiguous in `buf`,
+     *          or pulled up otherwise. `buf` is not drained.
+     * \param   buf         the input buffer.
+     * \param   frame       the payload of the frame found.
+     * \param   frameLen    bytes of the frame in `buf`, including framing.
+     * \return  1 if a frame is found, 0 if more bytes are needed, or -1 on
+     *          malformed or too large frame.
+     * */
+    virtual int     decode( struct evbuffer*    buf,
+                            Slice&              frame,
+                            size_t&             frameLen ) = 0;
+    /**
+     * \note    as decode(), resuming the search of the frame end from
+     *          `scanned`, the leading bytes known not to hold it, for a
+     *          codec searching for it in a growing buffer.<br>
+     *          `scanned` is updated when more bytes are needed, and reset
+     *          to 0 when a frame is found.
+     * */
+    virtual int     decodeFrom( struct evbuffer*    buf,
+                                Slice&              frame,
+                                size_t&             frameLen,
+                                size_t&             scanned ){
+        return  decode( buf, frame, frameLen );
+    }
+    /**
+     * \note    append `data` as one frame to `buf`.
+     * \return  0 on success, or -1 on failure.
+     * */
+    virtual int     encode( struct evbuffer*    buf,
+                            const void*         data,
+                            size_t              len ) = 0;
+
+    size_t          maxFrameSize(){ return _maxFrameSize;};
+    void            setMaxFrameSize(size_t size){ _maxFrameSize = size;};
+protected:
+    size_t          _maxFrameSize;
+    /**
+     * \note    view `len` bytes of `buf` from `offset`, pulling up the buffer
+     *          only if they are not contiguous.
+     * */
+    static Slice    view(   struct evbuffer*    buf,
+                            size_t              offset,
+                            size_t              len );
+};  // class Codec
+
+/**
+ *  \note   frames led by the payload length, in a big endian integer of
+ *          1, 2, 4 or 8 bytes, or in a varint (LEB128) when the header size
+ *          is zero.
+ * */
+class   LengthCodec: public Codec{
+public:
+    /**
+     * \note    throws std::invalid_argument for a header size other than
+     *          0, 1, 2, 4 or 8.
+     * */
+    explicit LengthCodec(int headerSize = 4);
+    virtual int     decode( struct evbuffer*    buf,
+                            Slice&              frame,
+                            size_t&             frameLen );
+    /**
+     * \note    fails with EMSGSIZE when `len` is over maxFrameSize(), or
+     *          over what the header can tell.
+     * */
+    virtual int     encode( struct evbuffer*    buf,
+                            const void*         data,
+                            size_t              len );
+protected:
+    int             _headerSize;
+};  // class LengthCodec
+
+/**
+ *  \note   frames ended by a delimiter, e.g. "\r\n".
+ * */
+class   DelimiterCodec: public Codec{
+public:
+    explicit DelimiterCodec(const std::string& delim = "\r\n"):
+        _delim(delim){};
+    virtual int     decode( struct evbuffer*    buf,
+                            Slice&              frame,
+                            size_t&             frameLen );
+    virtual int     decodeFrom( struct evbuffer*    buf,
+                                Slice&              frame,
+                                size_t&             frameLen,
+                                size_t&             scanned );
+    virtual int     encode( struct evbuffer*    buf,
+                            const void*         data,
+                            size_t              len );
+protected:
+    std::string     _delim;
+};  // class DelimiterCodec
+
+/**
+ *  \note   frames of a fixed size.
+ * */
+class   FixedCodec: public Codec{
+public:
+    explicit FixedCodec(size_t size): _size(size){};
+    virtual int     decode( struct evbuffer*    buf,
+                            Slice&              frame,
+                            size_t&             frameLen );
+    virtual int     encode( struct evbuffer*    buf,
+                            const void*         data,
+                            size_t              len );
+protected:
+    size_t          _size;
+};  // class FixedCodec
+
+NS_LEW_END();
+
+#endif
+
@@ -31,6 +31,7 @@
 #define LEW_CONNECTION_H
 
 #include    <cstdint>
+#include    <deque>
 #include    <string>
 
 #include    <event2/event.h>
@@ -40,10 +41,84 @@
 #include    <event2/http.h>
 
 #include    "lew/utildef.h"
+#include    "lew/buffer.h"
+#include    "lew/codec.h"
 
 NS_LEW_BEGIN();
 
 class   Wrapper;
+class   Connection;
+struct  HttpRequest;
+struct  ZeroCopyRef;
+struct  HttpCacheFill;
+
+/**
+ *  \note   takes the frames of a connection in place of Wrapper::onMessage,
+ *          e.g. a protocol layer on top of a connection.
+ * */
+class   MessageHandler{
+public:
+    virtual ~MessageHandler(){};
+    /**
+     *  \note   called for each frame received on the connection.
+     * */
+    virtual void    onMessage(  Connection* conn, const Slice& msg) = 0;
+    /**
+     *  \note   called when the connection has input, for a handler reading
+     *          the byte stream itself, e.g. a protocol of its own framing.
+     *  \return true if the input is taken, false to leave it to the codec.
+     * */
+    virtual bool    onInput(    Connection* conn){ return false;};
+    /**
+     *  \note   called when the output of the connection is written.
+     * */
+    virtual void    onWritten(  Connection* conn){};
+    /**
+     *  \note   called when a tcp client connection gets connected.
+     * */
+    virtual void    onConnected(Connection* conn){};
+    /**
+     *  \note   called when a tcp client connection is lost and connecting
+     *          again, see Connection::setRetryTimes(). the output not written
+     *          by then is dropped.
+     * */
+    virtual void    onReset(    Connection* conn){};
+    /**
+     *  \note   called when the connection is released.
+     * */
+    virtual void    onClose(    Connection* conn){};
+};
+
+/**
+ *  \note   handler of a streaming reply, see Wrapper::startHttpStream().
+ * */
+typedef void(Wrapper::*http_stream_handler_t)(  Connection*             conn,
+                                                struct evhttp_request*  req,
+                                                void*                   arg );
+
+/**
+ *  \note   state of a request to the http server, from its arrival to the
+ *          end of its reply, see Connection::httpContext(). contexts are
+ *          pooled by the wrapper, and released once the reply is sent, or
+ *          the connection is closed.
+ * */
+struct  HttpRequestContext{
+    Connection*             conn;       // the connection of the request.
+    struct evhttp_request*  req;        // the request.
+    int64_t                 start;      // CLOCK_MONOTONIC on arrival, in ns.
+    void*                   data;       // user data, reset on release.
+    HttpCacheFill*          fill;       // the cache fill it takes part in.
+    http_stream_handler_t   stream;     // of the streaming reply,
+    void*                   streamArg;  // its argument,
+    size_t                  watermark;  // and the output it refills below.
+    struct evbuffer*        body;       // body kept by onHttpBodyChunk,
+    int                     bodyFd;     // or its spool file, -1 if none,
+    uint64_t                bodyLength; // and the bytes of the body.
+    bool                    bodyFailed; // set if the body can't be kept,
+                                        // the request is replied 500.
+    HttpRequest*            request;    // of the native http server, where
+                                        // `req` is nullptr.
+};
 
 /**
  *  \note   (TCP|HTTP) x (SERVER|CLIENT) Connection created on libevent.
@@ -87,6 +162,23 @@ public:
     friend  void    _http_req_cb(
                                 struct evhttp_request*   req,
                                 void*                    ctx);
+    /**
+     *  \note   input and output callbacks of a http server connection.
+     * */
+    friend  void    _http_in_cb(
+                                struct evbuffer*                buf,
+                                const struct evbuffer_cb_info*  info,
+                                void*                           ctx);
+    friend  void    _http_out_cb(
+                                struct evbuffer*                buf,
+                                const struct evbuffer_cb_info*  info,
+                                void*                           ctx);
+    /**
+     *  \note   frames delivery of a connection with a codec.
+     * */
+    friend  void    _read_frames(
+                                Connection*              conn,
+                                Codec*                   codec);
 public:
     Connection( Wrapper*    owner,  //  the wrapper who owns the connection.
                 Type        type,   //  category of the connection.
@@ -96,6 +188,10 @@ public:
 public:
     Wrapper*                owner(){    return _owner;};
     Type                    type(){     return _type;};
+    /**
+     *  \note   unique id of the connection in the process, from 1.
+     * */
+    uint64_t                id(){       return _id;};
     Status                  status(){   return _status;};
     std::string             addr(){     return _addr;};
     uint16_t                port(){     return _port;};
@@ -104,6 +200,44 @@ public:
     struct evbuffer*        readBuf(){  return _readBuf;};
     struct evbuffer*        writeBuf(){ return _writeBuf;};
     struct evhttp_request*  httpReq(){  return _httpReq;};
+    /**
+     *  \note   the request being served on a http server connection, or
+     *          nullptr between requests.
+     * */
+    HttpRequestContext*     httpContext(){  return _httpCtx;};
+
+    /**
+     *  \note   count of bytes in readBuf().
+     * */
+    size_t  readLength();
+    /**
+     *  \note   view the bytes of readBuf() in place, without copying.
+     *  \param   vec     the slices to fill.
+     *  \param   n       count of slices in `vec`.
+     *  \return  count of slices needed to cover readBuf(), may be more
+     *           than `n`, or -1 on failure.
+     * */
+    int     peek(   struct evbuffer_iovec*  vec,    int     n );
+    /**
+     *  \note   view the first `len` bytes of readBuf() as contiguous memory.
+     *          the bytes are only moved together when they span more than
+     *          one chunk of the buffer.
+     *  \return the slice, which is empty if less than `len` bytes are there.
+     * */
+    Slice   peek(   size_t  len );
+    /**
+     *  \note   view the bytes of readBuf() up to the first `delim`.
+     *  \param   delim       the delimiter, e.g. "\r\n".
+     *  \param   delimLen    length of the delimiter.
+     *  \return the slice without the delimiter, or an empty slice with a
+     *          null data if the delimiter is not found.
+     * */
+    Slice   peekUntil(  const char*     delim,  size_t  delimLen );
+    /**
+     *  \note   drop the first `len` bytes of readBuf().
+     *  \return 0 on success, or -1 on failure.
+     * */
+    int     consume(    size_t  len );
     /**
      *  \note   get retryTimes. if it's zero, the connection will not try
      *          to reconnect to tcp server when connection is lost.
@@ -115,8 +249,100 @@ public:
      *          not try to reconnect to tcp server when connection is lost.
      * */
     void    setRetryTimes(int retryTimes){ _retryTimes  = retryTimes;};
+
+    /**
+     *  \note   write `len` bytes of `data` without copying it into the kernel
+     *          (MSG_ZEROCOPY). the buffer must stay untouched until `cleanup`
+     *          is called, which happens once the kernel acknowledges the
+     *          transmission from the socket error queue.<br>
+     *          payloads below zeroCopyThreshold() are copied into writeBuf()
+     *          and `cleanup` is called at once; when writeBuf() still holds
+     *          data, or zero copy is not supported, the buffer is referenced
+     *          by writeBuf() and released after being written.<br>
+     *          the acknowledgments are polled every millisecond while
+     *          sends are pending, and on writeZeroCopy() and flush().
+     *          when the socket is closed, or replaced on a reconnect, the
+     *          sends not yet acknowledged are released at once, though the
+     *          kernel may still transmit from the buffer; keep it intact
+     *          after the connection is gone if that matters.
+     *  \return 0 on success, or -1 on failure.
+     * */
+    int     writeZeroCopy(  const void*         data,
+                            size_t              len,
+                            buffer_cleanup_t    cleanup,
+                            void*               arg );
+    /**
+     *  \note   minimum payload size of writeZeroCopy to skip the copy,
+     *          default to 64KB.
+     * */
+    size_t  zeroCopyThreshold(){ return _zcThreshold;};
+    void    setZeroCopyThreshold(size_t threshold){ _zcThreshold = threshold;};
+    /**
+     *  \note   count of zero copy sends not yet acknowledged by the kernel.
+     * */
+    size_t  zeroCopyPending(){  return _zcPending.size();};
+
+
+    /**
+     *  \note   set the framing of the connection. when set, incoming frames
+     *          are delivered to Wrapper::onMessage instead of
+     *          Wrapper::onConnectionRead. the codec is not owned.
+     * */
+    void    setCodec(Codec* codec){ _codec = codec; _scanned = 0;};
+    Codec*  codec(){    return _codec;};
+    /**
+     *  \note   set the handler of incoming frames, see MessageHandler.
+     *          the handler is not owned.
+     * */
+    void    setHandler(MessageHandler* handler){ _handler = handler;};
+    MessageHandler* handler(){  return _handler;};
+    /**
+     *  \note   append `data` as one frame to writeBuf(), by the codec.
+     *  \return 0 on success, or -1 on failure.
+     * */
+    int     writeMessage(const void* data, size_t len);
+
+    /**
+     *  \note   hold the output of a tcp connection, until uncork() is called.
+     * */
+    void    cork();
+    /**
+     *  \note   release the output held by cork(), everything queued is
+     *          flushed with one writev.
+     *  \return 0 on success, or -1 on failure.
+     * */
+    int     uncork();
+    bool    corked(){   return _corked;};
+    /**
+     *  \note   write the queued output with one writev now, what's left is
+     *          written when the socket becomes writable again.
+     *  \return 0 on success, or -1 on failure.
+     * */
+    int     flush();
+    /**
+     *  \note   when enabled, output of a tcp connection is held and flushed
+     *          by the owner wrapper at the end of the current loop iteration,
+     *          see Wrapper::setWriteCoalescing.
+     * */
+    void    setAutoFlush(bool autoFlush);
+    bool    autoFlush(){    return _autoFlush;};
+    /**
+     *  \note   count of write syscalls and count of writes into writeBuf(),
+     *          of a tcp connection. the syscalls are approximated by the
+     *          drains of writeBuf(): those which wrote nothing are not
+     *          counted, a drain by the user is.
+     * */
+    uint64_t    writeSyscalls(){    return _writeSyscalls;};
+    uint64_t    writeMessages(){    return _writeMessages;};
+
+    friend  void    _zerocopy_cb( evutil_socket_t fd, short what, void* ctx);
+    friend  void    _flush_cb( int s, short what, void* arg);
+    friend  void    _output_cb( struct evbuffer*                  buf,
+                                const struct evbuffer_cb_info*    info,
+                                void*                             ctx);
 protected:
     Wrapper*                _owner;
+    uint64_t                _id;
     Type                    _type;
     Status                  _status;
     std::string             _addr;
@@ -132,6 +358,39 @@ protected:
     //
     //  http client connection
     struct evhttp_connection*   _httpConn;
+    //  http server connection
+    struct evhttp_connection*   _httpEvcon; // not owned.
+    HttpRequestContext*     _httpCtx;
+    int                     _httpServed;    // requests received.
+    size_t                  _httpParsed;    // bytes of the request parsed,
+    size_t                  _httpBuffered;  // and yet to parse.
+    struct timeval          _httpActive;    // last input or output.
+    struct evbuffer_cb_entry*   _httpCbs[2];
+    Codec*                  _codec;
+    size_t                  _scanned;       // input searched by the codec
+                                            // without a frame end.
+    MessageHandler*         _handler;
+    bool*                   _alive;         // cleared when deleted, while
+                                            // frames are delivered.
+    //
+    //  zero copy sending
+    typedef std::deque< std::pair<uint32_t, ZeroCopyRef*> >  ZeroCopyQueue;
+    size_t                  _zcThreshold;
+    int                     _zcEnabled;     // 0: unknown, 1: yes, -1: no
+    uint32_t                _zcNextSeq;
+    ZeroCopyQueue           _zcPending;
+    struct event*           _zcEvent;       // timer polling completions.
+    void                    zeroCopyComplete(uint32_t lo, uint32_t hi);
+    void                    zeroCopyDrain();
+    void                    zeroCopyReset();
+    //
+    //  write coalescing
+    bool                    _corked;
+    bool                    _autoFlush;
+    bool                    _flushPending;
+    uint64_t                _writeSyscalls;
+    uint64_t                _writeMessages;
+    void                    holdWrite();
 };  // class Connection
 
 
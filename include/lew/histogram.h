@@ -0,0 +1,86 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_HISTOGRAM_H
+#define LEW_HISTOGRAM_H
+
+#include    <cstdint>
+#include    <vector>
+
+#include    "lew/utildef.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   histogram of integer values with a fixed relative precision, in
+ *          the layout of HdrHistogram: power of two buckets, each split in
+ *          linear sub buckets. recording is a few shifts and an increment.
+ *          values over the highest trackable one are counted as it.
+ *
+ * */
+class   Histogram{
+public:
+    /**
+     * \param   highest     the highest value to track, at least 2.
+     * \param   digits      significant decimal digits kept, from 1 to 5.
+     * */
+    Histogram(  int64_t     highest = 3600LL * 1000 * 1000,
+                int         digits  = 3 );
+
+    void        record( int64_t value, int64_t count = 1 );
+    void        merge(  const Histogram& other );
+    void        reset();
+
+    int64_t     count() const {    return _total;};
+    int64_t     min() const;
+    int64_t     max() const {      return _max;};
+    double      mean() const;
+    /**
+     * \note    the value at a percentile, from 0 to 100.
+     * */
+    int64_t     percentile( double  p ) const;
+    int64_t     highest() const {   return _highest;};
+protected:
+    int64_t                 _highest;
+    int                     _subBucketHalfCountMagnitude;
+    int64_t                 _subBucketHalfCount;
+    int64_t                 _subBucketMask;
+    int64_t                 _total;
+    int64_t                 _min;
+    int64_t                 _max;
+    double                  _sum;
+    std::vector<int64_t>    _counts;
+    size_t                  indexOf( int64_t value ) const;
+    int64_t                 valueAt( size_t index ) const;
+};  // class Histogram
+
+NS_LEW_END();
+
+#endif
+
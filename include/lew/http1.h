@@ -0,0 +1,152 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_HTTP1_H
+#define LEW_HTTP1_H
+
+#include    <cstdint>
+#include    <string>
+
+#include    <event2/buffer.h>
+#include    <event2/http.h>
+
+#include    "lew/buffer.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   a header of a request, as views into the request.
+ * */
+struct  HttpHeader{
+    Slice       name;
+    Slice       value;
+};
+
+/**
+ *  \note   a request parsed by HttpParser, as views into the bytes parsed.
+ *          it takes no allocation, and is reused by the connections of the
+ *          native http server, see Wrapper::startNativeHttpServer().
+ * */
+struct  HttpRequest{
+    enum{   MAX_HEADERS     = 64 };
+    HttpRequest(){  reset();};
+    void        reset();
+    /**
+     * \note    the value of the first header named `name`, case
+     *          insensitive, or an empty slice with a null data.
+     * */
+    Slice       header( const char*     name ) const;
+    /**
+     * \note    move the views from the bytes at `from` to a copy at `to`.
+     * */
+    void        rebase( const char*     from,
+                        const char*     to );
+
+    evhttp_cmd_type method;         // 0 if not known by evhttp.
+    Slice           uri;
+    Slice           path;           // of the uri, before '?'.
+    Slice           query;          // of the uri, after '?'.
+    int             minorVersion;   // HTTP/1.x.
+    bool            keepAlive;      // by the version and Connection.
+    bool            chunked;        // Transfer-Encoding ends with chunked.
+    bool            upgrade;        // Connection: upgrade, with Upgrade.
+    int64_t         contentLength;  // -1 if no Content-Length.
+    HttpHeader      headers[ MAX_HEADERS ];
+    int             headerCount;
+    Slice           body;           // the body, once read.
+};
+
+/**
+ *  \note   parser of the request line and headers of HTTP/1.x.
+ *          <br>
+ *          the scan of the uri and the header values, where most of the
+ *          bytes are, runs on AVX2 or SSE4.2 when the cpu has them, chosen
+ *          at run time. obsolete line folding is refused, so are a request
+ *          with both Content-Length and Transfer-Encoding, conflicting
+ *          Content-Lengths and transfer codings other than chunked.
+ *
+ * */
+class   HttpParser{
+public:
+    enum    Isa {
+        ISA_SCALAR  = 0,
+        ISA_SSE42,
+        ISA_AVX2,
+    };
+    /**
+     * \note    parse the head of a request at `data`.
+     * \return  bytes of the request line and headers, 0 if more bytes are
+     *          needed, or -1 on malformed request.
+     * */
+    static int          parse(  const char*     data,
+                                size_t          len,
+                                HttpRequest&    req );
+    /**
+     * \note    the instructions the scan runs on. setIsa() falls back to
+     *          the best one of the cpu, it's meant for tests and benchmarks
+     *          and should be called before any parse.
+     * */
+    static Isa          isa();
+    static Isa          setIsa( Isa     isa );
+    static const char*  isaName(Isa     isa );
+};  // class HttpParser
+
+/**
+ *  \note   writer of the head of responses, from preformatted status lines
+ *          and a Date header formatted once a second.
+ * */
+class   HttpResponseWriter{
+public:
+    /**
+     * \note    append the status line and the headers to `out`.
+     * \param   bodyLen     the Content-Length.
+     * \param   contentType the Content-Type, or nullptr for none.
+     * \param   headers     more headers, `count` of them.
+     * \param   keepAlive   false to add Connection: close, true to add
+     *                      Connection: keep-alive for HTTP/1.0.
+     * \param   minorVersion    of the request, HTTP/1.x.
+     * \return  0 on success, or -1 on failure.
+     * */
+    static int          writeHead(  struct evbuffer*    out,
+                                    int                 code,
+                                    size_t              bodyLen,
+                                    const char*         contentType,
+                                    const HttpHeader*   headers,
+                                    int                 count,
+                                    bool                keepAlive,
+                                    int                 minorVersion = 1 );
+    /**
+     * \note    the reason phrase of `code`, "Unknown" if it has none.
+     * */
+    static const char*  reason( int     code );
+};  // class HttpResponseWriter
+
+NS_LEW_END();
+
+#endif
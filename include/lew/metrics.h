@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_METRICS_H
+#define LEW_METRICS_H
+
+#include    <atomic>
+#include    <cstdint>
+
+#include    "lew/histogram.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   a counter written by the loop thread of its wrapper only.
+ *          an increment is a relaxed load and store, no locked instruction,
+ *          so it may be read from any thread while costing nothing on the
+ *          hot path.
+ * */
+class   Counter{
+public:
+    Counter(): _value(0){};
+    void        inc(    uint64_t    n = 1 ){
+        _value.store( _value.load(std::memory_order_relaxed) + n,
+                      std::memory_order_relaxed );
+    };
+    uint64_t    value() const { return _value.load(std::memory_order_relaxed);};
+    void        reset(){    _value.store( 0, std::memory_order_relaxed );};
+    void        add(    const Counter&  other ){    inc( other.value() );};
+protected:
+    std::atomic<uint64_t>   _value;
+};
+
+/**
+ *  \note   metrics maintained by a wrapper, see Wrapper::metrics().<br>
+ *          gauges are computed on demand by the wrapper, see
+ *          Wrapper::pendingOutput() and Wrapper::pendingTimers().
+ * */
+class   Metrics{
+public:
+    Metrics();
+
+    Counter     accepts;        // tcp connections accepted.
+    Counter     closes;         // tcp connections closed.
+    Counter     reconnects;     // reconnections of tcp clients.
+    Counter     bytesIn;        // bytes read from tcp connections.
+    Counter     bytesOut;       // bytes written to tcp connections.
+    Counter     readCallbacks;  // tcp read callbacks.
+    Counter     writeCallbacks; // tcp write callbacks.
+    Counter     timersFired;    // timers of addTimer triggered.
+    Counter     httpRequests;   // http requests received.
+    Counter     slowCallbacks;  // see Wrapper::setSlowCallbackThreshold.
+    /**
+     * \note    violations of HttpServerOptions, each request or connection
+     *          counted once.
+     * */
+    Counter     httpTimeouts;       // connections closed by the timeout.
+    Counter     httpHeadersTooLarge;// requests over the headers size.
+    Counter     httpBodyTooLarge;   // requests over the body size.
+    Counter     httpBadRequests;    // malformed requests.
+    Counter     httpBadMethods;     // requests of methods not allowed.
+    Counter     httpKeepAliveLimits;// connections closed after the requests.
+    /**
+     * \note    http responses sent by status class, e.g. [2] for 2xx,
+     *          [0] for requests completed without a valid status.
+     * */
+    Counter     httpStatus[6];
+
+    /**
+     * \note    time callbacks of the wrapper into `callbackTime`, in
+     *          nanoseconds. it is off by default, for the two clock reads
+     *          per callback.
+     * */
+    void        setTiming(bool timing){ _timing = timing;};
+    bool        timing() const {    return _timing;};
+    /**
+     * \note    duration of callbacks, in nanoseconds, only to be read in the
+     *          loop thread.
+     * */
+    Histogram   callbackTime;
+    /**
+     * \note    scheduling lag of the loop, in nanoseconds, see
+     *          Wrapper::setLagProbe. only to be read in the loop thread.
+     * */
+    Histogram   loopLag;
+
+    void        reset();
+    /**
+     * \note    add the counters, and the histograms if `histograms`, of
+     *          `other`, e.g. of another loop thread. the histograms of
+     *          `other` are read as they are, so merge them once its loop is
+     *          stopped.
+     * */
+    void        merge(  const Metrics&  other,
+                        bool            histograms  = true );
+protected:
+    bool        _timing;
+};  // class Metrics
+
+NS_LEW_END();
+
+#endif
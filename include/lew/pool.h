@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_POOL_H
+#define LEW_POOL_H
+
+#include    <cstdint>
+#include    <string>
+#include    <vector>
+
+#include    "lew/rpc.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   pool of rpc connections over replicated endpoints.<br>
+ *          each endpoint gets `connsPerEndpoint` connections, opened by
+ *          start(). endpoints whose calls keep failing, or whose latency is
+ *          over the limit, are ejected for a while, and closed connections
+ *          are opened again by a periodic health check.
+ *
+ * */
+class   ClientPool{
+public:
+    enum    Policy{
+        ROUND_ROBIN         = 0,
+        POWER_OF_TWO,           // the less loaded of two random endpoints.
+        EWMA_LATENCY,           // the lowest latency, weighted by load.
+        CONSISTENT_HASH,        // the endpoint owning the key on a hash ring.
+    };
+    struct  Endpoint{
+        std::string     addr;
+        uint16_t        port;
+    };
+
+    ClientPool( Wrapper*                        owner,
+                const std::vector<Endpoint>&    endpoints,
+                int                             connsPerEndpoint,
+                Policy                          policy,
+                int                             timeoutMs   = 1000 );
+    virtual ~ClientPool();
+
+    /**
+     * \note    open the connections, and start the health check.
+     * \return  0 on success, or -1 if no connection can be started.
+     * */
+    int             start();
+
+    /**
+     * \note    pick a connection by the policy.
+     * \param   key     the key for CONSISTENT_HASH, ignored otherwise.
+     * \return  the client, or nullptr if no endpoint is available.
+     * */
+    RpcClient*      pick(   const char*     key     = nullptr,
+                            size_t          keyLen  = 0 );
+    /**
+     * \note    send a request on a picked connection, see RpcClient::call.
+     * \return  the correlation id, or 0 on failure.
+     * */
+    uint64_t        call(   const void*     data,
+                            size_t          len,
+                            rpc_handler_t   handler,
+                            void*           arg,
+                            const char*     key     = nullptr,
+                            size_t          keyLen  = 0 );
+
+    /**
+     * \note    ejection thresholds: calls failed in a row, and response
+     *          time in microseconds (0 for no limit). an ejected endpoint
+     *          is back after `ejectMs`.
+     * */
+    void            setEjection(    int     maxFailures,
+                                    double  maxLatencyUs,
+                                    int     ejectMs );
+    /**
+     * \note    at most this percent of the endpoints are ejected at once.
+     * */
+    void            setMaxEjectedPercent(int percent){
+        _maxEjectedPercent  = percent;
+    };
+
+    size_t          endpointCount(){    return _endpoints.size();};
+    bool            ejected(size_t endpoint);
+    size_t          inflight(size_t endpoint);
+    double          latencyEwma(size_t endpoint);
+    /**
+     * \note    index of the endpoint of a client picked from the pool.
+     * */
+    int             endpointOf(RpcClient* client);
+protected:
+    struct  Node{
+        Endpoint                    ep;
+        std::vector<RpcClient*>     clients;
+        int64_t                     ejectedUntil;   // ms, 0 when healthy.
+    };
+    Wrapper*                        _owner;
+    std::vector<Node>               _endpoints;
+    int                             _connsPerEndpoint;
+    Policy                          _policy;
+    int                             _timeoutMs;
+    int                             _maxFailures;
+    double                          _maxLatencyUs;
+    int                             _ejectMs;
+    int                             _maxEjectedPercent;
+    size_t                          _next;
+    unsigned                        _seed;
+    std::vector< std::pair<uint64_t, size_t> >  _ring;
+    struct event*                   _health;
+    //
+    bool            available(size_t endpoint);
+    int             pickEndpoint(const char* key, size_t keyLen);
+    RpcClient*      pickClient(size_t endpoint);
+    void            connect(size_t endpoint, size_t slot);
+    void            check();
+    static void     _health_cb( evutil_socket_t fd, short what, void* arg);
+};  // class ClientPool
+
+NS_LEW_END();
+
+#endif
+
@@ -0,0 +1,139 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_RAMP_H
+#define LEW_RAMP_H
+
+#include    <cstdint>
+#include    <chrono>
+#include    <map>
+#include    <string>
+#include    <unordered_map>
+#include    <vector>
+
+#include    "lew/wrapper.h"
+
+NS_LEW_BEGIN();
+
+class   ConnectionRamp;
+
+typedef void(Wrapper::*ramp_handler_t)(ConnectionRamp* ramp);
+
+/**
+ *  \note   opens tcp client connections at a paced rate.<br>
+ *          at most `maxInflight` connects are pending at once, failed
+ *          connects are retried with exponential backoff, and the connect
+ *          times are kept for percentiles. connections are created by
+ *          Wrapper::startTcpClient, and are left to the wrapper once they
+ *          are connected.
+ *
+ * */
+class   ConnectionRamp: public MessageHandler{
+public:
+    ConnectionRamp( Wrapper*            owner,
+                    const std::string&  addr,
+                    uint16_t            port );
+    virtual ~ConnectionRamp();
+
+    /**
+     * \note    connects per second, default to 1000.
+     * */
+    void        setRate(double  perSecond){ _rate = perSecond;};
+    /**
+     * \note    pending connects at most, default to 1000.
+     * */
+    void        setMaxInflight(int  maxInflight){ _maxInflight = maxInflight;};
+    /**
+     * \note    retry a failed connect up to `maxRetries` times, waiting
+     *          `backoffMs` first and doubling up to `maxBackoffMs`.
+     * */
+    void        setRetry(int maxRetries, int backoffMs, int maxBackoffMs);
+    /**
+     * \note    handler called when all the connects are done.
+     * */
+    void        setDoneHandler(ramp_handler_t handler){ _doneHandler = handler;};
+
+    /**
+     * \note    start to open `count` connections.
+     * \return  0 on success, or -1 on failure.
+     * */
+    int         start(long  count);
+    void        cancel();
+
+    long        started(){      return _started;};
+    long        connected(){    return _connected;};
+    long        failed(){       return _failed;};
+    long        retried(){      return _retried;};
+    long        inflight(){     return (long)_pending.size();};
+    bool        done(){         return _connected + _failed >= _count;};
+    /**
+     * \note    percentile of connect times, in milliseconds.
+     * \param   p       the percentile, from 0 to 100.
+     * */
+    double      connectTime(double  p);
+
+    virtual void    onMessage(  Connection* conn, const Slice& msg);
+    virtual void    onConnected(Connection* conn);
+    virtual void    onClose(    Connection* conn);
+protected:
+    typedef std::chrono::steady_clock       clock;
+    struct  Attempt{
+        clock::time_point   start;
+        int                 retries;
+    };
+    Wrapper*                                    _owner;
+    std::string                                 _addr;
+    uint16_t                                    _port;
+    double                                      _rate;
+    int                                         _maxInflight;
+    int                                         _maxRetries;
+    int                                         _backoffMs;
+    int                                         _maxBackoffMs;
+    ramp_handler_t                              _doneHandler;
+    long                                        _count;
+    long                                        _started;
+    long                                        _connected;
+    long                                        _failed;
+    long                                        _retried;
+    clock::time_point                           _begin;
+    std::unordered_map<Connection*, Attempt>    _pending;
+    std::multimap<clock::time_point, int>       _retries;
+    std::vector<double>                         _times;
+    struct event*                               _tick;
+    void            connect(int retries);
+    void            fail(int retries);
+    void            pace();
+    void            finish();
+    static void     _tick_cb( evutil_socket_t fd, short what, void* arg);
+};  // class ConnectionRamp
+
+NS_LEW_END();
+
+#endif
+
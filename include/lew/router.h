@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_ROUTER_H
+#define LEW_ROUTER_H
+
+#include    <string>
+#include    <vector>
+
+#include    <event2/http.h>
+
+#include    "lew/buffer.h"
+
+NS_LEW_BEGIN();
+
+class   Wrapper;
+class   Connection;
+
+/**
+ *  \note   parameters of a matched route, as views into the route and the
+ *          uri of the request, valid during the handler call only.
+ * */
+struct  HttpParams{
+    enum{   MAX_PARAMS  = 8 };
+    HttpParams(): count(0){};
+    /**
+     * \note    the value of a parameter, or an empty slice with a null data
+     *          if there is no such parameter.
+     * */
+    Slice       get( const char*    name ) const;
+    Slice       names[ MAX_PARAMS ];
+    Slice       values[ MAX_PARAMS ];
+    int         count;
+};
+
+/**
+ *  \note   handler of a http route.
+ * */
+typedef void(Wrapper::*http_handler_t)( Connection*             conn,
+                                        struct evhttp_request*  req,
+                                        const HttpParams&       params );
+
+/**
+ *  \note   http router on a compressed radix tree, see Wrapper::router().
+ *          <br>
+ *          a route is a path of static parts, parameters and an optional
+ *          wildcard at the end: a segment ":id" matches one segment of the
+ *          path, e.g. "/users/:id/posts", and a last segment "*path"
+ *          matches the rest of the path, even if empty.
+ *          static parts are tried first, then parameters, then wildcards,
+ *          for a route taking the method of the request.
+ *          matching takes no allocation; the path is matched as is, i.e.
+ *          percent-encoded bytes are not decoded.
+ *
+ * */
+class   HttpRouter{
+public:
+    HttpRouter();
+    virtual ~HttpRouter();
+
+    /**
+     * \note    add a route.
+     * \param   methods     the methods, e.g. EVHTTP_REQ_GET | EVHTTP_REQ_HEAD.
+     * \param   pattern     the path of the route, starting with '/'.
+     * \param   handler     the handler of the route.
+     * \return  0 on success, or -1 if the pattern is invalid, or conflicts
+     *          with a route added before.
+     * */
+    int         add(    int                 methods,
+                        const std::string&  pattern,
+                        http_handler_t      handler );
+    /**
+     * \note    handler of requests matching no route, the default one
+     *          replies 404.
+     * */
+    void        setNotFound(http_handler_t handler){ _notFound = handler;};
+    http_handler_t  notFound(){ return _notFound;};
+    bool        empty(){    return 0 == _routes;};
+
+    /**
+     * \note    match the path of a request, without the query.
+     * \return  200 with `handler` and `params` set, 404 if no route
+     *          matches, or 405 if the routes of the path take other methods.
+     * */
+    int         match(  evhttp_cmd_type     method,
+                        const Slice&        path,
+                        http_handler_t&     handler,
+                        HttpParams&         params ) const;
+
+    enum{   METHODS     = 9 };  // EVHTTP_REQ_GET to EVHTTP_REQ_PATCH
+    struct  Node;
+protected:
+    Node*                   _root;
+    size_t                  _routes;
+    http_handler_t          _notFound;
+};  // class HttpRouter
+
+NS_LEW_END();
+
+#endif
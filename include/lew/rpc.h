@@ -0,0 +1,140 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_RPC_H
+#define LEW_RPC_H
+
+#include    <cstdint>
+#include    <chrono>
+#include    <set>
+#include    <unordered_map>
+
+#include    "lew/wrapper.h"
+
+NS_LEW_BEGIN();
+
+class   RpcClient;
+
+/**
+ *  \note   handler of a rpc response.
+ *          `status` is 0 on response, ETIMEDOUT when the deadline passed,
+ *          or ECONNRESET when the connection is closed or reconnecting.
+ * */
+typedef void(Wrapper::*rpc_handler_t)(  RpcClient*      client,
+                                        int             status,
+                                        const Slice&    response,
+                                        void*           arg );
+
+/**
+ *  \note   pipelined request/response client over one tcp connection.<br>
+ *          each message is a frame of LengthCodec(4), whose payload starts
+ *          with the 8 bytes big endian correlation id of the call, followed
+ *          by the body. responses carry the id of their request, and may
+ *          come back in any order.
+ *
+ * */
+class   RpcClient: public MessageHandler{
+public:
+    /**
+     * \note    take over the frames of `conn`, e.g. from startTcpClient.
+     * \param   timeoutMs   default deadline of calls, in milliseconds.
+     * */
+    RpcClient(Wrapper*  owner, Connection* conn, int timeoutMs = 1000);
+    virtual ~RpcClient();
+
+    /**
+     * \note    send a request.
+     * \param   timeoutMs   deadline of the call, or the default if negative.
+     * \return  the correlation id, or 0 on failure.
+     * */
+    uint64_t        call(   const void*     data,
+                            size_t          len,
+                            rpc_handler_t   handler,
+                            void*           arg,
+                            int             timeoutMs = -1 );
+
+    struct  Request{
+        const void*     data;
+        size_t          len;
+        rpc_handler_t   handler;
+        void*           arg;
+    };
+    /**
+     * \note    send requests together, with one write.
+     * \return  count of requests sent.
+     * */
+    int             callBatch(  Request*    reqs,
+                                int         count,
+                                int         timeoutMs = -1 );
+
+    Connection*     connection(){   return _conn;};
+    size_t          inflight(){     return _calls.size();};
+    /**
+     * \note    moving average of the response time, in microseconds.
+     * */
+    double          latencyEwma(){  return _latencyEwma;};
+    /**
+     * \note    count of calls failed in a row, since the last response.
+     * */
+    int             failures(){     return _failures;};
+    void            resetStats(){   _latencyEwma = 0; _failures = 0;};
+
+    virtual void    onMessage(  Connection* conn, const Slice& msg);
+    virtual void    onReset(    Connection* conn);
+    virtual void    onClose(    Connection* conn);
+protected:
+    typedef std::chrono::steady_clock           clock;
+    struct  Call{
+        rpc_handler_t       handler;
+        void*               arg;
+        clock::time_point   start;
+        clock::time_point   deadline;
+    };
+    typedef std::unordered_map<uint64_t, Call>                  CallMap;
+    typedef std::set< std::pair<clock::time_point, uint64_t> >  DeadlineSet;
+    Wrapper*            _owner;
+    Connection*         _conn;
+    LengthCodec         _codec;
+    int                 _timeoutMs;
+    uint64_t            _nextId;
+    CallMap             _calls;
+    DeadlineSet         _deadlines;
+    struct event*       _timer;
+    double              _latencyEwma;
+    int                 _failures;
+    void                armTimer();
+    void                finish( uint64_t id, int status, const Slice& resp);
+    void                failAll( int status );
+    static void         _timeout_cb( evutil_socket_t fd, short what, void* arg);
+};  // class RpcClient
+
+NS_LEW_END();
+
+#endif
+
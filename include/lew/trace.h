@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_TRACE_H
+#define LEW_TRACE_H
+
+#include    <cstdint>
+#include    <string>
+#include    <vector>
+
+#include    "lew/utildef.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   an event of the trace, see Tracer.
+ * */
+struct  TraceEvent{
+    const char*     name;       // static string, e.g. "read".
+    char            phase;      // 'X' for a span, 'i' for an instant.
+    uint64_t        conn;       // id of the connection, 0 for none.
+    int64_t         start;      // CLOCK_MONOTONIC, in nanoseconds.
+    int64_t         duration;   // in nanoseconds.
+};
+
+/**
+ *  \note   timeline of what the loop of a wrapper did, kept in a ring
+ *          buffer of the latest events, see Wrapper::setTracer.<br>
+ *          the tracer is written by the loop thread only, without locks;
+ *          dump it in the loop thread too, e.g. on SIGUSR2, which the
+ *          wrapper does by itself. the dump is in the Chrome trace_event
+ *          JSON format, to be opened by chrome://tracing or Perfetto.<br>
+ *          with sampling, all the events of one connection in N are kept,
+ *          and one timer in N, so the trace stays coherent per connection.
+ *
+ * */
+class   Tracer{
+public:
+    /**
+     * \param   capacity    events kept, rounded up to a power of two.
+     * */
+    Tracer( size_t  capacity = 65536 );
+
+    /**
+     * \note    keep the events of one connection in `oneIn`, default to 1.
+     * */
+    void        setSampling(unsigned oneIn){ _oneIn = oneIn ? oneIn : 1;};
+    unsigned    sampling(){     return _oneIn;};
+    /**
+     * \note    whether the events of a connection, or of a timer when
+     *          `conn` is 0, are to be recorded.
+     * */
+    bool        sampled(uint64_t conn){
+        return  1 == _oneIn || (conn ? conn : ++_tick) % _oneIn == 0;
+    };
+    void        record( const char* name,   char    phase,  uint64_t conn,
+                        int64_t     start,  int64_t duration );
+
+    /**
+     * \note    file written by dump() without a path, default to
+     *          "lew-trace-<pid>.json".
+     * */
+    void        setDumpPath(const std::string& path){ _dumpPath = path;};
+    /**
+     * \note    write the events kept as Chrome trace_event JSON.
+     * \return  0 on success, or -1 on failure.
+     * */
+    int         dump(   const std::string&  path = "" );
+    std::string toJson();
+
+    size_t      size(){     return _next < _ring.size() ? _next : _ring.size();};
+    uint64_t    recorded(){ return _next;};
+    void        clear(){    _next = 0;};
+
+    static int64_t  now();
+protected:
+    std::vector<TraceEvent>     _ring;
+    uint64_t                    _mask;
+    uint64_t                    _next;
+    unsigned                    _oneIn;
+    uint64_t                    _tick;
+    long                        _tid;
+    std::string                 _dumpPath;
+};  // class Tracer
+
+NS_LEW_END();
+
+#endif
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_WEBSOCKET_H
+#define LEW_WEBSOCKET_H
+
+#include    <cstdint>
+
+#include    "lew/buffer.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   the header of a frame of RFC 6455.
+ * */
+struct  WsFrame{
+    bool            fin;
+    int             opcode;
+    bool            masked;
+    uint8_t         key[4];         // the masking key, if masked.
+    uint64_t        length;         // of the payload.
+};
+
+/**
+ *  \note   codec of the frames of WebSocket.
+ *          <br>
+ *          unmasking, a XOR over every byte of the payloads from clients,
+ *          runs on AVX2 or SSE2 when the cpu has them, chosen at run time.
+ * */
+class   WsCodec{
+public:
+    enum    Opcode{
+        CONTINUATION    = 0x0,
+        TEXT            = 0x1,
+        BINARY          = 0x2,
+        CLOSE           = 0x8,
+        PING            = 0x9,
+        PONG            = 0xa,
+    };
+    enum    Isa {
+        ISA_SCALAR  = 0,
+        ISA_SSE2,
+        ISA_AVX2,
+    };
+    enum{   MAX_HEADER  = 14 };
+    /**
+     * \note    parse the header of a frame at `data`.
+     * \return  bytes of the header, 0 if more bytes are needed, or -1 if
+     *          reserved bits are set or the length is over 63 bits.
+     * */
+    static int          parseHeader(const char*     data,
+                                    size_t          len,
+                                    WsFrame&        frame );
+    /**
+     * \note    write the header of a frame to `out`, of MAX_HEADER bytes at
+     *          least, masked by `key` if not nullptr.
+     * \return  bytes of the header.
+     * */
+    static size_t       writeHeader(char*           out,
+                                    int             opcode,
+                                    bool            fin,
+                                    uint64_t        length,
+                                    const uint8_t*  key = nullptr );
+    /**
+     * \note    XOR `data` in place by `key`, `offset` bytes into the
+     *          payload. masking and unmasking are the same.
+     * */
+    static void         unmask(     char*           data,
+                                    size_t          len,
+                                    const uint8_t   key[4],
+                                    size_t          offset  = 0 );
+    /**
+     * \note    a whole unmasked frame of `data`, e.g. to be broadcast to
+     *          the connections of Wrapper::webSocketConnectionSet().
+     * \return  a new buffer with one reference, or nullptr on failure.
+     * */
+    static SharedBuffer*    frame(  const void*     data,
+                                    size_t          len,
+                                    int             opcode  = TEXT );
+    /**
+     * \note    the Sec-WebSocket-Accept of `key`, 28 bytes and a '\0'.
+     * */
+    static void         accept(     const char*     key,
+                                    size_t          len,
+                                    char            out[29] );
+    /**
+     * \note    if `data` is well formed UTF-8, as a text message must be:
+     *          no overlong form, surrogate, or code point over U+10FFFF.
+     * */
+    static bool         validUtf8(  const char*     data,
+                                    size_t          len );
+    /**
+     * \note    if `code` may be sent in a close frame, as registered by
+     *          RFC 6455 or in the range of the applications.
+     * */
+    static bool         validCloseCode( int code );
+    /**
+     * \note    the instructions unmask() runs on, as HttpParser::isa().
+     * */
+    static Isa          isa();
+    static Isa          setIsa( Isa     isa );
+    static const char*  isaName(Isa     isa );
+};  // class WsCodec
+
+NS_LEW_END();
+
+#endif
@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#ifndef LEW_WORKERS_H
+#define LEW_WORKERS_H
+
+#include    <cstdint>
+#include    <string>
+#include    <thread>
+#include    <vector>
+
+#include    "lew/wrapper.h"
+
+NS_LEW_BEGIN();
+
+/**
+ *  \note   http server over several loop threads.<br>
+ *          each thread runs a wrapper of its own, created by the factory,
+ *          with its own evhttp, connections and metrics. the wrappers accept
+ *          on sockets bound to the same port with SO_REUSEPORT, so that the
+ *          kernel spreads the connections over them, or on one shared
+ *          socket. a connection stays in the thread which accepted it, so
+ *          the callbacks and the router of a wrapper are unchanged, and set
+ *          up per wrapper, e.g. in its constructor.
+ *
+ * */
+class   HttpWorkers{
+public:
+    /**
+     * \note    create the wrapper of the index-th thread.
+     * */
+    typedef Wrapper* (*factory_t)( int  index, void*    arg );
+
+    HttpWorkers(    factory_t   factory,
+                    void*       arg     = nullptr );
+    virtual ~HttpWorkers();
+
+    /**
+     * \note    accept on one socket per thread with SO_REUSEPORT, which is
+     *          the default, or on one socket shared by the threads.
+     * */
+    void        setReusePort(bool reusePort){ _reusePort = reusePort;};
+
+    /**
+     * \note    create the wrappers and their listening sockets.
+     * \param   listenAddr  the listening address, must be IPv4.
+     * \param   port        the listening port.
+     * \param   threads     count of loop threads.
+     * \return  true on success, or false on failure.
+     * */
+    bool        listen( const std::string&  listenAddr,
+                        uint16_t            port,
+                        int                 threads );
+    /**
+     * \note    run the loops, the first one in the calling thread, which
+     *          handles the signals, and return once it is stopped, after
+     *          stopping and joining the others.
+     * \return  true on success, or false on failure.
+     * */
+    bool        run();
+    /**
+     * \note    stop the loops, from any thread.
+     * */
+    void        stop();
+
+    int         size(){ return (int)_workers.size();};
+    Wrapper*    worker( int index ){ return _workers[ index ];};
+    /**
+     * \note    the metrics of the wrappers summed up. the counters are read
+     *          at any time, the histograms are only merged once run()
+     *          returned.
+     * */
+    void        metrics( Metrics&   out );
+
+protected:
+    factory_t                   _factory;
+    void*                       _arg;
+    bool                        _reusePort;
+    bool                        _running;
+    std::vector<Wrapper*>       _workers;
+    std::vector<struct event*>  _stops;
+    std::vector<std::thread>    _threads;
+    void        join();
+};  // class HttpWorkers
+
+NS_LEW_END();
+
+#endif
@@ -29,10 +29,12 @@
 #ifndef LEW_WRAPPER_H
 #define LEW_WRAPPER_H
 
+#include    <netinet/in.h>
 #include    <cstdint>
 #include    <exception>
 #include    <vector>
 #include    <string>
+#include    <unordered_map>
 #include    <unordered_set>
 
 #include    <event2/event.h>
@@ -44,6 +46,12 @@
 #include    <event2/listener.h>
 
 #include    "lew/connection.h"
+#include    "lew/metrics.h"
+#include    "lew/trace.h"
+#include    "lew/router.h"
+#include    "lew/cache.h"
+#include    "lew/http1.h"
+#include    "lew/websocket.h"
 
 NS_LEW_BEGIN();
 
@@ -68,6 +76,51 @@ public:
     struct event*       evt;        // internal event used.
 };
 
+/**
+ *  \note   limits of the http server, see Wrapper::setHttpServerOptions.
+ *          each violation is counted in its own counter of the metrics.
+ * */
+struct  HttpServerOptions{
+    HttpServerOptions(){
+        timeoutMs           = 0;
+        maxHeadersSize      = -1;
+        maxBodySize         = -1;
+        allowedMethods      = EVHTTP_REQ_GET | EVHTTP_REQ_POST |
+                              EVHTTP_REQ_HEAD | EVHTTP_REQ_PUT |
+                              EVHTTP_REQ_DELETE;
+        maxKeepAliveRequests= 0;
+        streamBodies        = false;
+        spoolThreshold      = 0;
+        spoolDir            = "/tmp";
+        pipelineDepth       = 16;
+        maxWsMessageSize    = 16 * 1024 * 1024;
+    }
+    int             timeoutMs;              // read and write timeout of
+                                            // connections, 0 for evhttp's
+                                            // default of 50 seconds.
+    ev_ssize_t      maxHeadersSize;         // bytes of the request line and
+                                            // headers, -1 for no limit, or
+                                            // 16 KB on the native engine.
+    ev_ssize_t      maxBodySize;            // bytes of the body, -1 for no
+                                            // limit.
+    int             allowedMethods;         // others are replied 405.
+    int             maxKeepAliveRequests;   // requests per connection, 0 for
+                                            // no limit.
+    bool            streamBodies;           // pass request bodies to
+                                            // Wrapper::onHttpBodyChunk.
+    size_t          spoolThreshold;         // bodies over it are spooled to
+                                            // a file by the default
+                                            // onHttpBodyChunk, 0 for never.
+    std::string     spoolDir;               // directory of the spool files.
+    int             pipelineDepth;          // requests of a connection of the
+                                            // native http server waiting for
+                                            // their responses, 0 for no
+                                            // limit.
+    size_t          maxWsMessageSize;       // bytes of a WebSocket message,
+                                            // closed 1009 over it, 0 for no
+                                            // limit.
+};
+
 class   ConstructException: public std::exception{
 public:
     virtual const char* what() const throw(){
@@ -120,6 +173,23 @@ public:
      * */
     Connection*     startTcpClient( std::string     remoteAddr,
                                     uint16_t        port );
+    /**
+     * \note    bind tcp client connections created afterwards to the given
+     *          source addresses, in round robin, e.g. loopback aliases
+     *          127.0.0.x. with IP_BIND_ADDRESS_NO_PORT the port is picked at
+     *          connect time, so each address offers its own range of
+     *          ephemeral ports to every remote.
+     * \param   addrs       IPv4 addresses, empty to let the kernel choose.
+     * \return  true on success, or false if an address is invalid.
+     * */
+    bool            setSourceAddresses(const std::vector<std::string>& addrs);
+    /**
+     * \note    close tcp client connections created afterwards with SO_LINGER
+     *          of zero, i.e. with a reset instead of a TIME_WAIT, meant for
+     *          load generating clients.
+     * */
+    void            setLingerZero(bool  lingerZero){ _lingerZero = lingerZero;};
+
     /**
      * \note    start a http server.
      * \param   listenAddr  the listening address, must be IPv4.
@@ -128,6 +198,35 @@ public:
      * */
     bool            startHttpServer(std::string     listenAddr,
                                     uint16_t        port);
+    /**
+     * \note    start a http server on a listening socket, e.g. one of the
+     *          sockets of HttpWorkers. the socket is closed by the wrapper.
+     * \param   fd          the bound and listening socket, nonblocking.
+     * \return  true on success, or false on failure
+     * */
+    bool            startHttpServer(evutil_socket_t fd);
+    /**
+     * \note    set the limits of http servers started afterwards.
+     *          requests over the body size are replied 413, and those over
+     *          the headers size or malformed 400, by evhttp, before reaching
+     *          the wrapper.
+     * */
+    void            setHttpServerOptions( const HttpServerOptions& options );
+    const HttpServerOptions&    httpServerOptions(){ return _httpOptions; };
+    /**
+     * \note    start the native http server, an HTTP/1.1 engine on the
+     *          bufferevents of the wrapper in place of evhttp: requests are
+     *          parsed in place by HttpParser, delivered to
+     *          onNativeHttpRequest, and replied by sendNativeHttpResponse().
+     *          the options of setHttpServerOptions() apply to it, requests
+     *          with a chunked body are replied 411 though.
+     * \param   listenAddr  the listening address, must be IPv4.
+     * \param   port        the listening port.
+     * \return  true on success, or false on failure
+     * */
+    bool            startNativeHttpServer(  std::string     listenAddr,
+                                            uint16_t        port);
+    void            stopNativeHttpServer();
     /**
      * \note    start a http connection to remote host.
      * \param   remoteAddr  the IPv4 address of remote http server.
@@ -143,6 +242,95 @@ public:
     void            stopHttpServer();
     void            stopHttpClient();
 
+    /**
+     * \note    close a connection created by the wrapper, and release it.
+     * */
+    void            closeConnection(Connection*     conn);
+
+    /**
+     * \note    what broadcast does with a connection whose output has
+     *          more than `maxQueued` bytes pending.
+     * */
+    enum    SlowConsumerPolicy{
+        SLOW_CONSUMER_SKIP      = 0,    // skip the buffer for the connection.
+        SLOW_CONSUMER_CLOSE,            // close the connection.
+    };
+    /**
+     * \note    append a shared buffer to the output of each connection of a
+     *          group, without copying the content.
+     * \param   group       the connections, e.g. tcpServerConnectionSet().
+     * \param   buf         the buffer to send.
+     * \param   maxQueued   pending output bytes over which a connection is
+     *                      taken as slow consumer, zero for no limit.
+     * \param   policy      what to do with slow consumers.
+     * \return  count of connections the buffer is appended to.
+     * */
+    int             broadcast(  ConnectionSet&      group,
+                                SharedBuffer*       buf,
+                                size_t              maxQueued   = 0,
+                                SlowConsumerPolicy  policy      =
+                                    SLOW_CONSUMER_SKIP );
+
+    /**
+     * \note    the router of the http server. once it has a route, requests
+     *          are dispatched by it, instead of onHttpRequest.
+     * */
+    HttpRouter&     router(){   return _router; };
+    /**
+     * \note    put `cache` in front of the handlers of the http server, see
+     *          HttpCache. the cache is not owned, and serves this wrapper
+     *          only. set it before the http server starts, nullptr for no
+     *          cache, which is the default.
+     * */
+    void            setHttpCache(HttpCache*  cache){ _httpCache = cache; };
+    HttpCache*      httpCache(){    return _httpCache; };
+    /**
+     * \note    reply a request of the http server, as evhttp_send_reply()
+     *          does, through the cache if the request fills it. a handler
+     *          replying otherwise is not cached.
+     * \param   body        the body, drained, or nullptr.
+     * */
+    void            sendHttpReply(  Connection*             conn,
+                                    struct evhttp_request*  req,
+                                    int                     code,
+                                    const char*             reason,
+                                    struct evbuffer*        body );
+    /**
+     * \note    start a chunked reply of a request of the http server, whose
+     *          body is written by writeHttpStream() and ended by
+     *          endHttpStream(). `handler` is called each time the output of
+     *          the connection drains below `watermark` after a chunk, to
+     *          write more; it's called with a null request if the
+     *          connection closes before the end, the stream is over then.
+     *          writing only while httpStreamWritable() keeps the memory of
+     *          a stream at about `watermark` plus a chunk.
+     * \return  0 on success, or -1 on failure.
+     * */
+    int             startHttpStream(Connection*             conn,
+                                    struct evhttp_request*  req,
+                                    int                     code,
+                                    const char*             reason,
+                                    http_stream_handler_t   handler,
+                                    void*                   arg,
+                                    size_t                  watermark =
+                                                                64 * 1024 );
+    /**
+     * \note    write a chunk of the streaming reply of `conn`.
+     * \param   chunk       the chunk, drained.
+     * \return  0 on success, or -1 if there's no stream.
+     * */
+    int             writeHttpStream(Connection*             conn,
+                                    struct evbuffer*        chunk );
+    /**
+     * \note    whether the output of the stream is below its watermark.
+     * */
+    bool            httpStreamWritable(Connection*          conn);
+    /**
+     * \note    end the streaming reply of `conn`.
+     * \return  0 on success, or -1 if there's no stream.
+     * */
+    int             endHttpStream(  Connection*             conn);
+
     /**
      * \note    make a new http request on an http client connection.
      * \param   conn        the connection created by startHttpClient.
@@ -179,6 +367,12 @@ public:
      * */
     virtual void    onConnectionRead(   Connection* conn){};
 
+    /**
+     * \note    callback method called for each frame received on a connection
+     *          with a codec. the frame is only valid during the call.
+     * */
+    virtual void    onMessage(  Connection* conn, const Slice& msg){};
+
     /**
      * \note    callback method called when a connection is ready to write.
      * */
@@ -195,6 +389,128 @@ public:
      *          a request.
      * */
     virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){};
+    /**
+     * \note    callback method called when a connection of the native http
+     *          server receives a request. `req` and its views are valid
+     *          until the request is replied, which may happen later.
+     *          pipelined requests are dispatched as they're parsed, without
+     *          waiting for the responses of earlier ones, which are written
+     *          in the order of the requests whatever order they're replied.
+     * */
+    virtual void    onNativeHttpRequest(Connection* conn, HttpRequest& req){};
+    /**
+     * \note    reply the request of a connection of the native http server
+     *          being dispatched to onNativeHttpRequest, or out of it, the
+     *          first request not replied yet.
+     * \param   body        the body, copied into the output.
+     * \param   contentType the Content-Type, or nullptr for none.
+     * \param   headers     more headers, `count` of them.
+     * \return  0 on success, or -1 if the connection has no request.
+     * */
+    int             sendNativeHttpResponse( Connection*         conn,
+                                            int                 code,
+                                            const Slice&        body,
+                                            const char*         contentType =
+                                                                    nullptr,
+                                            const HttpHeader*   headers =
+                                                                    nullptr,
+                                            int                 count   = 0 );
+    /**
+     * \note    reply with a shared body, appended to the output by
+     *          reference.
+     * */
+    int             sendNativeHttpResponse( Connection*         conn,
+                                            int                 code,
+                                            SharedBuffer*       body,
+                                            const char*         contentType =
+                                                                    nullptr,
+                                            const HttpHeader*   headers =
+                                                                    nullptr,
+                                            int                 count   = 0 );
+    /**
+     * \note    reply `req` of a connection of the native http server, for
+     *          pipelined requests replied out of order.
+     * */
+    int             sendNativeHttpResponse( Connection*         conn,
+                                            const HttpRequest&  req,
+                                            int                 code,
+                                            const Slice&        body,
+                                            const char*         contentType =
+                                                                    nullptr,
+                                            const HttpHeader*   headers =
+                                                                    nullptr,
+                                            int                 count   = 0 );
+    int             sendNativeHttpResponse( Connection*         conn,
+                                            const HttpRequest&  req,
+                                            int                 code,
+                                            SharedBuffer*       body,
+                                            const char*         contentType =
+                                                                    nullptr,
+                                            const HttpHeader*   headers =
+                                                                    nullptr,
+                                            int                 count   = 0 );
+    /**
+     * \note    upgrade a request of the native http server to WebSocket,
+     *          from onNativeHttpRequest or later, once the earlier requests
+     *          of the connection are replied. the connection moves to
+     *          webSocketConnectionSet(), its messages are delivered to
+     *          onWsMessage, pings are answered, and it has no read timeout.
+     * \param   protocol    the Sec-WebSocket-Protocol chosen, or nullptr.
+     * \return  0 on success, or -1 after replying 400, or 426 for another
+     *          version, if `req` is not a handshake.
+     * */
+    int             upgradeWebSocket(   Connection*         conn,
+                                        const HttpRequest&  req,
+                                        const char*         protocol =
+                                                                nullptr );
+    /**
+     * \note    callback method called with each message of a WebSocket
+     *          connection, the fragments of a message joined. text messages
+     *          are not checked for UTF-8.
+     * */
+    virtual void    onWsMessage(Connection*     conn,
+                                const Slice&    msg,
+                                bool            binary){};
+    /**
+     * \note    send a message in a frame to a WebSocket connection.
+     * \return  0 on success, or -1 if it's not one, or is closing.
+     * */
+    int             sendWsMessage(  Connection*     conn,
+                                    const Slice&    msg,
+                                    bool            binary  = false );
+    /**
+     * \note    send a shared message, appended by reference.
+     * */
+    int             sendWsMessage(  Connection*     conn,
+                                    SharedBuffer*   msg,
+                                    bool            binary  = false );
+    /**
+     * \note    start the closing handshake of a WebSocket connection, it's
+     *          closed once the peer answers, or after the timeout of
+     *          HttpServerOptions.
+     * \return  0 on success, or -1 if it's not one, or is closing.
+     * */
+    int             closeWebSocket( Connection*     conn,
+                                    int             code    = 1000 );
+    /**
+     * \note    callback method called with each piece of the body of a
+     *          request to the http server before onHttpRequest, if
+     *          HttpServerOptions::streamBodies. HttpRequestContext::bodyLength
+     *          counts the chunk already.
+     *          the default one keeps the body in memory, to be found in the
+     *          input buffer of the request as usual, or once over the spool
+     *          threshold, in the file HttpRequestContext::bodyFd. a body
+     *          which can't be kept sets HttpRequestContext::bodyFailed, the
+     *          request is replied 500 then.
+     * */
+    virtual void    onHttpBodyChunk(HttpRequestContext*     ctx,
+                                    const Slice&            chunk);
+    /**
+     * \note    stop reading a http server connection, to apply back pressure
+     *          on the body of its request, until resumeHttpBody().
+     * */
+    void            pauseHttpBody(  Connection*     conn);
+    void            resumeHttpBody( Connection*     conn);
 
     /**
      * \note    callback method called when a http client connection receives
@@ -202,8 +518,27 @@ public:
      * */
     virtual void    onHttpResponse(Connection* conn, struct evhttp_request* req){};
 
+    friend class    Connection;
+    friend class    CallbackClock;
+    friend class    NativeHttpSession;
+    friend class    WebSocketSession;
+    friend void     _native_http_listen_cb( struct evconnlistener*  listener,
+                                            evutil_socket_t         fd,
+                                            struct sockaddr*        sock,
+                                            int                     socklen,
+                                            void*                   ctx);
+    friend void     _listen_cb( struct evconnlistener*  listener,
+                                evutil_socket_t         fd,
+                                struct sockaddr*        sock,
+                                int                     socklen,
+                                void*                   ctx);
     friend void     _event_cb( struct bufferevent*  bev, short evt, void* ctx);
     friend void     _timer_cb( int  s, short what, void* arg);
+    friend void     _flush_cb( int  s, short what, void* arg);
+    friend void     _lag_probe_cb( int  s, short what, void* arg);
+    friend void     _output_cb( struct evbuffer*                  buf,
+                                const struct evbuffer_cb_info*    info,
+                                void*                             ctx);
 
 public:
     /**
@@ -221,11 +556,102 @@ public:
      * */
     bool        delTimer(Timer*             timer);
 
+    /**
+     * \note    set the codec of tcp connections created afterwards, see
+     *          Connection::setCodec. the codec is not owned.
+     * */
+    void        setCodec(Codec* codec){ _codec = codec; };
+    Codec*      codec(){    return _codec; };
+
+    /**
+     * \note    coalesce the output of tcp connections created afterwards.
+     *          what's written during a loop iteration is held, and flushed
+     *          with one writev per connection at the end of the iteration,
+     *          or `usec` microseconds later if `usec` is positive.
+     * \param   usec        the flush delay, negative to turn it off.
+     * */
+    void        setWriteCoalescing(int  usec){ _flushUsec = usec; };
+    int         writeCoalescing(){ return _flushUsec; };
+
+    /**
+     * \note    total count of write syscalls and of writes into the output
+     *          buffers of tcp connections, the syscalls approximated as in
+     *          Connection::writeSyscalls.
+     * */
+    uint64_t    writeSyscalls(){    return _writeSyscalls; };
+    uint64_t    writeMessages(){    return _writeMessages; };
+
+    /**
+     * \note    counters and callback durations of the wrapper.
+     * */
+    Metrics&    metrics(){  return _metrics; };
+    /**
+     * \note    gauge of bytes queued in the output of tcp connections.
+     * */
+    size_t      pendingOutput();
+    /**
+     * \note    gauge of timers created by addTimer and not yet triggered.
+     * */
+    size_t      pendingTimers(){    return _timerSet.size(); };
+
+    /**
+     * \note    callbacks of the wrapper into user code.
+     * */
+    enum    CallbackType{
+        CALLBACK_ACCEPT         = 0,    // onNewConnection of an accept.
+        CALLBACK_READ,                  // onConnectionRead, onMessage.
+        CALLBACK_WRITE,                 // onConnectionWrite.
+        CALLBACK_EVENT,                 // connect, close, error.
+        CALLBACK_TIMER,                 // handler of addTimer.
+        CALLBACK_HTTP_REQUEST,          // onHttpRequest.
+        CALLBACK_HTTP_RESPONSE,         // onHttpResponse.
+    };
+    static const char*  callbackName(CallbackType   type);
+    /**
+     * \note    report callbacks taking more than `usec` microseconds, by
+     *          onSlowCallback, and count them in Metrics::slowCallbacks.
+     *          each callback is then timed with two clock reads.
+     * \param   usec        the threshold, negative to turn it off.
+     * */
+    void        setSlowCallbackThreshold(int    usec);
+    /**
+     * \note    callback method called after a slow callback returned.
+     *          the default one prints it to stderr.
+     * \param   addr        remote address of the connection, empty for
+     *                      timers.
+     * */
+    virtual void    onSlowCallback( CallbackType        type,
+                                    const std::string&  addr,
+                                    uint16_t            port,
+                                    int64_t             usec );
+    /**
+     * \note    record the callbacks, and the closes of connections, into
+     *          `tracer`, which is dumped on SIGUSR2. the tracer is not owned,
+     *          nullptr to turn it off.
+     * */
+    void        setTracer(Tracer*   tracer){ _tracer = tracer; };
+    Tracer*     tracer(){   return _tracer; };
+    /**
+     * \note    handle SIGTERM, SIGQUIT, SIGUSR1, SIGUSR2 and SIGINT in start(),
+     *          by onSignal, which is the default. libevent delivers signals
+     *          to one loop only, so only one wrapper of a process should.
+     * */
+    void        setSignalHandling(bool  on){ _signals = on; };
+    /**
+     * \note    probe the scheduling lag of the loop every `ms` milliseconds,
+     *          i.e. how late a timer fires, into Metrics::loopLag. the lag
+     *          is the time the loop spent in the iteration it was due in.
+     * \param   ms          interval of the probe, zero to turn it off.
+     * */
+    void        setLagProbe(int     ms);
+
 public:
     ConnectionSet&  tcpServerConnectionSet(){ return _tcpServerConnectionSet; };
     ConnectionSet&  tcpClientConnectionSet(){ return _tcpClientConnectionSet; };
     ConnectionSet&  httpServerConnectionSet(){return _httpServerConnectionSet;};
     ConnectionSet&  httpClientConnectionSet(){return _httpClientConnectionSet;};
+    ConnectionSet&  nativeHttpConnectionSet(){return _nativeHttpConnectionSet;};
+    ConnectionSet&  webSocketConnectionSet(){ return _webSocketConnectionSet; };
     struct event_base*      base(){ return _base; };
 
 protected:
@@ -234,6 +660,8 @@ protected:
     ConnectionSet           _tcpClientConnectionSet;
     ConnectionSet           _httpServerConnectionSet;
     ConnectionSet           _httpClientConnectionSet;
+    ConnectionSet           _nativeHttpConnectionSet;
+    ConnectionSet           _webSocketConnectionSet;
 protected:
     typedef std::unordered_set<Timer*>      TimerSet;
     TimerSet                                _timerSet;
@@ -241,9 +669,83 @@ protected:
     std::vector<struct evhttp*>             _http;
     bool                                    _started;
     bool                                    _stopped;
+    bool                                    _signals;
     struct event*                           _sig_events[256];
     //
     int             tcpClientReconnect( Connection* conn );
+    std::vector<struct sockaddr_in>         _srcAddrs;
+    size_t                                  _srcNext;
+    bool                                    _lingerZero;
+    int             tcpClientSocket( evutil_socket_t&   fd );
+    Codec*                                  _codec;
+    //
+    //  write coalescing
+    int                                     _flushUsec;
+    struct event*                           _flushEvent;
+    ConnectionSet                           _flushSet;
+    uint64_t                                _writeSyscalls;
+    uint64_t                                _writeMessages;
+    void            scheduleFlush( Connection* conn );
+    //
+    //  http server: one connection per evhttp connection, and pooled
+    //  request contexts.
+    typedef std::unordered_map<struct evhttp_connection*, Connection*>
+                                            HttpConnectionMap;
+    HttpConnectionMap                       _httpServerConns;
+    HttpServerOptions                       _httpOptions;
+    std::string                             _httpAllow;
+    std::vector<struct bufferevent*>        _httpAccepted;
+    struct event*                           _httpAcceptEvent;
+    HttpRouter                              _router;
+    HttpCache*                              _httpCache;
+    void            readHttpBody(   HttpRequestContext*     ctx );
+    //
+    //  native http server
+    std::vector<struct evconnlistener*>     _nativeLev;
+    Connection*     acceptConnection(   evutil_socket_t     fd,
+                                        ConnectionSet&      set );
+    void            dispatchNativeHttpRequest(  Connection*     conn,
+                                                HttpRequest&    req );
+    void            startWebSocket( Connection*     conn );
+    void            dispatchHttpRequest(    Connection*             conn,
+                                            struct evhttp_request*  req );
+    struct evhttp*  newHttpServer();
+    std::vector<HttpRequestContext*>        _httpCtxPool;
+    Connection*     httpServerConnection( struct evhttp_connection* evcon );
+    HttpRequestContext* acquireHttpContext( Connection*             conn,
+                                            struct evhttp_request*  req );
+    void            releaseHttpContext( HttpRequestContext* ctx );
+    friend void     _http_req_cb(   struct evhttp_request*  req, void* ctx);
+    friend void     _http_client_close_cb(  struct evhttp_connection* evcon,
+                                            void*                     ctx);
+    friend void     _http_req_done_cb(  struct evhttp_request*  req,
+                                        void*                   ctx);
+    friend bufferevent* _http_bev_cb(   struct event_base*  base,
+                                        void*               ctx);
+    friend void     _http_accept_cb(    evutil_socket_t fd, short what,
+                                        void*           arg);
+    friend void     _http_out_cb(   struct evbuffer*                buf,
+                                    const struct evbuffer_cb_info*  info,
+                                    void*                           ctx);
+    void            closeHttpServerConnection(
+                                    struct evhttp_connection*   evcon,
+                                    Connection*                 conn );
+    //
+    Metrics                                 _metrics;
+    int64_t                                 _slowNs;
+    Tracer*                                 _tracer;
+    bool            callbackClocked(){  return _slowNs >= 0 || _metrics.timing();};
+    void            callbackDone(   CallbackType        type,
+                                    uint64_t            conn,
+                                    const std::string&  addr,
+                                    uint16_t            port,
+                                    int64_t             start,
+                                    int64_t             ns,
+                                    bool                trace );
+    int                                     _lagMs;
+    int64_t                                 _lagDue;
+    struct event*                           _lagEvent;
+    void            scheduleLagProbe( int64_t now );
 
 };
 
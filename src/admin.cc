@@ -0,0 +1,359 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    <algorithm>
+#include    <cerrno>
+#include    <cinttypes>
+#include    <cstdarg>
+#include    <cstdio>
+#include    <cstring>
+#include    <vector>
+#include    "lew/admin.h"
+
+using namespace std;
+NS_LEW_BEGIN();
+
+/**
+ *  \note   what's kept of a connection for /debug/connections.
+ * */
+struct  ConnectionInfo{
+    const char*     set;
+    string          addr;
+    uint16_t        port;
+    int             status;
+    size_t          pending;
+    uint64_t        writeSyscalls;
+    uint64_t        writeMessages;
+};
+
+struct  AdminServer::Render{
+    AdminServer*                server;
+    struct evhttp_request*      req;
+    struct evhttp_connection*   evcon;
+    struct event*               next;
+    vector<ConnectionInfo>      conns;
+    size_t                      index;
+};
+
+static const char*  _status_names[] = {
+    "disconnected", "connecting", "connected" };
+
+/**
+ *  \note   every set of connections of the owner, as closed by
+ *          Wrapper::closeConnection.
+ * */
+static const int    _nsets          = 6;
+static const char*  _set_names[]    = {
+    "tcp_server", "tcp_client", "http_server", "http_client", "native_http",
+    "websocket" };
+
+static void
+_connection_sets( Wrapper* owner, ConnectionSet* sets[] ){
+    sets[0] = &owner->tcpServerConnectionSet();
+    sets[1] = &owner->tcpClientConnectionSet();
+    sets[2] = &owner->httpServerConnectionSet();
+    sets[3] = &owner->httpClientConnectionSet();
+    sets[4] = &owner->nativeHttpConnectionSet();
+    sets[5] = &owner->webSocketConnectionSet();
+}
+
+static void
+_append( string& out, const char* fmt, ... )
+    __attribute__((format(printf, 2, 3)));
+
+static void
+_append( string& out, const char* fmt, ... ){
+    char        buf[512];
+    va_list     args;
+    va_start( args, fmt );
+    int         len = vsnprintf( buf, sizeof(buf), fmt, args );
+    va_end( args );
+    if (len > 0){
+        out.append( buf, std::min( (size_t)len, sizeof(buf) - 1 ) );
+    }
+}
+
+static void
+_counter( string& out, const string& prefix, const char* name,
+          const char* help, uint64_t value ){
+    _append( out, "# HELP %s%s %s\n# TYPE %s%s counter\n%s%s %" PRIu64 "\n",
+             prefix.c_str(), name, help, prefix.c_str(), name,
+             prefix.c_str(), name, value );
+}
+
+static void
+_gauge( string& out, const string& prefix, const char* name,
+        const char* help, uint64_t value ){
+    _append( out, "# HELP %s%s %s\n# TYPE %s%s gauge\n%s%s %" PRIu64 "\n",
+             prefix.c_str(), name, help, prefix.c_str(), name,
+             prefix.c_str(), name, value );
+}
+
+/**
+ *  \note   a histogram of nanoseconds as a summary in seconds.
+ * */
+static void
+_summary( string& out, const string& prefix, const char* name,
+          const char* help, const Histogram& h ){
+    double      qs[]    = { 50, 90, 99, 99.9 };
+    _append( out, "# HELP %s%s %s\n# TYPE %s%s summary\n",
+             prefix.c_str(), name, help, prefix.c_str(), name );
+    for( auto q : qs ){
+        _append( out, "%s%s{quantile=\"%g\"} %.9f\n",
+                 prefix.c_str(), name, q / 100, h.percentile( q ) / 1e9 );
+    }
+    _append( out, "%s%s_sum %.9f\n%s%s_count %" PRId64 "\n",
+             prefix.c_str(), name, h.mean() * h.count() / 1e9,
+             prefix.c_str(), name, h.count() );
+}
+
+void
+_admin_req_cb( struct evhttp_request*  req, void* ctx){
+    AdminServer*            server  = (AdminServer*)ctx;
+    const struct evhttp_uri*    uri = evhttp_request_get_evhttp_uri( req );
+    const char*             path    = uri ? evhttp_uri_get_path( uri ) : NULL;
+    struct evkeyvalq*       headers = evhttp_request_get_output_headers( req );
+    if (evhttp_request_get_command( req ) != EVHTTP_REQ_GET || ! path){
+        evhttp_send_error( req, HTTP_BADMETHOD, NULL );
+    }
+    else if (strcmp( path, "/metrics" ) == 0){
+        string              text    = server->renderMetrics();
+        struct evbuffer*    body    = evbuffer_new();
+        evbuffer_add( body, text.data(), text.size() );
+        evhttp_add_header( headers, "Content-Type",
+                           "text/plain; version=0.0.4" );
+        evhttp_send_reply( req, HTTP_OK, "OK", body );
+        evbuffer_free( body );
+    }
+    else if (strcmp( path, "/debug/connections" ) == 0){
+        evhttp_add_header( headers, "Content-Type", "application/json" );
+        server->serveConnections( req );
+    }
+    else{
+        evhttp_send_error( req, HTTP_NOTFOUND, NULL );
+    }
+}
+
+void
+_admin_next_cb( evutil_socket_t fd, short what, void* arg){
+    AdminServer::Render*    render  = (AdminServer::Render*)arg;
+    size_t                  end     =
+        std::min( render->index + render->server->_chunk,
+                  render->conns.size() );
+    string                  text;
+    if (render->index == 0){
+        text    = "{\"connections\": [";
+    }
+    for( ; render->index < end; render->index++){
+        ConnectionInfo&     c   = render->conns[ render->index ];
+        _append( text, "%s\n{\"set\": \"%s\", \"addr\": \"%s\", \"port\": %u, "
+                 "\"status\": \"%s\", \"pending_output\": %zu, "
+                 "\"write_syscalls\": %" PRIu64 ", "
+                 "\"write_messages\": %" PRIu64 "}",
+                 render->index ? "," : "", c.set, c.addr.c_str(),
+                 (unsigned)c.port, _status_names[ c.status ], c.pending,
+                 c.writeSyscalls, c.writeMessages );
+    }
+    bool                    done    = render->index == render->conns.size();
+    if (done){
+        text    += "\n]}\n";
+    }
+    struct evbuffer*        chunk   = evbuffer_new();
+    evbuffer_add( chunk, text.data(), text.size() );
+    evhttp_send_reply_chunk( render->req, chunk );
+    evbuffer_free( chunk );
+    if (done){
+        evhttp_send_reply_end( render->req );
+        render->server->finish( render, false );
+    }
+    else{
+        event_active( render->next, EV_TIMEOUT, 0 );
+    }
+}
+
+void
+_admin_close_cb( struct evhttp_connection*  evcon, void* arg){
+    AdminServer::Render*    render  = (AdminServer::Render*)arg;
+    render->server->finish( render, true );
+}
+
+AdminServer::AdminServer( Wrapper* owner )
+    : _owner(owner), _http(nullptr), _prefix("lew_"), _chunk(256){
+}
+
+AdminServer::~AdminServer(){
+    stop();
+}
+
+bool
+AdminServer::start( const string& listenAddr, uint16_t port ){
+    if (_http){
+        errno   = EEXIST;
+        return  false;
+    }
+    _http   = evhttp_new( _owner->base() );
+    if (! _http){
+        return  false;
+    }
+    evhttp_set_gencb( _http, _admin_req_cb, this );
+    evhttp_set_allowed_methods( _http, EVHTTP_REQ_GET );
+    if (evhttp_bind_socket( _http, listenAddr.c_str(), port ) != 0){
+        evhttp_free( _http );
+        _http   = nullptr;
+        return  false;
+    }
+    return  true;
+}
+
+void
+AdminServer::stop(){
+    vector<Render*>     renders( _renders.begin(), _renders.end() );
+    for( auto render : renders ){
+        finish( render, false );
+    }
+    if (_http){
+        evhttp_free( _http );
+        _http   = nullptr;
+    }
+}
+
+void
+AdminServer::serveConnections( struct evhttp_request* req ){
+    Render*         render  = new Render;
+    render->server  = this;
+    render->req     = req;
+    render->evcon   = evhttp_request_get_connection( req );
+    render->index   = 0;
+    render->next    = event_new( _owner->base(), -1, 0, _admin_next_cb, render);
+    ConnectionSet*  sets[ _nsets ];
+    _connection_sets( _owner, sets );
+    for( int i = 0; i < _nsets; i++){
+        for( auto conn : *sets[i] ){
+            ConnectionInfo  info;
+            info.set            = _set_names[i];
+            info.addr           = conn->addr();
+            info.port           = conn->port();
+            info.status         = conn->status();
+            info.pending        = conn->writeBuf() ?
+                evbuffer_get_length( conn->writeBuf() ) : 0;
+            info.writeSyscalls  = conn->writeSyscalls();
+            info.writeMessages  = conn->writeMessages();
+            render->conns.push_back( info );
+        }
+    }
+    _renders.insert( render );
+    evhttp_connection_set_closecb( render->evcon, _admin_close_cb, render );
+    evhttp_send_reply_start( req, HTTP_OK, "OK" );
+    event_active( render->next, EV_TIMEOUT, 0 );
+}
+
+/**
+ *  \note   release a render. once aborted, the request is being freed by
+ *          libevent with its connection.
+ * */
+void
+AdminServer::finish( Render* render, bool aborted ){
+    if (! aborted && render->evcon){
+        evhttp_connection_set_closecb( render->evcon, NULL, NULL );
+    }
+    event_free( render->next );
+    _renders.erase( render );
+    delete  render;
+}
+
+string
+AdminServer::renderMetrics(){
+    string          out;
+    Metrics&        m   = _owner->metrics();
+    const string&   p   = _prefix;
+    _counter( out, p, "accepts_total", "tcp connections accepted.",
+              m.accepts.value() );
+    _counter( out, p, "closes_total", "tcp connections closed.",
+              m.closes.value() );
+    _counter( out, p, "reconnects_total", "reconnections of tcp clients.",
+              m.reconnects.value() );
+    _counter( out, p, "bytes_in_total", "bytes read from tcp connections.",
+              m.bytesIn.value() );
+    _counter( out, p, "bytes_out_total", "bytes written to tcp connections.",
+              m.bytesOut.value() );
+    _counter( out, p, "read_callbacks_total", "tcp read callbacks.",
+              m.readCallbacks.value() );
+    _counter( out, p, "write_callbacks_total", "tcp write callbacks.",
+              m.writeCallbacks.value() );
+    _counter( out, p, "timers_fired_total", "timers triggered.",
+              m.timersFired.value() );
+    _counter( out, p, "http_requests_total", "http requests received.",
+              m.httpRequests.value() );
+    _counter( out, p, "slow_callbacks_total", "callbacks over the threshold.",
+              m.slowCallbacks.value() );
+    _append( out, "# HELP %shttp_rejected_total http requests or connections "
+             "rejected by the server options.\n"
+             "# TYPE %shttp_rejected_total counter\n", p.c_str(), p.c_str() );
+    const char*     reasons[]   = { "timeout", "headers_too_large",
+                                    "body_too_large", "bad_request",
+                                    "bad_method", "keep_alive_limit" };
+    Counter*        rejects[]   = { &m.httpTimeouts, &m.httpHeadersTooLarge,
+                                    &m.httpBodyTooLarge, &m.httpBadRequests,
+                                    &m.httpBadMethods, &m.httpKeepAliveLimits };
+    for( int i = 0; i < 6; i++){
+        _append( out, "%shttp_rejected_total{reason=\"%s\"} %" PRIu64 "\n",
+                 p.c_str(), reasons[i], rejects[i]->value() );
+    }
+    _append( out, "# HELP %shttp_responses_total http responses sent.\n"
+             "# TYPE %shttp_responses_total counter\n",
+             p.c_str(), p.c_str() );
+    for( int i = 0; i < 6; i++){
+        char        code[8];
+        snprintf( code, sizeof(code), i ? "%dxx" : "unknown", i );
+        _append( out, "%shttp_responses_total{code=\"%s\"} %" PRIu64 "\n",
+                 p.c_str(), code, m.httpStatus[i].value() );
+    }
+    //
+    _append( out, "# HELP %sconnections live connections.\n"
+             "# TYPE %sconnections gauge\n", p.c_str(), p.c_str() );
+    ConnectionSet*  sets[ _nsets ];
+    _connection_sets( _owner, sets );
+    for( int i = 0; i < _nsets; i++){
+        _append( out, "%sconnections{set=\"%s\"} %zu\n",
+                 p.c_str(), _set_names[i], sets[i]->size() );
+    }
+    _gauge( out, p, "pending_output_bytes", "bytes queued for output.",
+            _owner->pendingOutput() );
+    _gauge( out, p, "pending_timers", "timers not yet triggered.",
+            _owner->pendingTimers() );
+    //
+    _summary( out, p, "callback_duration_seconds", "duration of callbacks.",
+              m.callbackTime );
+    _summary( out, p, "loop_lag_seconds", "scheduling lag of the loop.",
+              m.loopLag );
+    return  out;
+}
+
+NS_LEW_END();
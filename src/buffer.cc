@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#include    <cstdlib>
+#include    <cstring>
+#include    "lew/buffer.h"
+
+NS_LEW_BEGIN();
+
+static void
+_free_data(const void* data, size_t len, void* arg){
+    free( (void*)data );
+}
+
+SharedBuffer*
+SharedBuffer::create( const void* data, size_t len ){
+    void*   copy    = malloc( len ? len : 1 );
+    if (! copy){
+        return  nullptr;
+    }
+    memcpy( copy, data, len );
+    return  wrap( copy, len, _free_data, nullptr );
+}
+
+SharedBuffer*
+SharedBuffer::wrap( const void*         data,
+                    size_t              len,
+                    buffer_cleanup_t    cleanup,
+                    void*               arg ){
+    SharedBuffer*   buf = new SharedBuffer();
+    buf->_data      = data;
+    buf->_len       = len;
+    buf->_cleanup   = cleanup;
+    buf->_arg       = arg;
+    buf->_refs.store( 1 );
+    return  buf;
+}
+
+void
+SharedBuffer::unref(){
+    if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        if (_cleanup){
+            _cleanup( _data, _len, _arg );
+        }
+        delete  this;
+    }
+}
+
+void
+SharedBuffer::release(const void* data, size_t len, void* arg){
+    ((SharedBuffer*)arg)->unref();
+}
+
+int
+SharedBuffer::appendTo( struct evbuffer* buf ){
+    ref();
+    int     ret = evbuffer_add_reference( buf, _data, _len, release, this );
+    if (ret != 0){
+        unref();
+    }
+    return  ret;
+}
+
+NS_LEW_END();
+
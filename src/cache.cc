@@ -0,0 +1,356 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    <time.h>
+#include    <cstdio>
+#include    <cstdlib>
+#include    <cstring>
+#include    <algorithm>
+#include    <event2/keyvalq_struct.h>
+#include    "lew/cache.h"
+#include    "lew/connection.h"
+
+using namespace std;
+NS_LEW_BEGIN();
+
+typedef vector< pair<string, string> >  HeaderList;
+
+struct  HttpCache::Entry{
+    string              key;
+    SharedBuffer*       body;
+    string              etag;
+    HeaderList          headers;    // of the reply, but those of the
+                                    // connection and the framing.
+    int64_t             expires;    // CLOCK_MONOTONIC, in ns.
+    size_t              bytes;
+    EntryList::iterator pos;
+};
+
+static int64_t
+_now_ns(){
+    struct timespec     ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void
+_free_data(const void* data, size_t len, void* arg){
+    free( (void*)data );
+}
+
+/**
+ *  \note   FNV-1a of the body, quoted.
+ * */
+static string
+_etag( const void* data, size_t len ){
+    const unsigned char*    p   = (const unsigned char*)data;
+    uint64_t                h   = 14695981039346656037ULL;
+    char                    buf[24];
+    for( size_t i = 0; i < len; i++){
+        h   ^= p[i];
+        h   *= 1099511628211ULL;
+    }
+    snprintf( buf, sizeof(buf), "\"%016llx\"", (unsigned long long)h );
+    return  buf;
+}
+
+static bool
+_not_modified( struct evhttp_request* req, const string& etag ){
+    const char*     inm = evhttp_find_header(
+                            evhttp_request_get_input_headers( req ),
+                            "If-None-Match" );
+    if (! inm){
+        return  false;
+    }
+    while( ' ' == *inm || '\t' == *inm ){
+        inm++;
+    }
+    return  0 == strcmp( inm, "*" ) || strstr( inm, etag.c_str() );
+}
+
+/**
+ *  \note   the headers not replayed from the cache, of the framing or of a
+ *          client, e.g. its session cookie.
+ * */
+static bool
+_stored_header( const char* name ){
+    const char*     skipped[]   = { "Connection", "Content-Length", "Date",
+                                    "Transfer-Encoding", "Keep-Alive",
+                                    "Set-Cookie" };
+    for( auto s : skipped ){
+        if (0 == evutil_ascii_strcasecmp( name, s ) ){
+            return  false;
+        }
+    }
+    return  true;
+}
+
+/**
+ *  \note   if the reply may be shared, i.e. its Cache-Control has neither
+ *          private nor no-store.
+ * */
+static bool
+_shared_reply( struct evkeyvalq* headers ){
+    for( struct evkeyval* h = headers->tqh_first; h; h = h->next.tqe_next ){
+        if (evutil_ascii_strcasecmp( h->key, "Cache-Control" ) ){
+            continue;
+        }
+        const char*     p   = h->value;
+        while( *p ){
+            p   += strspn( p, " \t," );
+            size_t      n   = strcspn( p, " \t,=" );
+            if ((n == 7 && 0 == evutil_ascii_strncasecmp( p, "private", 7 )) ||
+                (n == 8 && 0 == evutil_ascii_strncasecmp( p, "no-store", 8 ))){
+                return  false;
+            }
+            p   += strcspn( p, "," );
+        }
+    }
+    return  true;
+}
+
+/**
+ *  \note   reply `body` by reference, or 304 if the client has it.
+ * */
+static void
+_reply(     HttpCache*              cache,
+            struct evhttp_request*  req,
+            int                     code,
+            const char*             reason,
+            SharedBuffer*           body,
+            const string&           etag,
+            const HeaderList*       headers ){
+    struct evkeyvalq*   out = evhttp_request_get_output_headers( req );
+    if (headers){
+        for( auto& h : *headers ){
+            evhttp_add_header( out, h.first.c_str(), h.second.c_str() );
+        }
+    }
+    evhttp_add_header( out, "ETag", etag.c_str() );
+    if (HTTP_OK == code && _not_modified( req, etag ) ){
+        cache->notModified.inc();
+        evhttp_send_reply( req, HTTP_NOTMODIFIED, "Not Modified", NULL );
+        return;
+    }
+    struct evbuffer*    buf = evbuffer_new();
+    if (buf && body->len() ){
+        body->appendTo( buf );
+    }
+    evhttp_send_reply( req, code, reason, buf );
+    if (buf){
+        evbuffer_free( buf );
+    }
+}
+
+HttpCache::HttpCache( size_t maxBytes, int ttlMs )
+    : _maxBytes( maxBytes ), _ttlNs( ttlMs * 1000000LL ), _bytes( 0 ){
+}
+
+HttpCache::~HttpCache(){
+    abort();
+    clear();
+}
+
+void
+HttpCache::clear(){
+    while( ! _lru.empty() ){
+        evict( _lru.back() );
+    }
+}
+
+void
+HttpCache::evict( Entry* entry ){
+    _bytes  -= entry->bytes;
+    _lru.erase( entry->pos );
+    _map.erase( entry->key );
+    entry->body->unref();
+    delete  entry;
+}
+
+string
+HttpCache::key( struct evhttp_request* req ){
+    string              k;
+    struct evkeyvalq*   in  = evhttp_request_get_input_headers( req );
+    k   += (char)('0' + evhttp_request_get_command( req ) );
+    k   += evhttp_request_get_uri( req );
+    for( auto& name : _vary ){
+        const char*     value   = evhttp_find_header( in, name.c_str() );
+        k   += '\n';
+        k   += value ? value : "";
+    }
+    return  k;
+}
+
+int
+HttpCache::lookup( HttpRequestContext* rc ){
+    evhttp_cmd_type     cmd     = evhttp_request_get_command( rc->req );
+    if (cmd != EVHTTP_REQ_GET && cmd != EVHTTP_REQ_HEAD){
+        return  FILL;
+    }
+    string              k       = key( rc->req );
+    auto                it      = _map.find( k );
+    if (it != _map.end() ){
+        Entry*          entry   = it->second;
+        if (entry->expires > _now_ns() ){
+            hits.inc();
+            _lru.splice( _lru.begin(), _lru, entry->pos );
+            _reply( this, rc->req, HTTP_OK, "OK", entry->body, entry->etag,
+                    &entry->headers );
+            return  SERVED;
+        }
+        evictions.inc();
+        evict( entry );
+    }
+    auto                f       = _fills.find( k );
+    if (f != _fills.end() ){
+        coalesced.inc();
+        f->second->waiters.push_back( rc );
+        rc->fill    = f->second;
+        return  WAIT;
+    }
+    misses.inc();
+    HttpCacheFill*      fill    = new HttpCacheFill;
+    fill->key       = k;
+    fill->filler    = rc;
+    rc->fill        = fill;
+    _fills[ k ]     = fill;
+    return  FILL;
+}
+
+void
+HttpCache::fill(    HttpRequestContext*     rc,
+                    int                     code,
+                    const char*             reason,
+                    struct evbuffer*        body,
+                    std::vector<HttpRequestContext*>&   unshared ){
+    HttpCacheFill*      fill    = rc->fill;
+    size_t              len     = body ? evbuffer_get_length( body ) : 0;
+    void*               data    = malloc( len ? len : 1 );
+    if (! data){
+        //  reply uncached, the waiters are handled once it's released.
+        evhttp_send_reply( rc->req, code, reason, body );
+        return;
+    }
+    if (len){
+        evbuffer_remove( body, data, len );
+    }
+    else{
+        *(char*)data    = 0;
+    }
+    SharedBuffer*       buf     = SharedBuffer::wrap( data, len, _free_data,
+                                                      nullptr );
+    string              etag    = _etag( data, len );
+    HeaderList          headers;
+    struct evkeyvalq*   out     = evhttp_request_get_output_headers( rc->req );
+    bool                shared  = _shared_reply( out );
+    size_t              bytes   = sizeof(Entry) + 2 * fill->key.size() +
+                                  etag.size() + len;
+    for( struct evkeyval* h = out->tqh_first; h; h = h->next.tqe_next ){
+        if (_stored_header( h->key ) ){
+            headers.push_back( make_pair( string(h->key), string(h->value) ));
+            bytes   += strlen( h->key ) + strlen( h->value );
+        }
+    }
+    _fills.erase( fill->key );
+    if (HTTP_OK == code && shared && bytes <= _maxBytes){
+        auto            it      = _map.find( fill->key );
+        if (it != _map.end() ){
+            evict( it->second );
+        }
+        while( _bytes + bytes > _maxBytes ){
+            evictions.inc();
+            evict( _lru.back() );
+        }
+        Entry*          entry   = new Entry;
+        entry->key      = fill->key;
+        entry->body     = buf;
+        entry->etag     = etag;
+        entry->headers  = headers;
+        entry->expires  = _now_ns() + _ttlNs;
+        entry->bytes    = bytes;
+        buf->ref();
+        _lru.push_front( entry );
+        entry->pos      = _lru.begin();
+        _map[ entry->key ]  = entry;
+        _bytes          += bytes;
+    }
+    //  detach the requests first, their completion releases them.
+    for( auto w : fill->waiters ){
+        w->fill     = nullptr;
+    }
+    rc->fill        = nullptr;
+    _reply( this, rc->req, code, reason, buf, etag, nullptr );
+    if (shared){
+        for( auto w : fill->waiters ){
+            _reply( this, w->req, code, reason, buf, etag, &headers );
+        }
+    }
+    else{
+        unshared.swap( fill->waiters );
+    }
+    buf->unref();
+    delete  fill;
+}
+
+HttpRequestContext*
+HttpCache::leave( HttpRequestContext* rc ){
+    HttpCacheFill*      fill    = rc->fill;
+    rc->fill    = nullptr;
+    if (fill->filler != rc){
+        auto    it  = std::find( fill->waiters.begin(), fill->waiters.end(), rc);
+        if (it != fill->waiters.end() ){
+            fill->waiters.erase( it );
+        }
+        return  nullptr;
+    }
+    if (fill->waiters.empty() ){
+        _fills.erase( fill->key );
+        delete  fill;
+        return  nullptr;
+    }
+    fill->filler    = fill->waiters.front();
+    fill->waiters.erase( fill->waiters.begin() );
+    return  fill->filler;
+}
+
+void
+HttpCache::abort(){
+    for( auto& it : _fills ){
+        HttpCacheFill*  fill    = it.second;
+        fill->filler->fill  = nullptr;
+        for( auto w : fill->waiters ){
+            w->fill     = nullptr;
+        }
+        delete  fill;
+    }
+    _fills.clear();
+}
+
+NS_LEW_END();
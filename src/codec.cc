@@ -0,0 +1,202 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#include    <cerrno>
+#include    <stdexcept>
+#include    "lew/codec.h"
+
+NS_LEW_BEGIN();
+
+Slice
+Codec::view( struct evbuffer* buf, size_t offset, size_t len ){
+    struct evbuffer_ptr     ptr;
+    struct evbuffer_iovec   vec;
+    if (0 == len){
+        return  Slice( "", 0 );
+    }
+    if (evbuffer_ptr_set( buf, &ptr, offset, EVBUFFER_PTR_SET) == 0 &&
+        evbuffer_peek( buf, len, &ptr, &vec, 1) == 1 ){
+        return  Slice( (const char*)vec.iov_base, len );
+    }
+    unsigned char*  data    = evbuffer_pullup( buf, offset + len );
+    return  Slice( (const char*)data + offset, len );
+}
+
+///////////////////////////////////
+LengthCodec::LengthCodec( int headerSize ): _headerSize(headerSize){
+    if (headerSize != 0 && headerSize != 1 && headerSize != 2 &&
+        headerSize != 4 && headerSize != 8 ){
+        throw   std::invalid_argument( "bad header size of LengthCodec" );
+    }
+}
+
+int
+LengthCodec::decode( struct evbuffer* buf, Slice& frame, size_t& frameLen ){
+    unsigned char   header[10];
+    size_t          avail   = evbuffer_get_length( buf );
+    size_t          hlen    = 0;
+    uint64_t        len     = 0;
+    if (_headerSize > 0){
+        hlen    = _headerSize;
+        if (avail < hlen){
+            return  0;
+        }
+        evbuffer_copyout( buf, header, hlen );
+        for( size_t i = 0; i < hlen; i++){
+            len = (len << 8) | header[i];
+        }
+    }
+    else{
+        ev_ssize_t  n   = evbuffer_copyout( buf, header, sizeof(header) );
+        for( ; hlen < (size_t)n; hlen++){
+            len |= (uint64_t)(header[hlen] & 0x7f) << (7 * hlen);
+            if (! (header[hlen] & 0x80) ){
+                break;
+            }
+        }
+        if (hlen == (size_t)n){
+            return  (n < (ev_ssize_t)sizeof(header)) ? 0 : -1;
+        }
+        hlen++;
+    }
+    if (len > _maxFrameSize){
+        errno   = EMSGSIZE;
+        return  -1;
+    }
+    if (avail < hlen + len){
+        return  0;
+    }
+    frame       = view( buf, hlen, len );
+    frameLen    = hlen + len;
+    return  1;
+}
+
+int
+LengthCodec::encode( struct evbuffer* buf, const void* data, size_t len ){
+    unsigned char   header[10];
+    size_t          hlen    = 0;
+    if (len > _maxFrameSize ||
+        (_headerSize > 0 && _headerSize < 8 &&
+         (uint64_t)len >> (8 * _headerSize) ) ){
+        errno   = EMSGSIZE;
+        return  -1;
+    }
+    if (_headerSize > 0){
+        hlen    = _headerSize;
+        for( size_t i = 0; i < hlen; i++){
+            header[hlen - i - 1]    = (unsigned char)(len >> (8 * i));
+        }
+    }
+    else{
+        uint64_t    v   = len;
+        do{
+            header[hlen++]  = (v & 0x7f) | (v > 0x7f ? 0x80 : 0);
+            v >>= 7;
+        }while( v );
+    }
+    if (evbuffer_add( buf, header, hlen) != 0){
+        return  -1;
+    }
+    return  evbuffer_add( buf, data, len );
+}
+
+///////////////////////////////////
+int
+DelimiterCodec::decode( struct evbuffer* buf, Slice& frame, size_t& frameLen){
+    size_t      scanned = 0;
+    return  decodeFrom( buf, frame, frameLen, scanned );
+}
+
+int
+DelimiterCodec::decodeFrom( struct evbuffer*    buf,
+                            Slice&              frame,
+                            size_t&             frameLen,
+                            size_t&             scanned ){
+    struct evbuffer_ptr start;
+    size_t              avail   = evbuffer_get_length( buf );
+    if (scanned > avail ||
+        evbuffer_ptr_set( buf, &start, scanned, EVBUFFER_PTR_SET) != 0 ){
+        scanned = 0;
+        evbuffer_ptr_set( buf, &start, 0, EVBUFFER_PTR_SET );
+    }
+    struct evbuffer_ptr pos = evbuffer_search( buf, _delim.data(),
+                                               _delim.size(), &start );
+    if (pos.pos < 0){
+        if (avail > _maxFrameSize + _delim.size() ){
+            errno   = EMSGSIZE;
+            return  -1;
+        }
+        //  a delimiter may start in the last bytes.
+        scanned = (avail >= _delim.size()) ? avail - _delim.size() + 1 : 0;
+        return  0;
+    }
+    scanned = 0;
+    if ((size_t)pos.pos > _maxFrameSize){
+        errno   = EMSGSIZE;
+        return  -1;
+    }
+    frame       = view( buf, 0, pos.pos );
+    frameLen    = pos.pos + _delim.size();
+    return  1;
+}
+
+int
+DelimiterCodec::encode( struct evbuffer* buf, const void* data, size_t len ){
+    if (evbuffer_add( buf, data, len) != 0){
+        return  -1;
+    }
+    return  evbuffer_add( buf, _delim.data(), _delim.size() );
+}
+
+///////////////////////////////////
+int
+FixedCodec::decode( struct evbuffer* buf, Slice& frame, size_t& frameLen ){
+    if (_size > _maxFrameSize){
+        errno   = EMSGSIZE;
+        return  -1;
+    }
+    if (evbuffer_get_length( buf ) < _size){
+        return  0;
+    }
+    frame       = view( buf, 0, _size );
+    frameLen    = _size;
+    return  1;
+}
+
+int
+FixedCodec::encode( struct evbuffer* buf, const void* data, size_t len ){
+    if (len != _size){
+        errno   = EINVAL;
+        return  -1;
+    }
+    return  evbuffer_add( buf, data, len );
+}
+
+NS_LEW_END();
+
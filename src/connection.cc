@@ -26,28 +26,86 @@
  *
  *
  * */
+#include    <sys/socket.h>
+#include    <atomic>
+#include    <cerrno>
+#include    <cstring>
+#ifdef      __linux__
+#   include <linux/errqueue.h>
+#endif
 #include    "lew/connection.h"
 #include    "lew/wrapper.h"
 
+#define     ZEROCOPY_THRESHOLD      (64 * 1024)
+#define     ZEROCOPY_POLL_USEC      1000
+
 NS_LEW_BEGIN();
 
+void    _output_cb( struct evbuffer*                  buf,
+                    const struct evbuffer_cb_info*    info,
+                    void*                             ctx);
+static void _input_cb(  struct evbuffer*                  buf,
+                        const struct evbuffer_cb_info*    info,
+                        void*                             ctx);
+
+static  std::atomic<uint64_t>    _nextId( 0 );
+
 Connection::Connection(
                        Wrapper*     owner,
                        Type         type,
                        const char*  addr,
                        uint16_t     port )
     : _owner(owner), _type(type), _addr(addr), _port(port){
+    _id         = _nextId.fetch_add( 1, std::memory_order_relaxed ) + 1;
     _bev        = nullptr;
     _readBuf    = nullptr;
     _writeBuf   = nullptr;
     _httpConn   = nullptr;
+    _httpReq    = nullptr;
+    _httpCtx    = nullptr;
+    _httpServed = 0;
+    _httpParsed = 0;
+    _httpBuffered   = 0;
+    _httpEvcon  = nullptr;
+    _httpCbs[0] = nullptr;
+    _httpCbs[1] = nullptr;
+    memset( &_httpActive, 0, sizeof(_httpActive) );
+    _codec      = nullptr;
+    _scanned    = 0;
+    _handler    = nullptr;
+    _alive      = nullptr;
     _retryTimes = 0;
+    _zcThreshold= ZEROCOPY_THRESHOLD;
+    _zcEnabled  = 0;
+    _zcNextSeq  = 0;
+    _zcEvent    = nullptr;
+    _corked     = false;
+    _autoFlush  = false;
+    _flushPending   = false;
+    _writeSyscalls  = 0;
+    _writeMessages  = 0;
 
     _status     = (CONN_TCP_CLIENT == type) ? DISCONNECTED : CONNECTED;
 }
 
 Connection::~Connection(){
+    if (CONN_TCP_SERVER == _type || CONN_TCP_CLIENT == _type){
+        _owner->_metrics.closes.inc();
+    }
+    if (_owner->_tracer && _owner->_tracer->sampled( _id ) ){
+        _owner->_tracer->record( "close", 'i', _id, Tracer::now(), 0 );
+    }
+    if (_alive){
+        *_alive = false;
+    }
     _owner->onConnectionClose( this );
+    if (_handler){
+        _handler->onClose( this );
+    }
+    if (_flushPending){
+        _owner->_flushSet.erase( this );
+    }
+    zeroCopyReset();
     if (_bev){
         bufferevent_free( _bev );
         _bev    = nullptr;
@@ -60,10 +118,16 @@ Connection::~Connection(){
 
 void
 Connection::setBev( struct bufferevent*     bev){
+    if (bev != _bev){
+        zeroCopyReset();
+        _scanned    = 0;
+    }
     if (  bev){
         _bev        = bev;
         _readBuf    = bufferevent_get_input( _bev );
         _writeBuf   = bufferevent_get_output(_bev);
+        evbuffer_add_cb( _readBuf,  _input_cb,  this );
+        evbuffer_add_cb( _writeBuf, _output_cb, this );
     }
     else{
         _bev        = nullptr;
@@ -86,5 +150,338 @@ Connection::setHttpReq( struct evhttp_request*  req){
     }
 }
 
+struct  ZeroCopyRef{
+    const void*         data;
+    size_t              len;
+    buffer_cleanup_t    cleanup;
+    void*               arg;
+    int                 refs;
+};
+
+static void
+_zerocopy_ref_release(const void* data, size_t len, void* arg){
+    ZeroCopyRef*    ref     = (ZeroCopyRef*)arg;
+    if (--ref->refs == 0){
+        if (ref->cleanup){
+            ref->cleanup( ref->data, ref->len, ref->arg );
+        }
+        delete  ref;
+    }
+}
+
+/**
+ *  \note   poll the completions while sends are pending. the socket is not
+ *          watched, as it's readable for data as well as for completions.
+ * */
+void
+_zerocopy_cb( evutil_socket_t fd, short what, void* ctx){
+    Connection*     conn    = (Connection*)ctx;
+    conn->zeroCopyDrain();
+}
+
+/**
+ *  \note   drain completion notifications from the socket error queue,
+ *          then poll again later if sends are still pending.
+ * */
+void
+Connection::zeroCopyDrain(){
+    evutil_socket_t fd      = _bev ? bufferevent_getfd( _bev ) : -1;
+#if defined(SO_EE_ORIGIN_ZEROCOPY)
+    char            control[128];
+    struct msghdr   msg;
+    while( fd >= 0 && ! _zcPending.empty() ){
+        memset( &msg, 0, sizeof(msg) );
+        msg.msg_control     = control;
+        msg.msg_controllen  = sizeof(control);
+        if (recvmsg( fd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0){
+            break;
+        }
+        for(struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm;
+            cm = CMSG_NXTHDR(&msg, cm) ){
+            struct sock_extended_err*   serr =
+                (struct sock_extended_err*)CMSG_DATA( cm );
+            if (serr->ee_errno == 0 &&
+                serr->ee_origin == SO_EE_ORIGIN_ZEROCOPY ){
+                zeroCopyComplete( serr->ee_info, serr->ee_data );
+            }
+        }
+    }
+#endif
+    if (! _zcPending.empty() ){
+        struct timeval  tv  = { 0, ZEROCOPY_POLL_USEC };
+        if (! _zcEvent){
+            _zcEvent    = evtimer_new( _owner->base(), _zerocopy_cb, this );
+        }
+        if (_zcEvent && ! evtimer_pending( _zcEvent, NULL ) ){
+            evtimer_add( _zcEvent, &tv );
+        }
+    }
+    else if (_zcEvent){
+        evtimer_del( _zcEvent );
+    }
+}
+
+int
+Connection::writeZeroCopy(  const void*         data,
+                            size_t              len,
+                            buffer_cleanup_t    cleanup,
+                            void*               arg ){
+    if (! data || ! _bev || ! _writeBuf){
+        errno   = EINVAL;
+        return  -1;
+    }
+    if (len < _zcThreshold){
+        int     ret = evbuffer_add( _writeBuf, data, len );
+        if (cleanup){
+            cleanup( data, len, arg );
+        }
+        return  ret;
+    }
+    evutil_socket_t     fd      = bufferevent_getfd( _bev );
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    if (_zcEnabled == 0 && fd >= 0){
+        int     one     = 1;
+        _zcEnabled  =
+            (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0)
+            ? 1 : -1;
+    }
+#endif
+    ZeroCopyRef*        ref     = new ZeroCopyRef;
+    ssize_t             sent    = 0;
+    int                 ret     = 0;
+    ref->data       = data;
+    ref->len        = len;
+    ref->cleanup    = cleanup;
+    ref->arg        = arg;
+    ref->refs       = 1;
+    //
+    //  only send directly when nothing is queued, to keep the byte order.
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    if (_zcEnabled > 0 && evbuffer_get_length( _writeBuf ) == 0 ){
+        zeroCopyDrain();
+        sent    = send( fd, data, len,
+                        MSG_ZEROCOPY | MSG_DONTWAIT | MSG_NOSIGNAL );
+        _writeSyscalls++;
+        _writeMessages++;
+        _owner->_writeSyscalls++;
+        _owner->_writeMessages++;
+        if (sent > 0){
+            _owner->_metrics.bytesOut.inc( sent );
+            ref->refs++;
+            _zcPending.push_back( std::make_pair(_zcNextSeq++, ref) );
+            zeroCopyDrain();
+        }
+        else{
+            sent    = 0;
+        }
+    }
+#endif
+    if ((size_t)sent < len){
+        ref->refs++;
+        ret     = evbuffer_add_reference( _writeBuf, (const char*)data + sent,
+                                          len - sent,
+                                          _zerocopy_ref_release, ref );
+        if (ret != 0){
+            ref->refs--;
+        }
+    }
+    _zerocopy_ref_release( data, len, ref );
+    return  ret;
+}
+
+void
+Connection::zeroCopyComplete( uint32_t lo, uint32_t hi){
+    while( ! _zcPending.empty() ){
+        uint32_t    seq     = _zcPending.front().first;
+        if ( seq - lo > hi - lo ){
+            break;
+        }
+        ZeroCopyRef*    ref = _zcPending.front().second;
+        _zcPending.pop_front();
+        _zerocopy_ref_release( ref->data, ref->len, ref );
+    }
+}
+
+/**
+ *  \note   the socket is going away, no more notification will arrive.
+ *          the pending sends are released unacknowledged, as documented
+ *          by writeZeroCopy().
+ * */
+void
+Connection::zeroCopyReset(){
+    if (_zcEvent){
+        event_free( _zcEvent );
+        _zcEvent    = nullptr;
+    }
+    while( ! _zcPending.empty() ){
+        ZeroCopyRef*    ref = _zcPending.front().second;
+        _zcPending.pop_front();
+        _zerocopy_ref_release( ref->data, ref->len, ref );
+    }
+    _zcEnabled  = 0;
+    _zcNextSeq  = 0;
+}
+
+size_t
+Connection::readLength(){
+    return  _readBuf ? evbuffer_get_length( _readBuf ) : 0;
+}
+
+int
+Connection::peek( struct evbuffer_iovec* vec, int n ){
+    if (! _readBuf){
+        errno   = ENOTCONN;
+        return  -1;
+    }
+    return  evbuffer_peek( _readBuf, -1, NULL, vec, n );
+}
+
+Slice
+Connection::peek( size_t len ){
+    struct evbuffer_iovec   vec;
+    if (! _readBuf || evbuffer_get_length( _readBuf ) < len){
+        return  Slice();
+    }
+    if (evbuffer_peek( _readBuf, len, NULL, &vec, 1) == 1){
+        return  Slice( (const char*)vec.iov_base, len );
+    }
+    return  Slice( (const char*)evbuffer_pullup( _readBuf, len ), len );
+}
+
+Slice
+Connection::peekUntil( const char* delim, size_t delimLen ){
+    if (! _readBuf){
+        return  Slice();
+    }
+    struct evbuffer_ptr     pos =
+        evbuffer_search( _readBuf, delim, delimLen, NULL );
+    if (pos.pos < 0){
+        return  Slice();
+    }
+    if (pos.pos == 0){
+        return  Slice( "", 0 );
+    }
+    return  peek( (size_t)pos.pos );
+}
+
+int
+Connection::consume( size_t len ){
+    if (! _readBuf){
+        errno   = ENOTCONN;
+        return  -1;
+    }
+    return  evbuffer_drain( _readBuf, len );
+}
+
+int
+Connection::writeMessage( const void* data, size_t len ){
+    if (! _codec || ! _writeBuf){
+        errno   = EINVAL;
+        return  -1;
+    }
+    return  _codec->encode( _writeBuf, data, len );
+}
+
+/**
+ *  \note   watch the output buffer, to count writes and to schedule the
+ *          flush of coalesced output.
+ * */
+void
+_output_cb( struct evbuffer*                  buf,
+            const struct evbuffer_cb_info*    info,
+            void*                             ctx){
+    Connection*     conn    = (Connection*)ctx;
+    Wrapper*        owner   = conn->owner();
+    if (info->n_added){
+        conn->_writeMessages++;
+        owner->_writeMessages++;
+        if (conn->_autoFlush && ! conn->_corked && ! conn->_flushPending){
+            conn->_flushPending = true;
+            owner->scheduleFlush( conn );
+        }
+    }
+    //  a drain is counted as a syscall, as the output is drained once by
+    //  each write or writev which wrote; an approximation, as a drain by
+    //  the user is counted too.
+    if (info->n_deleted){
+        conn->_writeSyscalls++;
+        owner->_writeSyscalls++;
+        owner->_metrics.bytesOut.inc( info->n_deleted );
+    }
+}
+
+/**
+ *  \note   counts the bytes read into the input of a tcp connection.
+ * */
+static void
+_input_cb(  struct evbuffer*                  buf,
+            const struct evbuffer_cb_info*    info,
+            void*                             ctx){
+    if (info->n_added){
+        ((Connection*)ctx)->owner()->metrics().bytesIn.inc( info->n_added );
+    }
+}
+
+void
+Connection::holdWrite(){
+    if (_bev){
+        bufferevent_disable( _bev, EV_WRITE );
+    }
+}
+
+void
+Connection::cork(){
+    _corked = true;
+    holdWrite();
+}
+
+int
+Connection::uncork(){
+    _corked = false;
+    int     ret = flush();
+    if (_bev && ! _autoFlush){
+        bufferevent_enable( _bev, EV_WRITE );
+    }
+    return  ret;
+}
+
+int
+Connection::flush(){
+    int     ret = 0;
+    if (! _bev){
+        errno   = ENOTCONN;
+        return  -1;
+    }
+    if (_status == CONNECTED && evbuffer_get_length( _writeBuf ) > 0){
+        //  the bufferevent freezes the start of its output, but for its
+        //  own writes, as done here.
+        evbuffer_unfreeze( _writeBuf, 1 );
+        if (evbuffer_write( _writeBuf, bufferevent_getfd(_bev) ) < 0 &&
+            errno != EAGAIN && errno != EINTR ){
+            ret     = -1;
+        }
+        evbuffer_freeze( _writeBuf, 1 );
+    }
+    //  the rest, or the error, is left to the bufferevent.
+    if (evbuffer_get_length( _writeBuf ) > 0){
+        bufferevent_enable( _bev, EV_WRITE );
+    }
+    if (! _zcPending.empty() ){
+        zeroCopyDrain();
+    }
+    return  ret;
+}
+
+void
+Connection::setAutoFlush(bool autoFlush){
+    _autoFlush  = autoFlush;
+    if (_autoFlush){
+        holdWrite();
+    }
+    else if ( ! _corked && _bev ){
+        bufferevent_enable( _bev, EV_WRITE );
+    }
+}
+
 NS_LEW_END();
 
@@ -0,0 +1,158 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#include    <algorithm>
+#include    <cmath>
+#include    "lew/histogram.h"
+
+NS_LEW_BEGIN();
+
+Histogram::Histogram( int64_t highest, int digits ){
+    if (highest < 2){
+        highest = 2;
+    }
+    if (digits < 1 || digits > 5){
+        digits  = 3;
+    }
+    int64_t     largest = 2 * (int64_t)pow( 10, digits );
+    int         mag     = (int)ceil( log2( (double)largest ) );
+    _subBucketHalfCountMagnitude    = (mag > 1 ? mag : 1) - 1;
+    _subBucketHalfCount             = 1LL << _subBucketHalfCountMagnitude;
+    _subBucketMask                  = 2 * _subBucketHalfCount - 1;
+    _highest    = highest;
+    //
+    int64_t     untrackable = 2 * _subBucketHalfCount;
+    int         buckets     = 1;
+    while( untrackable <= highest && untrackable < (INT64_MAX >> 1) ){
+        untrackable <<= 1;
+        buckets++;
+    }
+    _counts.assign( (buckets + 1) * _subBucketHalfCount, 0 );
+    reset();
+}
+
+void
+Histogram::reset(){
+    std::fill( _counts.begin(), _counts.end(), 0 );
+    _total  = 0;
+    _min    = INT64_MAX;
+    _max    = 0;
+    _sum    = 0;
+}
+
+size_t
+Histogram::indexOf( int64_t value ) const {
+    int     bucket  = 63 - __builtin_clzll( (uint64_t)(value | _subBucketMask) )
+                      - _subBucketHalfCountMagnitude;
+    int64_t sub     = value >> bucket;
+    return  ((size_t)bucket << _subBucketHalfCountMagnitude) + sub;
+}
+
+int64_t
+Histogram::valueAt( size_t index ) const {
+    int     bucket  = (int)(index >> _subBucketHalfCountMagnitude) - 1;
+    int64_t sub     = (index & (_subBucketHalfCount - 1)) + _subBucketHalfCount;
+    if (bucket < 0){
+        sub    -= _subBucketHalfCount;
+        bucket  = 0;
+    }
+    //  the highest value equivalent to the sub bucket.
+    return  (sub << bucket) + (1LL << bucket) - 1;
+}
+
+void
+Histogram::record( int64_t value, int64_t count ){
+    if (value < 0){
+        value   = 0;
+    }
+    if (value > _highest){
+        value   = _highest;
+    }
+    _counts[ indexOf( value ) ]    += count;
+    _total  += count;
+    _sum    += (double)value * count;
+    if (value < _min)   _min    = value;
+    if (value > _max)   _max    = value;
+}
+
+void
+Histogram::merge( const Histogram& other ){
+    if (other._counts.size() == _counts.size() &&
+        other._subBucketHalfCount == _subBucketHalfCount ){
+        for( size_t i = 0; i < _counts.size(); i++){
+            _counts[i]  += other._counts[i];
+        }
+        _total  += other._total;
+        _sum    += other._sum;
+        if (other._total && other._min < _min)  _min    = other._min;
+        if (other._max > _max)                  _max    = other._max;
+        return;
+    }
+    for( size_t i = 0; i < other._counts.size(); i++){
+        if (other._counts[i]){
+            record( other.valueAt(i), other._counts[i] );
+        }
+    }
+}
+
+int64_t
+Histogram::min() const {
+    return  _total ? _min : 0;
+}
+
+double
+Histogram::mean() const {
+    return  _total ? _sum / _total : 0;
+}
+
+int64_t
+Histogram::percentile( double p ) const {
+    if (0 == _total){
+        return  0;
+    }
+    if (p >= 100){
+        return  _max;
+    }
+    int64_t     target  = (int64_t)ceil( p / 100.0 * _total );
+    int64_t     seen    = 0;
+    if (target < 1){
+        target  = 1;
+    }
+    for( size_t i = 0; i < _counts.size(); i++){
+        seen    += _counts[i];
+        if (seen >= target){
+            int64_t     v   = valueAt( i );
+            return  v < _max ? v : _max;
+        }
+    }
+    return  _max;
+}
+
+NS_LEW_END();
+
@@ -0,0 +1,1341 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    <time.h>
+#include    <unistd.h>
+#include    <cctype>
+#include    <cstdio>
+#include    <cstring>
+#include    <deque>
+#include    <string>
+#include    <vector>
+#include    <event2/bufferevent.h>
+#include    <event2/listener.h>
+#include    <event2/util.h>
+#include    "lew/http1.h"
+#include    "lew/websocket.h"
+#include    "lew/wrapper.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define     LEW_HTTP_SIMD   1
+#include    <immintrin.h>
+#endif
+
+NS_LEW_BEGIN();
+
+void
+HttpRequest::reset(){
+    method          = (evhttp_cmd_type)0;
+    uri             = Slice();
+    path            = Slice();
+    query           = Slice();
+    minorVersion    = 0;
+    keepAlive       = false;
+    chunked         = false;
+    upgrade         = false;
+    contentLength   = -1;
+    headerCount     = 0;
+    body            = Slice();
+}
+
+Slice
+HttpRequest::header( const char* name ) const {
+    size_t      len = strlen( name );
+    for( int i = 0; i < headerCount; i++){
+        if (headers[i].name.len == len &&
+            0 == evutil_ascii_strncasecmp( headers[i].name.data, name, len) ){
+            return  headers[i].value;
+        }
+    }
+    return  Slice();
+}
+
+static void
+_rebase( Slice& s, const char* from, const char* to ){
+    if (s.data){
+        s.data  = to + (s.data - from);
+    }
+}
+
+void
+HttpRequest::rebase( const char* from, const char* to ){
+    _rebase( uri, from, to );
+    _rebase( path, from, to );
+    _rebase( query, from, to );
+    for( int i = 0; i < headerCount; i++){
+        _rebase( headers[i].name, from, to );
+        _rebase( headers[i].value, from, to );
+    }
+}
+
+/**
+ *  \note   the scan kernels find the first control byte, but the tab, or
+ *          `stop`, from `p` to `end`.
+ * */
+typedef const char* (*scan_t)( const char* p, const char* end, char stop );
+
+static inline bool
+_is_stop( unsigned char c, char stop ){
+    return  (c < 0x20 && c != '\t') || c == 0x7f || c == (unsigned char)stop;
+}
+
+static const char*
+_scan_scalar( const char* p, const char* end, char stop ){
+    for( ; p < end; p++){
+        if (_is_stop( (unsigned char)*p, stop ) ){
+            break;
+        }
+    }
+    return  p;
+}
+
+#ifdef  LEW_HTTP_SIMD
+__attribute__((target("sse4.2")))
+static const char*
+_scan_sse42( const char* p, const char* end, char stop ){
+    const __m128i   ranges  = _mm_setr_epi8( 0x00, 0x08, 0x0a, 0x1f,
+                                             0x7f, 0x7f, stop, stop,
+                                             0, 0, 0, 0, 0, 0, 0, 0 );
+    for( ; end - p >= 16; p += 16){
+        __m128i     v   = _mm_loadu_si128( (const __m128i*)p );
+        int         i   = _mm_cmpestri( ranges, 8, v, 16,
+                                        _SIDD_UBYTE_OPS | _SIDD_CMP_RANGES |
+                                        _SIDD_LEAST_SIGNIFICANT );
+        if (i < 16){
+            return  p + i;
+        }
+    }
+    return  _scan_scalar( p, end, stop );
+}
+
+__attribute__((target("avx2")))
+static const char*
+_scan_avx2( const char* p, const char* end, char stop ){
+    const __m256i   ctl     = _mm256_set1_epi8( 0x1f );
+    const __m256i   tab     = _mm256_set1_epi8( '\t' );
+    const __m256i   del     = _mm256_set1_epi8( 0x7f );
+    const __m256i   stp     = _mm256_set1_epi8( stop );
+    for( ; end - p >= 32; p += 32){
+        __m256i     v   = _mm256_loadu_si256( (const __m256i*)p );
+        __m256i     lo  = _mm256_cmpeq_epi8( _mm256_max_epu8( v, ctl ), ctl );
+        __m256i     hit = _mm256_or_si256(
+                            _mm256_andnot_si256( _mm256_cmpeq_epi8( v, tab ),
+                                                 lo ),
+                            _mm256_or_si256( _mm256_cmpeq_epi8( v, del ),
+                                             _mm256_cmpeq_epi8( v, stp ) ) );
+        unsigned    mask    = (unsigned)_mm256_movemask_epi8( hit );
+        if (mask){
+            return  p + __builtin_ctz( mask );
+        }
+    }
+    return  _scan_sse42( p, end, stop );
+}
+#endif
+
+static HttpParser::Isa
+_best_isa(){
+#ifdef  LEW_HTTP_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports( "avx2" ) ){
+        return  HttpParser::ISA_AVX2;
+    }
+    if (__builtin_cpu_supports( "sse4.2" ) ){
+        return  HttpParser::ISA_SSE42;
+    }
+#endif
+    return  HttpParser::ISA_SCALAR;
+}
+
+static scan_t
+_scan_of( HttpParser::Isa isa ){
+#ifdef  LEW_HTTP_SIMD
+    if (HttpParser::ISA_AVX2 == isa){
+        return  _scan_avx2;
+    }
+    if (HttpParser::ISA_SSE42 == isa){
+        return  _scan_sse42;
+    }
+#endif
+    return  _scan_scalar;
+}
+
+static HttpParser::Isa  _isa    = _best_isa();
+static scan_t           _scan   = _scan_of( _isa );
+
+HttpParser::Isa
+HttpParser::isa(){
+    return  _isa;
+}
+
+HttpParser::Isa
+HttpParser::setIsa( Isa isa ){
+    Isa     best    = _best_isa();
+    _isa    = isa < best ? isa : best;
+    _scan   = _scan_of( _isa );
+    return  _isa;
+}
+
+const char*
+HttpParser::isaName( Isa isa ){
+    static const char*  names[] = { "scalar", "sse4.2", "avx2" };
+    return  (isa >= ISA_SCALAR && isa <= ISA_AVX2) ? names[isa] : "";
+}
+
+/**
+ *  \note   tchar of RFC 7230, the bytes of methods and header names.
+ * */
+static struct  _TokenTable{
+    _TokenTable(){
+        const char* extra   = "!#$%&'*+-.^_`|~";
+        for( int i = 0; i < 256; i++){
+            token[i]    = i < 0x80 && isalnum( i );
+        }
+        for( ; *extra; extra++){
+            token[ (unsigned char)*extra ]  = true;
+        }
+    }
+    bool    token[256];
+}   _tokens;
+
+static inline bool
+_is_token( char c ){
+    return  _tokens.token[ (unsigned char)c ];
+}
+
+static evhttp_cmd_type
+_method( const char* p, size_t len ){
+    static const struct {
+        const char*     name;
+        size_t          len;
+        evhttp_cmd_type type;
+    }   methods[]   = {
+        { "GET",     3, EVHTTP_REQ_GET },
+        { "POST",    4, EVHTTP_REQ_POST },
+        { "HEAD",    4, EVHTTP_REQ_HEAD },
+        { "PUT",     3, EVHTTP_REQ_PUT },
+        { "DELETE",  6, EVHTTP_REQ_DELETE },
+        { "OPTIONS", 7, EVHTTP_REQ_OPTIONS },
+        { "TRACE",   5, EVHTTP_REQ_TRACE },
+        { "CONNECT", 7, EVHTTP_REQ_CONNECT },
+        { "PATCH",   5, EVHTTP_REQ_PATCH },
+    };
+    for( auto& m : methods ){
+        if (m.len == len && 0 == memcmp( m.name, p, len ) ){
+            return  m.type;
+        }
+    }
+    return  (evhttp_cmd_type)0;
+}
+
+static bool
+_ieq( const Slice& s, const char* str, size_t len ){
+    return  s.len == len && 0 == evutil_ascii_strncasecmp( s.data, str, len );
+}
+
+/**
+ *  \note   the end of the line at `p`.
+ * \return  bytes of CRLF or LF, 0 if more bytes are needed, or -1.
+ * */
+static int
+_eol( const char* p, const char* end ){
+    if (p >= end){
+        return  0;
+    }
+    if ('\n' == *p){
+        return  1;
+    }
+    if ('\r' != *p){
+        return  -1;
+    }
+    if (p + 1 >= end){
+        return  0;
+    }
+    return  '\n' == p[1] ? 2 : -1;
+}
+
+/**
+ *  \note   if the comma separated `list` has `token`, case insensitive.
+ * */
+static bool
+_has_token( const Slice& list, const char* token, size_t len ){
+    const char*     p   = list.data;
+    const char*     q   = p + list.len;
+    while( p < q ){
+        const char* t   = p;
+        while( t < q && ',' != *t ){
+            t++;
+        }
+        const char* b   = p;
+        const char* e   = t;
+        while( b < e && (' ' == *b || '\t' == *b) )     b++;
+        while( e > b && (' ' == e[-1] || '\t' == e[-1]) ) e--;
+        if (_ieq( Slice( b, e - b ), token, len ) ){
+            return  true;
+        }
+        p       = t + 1;
+    }
+    return  false;
+}
+
+/**
+ *  \note   the meaning of the headers framing the body or the connection.
+ * */
+static int
+_semantics( HttpRequest& req ){
+    bool        te      = false;
+    bool        close   = false;
+    bool        keep    = false;
+    bool        upgrade = false;
+    bool        proto   = false;
+    for( int i = 0; i < req.headerCount; i++){
+        const HttpHeader&   h   = req.headers[i];
+        if (_ieq( h.name, "Content-Length", 14 ) ){
+            int64_t     len     = 0;
+            if (h.value.len == 0 || h.value.len > 18){
+                return  -1;
+            }
+            for( size_t j = 0; j < h.value.len; j++){
+                char    c   = h.value.data[j];
+                if (c < '0' || c > '9'){
+                    return  -1;
+                }
+                len     = len * 10 + (c - '0');
+            }
+            if (req.contentLength >= 0 && req.contentLength != len){
+                return  -1;
+            }
+            req.contentLength   = len;
+        }
+        else if (_ieq( h.name, "Transfer-Encoding", 17 ) ){
+            //  the last coding must be chunked.
+            const char*     p   = h.value.data;
+            const char*     q   = p + h.value.len;
+            const char*     c   = q;
+            while( c > p && ',' != c[-1] && ' ' != c[-1] && '\t' != c[-1] ){
+                c--;
+            }
+            if (! _ieq( Slice( c, q - c ), "chunked", 7 ) ){
+                return  -1;
+            }
+            te          = true;
+            req.chunked = true;
+        }
+        else if (_ieq( h.name, "Connection", 10 ) ){
+            close   |= _has_token( h.value, "close", 5 );
+            keep    |= _has_token( h.value, "keep-alive", 10 );
+            upgrade |= _has_token( h.value, "upgrade", 7 );
+        }
+        else if (_ieq( h.name, "Upgrade", 7 ) ){
+            proto   = true;
+        }
+    }
+    if (te && req.contentLength >= 0){
+        return  -1;
+    }
+    req.keepAlive   = ! close && (req.minorVersion > 0 || keep);
+    req.upgrade     = upgrade && proto;
+    const char*     q   = (const char*)memchr( req.uri.data, '?', req.uri.len );
+    if (q){
+        req.path    = Slice( req.uri.data, q - req.uri.data );
+        req.query   = Slice( q + 1, req.uri.data + req.uri.len - q - 1 );
+    }
+    else{
+        req.path    = req.uri;
+    }
+    return  0;
+}
+
+int
+HttpParser::parse( const char* data, size_t len, HttpRequest& req ){
+    const char*     p       = data;
+    const char*     end     = data + len;
+    const char*     t;
+    int             n;
+    req.reset();
+    //  request line
+    for( t = p; t < end && _is_token( *t ); t++ );
+    if (t == end){
+        return  0;
+    }
+    if (t == p || ' ' != *t){
+        return  -1;
+    }
+    req.method  = _method( p, t - p );
+    p   = t + 1;
+    t   = _scan( p, end, ' ' );
+    if (t == end){
+        return  0;
+    }
+    if (t == p || ' ' != *t){
+        return  -1;
+    }
+    req.uri     = Slice( p, t - p );
+    p   = t + 1;
+    if (end - p < 8){
+        return  memcmp( p, "HTTP/1.", end - p < 7 ? end - p : 7 ) ? -1 : 0;
+    }
+    if (memcmp( p, "HTTP/1.", 7 ) || (p[7] != '0' && p[7] != '1') ){
+        return  -1;
+    }
+    req.minorVersion    = p[7] - '0';
+    p   += 8;
+    if ((n = _eol( p, end )) <= 0){
+        return  n;
+    }
+    p   += n;
+    //  headers
+    for( ; ; ){
+        if ((n = _eol( p, end )) > 0){
+            p   += n;
+            break;
+        }
+        if (p >= end || (p + 1 == end && '\r' == *p) ){
+            return  0;
+        }
+        for( t = p; t < end && _is_token( *t ); t++ );
+        if (t == end){
+            return  0;
+        }
+        if (t == p || ':' != *t || req.headerCount == HttpRequest::MAX_HEADERS){
+            return  -1;
+        }
+        HttpHeader&     h   = req.headers[ req.headerCount++ ];
+        h.name  = Slice( p, t - p );
+        for( p = t + 1; p < end && (' ' == *p || '\t' == *p); p++ );
+        t   = _scan( p, end, '\r' );
+        if ((n = _eol( t, end )) <= 0){
+            return  n;
+        }
+        const char*     v   = t;
+        while( v > p && (' ' == v[-1] || '\t' == v[-1]) ){
+            v--;
+        }
+        h.value = Slice( p, v - p );
+        p   = t + n;
+    }
+    if (_semantics( req ) < 0){
+        return  -1;
+    }
+    return  (int)(p - data);
+}
+
+static const char*
+_reason( int code ){
+    switch( code ){
+    case 100:   return  "Continue";
+    case 101:   return  "Switching Protocols";
+    case 200:   return  "OK";
+    case 201:   return  "Created";
+    case 202:   return  "Accepted";
+    case 204:   return  "No Content";
+    case 206:   return  "Partial Content";
+    case 301:   return  "Moved Permanently";
+    case 302:   return  "Found";
+    case 303:   return  "See Other";
+    case 304:   return  "Not Modified";
+    case 307:   return  "Temporary Redirect";
+    case 308:   return  "Permanent Redirect";
+    case 400:   return  "Bad Request";
+    case 401:   return  "Unauthorized";
+    case 403:   return  "Forbidden";
+    case 404:   return  "Not Found";
+    case 405:   return  "Method Not Allowed";
+    case 408:   return  "Request Timeout";
+    case 409:   return  "Conflict";
+    case 411:   return  "Length Required";
+    case 412:   return  "Precondition Failed";
+    case 413:   return  "Payload Too Large";
+    case 414:   return  "URI Too Long";
+    case 415:   return  "Unsupported Media Type";
+    case 429:   return  "Too Many Requests";
+    case 431:   return  "Request Header Fields Too Large";
+    case 500:   return  "Internal Server Error";
+    case 501:   return  "Not Implemented";
+    case 502:   return  "Bad Gateway";
+    case 503:   return  "Service Unavailable";
+    case 504:   return  "Gateway Timeout";
+    default:    return  "Unknown";
+    }
+}
+
+const char*
+HttpResponseWriter::reason( int code ){
+    return  _reason( code );
+}
+
+/**
+ *  \note   "HTTP/1.1 <code> <reason>\r\n" of the codes 100 to 599,
+ *          formatted once.
+ * */
+static const std::string&
+_status_line( int code ){
+    static std::vector<std::string>     lines   = [](){
+        std::vector<std::string>    v( 500 );
+        char    buf[64];
+        for( int c = 100; c < 600; c++){
+            snprintf( buf, sizeof(buf), "HTTP/1.1 %d %s\r\n", c, _reason(c) );
+            v[c - 100]  = buf;
+        }
+        return  v;
+    }();
+    return  lines[ (code >= 100 && code < 600) ? code - 100 : 500 - 100 ];
+}
+
+/**
+ *  \note   the Date header of now, formatted once a second per thread.
+ * */
+static const char*
+_date_line( size_t& len ){
+    static thread_local time_t  last    = 0;
+    static thread_local char    line[64];
+    static thread_local size_t  n       = 0;
+    time_t      now = time( NULL );
+    if (now != last){
+        struct tm   tm;
+        gmtime_r( &now, &tm );
+        n       = strftime( line, sizeof(line),
+                            "Date: %a, %d %b %Y %H:%M:%S GMT\r\n", &tm );
+        last    = now;
+    }
+    len     = n;
+    return  line;
+}
+
+/**
+ *  \note   the head is gathered on the stack, to be added to the output at
+ *          once, and flushed early only if it's over the stack buffer.
+ * */
+class   _HeadBuf{
+public:
+    _HeadBuf( struct evbuffer* out ): _out( out ), _len( 0 ), _ret( 0 ){};
+    void    add( const char* data, size_t len ){
+        if (_len + len > sizeof(_buf) ){
+            flush();
+            if (len > sizeof(_buf) ){
+                _ret    |= evbuffer_add( _out, data, len );
+                return;
+            }
+        }
+        memcpy( _buf + _len, data, len );
+        _len    += len;
+    }
+    void    add( const char* str ){ add( str, strlen( str ) );};
+    void    add( const Slice& s ){  add( s.data, s.len );};
+    int     flush(){
+        if (_len){
+            _ret    |= evbuffer_add( _out, _buf, _len );
+            _len    = 0;
+        }
+        return  _ret;
+    }
+private:
+    struct evbuffer*    _out;
+    size_t              _len;
+    int                 _ret;
+    char                _buf[1024];
+};
+
+int
+HttpResponseWriter::writeHead(  struct evbuffer*    out,
+                                int                 code,
+                                size_t              bodyLen,
+                                const char*         contentType,
+                                const HttpHeader*   headers,
+                                int                 count,
+                                bool                keepAlive,
+                                int                 minorVersion ){
+    _HeadBuf            head( out );
+    const std::string&  line    = _status_line( code );
+    size_t              n;
+    const char*         date    = _date_line( n );
+    head.add( line.data(), line.size() );
+    head.add( date, n );
+    //  no body for 1xx, 204 and 304.
+    if (code >= 200 && 204 != code && 304 != code){
+        char        digits[32];
+        char*       d   = digits + sizeof(digits);
+        *--d    = '\n';
+        *--d    = '\r';
+        do{
+            *--d    = '0' + bodyLen % 10;
+            bodyLen /= 10;
+        }while( bodyLen );
+        head.add( "Content-Length: ", 16 );
+        head.add( d, digits + sizeof(digits) - d );
+    }
+    if (contentType){
+        head.add( "Content-Type: ", 14 );
+        head.add( contentType );
+        head.add( "\r\n", 2 );
+    }
+    for( int i = 0; i < count; i++){
+        head.add( headers[i].name );
+        head.add( ": ", 2 );
+        head.add( headers[i].value );
+        head.add( "\r\n", 2 );
+    }
+    if (! keepAlive){
+        head.add( "Connection: close\r\n", 19 );
+    }
+    else if (0 == minorVersion){
+        head.add( "Connection: keep-alive\r\n", 24 );
+    }
+    head.add( "\r\n", 2 );
+    return  head.flush() ? -1 : 0;
+}
+
+/**
+ *  \note   a request of a connection of the native http server, and its
+ *          response until it's written in order.
+ * */
+struct  NativeHttpExchange{
+    NativeHttpExchange(): body( nullptr ), reply( nullptr ){};
+    ~NativeHttpExchange(){
+        if (body){
+            evbuffer_free( body );
+        }
+        if (reply){
+            evbuffer_free( reply );
+        }
+    };
+    HttpRequest             req;
+    std::string             head;       // the request line and headers.
+    struct evbuffer*        body;       // the body, req.body views it.
+    struct evbuffer*        reply;      // the response, while an earlier
+                                        // one is not replied.
+    HttpRequestContext*     ctx;
+    bool                    dispatched;
+    bool                    done;       // replied.
+};
+
+/**
+ *  \note   the session of a connection of the native http server.
+ *          <br>
+ *          requests are pipelined: every complete request in the input is
+ *          parsed and dispatched at once, up to pipelineDepth of them
+ *          waiting for their responses, which are written in the order of
+ *          the requests whatever order they are replied in. a response
+ *          replied before an earlier one is kept aside until then.
+ *          <br>
+ *          the head of a request is copied out of the input buffer and its
+ *          body moved out, to keep the views of the request valid while
+ *          more input is read. the read timeout is off while requests wait
+ *          for their responses.
+ * */
+class   NativeHttpSession : public MessageHandler{
+public:
+    enum    State{
+        READING     = 0,
+        STOPPED,                // no more requests after the last one.
+        UPGRADING,              // no more requests until the last one is
+                                // replied, as it may change the protocol.
+        CLOSING,                // closed once the output is written.
+    };
+    NativeHttpSession( Wrapper* wrapper, const struct timeval& timeout ):
+        _wrapper( wrapper ), _state( READING ), _timeout( timeout ),
+        _current( nullptr ), _dispatching( nullptr ), _served( 0 ),
+        _remaining( 0 ), _scanned( 0 ), _busy( false ), _closed( false ),
+        _full( false ), _paused( false ){};
+    virtual ~NativeHttpSession();
+    virtual void    onMessage(  Connection* conn, const Slice& msg){};
+    virtual bool    onInput(    Connection* conn){
+        process( conn );
+        return  true;
+    };
+    virtual void    onWritten(  Connection* conn);
+    virtual void    onClose(    Connection* conn);
+    int             respond(    Connection*         conn,
+                                const HttpRequest*  req,
+                                int                 code,
+                                const Slice&        body,
+                                SharedBuffer*       shared,
+                                const char*         contentType,
+                                const HttpHeader*   headers,
+                                int                 count );
+    int             detach(     Connection*         conn,
+                                const HttpRequest&  req,
+                                const HttpHeader*   headers,
+                                int                 count );
+    void            pause(      Connection* conn,   bool    paused);
+private:
+    void            process(    Connection* conn);
+    bool            readHead(   Connection* conn);
+    bool            readBody(   Connection* conn);
+    void            dispatch(   Connection* conn);
+    void            reject(     Connection*         conn,
+                                NativeHttpExchange* ex,
+                                int                 code,
+                                const HttpHeader*   header  = nullptr );
+    void            write(      Connection*         conn,
+                                NativeHttpExchange* ex,
+                                int                 code,
+                                const Slice&        body,
+                                SharedBuffer*       shared,
+                                const char*         contentType,
+                                const HttpHeader*   headers,
+                                int                 count );
+    void            flush(      Connection* conn);
+    void            setIdle(    Connection* conn,   bool    idle);
+    void            enableRead( Connection* conn);
+    NativeHttpExchange* newExchange();
+
+    typedef std::deque<NativeHttpExchange*>     Pipeline;
+    Wrapper*                _wrapper;
+    State                   _state;
+    struct timeval          _timeout;       // of reads while idle.
+    Pipeline                _pipeline;      // in the order of requests.
+    std::vector<NativeHttpExchange*>    _free;
+    NativeHttpExchange*     _current;       // being read.
+    NativeHttpExchange*     _dispatching;   // in onNativeHttpRequest.
+    int                     _served;        // requests of the connection.
+    int64_t                 _remaining;     // bytes of the body to read.
+    size_t                  _scanned;       // of the input, for the end of
+                                            // a head not found there.
+    bool                    _busy;          // in process().
+    bool                    _closed;        // closed or detached while
+                                            // busy.
+    bool                    _full;          // not read for the depth.
+    bool                    _paused;        // by Wrapper::pauseHttpBody.
+};
+
+NativeHttpSession::~NativeHttpSession(){
+    for( auto ex : _pipeline ){
+        delete  ex;
+    }
+    for( auto ex : _free ){
+        delete  ex;
+    }
+}
+
+NativeHttpExchange*
+NativeHttpSession::newExchange(){
+    NativeHttpExchange*     ex;
+    if (_free.empty() ){
+        ex  = new NativeHttpExchange();
+    }
+    else{
+        ex  = _free.back();
+        _free.pop_back();
+    }
+    ex->ctx         = nullptr;
+    ex->dispatched  = false;
+    ex->done        = false;
+    _pipeline.push_back( ex );
+    return  ex;
+}
+
+/**
+ *  \note   parse and dispatch the requests in the input, until one is not
+ *          complete, the pipeline is full, or no more requests are to be
+ *          read. the session is deleted here, if the connection is closed by
+ *          a callback.
+ * */
+void
+NativeHttpSession::process( Connection* conn ){
+    if (_busy){
+        return;
+    }
+    _busy   = true;
+    for( bool more = true; more && ! _closed; ){
+        if (_current){
+            more    = readBody( conn );
+        }
+        else{
+            more    = READING == _state && readHead( conn );
+        }
+    }
+    _busy   = false;
+    if (_closed){
+        delete  this;
+    }
+}
+
+/**
+ *  \note   heads of any size are not taken even if maxHeadersSize is
+ *          negative.
+ * */
+static const ev_ssize_t     _max_head   = 16 * 1024;
+
+/**
+ *  \note   bytes of the head in `input` up to its blank line, searched from
+ *          `from`, or 0 if the blank line is not there yet.
+ * */
+static size_t
+_head_end( struct evbuffer* input, size_t from ){
+    struct evbuffer_ptr     p;
+    if (evbuffer_ptr_set( input, &p, from, EVBUFFER_PTR_SET ) < 0){
+        return  0;
+    }
+    for( ;; ){
+        p   = evbuffer_search( input, "\n", 1, &p );
+        if (p.pos < 0){
+            return  0;
+        }
+        struct evbuffer_ptr q   = p;
+        char                next[2];
+        if (evbuffer_ptr_set( input, &q, 1, EVBUFFER_PTR_ADD ) < 0){
+            return  0;
+        }
+        ev_ssize_t          n   = evbuffer_copyout_from( input, &q, next, 2 );
+        if (n >= 1 && '\n' == next[0]){
+            return  p.pos + 2;
+        }
+        if (2 == n && '\r' == next[0] && '\n' == next[1]){
+            return  p.pos + 3;
+        }
+        if (n < 1 || (n < 2 && '\r' == next[0]) ){
+            return  0;
+        }
+        evbuffer_ptr_set( input, &p, 1, EVBUFFER_PTR_ADD );
+    }
+}
+
+/**
+ *  \note   a head over the first chunk of the input is parsed once its
+ *          blank line is there, the input being searched for it only from
+ *          where the last search stopped.
+ * */
+bool
+NativeHttpSession::readHead( Connection* conn ){
+    const HttpServerOptions&    options = _wrapper->httpServerOptions();
+    struct evbuffer*            input   = conn->readBuf();
+    size_t                      avail   = evbuffer_get_length( input );
+    struct evbuffer_iovec       vec;
+    if (options.pipelineDepth > 0 &&
+        (int)_pipeline.size() >= options.pipelineDepth ){
+        //  read again once a response is written.
+        _full   = true;
+        bufferevent_disable( conn->bev(), EV_READ );
+        return  false;
+    }
+    if (avail <= _scanned || evbuffer_peek( input, -1, NULL, &vec, 1 ) < 1){
+        return  false;
+    }
+    NativeHttpExchange* ex      = newExchange();
+    HttpRequest&        req     = ex->req;
+    const char*         data    = (const char*)vec.iov_base;
+    int                 n       = 0;
+    if (0 == _scanned){
+        n   = HttpParser::parse( data, vec.iov_len, req );
+    }
+    if (0 == n){
+        size_t          end     = _head_end( input,
+                                             _scanned > 3 ? _scanned - 3 : 0 );
+        _scanned    = end ? 0 : avail;
+        if (end){
+            if (vec.iov_len < end){
+                data    = (const char*)evbuffer_pullup( input, end );
+            }
+            n   = HttpParser::parse( data, end, req );
+            n   = n ? n : -1;
+        }
+    }
+    ev_ssize_t          limit   = options.maxHeadersSize >= 0 ?
+                                  options.maxHeadersSize : _max_head;
+    if ((n > 0 && n > limit) || (0 == n && (ev_ssize_t)avail > limit) ){
+        _wrapper->metrics().httpHeadersTooLarge.inc();
+        reject( conn, ex, 431 );
+        return  false;
+    }
+    if (n < 0){
+        _wrapper->metrics().httpBadRequests.inc();
+        reject( conn, ex, 400 );
+        return  false;
+    }
+    if (0 == n){
+        _pipeline.pop_back();
+        _free.push_back( ex );
+        return  false;
+    }
+    ex->head.assign( data, n );
+    req.rebase( data, ex->head.data() );
+    evbuffer_drain( input, n );
+    _wrapper->metrics().httpRequests.inc();
+    if (options.maxKeepAliveRequests > 0 &&
+        ++_served >= options.maxKeepAliveRequests ){
+        if (req.keepAlive){
+            _wrapper->metrics().httpKeepAliveLimits.inc();
+        }
+        req.keepAlive   = false;
+    }
+    if (! (req.method & options.allowedMethods) ){
+        HttpHeader      allow;
+        allow.name  = Slice( "Allow", 5 );
+        allow.value = Slice( _wrapper->_httpAllow.data(),
+                             _wrapper->_httpAllow.size() );
+        _wrapper->metrics().httpBadMethods.inc();
+        reject( conn, ex, 405, &allow );
+        return  false;
+    }
+    if (req.chunked){
+        _wrapper->metrics().httpBadRequests.inc();
+        reject( conn, ex, 411 );
+        return  false;
+    }
+    if (options.maxBodySize >= 0 && req.contentLength > options.maxBodySize){
+        _wrapper->metrics().httpBodyTooLarge.inc();
+        reject( conn, ex, 413 );
+        return  false;
+    }
+    if (! req.keepAlive){
+        _state  = STOPPED;
+    }
+    else if (req.upgrade){
+        _state  = UPGRADING;
+    }
+    ex->ctx             = _wrapper->acquireHttpContext( conn, nullptr );
+    ex->ctx->request    = &req;
+    _current            = ex;
+    _remaining          = req.contentLength > 0 ? req.contentLength : 0;
+    if (1 == _pipeline.size() ){
+        setIdle( conn, false );
+    }
+    return  readBody( conn );
+}
+
+bool
+NativeHttpSession::readBody( Connection* conn ){
+    NativeHttpExchange* ex      = _current;
+    HttpRequest&        req     = ex->req;
+    struct evbuffer*    input   = conn->readBuf();
+    if (_wrapper->httpServerOptions().streamBodies){
+        struct evbuffer_iovec   vec;
+        while( _remaining > 0 && evbuffer_peek( input, -1, NULL, &vec, 1) > 0){
+            size_t      len = vec.iov_len < (size_t)_remaining ?
+                              vec.iov_len : (size_t)_remaining;
+            ex->ctx->bodyLength += len;
+            _wrapper->onHttpBodyChunk( ex->ctx,
+                                       Slice( (const char*)vec.iov_base, len ));
+            if (_closed){
+                return  false;
+            }
+            if (ex->ctx->bodyFailed){
+                _current    = nullptr;
+                _remaining  = 0;
+                reject( conn, ex, 500 );
+                return  false;
+            }
+            evbuffer_drain( input, len );
+            _remaining  -= len;
+        }
+        if (_remaining > 0){
+            return  false;
+        }
+        if (ex->ctx->body && evbuffer_get_length( ex->ctx->body ) ){
+            size_t  len = evbuffer_get_length( ex->ctx->body );
+            req.body    = Slice( (const char*)evbuffer_pullup( ex->ctx->body,
+                                                               len ), len );
+        }
+        if (ex->ctx->bodyFd >= 0){
+            lseek( ex->ctx->bodyFd, 0, SEEK_SET );
+        }
+    }
+    else if (_remaining > 0){
+        if ((int64_t)evbuffer_get_length( input ) < _remaining){
+            return  false;
+        }
+        if (! ex->body){
+            ex->body    = evbuffer_new();
+        }
+        evbuffer_remove_buffer( input, ex->body, (size_t)_remaining );
+        req.body    = Slice( (const char*)evbuffer_pullup( ex->body, -1 ),
+                             (size_t)_remaining );
+    }
+    dispatch( conn );
+    return  true;
+}
+
+void
+NativeHttpSession::dispatch( Connection* conn ){
+    NativeHttpExchange* ex  = _current;
+    _current        = nullptr;
+    _remaining      = 0;
+    ex->dispatched  = true;
+    if (STOPPED == _state || UPGRADING == _state){
+        bufferevent_disable( conn->bev(), EV_READ );
+    }
+    _dispatching    = ex;
+    _wrapper->dispatchNativeHttpRequest( conn, ex->req );
+    _dispatching    = nullptr;
+}
+
+/**
+ *  \note   reply a request refused before it's dispatched, the connection
+ *          is closed after it.
+ * */
+void
+NativeHttpSession::reject(  Connection*         conn,
+                            NativeHttpExchange* ex,
+                            int                 code,
+                            const HttpHeader*   header ){
+    _state              = STOPPED;
+    ex->req.keepAlive   = false;
+    bufferevent_disable( conn->bev(), EV_READ );
+    write( conn, ex, code, Slice(), nullptr, nullptr, header, header ? 1 : 0 );
+}
+
+/**
+ *  \note   the request replied is `req`, or the one being dispatched, or
+ *          the first one not replied.
+ * */
+int
+NativeHttpSession::respond( Connection*         conn,
+                            const HttpRequest*  req,
+                            int                 code,
+                            const Slice&        body,
+                            SharedBuffer*       shared,
+                            const char*         contentType,
+                            const HttpHeader*   headers,
+                            int                 count ){
+    if (! req && _dispatching && ! _dispatching->done){
+        req = &_dispatching->req;
+    }
+    for( auto ex : _pipeline ){
+        if (ex->dispatched && ! ex->done && (! req || req == &ex->req) ){
+            write( conn, ex, code, body, shared, contentType, headers, count );
+            return  0;
+        }
+    }
+    return  -1;
+}
+
+void
+NativeHttpSession::write(   Connection*         conn,
+                            NativeHttpExchange* ex,
+                            int                 code,
+                            const Slice&        body,
+                            SharedBuffer*       shared,
+                            const char*         contentType,
+                            const HttpHeader*   headers,
+                            int                 count ){
+    const HttpRequest&  req     = ex->req;
+    struct evbuffer*    out     = conn->writeBuf();
+    size_t              len     = shared ? shared->len() : body.len;
+    bool                bodyless= EVHTTP_REQ_HEAD == req.method ||
+                                  code < 200 || 204 == code || 304 == code;
+    if (ex != _pipeline.front() ){
+        if (! ex->reply){
+            ex->reply   = evbuffer_new();
+        }
+        out     = ex->reply;
+    }
+    HttpResponseWriter::writeHead( out, code, len, contentType, headers, count,
+                                   req.keepAlive, req.minorVersion );
+    if (! bodyless && len){
+        if (shared){
+            shared->appendTo( out );
+        }
+        else{
+            evbuffer_add( out, body.data, body.len );
+        }
+    }
+    int     klass   = (code >= 100 && code < 600) ? code / 100 : 0;
+    _wrapper->metrics().httpStatus[ klass ].inc();
+    if (ex->ctx){
+        _wrapper->releaseHttpContext( ex->ctx );
+        ex->ctx = nullptr;
+    }
+    ex->done    = true;
+    flush( conn );
+}
+
+/**
+ *  \note   reply 101 to `req`, the connection is no longer the session's
+ *          then. `req` must be the first request not replied.
+ * */
+int
+NativeHttpSession::detach(  Connection*         conn,
+                            const HttpRequest&  req,
+                            const HttpHeader*   headers,
+                            int                 count ){
+    if (_pipeline.empty() || &_pipeline.front()->req != &req ||
+        ! _pipeline.front()->dispatched || _pipeline.front()->done ){
+        return  -1;
+    }
+    NativeHttpExchange* ex  = _pipeline.front();
+    HttpResponseWriter::writeHead( conn->writeBuf(), 101, 0, nullptr,
+                                   headers, count, true );
+    _wrapper->metrics().httpStatus[1].inc();
+    if (ex->ctx){
+        _wrapper->releaseHttpContext( ex->ctx );
+        ex->ctx = nullptr;
+    }
+    if (_busy){
+        _closed = true;
+    }
+    else{
+        delete  this;
+    }
+    return  0;
+}
+
+/**
+ *  \note   write the responses replied in the order of the requests, and
+ *          read again if the pipeline has room.
+ * */
+void
+NativeHttpSession::flush( Connection* conn ){
+    while( ! _pipeline.empty() && _pipeline.front()->done ){
+        NativeHttpExchange* ex  = _pipeline.front();
+        if (ex->reply){
+            evbuffer_add_buffer( conn->writeBuf(), ex->reply );
+        }
+        if (ex->body){
+            evbuffer_drain( ex->body, evbuffer_get_length( ex->body ) );
+        }
+        _pipeline.pop_front();
+        _free.push_back( ex );
+        if (! ex->req.keepAlive){
+            _state  = CLOSING;
+            return;
+        }
+        if (UPGRADING == _state){
+            //  not upgraded.
+            _state  = READING;
+            enableRead( conn );
+        }
+    }
+    if (_pipeline.empty() ){
+        setIdle( conn, true );
+    }
+    if (_full){
+        _full   = false;
+        enableRead( conn );
+    }
+    //  a request replied later, out of process(), continues the input here.
+    process( conn );
+}
+
+/**
+ *  \note   the read timeout is for idle connections only, not for those
+ *          waiting for their responses.
+ * */
+void
+NativeHttpSession::setIdle( Connection* conn, bool idle ){
+    bufferevent_set_timeouts( conn->bev(), idle ? &_timeout : nullptr,
+                              &_timeout );
+}
+
+/**
+ *  \note   read again, if the body being read, or the next request, is to
+ *          be read: not when stopped, upgrading, closing, for the depth of
+ *          the pipeline, or paused.
+ * */
+void
+NativeHttpSession::enableRead( Connection* conn ){
+    if (! _paused && ! _closed &&
+        (_current ? CLOSING != _state : READING == _state && ! _full) ){
+        bufferevent_enable( conn->bev(), EV_READ );
+    }
+}
+
+void
+NativeHttpSession::pause( Connection* conn, bool paused ){
+    _paused = paused;
+    if (paused){
+        bufferevent_disable( conn->bev(), EV_READ );
+    }
+    else{
+        enableRead( conn );
+    }
+}
+
+void
+NativeHttpSession::onWritten( Connection* conn ){
+    if (CLOSING == _state && 0 == evbuffer_get_length( conn->writeBuf() ) ){
+        _wrapper->closeConnection( conn );
+    }
+}
+
+void
+NativeHttpSession::onClose( Connection* conn ){
+    for( auto ex : _pipeline ){
+        if (ex->ctx){
+            _wrapper->releaseHttpContext( ex->ctx );
+            ex->ctx = nullptr;
+        }
+    }
+    if (_busy){
+        _closed = true;
+    }
+    else{
+        delete  this;
+    }
+}
+
+void
+_native_http_listen_cb( struct evconnlistener*  listener,
+                        evutil_socket_t         fd,
+                        struct sockaddr*        sock,
+                        int                     socklen,
+                        void*                   ctx){
+    Wrapper*        wrapper = (Wrapper*)ctx;
+    Connection*     conn    = wrapper->acceptConnection(
+                                fd, wrapper->nativeHttpConnectionSet() );
+    int             ms      = wrapper->httpServerOptions().timeoutMs;
+    struct timeval  tv;
+    if (ms <= 0){
+        ms  = 50 * 1000;
+    }
+    tv.tv_sec   = ms / 1000;
+    tv.tv_usec  = (ms % 1000) * 1000;
+    bufferevent_set_timeouts( conn->bev(), &tv, &tv );
+    conn->setHandler( new NativeHttpSession( wrapper, tv ) );
+}
+
+static NativeHttpSession*
+_native_session( Wrapper* wrapper, Connection* conn ){
+    ConnectionSet&      cs  = wrapper->nativeHttpConnectionSet();
+    return  cs.find( conn ) != cs.end() ?
+            static_cast<NativeHttpSession*>( conn->handler() ) : nullptr;
+}
+
+void
+_native_http_pause( Wrapper* wrapper, Connection* conn, bool paused ){
+    NativeHttpSession*  session = _native_session( wrapper, conn );
+    if (session){
+        session->pause( conn, paused );
+    }
+}
+
+int
+Wrapper::sendNativeHttpResponse(Connection*         conn,
+                                int                 code,
+                                const Slice&        body,
+                                const char*         contentType,
+                                const HttpHeader*   headers,
+                                int                 count ){
+    NativeHttpSession*  session = _native_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    return  session->respond( conn, nullptr, code, body, nullptr, contentType,
+                              headers, count );
+}
+
+int
+Wrapper::sendNativeHttpResponse(Connection*         conn,
+                                int                 code,
+                                SharedBuffer*       body,
+                                const char*         contentType,
+                                const HttpHeader*   headers,
+                                int                 count ){
+    NativeHttpSession*  session = _native_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    return  session->respond( conn, nullptr, code, Slice(), body, contentType,
+                              headers, count );
+}
+
+int
+Wrapper::sendNativeHttpResponse(Connection*         conn,
+                                const HttpRequest&  req,
+                                int                 code,
+                                const Slice&        body,
+                                const char*         contentType,
+                                const HttpHeader*   headers,
+                                int                 count ){
+    NativeHttpSession*  session = _native_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    return  session->respond( conn, &req, code, body, nullptr, contentType,
+                              headers, count );
+}
+
+int
+Wrapper::sendNativeHttpResponse(Connection*         conn,
+                                const HttpRequest&  req,
+                                int                 code,
+                                SharedBuffer*       body,
+                                const char*         contentType,
+                                const HttpHeader*   headers,
+                                int                 count ){
+    NativeHttpSession*  session = _native_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    return  session->respond( conn, &req, code, Slice(), body, contentType,
+                              headers, count );
+}
+
+/**
+ *  \note   the request is replied 400 or 426 here if it's not a handshake
+ *          of RFC 6455.
+ * */
+int
+Wrapper::upgradeWebSocket(  Connection*         conn,
+                            const HttpRequest&  req,
+                            const char*         protocol ){
+    NativeHttpSession*  session = _native_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    Slice           key     = req.header( "Sec-WebSocket-Key" );
+    Slice           version = req.header( "Sec-WebSocket-Version" );
+    if (EVHTTP_REQ_GET != req.method || req.minorVersion < 1 ||
+        ! req.upgrade || 24 != key.len ||
+        ! _has_token( req.header( "Upgrade" ), "websocket", 9 ) ){
+        sendNativeHttpResponse( conn, req, 400, Slice() );
+        return  -1;
+    }
+    if (! _ieq( version, "13", 2 ) ){
+        HttpHeader  h;
+        h.name  = Slice( "Sec-WebSocket-Version", 21 );
+        h.value = Slice( "13", 2 );
+        sendNativeHttpResponse( conn, req, 426, Slice(), nullptr, &h, 1 );
+        return  -1;
+    }
+    char            accept[29];
+    HttpHeader      headers[4];
+    int             count   = 3;
+    WsCodec::accept( key.data, key.len, accept );
+    headers[0].name     = Slice( "Upgrade", 7 );
+    headers[0].value    = Slice( "websocket", 9 );
+    headers[1].name     = Slice( "Connection", 10 );
+    headers[1].value    = Slice( "Upgrade", 7 );
+    headers[2].name     = Slice( "Sec-WebSocket-Accept", 20 );
+    headers[2].value    = Slice( accept, 28 );
+    if (protocol){
+        headers[3].name     = Slice( "Sec-WebSocket-Protocol", 22 );
+        headers[3].value    = Slice( protocol, strlen( protocol ) );
+        count++;
+    }
+    if (session->detach( conn, req, headers, count ) < 0){
+        return  -1;
+    }
+    _nativeHttpConnectionSet.erase( conn );
+    _webSocketConnectionSet.insert( conn );
+    startWebSocket( conn );
+    return  0;
+}
+
+NS_LEW_END();
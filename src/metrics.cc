@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    "lew/metrics.h"
+
+NS_LEW_BEGIN();
+
+//  up to a minute, two significant digits, some 30KB of buckets.
+Metrics::Metrics()
+    : callbackTime( 60LL * 1000 * 1000 * 1000, 2 ),
+      loopLag(      60LL * 1000 * 1000 * 1000, 2 ){
+    _timing     = false;
+}
+
+void
+Metrics::reset(){
+    Counter*    counters[]  = { &accepts, &closes, &reconnects, &bytesIn,
+                                &bytesOut, &readCallbacks, &writeCallbacks,
+                                &timersFired, &httpRequests, &slowCallbacks,
+                                &httpTimeouts, &httpHeadersTooLarge,
+                                &httpBodyTooLarge, &httpBadRequests,
+                                &httpBadMethods, &httpKeepAliveLimits };
+    for( auto c : counters ){
+        c->reset();
+    }
+    for( auto& c : httpStatus ){
+        c.reset();
+    }
+    callbackTime.reset();
+    loopLag.reset();
+}
+
+void
+Metrics::merge( const Metrics& other, bool histograms ){
+    Counter*        counters[]  = { &accepts, &closes, &reconnects, &bytesIn,
+                                    &bytesOut, &readCallbacks, &writeCallbacks,
+                                    &timersFired, &httpRequests, &slowCallbacks,
+                                    &httpTimeouts, &httpHeadersTooLarge,
+                                    &httpBodyTooLarge, &httpBadRequests,
+                                    &httpBadMethods,
+                                    &httpKeepAliveLimits };
+    const Counter*  others[]    = { &other.accepts, &other.closes,
+                                    &other.reconnects, &other.bytesIn,
+                                    &other.bytesOut, &other.readCallbacks,
+                                    &other.writeCallbacks, &other.timersFired,
+                                    &other.httpRequests, &other.slowCallbacks,
+                                    &other.httpTimeouts,
+                                    &other.httpHeadersTooLarge,
+                                    &other.httpBodyTooLarge,
+                                    &other.httpBadRequests,
+                                    &other.httpBadMethods,
+                                    &other.httpKeepAliveLimits };
+    for( size_t i = 0; i < sizeof(counters) / sizeof(counters[0]); i++){
+        counters[i]->add( *others[i] );
+    }
+    for( size_t i = 0; i < sizeof(httpStatus) / sizeof(httpStatus[0]); i++){
+        httpStatus[i].add( other.httpStatus[i] );
+    }
+    if (histograms){
+        callbackTime.merge( other.callbackTime );
+        loopLag.merge( other.loopLag );
+    }
+}
+
+NS_LEW_END();
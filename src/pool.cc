@@ -0,0 +1,339 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#include    <algorithm>
+#include    <cerrno>
+#include    <chrono>
+#include    <cstdlib>
+#include    <string>
+#include    "lew/pool.h"
+
+NS_LEW_BEGIN();
+
+#define     POOL_VIRTUAL_NODES      100
+#define     POOL_HEALTH_MS          100
+
+static uint64_t
+_fnv1a( const char* data, size_t len ){
+    uint64_t    h   = 14695981039346656037ULL;
+    for( size_t i = 0; i < len; i++){
+        h   ^= (unsigned char)data[i];
+        h   *= 1099511628211ULL;
+    }
+    return  h;
+}
+
+static int64_t
+_now_ms(){
+    return  std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+ClientPool::ClientPool( Wrapper*                        owner,
+                        const std::vector<Endpoint>&    endpoints,
+                        int                             connsPerEndpoint,
+                        Policy                          policy,
+                        int                             timeoutMs )
+    : _owner(owner), _connsPerEndpoint(connsPerEndpoint),
+      _policy(policy), _timeoutMs(timeoutMs){
+    _maxFailures        = 5;
+    _maxLatencyUs       = 0;
+    _ejectMs            = 5000;
+    _maxEjectedPercent  = 50;
+    _next               = 0;
+    _seed               = (unsigned)_now_ms();
+    _health             = nullptr;
+    for( size_t i = 0; i < endpoints.size(); i++){
+        Node    node;
+        node.ep             = endpoints[i];
+        node.ejectedUntil   = 0;
+        node.clients.resize( connsPerEndpoint, nullptr );
+        _endpoints.push_back( node );
+        for( int v = 0; v < POOL_VIRTUAL_NODES; v++){
+            std::string     name    = endpoints[i].addr + ":" +
+                std::to_string( endpoints[i].port ) + "#" + std::to_string(v);
+            _ring.push_back(
+                std::make_pair( _fnv1a(name.data(), name.size()), i) );
+        }
+    }
+    std::sort( _ring.begin(), _ring.end() );
+}
+
+ClientPool::~ClientPool(){
+    if (_health){
+        event_free( _health );
+        _health = nullptr;
+    }
+    for( auto& node : _endpoints ){
+        for( auto& rpc : node.clients ){
+            if (! rpc){
+                continue;
+            }
+            Connection*     conn    = rpc->connection();
+            delete  rpc;
+            rpc     = nullptr;
+            if (conn){
+                _owner->closeConnection( conn );
+            }
+        }
+    }
+}
+
+void
+ClientPool::setEjection( int maxFailures, double maxLatencyUs, int ejectMs ){
+    _maxFailures    = maxFailures;
+    _maxLatencyUs   = maxLatencyUs;
+    _ejectMs        = ejectMs;
+}
+
+void
+ClientPool::connect( size_t endpoint, size_t slot ){
+    Node&           node    = _endpoints[ endpoint ];
+    RpcClient*&     rpc     = node.clients[ slot ];
+    if (rpc){
+        Connection* conn    = rpc->connection();
+        delete  rpc;
+        rpc     = nullptr;
+        if (conn){
+            _owner->closeConnection( conn );
+        }
+    }
+    Connection*     conn    =
+        _owner->startTcpClient( node.ep.addr, node.ep.port );
+    if (conn){
+        rpc     = new RpcClient( _owner, conn, _timeoutMs );
+    }
+}
+
+int
+ClientPool::start(){
+    int     count   = 0;
+    for( size_t e = 0; e < _endpoints.size(); e++){
+        for( int s = 0; s < _connsPerEndpoint; s++){
+            connect( e, s );
+            if (_endpoints[e].clients[s]){
+                count++;
+            }
+        }
+    }
+    if (! _health){
+        struct timeval  tv  = { 0, POOL_HEALTH_MS * 1000 };
+        _health = event_new( _owner->base(), -1, EV_PERSIST, _health_cb, this);
+        event_add( _health, &tv );
+    }
+    return  count ? 0 : -1;
+}
+
+static bool
+_usable( RpcClient* rpc ){
+    return  rpc && rpc->connection() &&
+            rpc->connection()->status() == Connection::CONNECTED;
+}
+
+bool
+ClientPool::available( size_t endpoint ){
+    Node&       node    = _endpoints[ endpoint ];
+    if (node.ejectedUntil){
+        return  false;
+    }
+    for( auto rpc : node.clients ){
+        if (_usable( rpc ) ){
+            return  true;
+        }
+    }
+    return  false;
+}
+
+bool
+ClientPool::ejected( size_t endpoint ){
+    return  _endpoints[ endpoint ].ejectedUntil != 0;
+}
+
+size_t
+ClientPool::inflight( size_t endpoint ){
+    size_t      n   = 0;
+    for( auto rpc : _endpoints[ endpoint ].clients ){
+        n   += rpc ? rpc->inflight() : 0;
+    }
+    return  n;
+}
+
+double
+ClientPool::latencyEwma( size_t endpoint ){
+    double      sum     = 0;
+    int         count   = 0;
+    for( auto rpc : _endpoints[ endpoint ].clients ){
+        if (rpc && rpc->latencyEwma() > 0){
+            sum += rpc->latencyEwma();
+            count++;
+        }
+    }
+    return  count ? sum / count : 0;
+}
+
+int
+ClientPool::endpointOf( RpcClient* client ){
+    for( size_t e = 0; e < _endpoints.size(); e++){
+        for( auto rpc : _endpoints[e].clients ){
+            if (rpc == client){
+                return  (int)e;
+            }
+        }
+    }
+    return  -1;
+}
+
+int
+ClientPool::pickEndpoint( const char* key, size_t keyLen ){
+    size_t              n   = _endpoints.size();
+    std::vector<size_t> up;
+    if (_policy == ROUND_ROBIN){
+        for( size_t i = 0; i < n; i++){
+            size_t  e   = _next++ % n;
+            if (available( e ) ){
+                return  (int)e;
+            }
+        }
+        return  -1;
+    }
+    if (_policy == CONSISTENT_HASH && key && ! _ring.empty() ){
+        std::pair<uint64_t, size_t> h( _fnv1a(key, keyLen), 0 );
+        size_t  pos = std::lower_bound( _ring.begin(), _ring.end(), h )
+                      - _ring.begin();
+        for( size_t i = 0; i < _ring.size(); i++){
+            size_t  e   = _ring[ (pos + i) % _ring.size() ].second;
+            if (available( e ) ){
+                return  (int)e;
+            }
+        }
+        return  -1;
+    }
+    for( size_t e = 0; e < n; e++){
+        if (available( e ) ){
+            up.push_back( e );
+        }
+    }
+    if (up.empty() ){
+        return  -1;
+    }
+    if (_policy == EWMA_LATENCY){
+        size_t      best    = up[0];
+        double      cost    = -1;
+        for( auto e : up ){
+            double  c   = (latencyEwma(e) + 1) * (inflight(e) + 1);
+            if (cost < 0 || c < cost){
+                best    = e;
+                cost    = c;
+            }
+        }
+        return  (int)best;
+    }
+    //  POWER_OF_TWO, or CONSISTENT_HASH without a key.
+    size_t      a   = up[ rand_r(&_seed) % up.size() ];
+    size_t      b   = up[ rand_r(&_seed) % up.size() ];
+    return  (int)(inflight(a) <= inflight(b) ? a : b);
+}
+
+RpcClient*
+ClientPool::pickClient( size_t endpoint ){
+    RpcClient*      best    = nullptr;
+    for( auto rpc : _endpoints[ endpoint ].clients ){
+        if (_usable( rpc ) && (! best || rpc->inflight() < best->inflight()) ){
+            best    = rpc;
+        }
+    }
+    return  best;
+}
+
+RpcClient*
+ClientPool::pick( const char* key, size_t keyLen ){
+    int     e   = pickEndpoint( key, keyLen );
+    if (e < 0){
+        errno   = EHOSTUNREACH;
+        return  nullptr;
+    }
+    return  pickClient( e );
+}
+
+uint64_t
+ClientPool::call(   const void*     data,
+                    size_t          len,
+                    rpc_handler_t   handler,
+                    void*           arg,
+                    const char*     key,
+                    size_t          keyLen ){
+    RpcClient*      rpc = pick( key, keyLen );
+    return  rpc ? rpc->call( data, len, handler, arg ) : 0;
+}
+
+void
+ClientPool::check(){
+    int64_t     now     = _now_ms();
+    size_t      ejected = 0;
+    for( auto& node : _endpoints ){
+        if (node.ejectedUntil && now >= node.ejectedUntil){
+            node.ejectedUntil   = 0;
+            for( auto rpc : node.clients ){
+                if (rpc){
+                    rpc->resetStats();
+                }
+            }
+        }
+        ejected += node.ejectedUntil ? 1 : 0;
+    }
+    for( size_t e = 0; e < _endpoints.size(); e++){
+        Node&       node    = _endpoints[e];
+        bool        failing = false;
+        for( size_t s = 0; s < node.clients.size(); s++){
+            RpcClient*  rpc = node.clients[s];
+            if (! rpc || ! rpc->connection() ){
+                connect( e, s );
+                continue;
+            }
+            failing = failing || rpc->failures() >= _maxFailures;
+        }
+        if (_maxLatencyUs > 0 && latencyEwma( e ) > _maxLatencyUs){
+            failing = true;
+        }
+        if (failing && ! node.ejectedUntil &&
+            (ejected + 1) * 100 <= _maxEjectedPercent * _endpoints.size() ){
+            node.ejectedUntil   = now + _ejectMs;
+            ejected++;
+            DBG_PRINT("eject %s:%d\n", node.ep.addr.c_str(), node.ep.port);
+        }
+    }
+}
+
+void
+ClientPool::_health_cb( evutil_socket_t fd, short what, void* arg ){
+    ((ClientPool*)arg)->check();
+}
+
+NS_LEW_END();
+
@@ -0,0 +1,215 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#include    <algorithm>
+#include    <cerrno>
+#include    "lew/ramp.h"
+
+NS_LEW_BEGIN();
+
+ConnectionRamp::ConnectionRamp( Wrapper*            owner,
+                                const std::string&  addr,
+                                uint16_t            port )
+    : _owner(owner), _addr(addr), _port(port){
+    _rate           = 1000;
+    _maxInflight    = 1000;
+    _maxRetries     = 3;
+    _backoffMs      = 100;
+    _maxBackoffMs   = 5000;
+    _doneHandler    = nullptr;
+    _count          = 0;
+    _started        = 0;
+    _connected      = 0;
+    _failed         = 0;
+    _retried        = 0;
+    _tick           = nullptr;
+}
+
+ConnectionRamp::~ConnectionRamp(){
+    cancel();
+}
+
+void
+ConnectionRamp::setRetry( int maxRetries, int backoffMs, int maxBackoffMs ){
+    _maxRetries     = maxRetries;
+    _backoffMs      = backoffMs;
+    _maxBackoffMs   = maxBackoffMs;
+}
+
+int
+ConnectionRamp::start( long count ){
+    if (_tick || _rate <= 0){
+        errno   = (_tick) ? EALREADY : EINVAL;
+        return  -1;
+    }
+    //  tick at the connect interval, or every millisecond for high rates.
+    long            us  = (long)(1e6 / _rate);
+    struct timeval  tv;
+    us              = std::max( us, 1000L );
+    tv.tv_sec       = us / 1000000;
+    tv.tv_usec      = us % 1000000;
+    _tick   = event_new( _owner->base(), -1, EV_PERSIST, _tick_cb, this );
+    if (! _tick || event_add( _tick, &tv ) != 0){
+        return  -1;
+    }
+    _count      = count;
+    _started    = 0;
+    _connected  = 0;
+    _failed     = 0;
+    _retried    = 0;
+    _times.clear();
+    _times.reserve( count );
+    _begin      = clock::now();
+    pace();
+    return  0;
+}
+
+void
+ConnectionRamp::cancel(){
+    if (_tick){
+        event_free( _tick );
+        _tick   = nullptr;
+    }
+    for( auto& p : _pending ){
+        p.first->setHandler( nullptr );
+    }
+    _pending.clear();
+    _retries.clear();
+}
+
+void
+ConnectionRamp::connect( int retries ){
+    Connection*     conn    = _owner->startTcpClient( _addr, _port );
+    if (! conn){
+        fail( retries );
+        return;
+    }
+    Attempt&        a       = _pending[ conn ];
+    a.start     = clock::now();
+    a.retries   = retries;
+    conn->setHandler( this );
+}
+
+void
+ConnectionRamp::fail( int retries ){
+    if (retries < _maxRetries){
+        long    ms  = _backoffMs;
+        for( int i = 0; i < retries && ms < _maxBackoffMs; i++){
+            ms  *= 2;
+        }
+        ms  = std::min( ms, (long)_maxBackoffMs );
+        _retries.insert( std::make_pair(
+            clock::now() + std::chrono::milliseconds(ms), retries + 1) );
+        _retried++;
+    }
+    else{
+        _failed++;
+    }
+}
+
+void
+ConnectionRamp::pace(){
+    clock::time_point   now     = clock::now();
+    double              secs    =
+        std::chrono::duration<double>( now - _begin ).count();
+    long                due     = std::min( (long)(secs * _rate) + 1, _count);
+    //  retries due come first, and are not counted again by the rate.
+    while( ! _retries.empty() && _retries.begin()->first <= now &&
+           (long)_pending.size() < _maxInflight ){
+        int     retries = _retries.begin()->second;
+        _retries.erase( _retries.begin() );
+        connect( retries );
+    }
+    while( _started < due && (long)_pending.size() < _maxInflight ){
+        _started++;
+        connect( 0 );
+    }
+    finish();
+}
+
+void
+ConnectionRamp::finish(){
+    if (_tick && done() ){
+        event_free( _tick );
+        _tick   = nullptr;
+        if (_doneHandler){
+            (_owner->*_doneHandler)( this );
+        }
+    }
+}
+
+void
+ConnectionRamp::onMessage( Connection* conn, const Slice& msg ){
+    _owner->onMessage( conn, msg );
+}
+
+void
+ConnectionRamp::onConnected( Connection* conn ){
+    auto    it  = _pending.find( conn );
+    if (it != _pending.end() ){
+        _times.push_back( std::chrono::duration<double, std::milli>(
+                            clock::now() - it->second.start ).count() );
+        _pending.erase( it );
+        _connected++;
+    }
+    conn->setHandler( nullptr );
+    finish();
+}
+
+void
+ConnectionRamp::onClose( Connection* conn ){
+    auto    it  = _pending.find( conn );
+    if (it != _pending.end() ){
+        int     retries = it->second.retries;
+        _pending.erase( it );
+        fail( retries );
+        finish();
+    }
+}
+
+double
+ConnectionRamp::connectTime( double p ){
+    if (_times.empty() ){
+        return  0;
+    }
+    std::vector<double>     sorted( _times );
+    size_t                  idx =
+        (size_t)( p / 100.0 * (sorted.size() - 1) + 0.5 );
+    idx     = std::min( idx, sorted.size() - 1 );
+    std::nth_element( sorted.begin(), sorted.begin() + idx, sorted.end() );
+    return  sorted[ idx ];
+}
+
+void
+ConnectionRamp::_tick_cb( evutil_socket_t fd, short what, void* arg ){
+    ((ConnectionRamp*)arg)->pace();
+}
+
+NS_LEW_END();
+
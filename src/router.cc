@@ -0,0 +1,257 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    <cstring>
+#include    "lew/router.h"
+
+using namespace std;
+NS_LEW_BEGIN();
+
+struct  HttpRouter::Node{
+    Node(): param(nullptr), wildcard(nullptr), terminal(false){
+        for( auto& h : handlers ){
+            h   = nullptr;
+        }
+    };
+    ~Node(){
+        for( auto c : children ){
+            delete c;
+        }
+        delete  param;
+        delete  wildcard;
+    };
+    string              prefix;     // static part, empty for param/wildcard.
+    string              indices;    // first bytes of `children`.
+    vector<Node*>       children;
+    Node*               param;
+    Node*               wildcard;
+    string              name;       // of the param or wildcard node.
+    bool                terminal;
+    http_handler_t      handlers[ METHODS ];
+};
+
+Slice
+HttpParams::get( const char* name ) const {
+    size_t      len = strlen( name );
+    for( int i = 0; i < count; i++){
+        if (names[i].len == len && memcmp( names[i].data, name, len ) == 0){
+            return  values[i];
+        }
+    }
+    return  Slice();
+}
+
+HttpRouter::HttpRouter(){
+    _root       = new Node;
+    _routes     = 0;
+    _notFound   = nullptr;
+}
+
+HttpRouter::~HttpRouter(){
+    delete  _root;
+}
+
+/**
+ *  \note   the node of `s` under `n`, splitting the node whose prefix
+ *          diverges from `s`.
+ * */
+static HttpRouter::Node*
+_insert_static( HttpRouter::Node* n, const string& s ){
+    size_t      pos     = 0;
+    while( pos < s.size() ){
+        size_t              i   = n->indices.find( s[pos] );
+        if (i == string::npos){
+            HttpRouter::Node*   c   = new HttpRouter::Node;
+            c->prefix   = s.substr( pos );
+            n->indices.push_back( s[pos] );
+            n->children.push_back( c );
+            return  c;
+        }
+        HttpRouter::Node*   c       = n->children[i];
+        size_t              common  = 0;
+        while( common < c->prefix.size() && pos + common < s.size() &&
+               c->prefix[common] == s[pos + common] ){
+            common++;
+        }
+        if (common < c->prefix.size() ){
+            HttpRouter::Node*   mid = new HttpRouter::Node;
+            mid->prefix     = c->prefix.substr( 0, common );
+            c->prefix       = c->prefix.substr( common );
+            mid->indices.push_back( c->prefix[0] );
+            mid->children.push_back( c );
+            n->children[i]  = mid;
+            c   = mid;
+        }
+        n   = c;
+        pos += common;
+    }
+    return  n;
+}
+
+int
+HttpRouter::add(    int                 methods,
+                    const std::string&  pattern,
+                    http_handler_t      handler ){
+    if (pattern.empty() || pattern[0] != '/' || ! handler ||
+        ! (methods & ((1 << METHODS) - 1)) ){
+        return  -1;
+    }
+    Node*       n       = _root;
+    int         params  = 0;
+    size_t      pos     = 0;
+    while( pos < pattern.size() ){
+        size_t  mark    = pos;
+        //  static part, up to a segment starting with ':' or '*'.
+        while( pos < pattern.size() &&
+               ! ((pattern[pos] == ':' || pattern[pos] == '*') &&
+                  pattern[pos - 1] == '/') ){
+            pos++;
+        }
+        n   = _insert_static( n, pattern.substr( mark, pos - mark ) );
+        if (pos == pattern.size() ){
+            break;
+        }
+        char    kind    = pattern[pos];
+        size_t  end     = pattern.find( '/', pos );
+        end     = (end == string::npos) ? pattern.size() : end;
+        string  name    = pattern.substr( pos + 1, end - pos - 1 );
+        if (name.empty() || ++params > HttpParams::MAX_PARAMS ||
+            (kind == '*' && end != pattern.size()) ){
+            return  -1;
+        }
+        Node*&  child   = (kind == ':') ? n->param : n->wildcard;
+        if (! child){
+            child       = new Node;
+            child->name = name;
+        }
+        else if (child->name != name){
+            return  -1;
+        }
+        n   = child;
+        pos = end;
+    }
+    for( int i = 0; i < METHODS; i++){
+        if ((methods & (1 << i)) && n->handlers[i] ){
+            return  -1;
+        }
+    }
+    for( int i = 0; i < METHODS; i++){
+        if (methods & (1 << i) ){
+            n->handlers[i]  = handler;
+        }
+    }
+    n->terminal = true;
+    _routes++;
+    return  0;
+}
+
+/**
+ *  \note   the terminal node matching `path` under `n` with a handler of
+ *          method `m`, backtracking from static parts to parameters and
+ *          wildcards. `matched` is set when a node matches the path but
+ *          takes other methods.
+ * */
+static const HttpRouter::Node*
+_match( const HttpRouter::Node* n, int m, const char* path, size_t len,
+        HttpParams& params, bool& matched ){
+    if (0 == len && n->terminal){
+        if (m < HttpRouter::METHODS && n->handlers[m]){
+            return  n;
+        }
+        matched = true;
+    }
+    if (len){
+        size_t      i   = n->indices.find( path[0] );
+        if (i != string::npos){
+            const HttpRouter::Node* c   = n->children[i];
+            size_t                  l   = c->prefix.size();
+            if (l <= len && memcmp( c->prefix.data(), path, l ) == 0){
+                const HttpRouter::Node* r =
+                    _match( c, m, path + l, len - l, params, matched );
+                if (r){
+                    return  r;
+                }
+            }
+        }
+        if (n->param && params.count < HttpParams::MAX_PARAMS){
+            const char* slash   = (const char*)memchr( path, '/', len );
+            size_t      seg     = slash ? (size_t)(slash - path) : len;
+            if (seg){
+                int     k       = params.count++;
+                params.names[k]     =
+                    Slice( n->param->name.data(), n->param->name.size() );
+                params.values[k]    = Slice( path, seg );
+                const HttpRouter::Node* r   =
+                    _match( n->param, m, path + seg, len - seg, params,
+                            matched );
+                if (r){
+                    return  r;
+                }
+                params.count    = k;
+            }
+        }
+    }
+    if (n->wildcard && params.count < HttpParams::MAX_PARAMS){
+        if (m >= HttpRouter::METHODS || ! n->wildcard->handlers[m]){
+            matched = true;
+            return  nullptr;
+        }
+        int     k       = params.count++;
+        params.names[k]     =
+            Slice( n->wildcard->name.data(), n->wildcard->name.size() );
+        params.values[k]    = Slice( path, len );
+        return  n->wildcard;
+    }
+    return  nullptr;
+}
+
+/**
+ *  \note   405 only if no route matching the path takes the method.
+ * */
+int
+HttpRouter::match(  evhttp_cmd_type     method,
+                    const Slice&        path,
+                    http_handler_t&     handler,
+                    HttpParams&         params ) const {
+    int             m       = __builtin_ctz( (unsigned)method );
+    bool            matched = false;
+    params.count    = 0;
+    handler         = nullptr;
+    const Node*     n   = _match( _root, m, path.data, path.len, params,
+                                  matched );
+    if (! n){
+        params.count    = 0;
+        return  matched ? 405 : 404;
+    }
+    handler     = n->handlers[m];
+    return  200;
+}
+
+NS_LEW_END();
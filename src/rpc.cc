@@ -0,0 +1,238 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+#include    <cerrno>
+#include    <vector>
+#include    "lew/rpc.h"
+
+NS_LEW_BEGIN();
+
+#define     RPC_ID_SIZE     8
+#define     RPC_EWMA_WEIGHT 0.2
+
+RpcClient::RpcClient( Wrapper* owner, Connection* conn, int timeoutMs )
+    : _owner(owner), _conn(conn), _codec(4), _timeoutMs(timeoutMs){
+    _nextId     = 1;
+    _latencyEwma= 0;
+    _failures   = 0;
+    _timer      = evtimer_new( owner->base(), _timeout_cb, this );
+    _conn->setCodec( &_codec );
+    _conn->setHandler( this );
+}
+
+RpcClient::~RpcClient(){
+    if (_conn){
+        _conn->setHandler( nullptr );
+        _conn->setCodec( nullptr );
+    }
+    if (_timer){
+        event_free( _timer );
+        _timer  = nullptr;
+    }
+}
+
+uint64_t
+RpcClient::call(    const void*     data,
+                    size_t          len,
+                    rpc_handler_t   handler,
+                    void*           arg,
+                    int             timeoutMs ){
+    if (! _conn || ! _conn->writeBuf() ){
+        errno   = ENOTCONN;
+        return  0;
+    }
+    uint64_t            id      = _nextId++;
+    struct evbuffer*    out     = _conn->writeBuf();
+    unsigned char       header[4 + RPC_ID_SIZE];
+    size_t              total   = RPC_ID_SIZE + len;
+    for( int i = 0; i < 4; i++){
+        header[3 - i]   = (unsigned char)(total >> (8 * i));
+    }
+    for( int i = 0; i < RPC_ID_SIZE; i++){
+        header[4 + RPC_ID_SIZE - 1 - i] = (unsigned char)(id >> (8 * i));
+    }
+    if (evbuffer_add( out, header, sizeof(header)) != 0 ||
+        evbuffer_add( out, data, len) != 0 ){
+        return  0;
+    }
+    Call&       c   = _calls[ id ];
+    c.handler   = handler;
+    c.arg       = arg;
+    c.start     = clock::now();
+    c.deadline  = c.start + std::chrono::milliseconds(
+                    timeoutMs < 0 ? _timeoutMs : timeoutMs );
+    bool    earliest    =
+        _deadlines.empty() || c.deadline < _deadlines.begin()->first;
+    _deadlines.insert( std::make_pair(c.deadline, id) );
+    if (earliest){
+        armTimer();
+    }
+    return  id;
+}
+
+int
+RpcClient::callBatch( Request* reqs, int count, int timeoutMs ){
+    int     sent    = 0;
+    if (! _conn){
+        errno   = ENOTCONN;
+        return  0;
+    }
+    bool    corked  = _conn->corked();
+    _conn->cork();
+    for( ; sent < count; sent++){
+        if (! call( reqs[sent].data, reqs[sent].len,
+                    reqs[sent].handler, reqs[sent].arg, timeoutMs ) ){
+            break;
+        }
+    }
+    if (! corked){
+        _conn->uncork();
+    }
+    return  sent;
+}
+
+void
+RpcClient::onMessage( Connection* conn, const Slice& msg ){
+    if (msg.len < RPC_ID_SIZE){
+        return;
+    }
+    uint64_t    id  = 0;
+    for( int i = 0; i < RPC_ID_SIZE; i++){
+        id  = (id << 8) | (unsigned char)msg.data[i];
+    }
+    finish( id, 0, Slice(msg.data + RPC_ID_SIZE, msg.len - RPC_ID_SIZE) );
+}
+
+/**
+ *  \note   the requests in flight are lost with the output.
+ * */
+void
+RpcClient::onReset( Connection* conn ){
+    failAll( ECONNRESET );
+}
+
+void
+RpcClient::onClose( Connection* conn ){
+    _conn   = nullptr;
+    failAll( ECONNRESET );
+}
+
+/**
+ *  \note   the pending calls fail, their handlers called with the members
+ *          left alone, as one may delete the client.
+ * */
+void
+RpcClient::failAll( int status ){
+    CallMap     calls;
+    DeadlineSet deadlines;
+    Wrapper*    owner   = _owner;
+    calls.swap( _calls );
+    deadlines.swap( _deadlines );
+    _failures   += calls.size();
+    evtimer_del( _timer );
+    for( auto& d : deadlines ){
+        Call&   c   = calls[ d.second ];
+        if (c.handler){
+            (owner->*c.handler)( this, status, Slice(), c.arg );
+        }
+    }
+}
+
+void
+RpcClient::finish( uint64_t id, int status, const Slice& resp ){
+    CallMap::iterator   it  = _calls.find( id );
+    if (it == _calls.end() ){
+        return;         // late response of an expired call.
+    }
+    Call        c   = it->second;
+    _calls.erase( it );
+    _deadlines.erase( std::make_pair(c.deadline, id) );
+    if (0 == status){
+        double  us  = std::chrono::duration_cast<std::chrono::microseconds>(
+                        clock::now() - c.start ).count();
+        _latencyEwma    = (_latencyEwma == 0) ? us :
+            _latencyEwma * (1 - RPC_EWMA_WEIGHT) + us * RPC_EWMA_WEIGHT;
+        _failures       = 0;
+    }
+    else{
+        _failures++;
+    }
+    if (c.handler){
+        (_owner->*c.handler)( this, status, resp, c.arg );
+    }
+}
+
+void
+RpcClient::armTimer(){
+    if (_deadlines.empty() ){
+        evtimer_del( _timer );
+        return;
+    }
+    clock::duration     left    = _deadlines.begin()->first - clock::now();
+    long long           us      =
+        std::chrono::duration_cast<std::chrono::microseconds>(left).count();
+    struct timeval      tv;
+    if (us < 0){
+        us  = 0;
+    }
+    tv.tv_sec   = us / 1000000;
+    tv.tv_usec  = us % 1000000;
+    evtimer_add( _timer, &tv );
+}
+
+/**
+ *  \note   the expired calls are taken out and the timer re-armed before
+ *          their handlers are called, as one may delete the client.
+ * */
+void
+RpcClient::_timeout_cb( evutil_socket_t fd, short what, void* arg ){
+    RpcClient*          client  = (RpcClient*)arg;
+    Wrapper*            owner   = client->_owner;
+    clock::time_point   now     = clock::now();
+    DeadlineSet&        dl      = client->_deadlines;
+    std::vector<Call>   expired;
+    while( ! dl.empty() && dl.begin()->first <= now ){
+        CallMap::iterator   it  = client->_calls.find( dl.begin()->second );
+        if (it != client->_calls.end() ){
+            expired.push_back( it->second );
+            client->_calls.erase( it );
+        }
+        dl.erase( dl.begin() );
+    }
+    client->_failures   += expired.size();
+    client->armTimer();
+    for( auto& c : expired ){
+        if (c.handler){
+            (owner->*c.handler)( client, ETIMEDOUT, Slice(), c.arg );
+        }
+    }
+}
+
+NS_LEW_END();
+
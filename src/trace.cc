@@ -0,0 +1,130 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    <sys/syscall.h>
+#include    <unistd.h>
+#include    <algorithm>
+#include    <cinttypes>
+#include    <cstdio>
+#include    <ctime>
+#include    "lew/trace.h"
+
+using namespace std;
+NS_LEW_BEGIN();
+
+Tracer::Tracer( size_t capacity ){
+    size_t      n   = 1;
+    while( n < capacity ){
+        n   <<= 1;
+    }
+    _ring.resize( n );
+    _mask       = n - 1;
+    _next       = 0;
+    _oneIn      = 1;
+    _tick       = 0;
+    _tid        = 0;
+}
+
+int64_t
+Tracer::now(){
+    struct timespec     ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void
+Tracer::record( const char* name,   char    phase,  uint64_t conn,
+                int64_t     start,  int64_t duration ){
+    if (0 == _tid){
+        _tid    = (long)syscall( SYS_gettid );
+    }
+    TraceEvent&     evt = _ring[ _next & _mask ];
+    evt.name        = name;
+    evt.phase       = phase;
+    evt.conn        = conn;
+    evt.start       = start;
+    evt.duration    = duration;
+    _next++;
+}
+
+string
+Tracer::toJson(){
+    string      out     = "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    char        buf[256];
+    int         pid     = (int)getpid();
+    uint64_t    first   = _next > _ring.size() ? _next - _ring.size() : 0;
+    for( uint64_t i = first; i < _next; i++){
+        TraceEvent&     evt = _ring[ i & _mask ];
+        int             len;
+        if (evt.phase == 'X'){
+            len = snprintf( buf, sizeof(buf),
+                "%s\n{\"name\": \"%s\", \"cat\": \"lew\", \"ph\": \"X\", "
+                "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %ld, "
+                "\"args\": {\"conn\": %" PRIu64 "}}",
+                i > first ? "," : "", evt.name, evt.start / 1e3,
+                evt.duration / 1e3, pid, _tid, evt.conn );
+        }
+        else{
+            len = snprintf( buf, sizeof(buf),
+                "%s\n{\"name\": \"%s\", \"cat\": \"lew\", \"ph\": \"i\", "
+                "\"s\": \"t\", \"ts\": %.3f, \"pid\": %d, \"tid\": %ld, "
+                "\"args\": {\"conn\": %" PRIu64 "}}",
+                i > first ? "," : "", evt.name, evt.start / 1e3,
+                pid, _tid, evt.conn );
+        }
+        if (len > 0){
+            out.append( buf, std::min( (size_t)len, sizeof(buf) - 1 ) );
+        }
+    }
+    out += "\n]}\n";
+    return  out;
+}
+
+int
+Tracer::dump( const string& path ){
+    string      file    = path;
+    if (file.empty() ){
+        file    = _dumpPath;
+    }
+    if (file.empty() ){
+        char    name[64];
+        snprintf( name, sizeof(name), "lew-trace-%d.json", (int)getpid() );
+        file    = name;
+    }
+    FILE*       fp      = fopen( file.c_str(), "w" );
+    if (! fp){
+        return  -1;
+    }
+    string      json    = toJson();
+    size_t      n       = fwrite( json.data(), 1, json.size(), fp );
+    return  (fclose( fp ) == 0 && n == json.size()) ? 0 : -1;
+}
+
+NS_LEW_END();
@@ -0,0 +1,678 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    <cstdlib>
+#include    <cstring>
+#include    <string>
+#include    <event2/bufferevent.h>
+#include    "lew/websocket.h"
+#include    "lew/wrapper.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define     LEW_WS_SIMD     1
+#include    <immintrin.h>
+#endif
+
+NS_LEW_BEGIN();
+
+int
+WsCodec::parseHeader( const char* data, size_t len, WsFrame& frame ){
+    const uint8_t*  p   = (const uint8_t*)data;
+    size_t          n   = 2;
+    if (len < 2){
+        return  0;
+    }
+    if (p[0] & 0x70){
+        return  -1;
+    }
+    frame.fin       = (p[0] & 0x80) != 0;
+    frame.opcode    = p[0] & 0x0f;
+    frame.masked    = (p[1] & 0x80) != 0;
+    frame.length    = p[1] & 0x7f;
+    if (126 == frame.length){
+        n   += 2;
+    }
+    else if (127 == frame.length){
+        n   += 8;
+    }
+    if (len < n + (frame.masked ? 4 : 0) ){
+        return  0;
+    }
+    if (n > 2){
+        frame.length    = 0;
+        for( size_t i = 2; i < n; i++){
+            frame.length    = (frame.length << 8) | p[i];
+        }
+        if (frame.length >> 63){
+            return  -1;
+        }
+    }
+    if (frame.masked){
+        memcpy( frame.key, p + n, 4 );
+        n   += 4;
+    }
+    return  (int)n;
+}
+
+size_t
+WsCodec::writeHeader(   char*           out,
+                        int             opcode,
+                        bool            fin,
+                        uint64_t        length,
+                        const uint8_t*  key ){
+    uint8_t*    p   = (uint8_t*)out;
+    size_t      n   = 2;
+    p[0]    = (fin ? 0x80 : 0) | (opcode & 0x0f);
+    if (length < 126){
+        p[1]    = (uint8_t)length;
+    }
+    else if (length <= 0xffff){
+        p[1]    = 126;
+        p[2]    = (uint8_t)(length >> 8);
+        p[3]    = (uint8_t)length;
+        n       = 4;
+    }
+    else{
+        p[1]    = 127;
+        for( int i = 0; i < 8; i++){
+            p[2 + i]    = (uint8_t)(length >> (56 - 8 * i));
+        }
+        n       = 10;
+    }
+    if (key){
+        p[1]    |= 0x80;
+        memcpy( p + n, key, 4 );
+        n       += 4;
+    }
+    return  n;
+}
+
+/**
+ *  \note   the unmask kernels XOR `data` by the 4 bytes of `key`, the key
+ *          rotated to the start of `data` already.
+ * */
+typedef void (*unmask_t)( char* data, size_t len, uint32_t key );
+
+static void
+_unmask_scalar( char* data, size_t len, uint32_t key ){
+    uint64_t    key8    = ((uint64_t)key << 32) | key;
+    size_t      i       = 0;
+    for( ; i + 8 <= len; i += 8){
+        uint64_t    v;
+        memcpy( &v, data + i, 8 );
+        v   ^= key8;
+        memcpy( data + i, &v, 8 );
+    }
+    const uint8_t*  k   = (const uint8_t*)&key;
+    for( ; i < len; i++){
+        data[i] ^= k[ i & 3 ];
+    }
+}
+
+#ifdef  LEW_WS_SIMD
+__attribute__((target("sse2")))
+static void
+_unmask_sse2( char* data, size_t len, uint32_t key ){
+    const __m128i   k   = _mm_set1_epi32( (int)key );
+    size_t          i   = 0;
+    for( ; i + 16 <= len; i += 16){
+        __m128i     v   = _mm_loadu_si128( (const __m128i*)(data + i) );
+        _mm_storeu_si128( (__m128i*)(data + i), _mm_xor_si128( v, k ) );
+    }
+    _unmask_scalar( data + i, len - i, key );
+}
+
+__attribute__((target("avx2")))
+static void
+_unmask_avx2( char* data, size_t len, uint32_t key ){
+    const __m256i   k   = _mm256_set1_epi32( (int)key );
+    size_t          i   = 0;
+    for( ; i + 32 <= len; i += 32){
+        __m256i     v   = _mm256_loadu_si256( (const __m256i*)(data + i) );
+        _mm256_storeu_si256( (__m256i*)(data + i), _mm256_xor_si256( v, k ) );
+    }
+    _unmask_sse2( data + i, len - i, key );
+}
+#endif
+
+static WsCodec::Isa
+_best_isa(){
+#ifdef  LEW_WS_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports( "avx2" ) ){
+        return  WsCodec::ISA_AVX2;
+    }
+    if (__builtin_cpu_supports( "sse2" ) ){
+        return  WsCodec::ISA_SSE2;
+    }
+#endif
+    return  WsCodec::ISA_SCALAR;
+}
+
+static unmask_t
+_unmask_of( WsCodec::Isa isa ){
+#ifdef  LEW_WS_SIMD
+    if (WsCodec::ISA_AVX2 == isa){
+        return  _unmask_avx2;
+    }
+    if (WsCodec::ISA_SSE2 == isa){
+        return  _unmask_sse2;
+    }
+#endif
+    return  _unmask_scalar;
+}
+
+static WsCodec::Isa     _isa    = _best_isa();
+static unmask_t         _unmask = _unmask_of( _isa );
+
+WsCodec::Isa
+WsCodec::isa(){
+    return  _isa;
+}
+
+WsCodec::Isa
+WsCodec::setIsa( Isa isa ){
+    Isa     best    = _best_isa();
+    _isa    = isa < best ? isa : best;
+    _unmask = _unmask_of( _isa );
+    return  _isa;
+}
+
+const char*
+WsCodec::isaName( Isa isa ){
+    static const char*  names[] = { "scalar", "sse2", "avx2" };
+    return  (isa >= ISA_SCALAR && isa <= ISA_AVX2) ? names[isa] : "";
+}
+
+void
+WsCodec::unmask( char* data, size_t len, const uint8_t key[4], size_t offset ){
+    uint8_t     k[4];
+    uint32_t    rotated;
+    for( int i = 0; i < 4; i++){
+        k[i]    = key[ (offset + i) & 3 ];
+    }
+    memcpy( &rotated, k, 4 );
+    _unmask( data, len, rotated );
+}
+
+static void
+_free_frame( const void* data, size_t len, void* arg ){
+    free( (void*)data );
+}
+
+SharedBuffer*
+WsCodec::frame( const void* data, size_t len, int opcode ){
+    char*       buf = (char*)malloc( MAX_HEADER + len );
+    if (! buf){
+        return  nullptr;
+    }
+    size_t      n   = writeHeader( buf, opcode, true, len );
+    memcpy( buf + n, data, len );
+    return  SharedBuffer::wrap( buf, n + len, _free_frame, nullptr );
+}
+
+bool
+WsCodec::validUtf8( const char* data, size_t len ){
+    const uint8_t*  p   = (const uint8_t*)data;
+    const uint8_t*  end = p + len;
+    while( p < end ){
+        //  ASCII, 8 bytes at a time.
+        if (end - p >= 8){
+            uint64_t    v;
+            memcpy( &v, p, 8 );
+            if (0 == (v & 0x8080808080808080ULL) ){
+                p   += 8;
+                continue;
+            }
+        }
+        if (*p < 0x80){
+            p++;
+            continue;
+        }
+        size_t      n;
+        uint32_t    cp, min;
+        if (0xc0 == (*p & 0xe0)){
+            n   = 1;    cp  = *p & 0x1f;    min = 0x80;
+        }
+        else if (0xe0 == (*p & 0xf0)){
+            n   = 2;    cp  = *p & 0x0f;    min = 0x800;
+        }
+        else if (0xf0 == (*p & 0xf8)){
+            n   = 3;    cp  = *p & 0x07;    min = 0x10000;
+        }
+        else{
+            return  false;
+        }
+        if ((size_t)(end - p) <= n){
+            return  false;
+        }
+        for( size_t i = 1; i <= n; i++){
+            if (0x80 != (p[i] & 0xc0)){
+                return  false;
+            }
+            cp  = (cp << 6) | (p[i] & 0x3f);
+        }
+        if (cp < min || cp > 0x10ffff || (cp >= 0xd800 && cp <= 0xdfff) ){
+            return  false;
+        }
+        p   += n + 1;
+    }
+    return  true;
+}
+
+bool
+WsCodec::validCloseCode( int code ){
+    return  (code >= 1000 && code <= 1003) || (code >= 1007 && code <= 1014) ||
+            (code >= 3000 && code <= 4999);
+}
+
+/**
+ *  \note   SHA-1 of FIPS 180-4, for the handshake only.
+ * */
+static void
+_sha1( const uint8_t* data, size_t len, uint8_t digest[20] ){
+    uint32_t    h[5]    = { 0x67452301, 0xefcdab89, 0x98badcfe,
+                            0x10325476, 0xc3d2e1f0 };
+    std::string msg( (const char*)data, len );
+    uint64_t    bits    = (uint64_t)len * 8;
+    msg     += '\x80';
+    while( msg.size() % 64 != 56 ){
+        msg += '\0';
+    }
+    for( int i = 7; i >= 0; i--){
+        msg += (char)(bits >> (8 * i));
+    }
+    for( size_t off = 0; off < msg.size(); off += 64){
+        const uint8_t*  p   = (const uint8_t*)msg.data() + off;
+        uint32_t        w[80];
+        for( int i = 0; i < 16; i++){
+            w[i]    = (uint32_t)p[4*i] << 24 | (uint32_t)p[4*i+1] << 16 |
+                      (uint32_t)p[4*i+2] << 8 | p[4*i+3];
+        }
+        for( int i = 16; i < 80; i++){
+            uint32_t    v   = w[i-3] ^ w[i-8] ^ w[i-14] ^ w[i-16];
+            w[i]    = (v << 1) | (v >> 31);
+        }
+        uint32_t    a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for( int i = 0; i < 80; i++){
+            uint32_t    f, k;
+            if (i < 20){
+                f   = (b & c) | (~b & d);
+                k   = 0x5a827999;
+            }
+            else if (i < 40){
+                f   = b ^ c ^ d;
+                k   = 0x6ed9eba1;
+            }
+            else if (i < 60){
+                f   = (b & c) | (b & d) | (c & d);
+                k   = 0x8f1bbcdc;
+            }
+            else{
+                f   = b ^ c ^ d;
+                k   = 0xca62c1d6;
+            }
+            uint32_t    t   = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d;  d = c;  c = (b << 30) | (b >> 2);   b = a;  a = t;
+        }
+        h[0] += a;  h[1] += b;  h[2] += c;  h[3] += d;  h[4] += e;
+    }
+    for( int i = 0; i < 20; i++){
+        digest[i]   = (uint8_t)(h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+void
+WsCodec::accept( const char* key, size_t len, char out[29] ){
+    static const char   guid[]  = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+    static const char   b64[]   =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string     text( key, len );
+    uint8_t         d[21];
+    text    += guid;
+    _sha1( (const uint8_t*)text.data(), text.size(), d );
+    d[20]   = 0;
+    for( int i = 0, j = 0; i < 21; i += 3, j += 4){
+        uint32_t    v   = (uint32_t)d[i] << 16 | (uint32_t)d[i+1] << 8 |
+                          (i + 2 < 21 ? d[i+2] : 0);
+        out[j]      = b64[ (v >> 18) & 63 ];
+        out[j+1]    = b64[ (v >> 12) & 63 ];
+        out[j+2]    = b64[ (v >> 6) & 63 ];
+        out[j+3]    = b64[ v & 63 ];
+    }
+    out[27] = '=';
+    out[28] = '\0';
+}
+
+/**
+ *  \note   the handler of a connection upgraded to WebSocket.
+ *          <br>
+ *          a frame is unmasked in place in the input buffer, and a message
+ *          of one frame delivered from there, the fragments of other
+ *          messages are joined first. a close from the peer is answered,
+ *          and the connection closed once the answer is written.
+ *          <br>
+ *          a text message of bad UTF-8 is closed 1007, a close of a bad
+ *          code 1002, as RFC 6455 requires.
+ * */
+class   WebSocketSession : public MessageHandler{
+public:
+    enum    State{
+        OPEN        = 0,
+        CLOSE_SENT,             // waiting for the close of the peer.
+        CLOSING,                // closed once the output is written.
+    };
+    WebSocketSession( Wrapper* wrapper ):
+        _wrapper( wrapper ), _state( OPEN ), _opcode( -1 ),
+        _busy( false ), _closed( false ){};
+    virtual void    onMessage(  Connection* conn, const Slice& msg){};
+    virtual bool    onInput(    Connection* conn){
+        process( conn );
+        return  true;
+    };
+    virtual void    onWritten(  Connection* conn);
+    virtual void    onClose(    Connection* conn);
+    int             send(       Connection*     conn,
+                                int             opcode,
+                                const Slice&    payload,
+                                SharedBuffer*   shared  = nullptr );
+    int             close(      Connection* conn,   int     code);
+private:
+    void            process(    Connection* conn);
+    int             handle(     Connection*     conn,
+                                const WsFrame&  frame,
+                                char*           payload );
+    void            shutdown(   Connection* conn,   int     code);
+
+    Wrapper*                _wrapper;
+    State                   _state;
+    int                     _opcode;        // of the fragmented message,
+                                            // or -1.
+    std::string             _message;       // fragments joined.
+    bool                    _busy;          // in process().
+    bool                    _closed;        // closed while busy.
+};
+
+/**
+ *  \note   handle the frames in the input, until one is not complete. the
+ *          session is deleted here, if the connection is closed by a
+ *          callback.
+ * */
+void
+WebSocketSession::process( Connection* conn ){
+    if (_busy){
+        return;
+    }
+    const HttpServerOptions&    options = _wrapper->httpServerOptions();
+    struct evbuffer*            input   = conn->readBuf();
+    _busy   = true;
+    while( ! _closed && _state != CLOSING ){
+        char        head[ WsCodec::MAX_HEADER ];
+        WsFrame     frame;
+        ev_ssize_t  n   = evbuffer_copyout( input, head, sizeof(head) );
+        int         hl  = n > 0 ? WsCodec::parseHeader( head, n, frame ) : 0;
+        if (0 == hl){
+            break;
+        }
+        bool        control = (frame.opcode & 0x8) != 0;
+        bool        fragment= WsCodec::CONTINUATION == frame.opcode;
+        if (hl < 0 || ! frame.masked ||
+            (control && (! frame.fin || frame.length > 125 ||
+                         frame.opcode > WsCodec::PONG) ) ||
+            (! control && (frame.opcode > WsCodec::BINARY ||
+                           fragment != (_opcode >= 0) ) ) ){
+            shutdown( conn, 1002 );
+            break;
+        }
+        if (! control && options.maxWsMessageSize > 0 &&
+            _message.size() + frame.length > options.maxWsMessageSize ){
+            shutdown( conn, 1009 );
+            break;
+        }
+        size_t      total   = hl + frame.length;
+        if (evbuffer_get_length( input ) < total){
+            break;
+        }
+        char*       payload = (char*)evbuffer_pullup( input, total ) + hl;
+        WsCodec::unmask( payload, frame.length, frame.key );
+        if (handle( conn, frame, payload ) < 0 || _closed){
+            break;
+        }
+        evbuffer_drain( input, total );
+    }
+    _busy   = false;
+    if (_closed){
+        delete  this;
+    }
+}
+
+int
+WebSocketSession::handle(   Connection*     conn,
+                            const WsFrame&  frame,
+                            char*           payload ){
+    size_t      len     = (size_t)frame.length;
+    switch( frame.opcode ){
+    case WsCodec::PING:
+        send( conn, WsCodec::PONG, Slice( payload, len ) );
+        return  0;
+    case WsCodec::PONG:
+        return  0;
+    case WsCodec::CLOSE:
+        if (OPEN == _state){
+            //  echo the status code if any, or fail a malformed close.
+            int     code    = len >= 2 ?
+                (uint8_t)payload[0] << 8 | (uint8_t)payload[1] : 0;
+            int     status  = 0;
+            if (1 == len || (len >= 2 && ! WsCodec::validCloseCode( code )) ){
+                status  = 1002;
+            }
+            else if (len > 2 && ! WsCodec::validUtf8( payload + 2, len - 2 )){
+                status  = 1007;
+            }
+            char    reply[2]    = { (char)(status >> 8), (char)status };
+            send( conn, WsCodec::CLOSE, status ? Slice( reply, 2 ) :
+                                        Slice( payload, len >= 2 ? 2 : 0 ) );
+        }
+        _state  = CLOSING;
+        bufferevent_disable( conn->bev(), EV_READ );
+        if (0 == evbuffer_get_length( conn->writeBuf() ) ){
+            _wrapper->closeConnection( conn );
+        }
+        return  -1;
+    default:
+        break;
+    }
+    if (frame.fin && _opcode < 0){
+        if (WsCodec::TEXT == frame.opcode &&
+            ! WsCodec::validUtf8( payload, len ) ){
+            shutdown( conn, 1007 );
+            return  -1;
+        }
+        _wrapper->onWsMessage( conn, Slice( payload, len ),
+                               WsCodec::BINARY == frame.opcode );
+        return  0;
+    }
+    if (_opcode < 0){
+        _opcode = frame.opcode;
+        _message.assign( payload, len );
+    }
+    else{
+        _message.append( payload, len );
+    }
+    if (frame.fin){
+        bool        binary  = WsCodec::BINARY == _opcode;
+        _opcode = -1;
+        if (! binary && ! WsCodec::validUtf8( _message.data(),
+                                              _message.size() ) ){
+            shutdown( conn, 1007 );
+            return  -1;
+        }
+        _wrapper->onWsMessage( conn, Slice( _message.data(), _message.size() ),
+                               binary );
+        if (! _closed){
+            _message.clear();
+        }
+    }
+    return  0;
+}
+
+int
+WebSocketSession::send( Connection*     conn,
+                        int             opcode,
+                        const Slice&    payload,
+                        SharedBuffer*   shared ){
+    if (_state != OPEN){
+        return  -1;
+    }
+    char        head[ WsCodec::MAX_HEADER ];
+    size_t      len     = shared ? shared->len() : payload.len;
+    size_t      hl      = WsCodec::writeHeader( head, opcode, true, len );
+    evbuffer_add( conn->writeBuf(), head, hl );
+    if (shared){
+        return  shared->appendTo( conn->writeBuf() );
+    }
+    return  evbuffer_add( conn->writeBuf(), payload.data, payload.len );
+}
+
+/**
+ *  \note   send a close of `code`, and wait for the one of the peer, for
+ *          the timeout of the http server at most.
+ * */
+int
+WebSocketSession::close( Connection* conn, int code ){
+    char        status[2]   = { (char)(code >> 8), (char)code };
+    int         timeoutMs   = _wrapper->httpServerOptions().timeoutMs;
+    struct timeval  tv;
+    if (send( conn, WsCodec::CLOSE, Slice( status, 2 ) ) < 0){
+        return  -1;
+    }
+    _state      = CLOSE_SENT;
+    if (timeoutMs <= 0){
+        timeoutMs   = 50 * 1000;
+    }
+    tv.tv_sec   = timeoutMs / 1000;
+    tv.tv_usec  = (timeoutMs % 1000) * 1000;
+    bufferevent_set_timeouts( conn->bev(), &tv, &tv );
+    return  0;
+}
+
+/**
+ *  \note   close the connection for a frame against the protocol, once
+ *          the close of `code` is written.
+ * */
+void
+WebSocketSession::shutdown( Connection* conn, int code ){
+    char        status[2]   = { (char)(code >> 8), (char)code };
+    send( conn, WsCodec::CLOSE, Slice( status, 2 ) );
+    _state  = CLOSING;
+    bufferevent_disable( conn->bev(), EV_READ );
+}
+
+void
+WebSocketSession::onWritten( Connection* conn ){
+    if (CLOSING == _state && 0 == evbuffer_get_length( conn->writeBuf() ) ){
+        _wrapper->closeConnection( conn );
+    }
+}
+
+void
+WebSocketSession::onClose( Connection* conn ){
+    if (_busy){
+        _closed = true;
+    }
+    else{
+        delete  this;
+    }
+}
+
+/**
+ *  \note   input read with the request upgraded is handled on the next
+ *          round of the loop, not in the callback of the request.
+ * */
+void
+Wrapper::startWebSocket( Connection* conn ){
+    int             ms      = _httpOptions.timeoutMs;
+    struct timeval  tv;
+    if (ms <= 0){
+        ms  = 50 * 1000;
+    }
+    tv.tv_sec   = ms / 1000;
+    tv.tv_usec  = (ms % 1000) * 1000;
+    conn->setHandler( new WebSocketSession( this ) );
+    bufferevent_set_timeouts( conn->bev(), nullptr, &tv );
+    bufferevent_enable( conn->bev(), EV_READ );
+    if (evbuffer_get_length( conn->readBuf() ) ){
+        bufferevent_trigger( conn->bev(), EV_READ,
+                             BEV_TRIG_IGNORE_WATERMARKS |
+                             BEV_TRIG_DEFER_CALLBACKS );
+    }
+}
+
+static WebSocketSession*
+_ws_session( Wrapper* wrapper, Connection* conn ){
+    ConnectionSet&      cs  = wrapper->webSocketConnectionSet();
+    return  cs.find( conn ) != cs.end() ?
+            static_cast<WebSocketSession*>( conn->handler() ) : nullptr;
+}
+
+int
+Wrapper::sendWsMessage( Connection*     conn,
+                        const Slice&    msg,
+                        bool            binary ){
+    WebSocketSession*   session = _ws_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    return  session->send( conn, binary ? WsCodec::BINARY : WsCodec::TEXT,
+                           msg );
+}
+
+int
+Wrapper::sendWsMessage( Connection*     conn,
+                        SharedBuffer*   msg,
+                        bool            binary ){
+    WebSocketSession*   session = _ws_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    return  session->send( conn, binary ? WsCodec::BINARY : WsCodec::TEXT,
+                           Slice(), msg );
+}
+
+int
+Wrapper::closeWebSocket( Connection* conn, int code ){
+    WebSocketSession*   session = _ws_session( this, conn );
+    if (! session){
+        return  -1;
+    }
+    return  session->close( conn, code );
+}
+
+NS_LEW_END();
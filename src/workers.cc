@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2016, Peixu Zhu
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ *    this list of conditions and the following disclaimer in the documentation
+ *    and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ *
+ * */
+
+
+#include    <arpa/inet.h>
+#include    <sys/socket.h>
+#include    <unistd.h>
+#include    <cerrno>
+#include    <cstring>
+#include    "lew/workers.h"
+
+using namespace std;
+NS_LEW_BEGIN();
+
+static void
+_workers_stop_cb( evutil_socket_t fd, short what, void* arg){
+    ((Wrapper*)arg)->stop();
+}
+
+static void
+_worker_main( Wrapper* worker ){
+    worker->start();
+}
+
+/**
+ *  \note   a bound and listening nonblocking socket, or -1.
+ * */
+static evutil_socket_t
+_listen_socket( const struct sockaddr_in& sin, bool reusePort ){
+    evutil_socket_t     fd  = socket( AF_INET, SOCK_STREAM, 0 );
+    if (fd < 0){
+        return  -1;
+    }
+    if (evutil_make_socket_nonblocking( fd ) < 0 ||
+        evutil_make_socket_closeonexec( fd ) < 0 ||
+        evutil_make_listen_socket_reuseable( fd ) < 0 ||
+        (reusePort && evutil_make_listen_socket_reuseable_port( fd ) < 0) ||
+        bind( fd, (const struct sockaddr*)&sin, sizeof(sin) ) < 0 ||
+        ::listen( fd, SOMAXCONN ) < 0 ){
+        int     err = errno;
+        evutil_closesocket( fd );
+        errno   = err;
+        return  -1;
+    }
+    return  fd;
+}
+
+HttpWorkers::HttpWorkers( factory_t factory, void* arg ){
+    _factory    = factory;
+    _arg        = arg;
+    _reusePort  = true;
+    _running    = false;
+}
+
+HttpWorkers::~HttpWorkers(){
+    stop();
+    join();
+    for( auto evt : _stops ){
+        if (evt){
+            event_free( evt );
+        }
+    }
+    for( auto worker : _workers ){
+        worker->clean();
+        delete  worker;
+    }
+}
+
+bool
+HttpWorkers::listen( const std::string& listenAddr, uint16_t port, int threads){
+    struct sockaddr_in  sin;
+    memset( &sin, 0, sizeof(sin) );
+    sin.sin_family  = AF_INET;
+    sin.sin_port    = htons( port );
+    if (threads < 1 || ! _workers.empty() ||
+        inet_pton( AF_INET, listenAddr.c_str(), &sin.sin_addr.s_addr ) <= 0){
+        errno   = EINVAL;
+        return  false;
+    }
+    evutil_socket_t     shared  = -1;
+    if (! _reusePort && (shared = _listen_socket( sin, false )) < 0){
+        return  false;
+    }
+    bool    ret     = true;
+    for( int i = 0; ret && i < threads; i++){
+        Wrapper*        worker  = _factory( i, _arg );
+        if (! worker){
+            ret     = false;
+            break;
+        }
+        struct event*   evt     =
+            event_new( worker->base(), -1, 0, _workers_stop_cb, worker );
+        _workers.push_back( worker );
+        _stops.push_back( evt );
+        worker->setSignalHandling( 0 == i );
+        //  each evhttp closes its own socket, so the shared one is dup'ed.
+        evutil_socket_t fd  = _reusePort ? _listen_socket( sin, true ) :
+                                           dup( shared );
+        ret     = evt && fd >= 0 && worker->startHttpServer( fd );
+    }
+    if (shared >= 0){
+        evutil_closesocket( shared );
+    }
+    return  ret;
+}
+
+bool
+HttpWorkers::run(){
+    if (_workers.empty() || _running){
+        errno   = _running ? EEXIST : EINVAL;
+        return  false;
+    }
+    _running    = true;
+    for( size_t i = 1; i < _workers.size(); i++){
+        _threads.push_back( std::thread( _worker_main, _workers[i] ) );
+    }
+    bool    ret = _workers[0]->start();
+    stop();
+    join();
+    _running    = false;
+    return  ret;
+}
+
+void
+HttpWorkers::stop(){
+    for( auto evt : _stops ){
+        if (evt){
+            event_active( evt, EV_TIMEOUT, 0 );
+        }
+    }
+}
+
+void
+HttpWorkers::join(){
+    for( auto& t : _threads ){
+        t.join();
+    }
+    _threads.clear();
+}
+
+void
+HttpWorkers::metrics( Metrics& out ){
+    out.reset();
+    for( auto worker : _workers ){
+        out.merge( worker->metrics(), ! _running );
+    }
+}
+
+NS_LEW_END();
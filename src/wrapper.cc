@@ -28,11 +28,15 @@
  * */
 
 #include    <arpa/inet.h>
+#include    <fcntl.h>
+#include    <unistd.h>
+#include    <algorithm>
 #include    <cerrno>
 #include    <cassert>
 #include    <csignal>
 #include    <cstdio>
 #include    <cstring>
+#include    <ctime>
 #include    "lew/wrapper.h"
 
 using namespace std;
@@ -76,9 +80,61 @@ get_host_port(int fd, std::string&  remote, uint16_t&   port){
     return  ret;
 }
 
+static  int64_t
+_clock_ns(){
+    struct timespec     ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ *  \note   records the duration of the callback it is declared in, when
+ *          timing of the metrics, the slow callback watchdog, or the
+ *          tracer is enabled.
+ * */
+class   CallbackClock{
+public:
+    CallbackClock(  Wrapper*                wrapper,
+                    Wrapper::CallbackType   type,
+                    Connection*             conn    = nullptr ){
+        _conn       = conn ? conn->id() : 0;
+        _trace      = wrapper->_tracer && wrapper->_tracer->sampled( _conn );
+        _wrapper    = (_trace || wrapper->callbackClocked()) ? wrapper : nullptr;
+        if (_wrapper){
+            _type   = type;
+            _port   = 0;
+            if (conn && wrapper->_slowNs >= 0){
+                _addr   = conn->addr();
+                _port   = conn->port();
+            }
+            _start  = _clock_ns();
+        }
+    }
+    ~CallbackClock(){
+        if (_wrapper){
+            int64_t     ns  = _clock_ns() - _start;
+            _wrapper->callbackDone( _type, _conn, _addr, _port,
+                                    _start, ns, _trace );
+        }
+    }
+protected:
+    Wrapper*                _wrapper;
+    Wrapper::CallbackType   _type;
+    uint64_t                _conn;
+    bool                    _trace;
+    std::string             _addr;
+    uint16_t                _port;
+    int64_t                 _start;
+};
+
 static void
 _signal_cb(evutil_socket_t  fd, short  what, void* arg){
     Wrapper*    wrapper     = (Wrapper*)arg;
+    if (SIGUSR2 == fd && wrapper->tracer() ){
+        if (wrapper->tracer()->dump() != 0){
+            perror("fail to dump the trace");
+        }
+    }
     wrapper->onSignal( fd );
 }
 
@@ -88,6 +144,8 @@ _timer_cb(int   s,  short what,  void* arg){
     if (t){
         Wrapper*            owner       = (Wrapper*)t->owner;
         timer_handler_t     handler     = t->handler;
+        CallbackClock       clock( owner, Wrapper::CALLBACK_TIMER );
+        owner->_metrics.timersFired.inc();
         if (owner && handler){
             (owner->*handler)(t, t->args);
         }
@@ -100,42 +158,99 @@ void
 _event_cb(struct bufferevent*   bev, short  evt, void* ctx ){
     Connection*             conn    = (Connection*)ctx;
     Wrapper*                wrapper = conn->owner();
-    bool                    is_live = true;
-    ConnectionSet::iterator it      =
-        wrapper->tcpServerConnectionSet().find( conn );
-    if (it == wrapper->tcpServerConnectionSet().end() ){
-        it = wrapper->tcpClientConnectionSet().find( conn );
-        if ( it == wrapper->tcpClientConnectionSet().end() ){
-            is_live = false;
+    CallbackClock           clock( wrapper, Wrapper::CALLBACK_EVENT, conn );
+    ConnectionSet*          sets[]  = { &wrapper->tcpServerConnectionSet(),
+                                        &wrapper->tcpClientConnectionSet(),
+                                        &wrapper->nativeHttpConnectionSet(),
+                                        &wrapper->webSocketConnectionSet() };
+    ConnectionSet*          set     = nullptr;
+    for( auto cs : sets ){
+        if (cs->find( conn ) != cs->end() ){
+            set = cs;
+            break;
         }
     }
-    if ( is_live ){
-        if (evt & (BEV_EVENT_EOF | BEV_EVENT_ERROR) ){
+    if ( set ){
+        //  only connections of the native http server have timeouts,
+        //  for idle reads, and WebSockets waiting for a close.
+        if (evt & BEV_EVENT_TIMEOUT){
+            wrapper->metrics().httpTimeouts.inc();
+        }
+        if (evt & (BEV_EVENT_EOF | BEV_EVENT_ERROR | BEV_EVENT_TIMEOUT) ){
             bool    remove_conn = true;
             bool    reconnect   =
                 (conn->retryTimes() &&
                  conn->type() ==Connection::CONN_TCP_CLIENT);
             if (reconnect){
                 if (conn->bev() ){
-                    bufferevent_free(conn->bev() );
+                    //  detached first, the fd is closed with the bev.
+                    struct bufferevent* bev = conn->bev();
                     conn->setBev( nullptr );
+                    bufferevent_free( bev );
                 }
                 conn->_status   = Connection::DISCONNECTED;
                 remove_conn     = (wrapper->tcpClientReconnect( conn ) != 0 );
             }
             if (remove_conn){
-                if (conn->type() == Connection::CONN_TCP_CLIENT ){
-                    wrapper->tcpClientConnectionSet().erase( conn );
-                }
-                else{
-                    wrapper->tcpServerConnectionSet().erase( conn );
-                }
+                set->erase( conn );
                 delete  conn;
+                return;
+            }
+            if (reconnect && conn->handler() ){
+                //  the handler may close the connection.
+                bool    alive   = true;
+                bool*   outer   = conn->_alive;
+                conn->_alive    = &alive;
+                conn->handler()->onReset( conn );
+                if (! alive){
+                    return;
+                }
+                conn->_alive    = outer;
             }
         }
         if (evt & BEV_EVENT_CONNECTED){
             conn->_status   = Connection::CONNECTED;
+            if (conn->handler() ){
+                conn->handler()->onConnected( conn );
+            }
+        }
+    }
+}
+
+/**
+ *  \note   deliver all the complete frames in the input buffer, until the
+ *          connection is closed or its codec changed by a callback, e.g.
+ *          when its handler is deleted.
+ * */
+void
+_read_frames( Connection* conn, Codec* codec ){
+    Wrapper*            wrapper = conn->owner();
+    struct evbuffer*    buf     = conn->readBuf();
+    Slice               frame;
+    size_t              len     = 0;
+    bool                alive   = true;
+    int                 ret;
+    conn->_alive    = &alive;
+    while( (ret = codec->decodeFrom( buf, frame, len,
+                                     conn->_scanned )) > 0 ){
+        if (conn->handler() ){
+            conn->handler()->onMessage( conn, frame );
+        }
+        else{
+            wrapper->onMessage( conn, frame );
+        }
+        if (! alive){
+            return;
         }
+        evbuffer_drain( buf, len );
+        if (conn->codec() != codec){
+            break;
+        }
+    }
+    conn->_alive    = nullptr;
+    if (ret < 0){
+        DBG_PRINT("bad frame from %s:%d\n", conn->addr().c_str(), conn->port());
+        wrapper->closeConnection( conn );
     }
 }
 
@@ -143,14 +258,33 @@ static void
 _read_cb( struct bufferevent*   bev, void* ctx){
     Connection* conn    = (Connection*)ctx;
     Wrapper*    wrapper = conn->owner();
-    wrapper->onConnectionRead( conn );
+    CallbackClock   clock( wrapper, Wrapper::CALLBACK_READ, conn );
+    wrapper->metrics().readCallbacks.inc();
+    if (conn->handler() && conn->handler()->onInput( conn ) ){
+        return;
+    }
+    if (conn->codec() ){
+        _read_frames( conn, conn->codec() );
+    }
+    else{
+        wrapper->onConnectionRead( conn );
+    }
 }
 
 static void
 _write_cb(struct bufferevent*   bev, void* ctx){
     Connection* conn    = (Connection*)ctx;
     Wrapper*    wrapper = conn->owner();
+    CallbackClock   clock( wrapper, Wrapper::CALLBACK_WRITE, conn );
+    wrapper->metrics().writeCallbacks.inc();
+    if (conn->corked() || conn->autoFlush() ){
+        bufferevent_disable( bev, EV_WRITE );
+    }
     wrapper->onConnectionWrite( conn );
+    //  last, the handler may close the connection.
+    if (conn->handler() ){
+        conn->handler()->onWritten( conn );
+    }
 }
 
 void
@@ -159,22 +293,14 @@ _listen_cb( struct evconnlistener*      listener,
             struct sockaddr*            sock,
             int                         socklen,
             void*                       ctx) {
-    Wrapper*    wrapper     = (Wrapper*)ctx;
-    int         flag        =
-        BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE;
-    struct event_base*  base= wrapper->base();
-    struct bufferevent* bev = bufferevent_socket_new( base, fd, flag );
-    //
-    assert( bev );
-    uint16_t        port;
-    string          remote_ip;
-    get_host_port(fd, remote_ip, port);
-    Connection*     conn    = new Connection(
-        wrapper, Connection::CONN_TCP_SERVER, remote_ip.c_str(), port);
-    bufferevent_setcb(bev, _read_cb, _write_cb, _event_cb, conn);
-    bufferevent_enable(bev, EV_READ | EV_WRITE);
-    conn->setBev( bev );
-    wrapper->tcpServerConnectionSet().insert( conn );
+    Wrapper*        wrapper = (Wrapper*)ctx;
+    Connection*     conn    = wrapper->acceptConnection(
+                                fd, wrapper->tcpServerConnectionSet() );
+    conn->setCodec( wrapper->codec() );
+    if (wrapper->writeCoalescing() >= 0){
+        conn->setAutoFlush( true );
+    }
+    CallbackClock   clock( wrapper, Wrapper::CALLBACK_ACCEPT, conn );
     wrapper->onNewConnection( conn );
 }
 
@@ -188,14 +314,99 @@ _listen_error_cb(struct evconnlistener* listener, void* ctx){
             err_info );
 }
 
-static void
+void
 _http_client_close_cb( struct evhttp_connection*    evconn, void*  ctx){
     Connection*     conn    = (Connection*)ctx;
     Wrapper*        wrapper = conn->owner();
     ConnectionSet&  cs      = wrapper->httpServerConnectionSet();
     if (cs.find( conn ) != cs.end() ){
-        delete conn;
-        wrapper->httpServerConnectionSet().erase( conn );
+        wrapper->closeHttpServerConnection( evconn, conn );
+    }
+}
+
+/**
+ *  \note   the bufferevent of a connection accepted by the http server.
+ *          it is referenced until the end of the loop iteration, when its
+ *          evhttp connection is bound to a Connection by _http_accept_cb.
+ * */
+struct bufferevent*
+_http_bev_cb( struct event_base* base, void* ctx){
+    Wrapper*            wrapper = (Wrapper*)ctx;
+    struct bufferevent* bev     =
+        bufferevent_socket_new( base, -1, BEV_OPT_CLOSE_ON_FREE );
+    if (bev){
+        bufferevent_incref( bev );
+        wrapper->_httpAccepted.push_back( bev );
+        event_active( wrapper->_httpAcceptEvent, EV_TIMEOUT, 0 );
+    }
+    return  bev;
+}
+
+void
+_http_accept_cb(int   s,  short what,  void* arg){
+    Wrapper*                        wrapper = (Wrapper*)arg;
+    std::vector<struct bufferevent*>    bevs;
+    bevs.swap( wrapper->_httpAccepted );
+    for( auto bev : bevs ){
+        //  the callback argument is the evhttp connection, or nullptr once
+        //  evhttp freed it.
+        void*       evcon   = nullptr;
+        bufferevent_getcb( bev, NULL, NULL, NULL, &evcon );
+        if (evcon){
+            wrapper->httpServerConnection( (struct evhttp_connection*)evcon );
+        }
+        bufferevent_decref( bev );
+    }
+}
+
+void
+_http_in_cb(    struct evbuffer*                buf,
+                const struct evbuffer_cb_info*  info,
+                void*                           ctx){
+    Connection*     conn    = (Connection*)ctx;
+    if (info->n_added){
+        event_base_gettimeofday_cached( conn->owner()->base(),
+                                        &conn->_httpActive );
+    }
+    conn->_httpParsed   += info->n_deleted;
+    conn->_httpBuffered = info->orig_size + info->n_added - info->n_deleted;
+}
+
+/**
+ *  \note   a reply written while no request is being served is one of
+ *          evhttp, rejecting a request before it reaches the wrapper: 413
+ *          for a body over the size, 400 for headers over the size, or
+ *          malformed ones.
+ * */
+void
+_http_out_cb(   struct evbuffer*                buf,
+                const struct evbuffer_cb_info*  info,
+                void*                           ctx){
+    Connection*     conn    = (Connection*)ctx;
+    Wrapper*        wrapper = conn->owner();
+    if (info->n_deleted){
+        event_base_gettimeofday_cached( wrapper->base(), &conn->_httpActive );
+    }
+    if (info->n_added && ! conn->_httpCtx){
+        char                    line[16];
+        struct evbuffer_ptr     pos;
+        evbuffer_ptr_set( buf, &pos, info->orig_size, EVBUFFER_PTR_SET );
+        ev_ssize_t  n   = evbuffer_copyout_from( buf, &pos, line,
+                                                 sizeof(line) - 1 );
+        line[ n > 0 ? n : 0 ]   = '\0';
+        int         code    = n > 9 ? atoi( line + 9 ) : 0;
+        ev_ssize_t  limit   = wrapper->httpServerOptions().maxHeadersSize;
+        size_t      seen    = conn->_httpParsed + conn->_httpBuffered;
+        if (HTTP_ENTITYTOOLARGE == code){
+            wrapper->metrics().httpBodyTooLarge.inc();
+        }
+        else if (HTTP_BADREQUEST == code && limit >= 0 &&
+                 seen > (size_t)limit){
+            wrapper->metrics().httpHeadersTooLarge.inc();
+        }
+        else if (HTTP_BADREQUEST == code){
+            wrapper->metrics().httpBadRequests.inc();
+        }
     }
 }
 
@@ -203,32 +414,108 @@ static void
 _http_req_close_cb( struct evhttp_request* req, void* ctx){
     Connection*     conn    = (Connection*)ctx;
     Wrapper*        wrapper = conn->owner();
+    CallbackClock   clock( wrapper, Wrapper::CALLBACK_HTTP_RESPONSE, conn );
     wrapper->onHttpResponse(conn, conn->httpReq() );
 }
 
+/**
+ *  \note   called once the reply of a request is sent.
+ * */
+void
+_http_req_done_cb( struct evhttp_request* req, void* ctx){
+    HttpRequestContext* rc      = (HttpRequestContext*)ctx;
+    Wrapper*        wrapper = rc->conn->owner();
+    int             code    = evhttp_request_get_response_code( req );
+    int             klass   = (code >= 100 && code < 600) ? code / 100 : 0;
+    wrapper->metrics().httpStatus[ klass ].inc();
+    wrapper->releaseHttpContext( rc );
+}
+
+static void
+_route_request( Wrapper* wrapper, Connection* conn, struct evhttp_request* req){
+    HttpRouter&             router  = wrapper->router();
+    const struct evhttp_uri*    uri = evhttp_request_get_evhttp_uri( req );
+    const char*             path    = uri ? evhttp_uri_get_path( uri ) : NULL;
+    HttpParams              params;
+    http_handler_t          handler;
+    if (! path || ! *path){
+        path    = "/";
+    }
+    int     status  = router.match( evhttp_request_get_command( req ),
+                                    Slice( path, strlen( path ) ),
+                                    handler, params );
+    if (200 == status){
+        (wrapper->*handler)( conn, req, params );
+    }
+    else if (404 == status && router.notFound() ){
+        (wrapper->*router.notFound())( conn, req, params );
+    }
+    else{
+        evhttp_send_error( req, status, NULL );
+    }
+}
+
 void
 _http_req_cb( struct evhttp_request*  req, void * ctx){
     Wrapper*        wrapper = (Wrapper*)ctx;
-    struct evhttp_connection*   http_conn =
-        evhttp_request_get_connection( req );
-    string          ip_addr = "";
-    uint16_t        port    = 0;
-    struct bufferevent* bev = nullptr;
-    if (http_conn){
-        char*   addr    = 0;
-        evhttp_connection_get_peer(http_conn, &addr, &port);
-        if (addr) ip_addr   = addr;
-        bev     = evhttp_connection_get_bufferevent( http_conn );
-        bufferevent_enable(bev, EV_READ);
+    wrapper->metrics().httpRequests.inc();
+    Connection*     conn    =
+        wrapper->httpServerConnection( evhttp_request_get_connection( req ) );
+    HttpRequestContext* rc  = wrapper->acquireHttpContext( conn, req );
+    const HttpServerOptions&    options = wrapper->httpServerOptions();
+    evhttp_request_set_on_complete_cb( req, _http_req_done_cb, rc );
+    conn->_httpParsed   = 0;
+    if (options.maxKeepAliveRequests > 0 &&
+        ++conn->_httpServed >= options.maxKeepAliveRequests ){
+        const char*     close   = evhttp_find_header(
+            evhttp_request_get_input_headers( req ), "Connection" );
+        if (! close || evutil_ascii_strcasecmp( close, "close" ) != 0){
+            wrapper->metrics().httpKeepAliveLimits.inc();
+        }
+        evhttp_add_header( evhttp_request_get_output_headers( req ),
+                           "Connection", "close" );
     }
-    Connection* conn = new Connection( wrapper, Connection::CONN_HTTP_SERVER,
-                                       ip_addr.c_str(), port);
-    conn->setHttpReq( req );
-    if (http_conn){
-        evhttp_connection_set_closecb(http_conn, _http_client_close_cb, conn );
+    if (! (evhttp_request_get_command( req ) & options.allowedMethods) ){
+        wrapper->metrics().httpBadMethods.inc();
+        evhttp_add_header( evhttp_request_get_output_headers( req ),
+                           "Allow", wrapper->_httpAllow.c_str() );
+        evhttp_send_reply( req, HTTP_BADMETHOD, "Method Not Allowed", NULL );
+        return;
+    }
+    if (options.streamBodies){
+        wrapper->readHttpBody( rc );
+        if (rc->bodyFailed){
+            evhttp_send_reply( req, HTTP_INTERNAL, "Internal Server Error",
+                               NULL );
+            return;
+        }
+    }
+    if (wrapper->_httpCache &&
+        wrapper->_httpCache->lookup( rc ) != HttpCache::FILL ){
+        return;
+    }
+    wrapper->dispatchHttpRequest( conn, req );
+}
+
+void
+_flush_cb(int   s,  short what,  void* arg){
+    Wrapper*                    wrapper = (Wrapper*)arg;
+    std::vector<Connection*>    conns( wrapper->_flushSet.begin(),
+                                       wrapper->_flushSet.end() );
+    wrapper->_flushSet.clear();
+    for( auto conn : conns ){
+        conn->_flushPending = false;
+        conn->flush();
     }
-    wrapper->httpServerConnectionSet().insert( conn );
-    wrapper->onHttpRequest(conn, req);
+}
+
+void
+_lag_probe_cb(int   s,  short what,  void* arg){
+    Wrapper*        wrapper = (Wrapper*)arg;
+    int64_t         now     = _clock_ns();
+    wrapper->_metrics.loopLag.record( std::max( now - wrapper->_lagDue,
+                                                (int64_t)0 ) );
+    wrapper->scheduleLagProbe( now );
 }
 
 ///////////////////////////////////
@@ -250,13 +537,53 @@ Wrapper::Wrapper(){
     if (! _base)    throw _constructException;
     _started    = false;
     _stopped    = false;
+    _signals    = true;
     memset(_sig_events, 0, sizeof(_sig_events) );
+    _codec          = nullptr;
+    _srcNext        = 0;
+    _lingerZero     = false;
+    _flushUsec      = -1;
+    _flushEvent     = evtimer_new( _base, _flush_cb, this );
+    _writeSyscalls  = 0;
+    _writeMessages  = 0;
+    _slowNs         = -1;
+    _tracer         = nullptr;
+    _httpCache      = nullptr;
+    _lagMs          = 0;
+    _lagDue         = 0;
+    _lagEvent       = evtimer_new( _base, _lag_probe_cb, this );
+    _httpAcceptEvent= event_new( _base, -1, 0, _http_accept_cb, this );
+    if (! _flushEvent || ! _lagEvent || ! _httpAcceptEvent){
+        throw _constructException;
+    }
+    setHttpServerOptions( HttpServerOptions() );
 }
 
 Wrapper::~Wrapper(){
     for( auto t : _timerSet ){
         delete t;
     }
+    for( auto rc : _httpCtxPool ){
+        if (rc->body){
+            evbuffer_free( rc->body );
+        }
+        delete rc;
+    }
+    if (_flushEvent){
+        event_free( _flushEvent );
+        _flushEvent = nullptr;
+    }
+    if (_lagEvent){
+        event_free( _lagEvent );
+        _lagEvent   = nullptr;
+    }
+    for( auto bev : _httpAccepted ){
+        bufferevent_decref( bev );
+    }
+    if (_httpAcceptEvent){
+        event_free( _httpAcceptEvent );
+        _httpAcceptEvent    = nullptr;
+    }
     if (_base){
         event_base_free( _base );
         _base   = nullptr;
@@ -304,6 +631,496 @@ Wrapper::delTimer(Timer* timer){
     return ( 0 == ret);
 }
 
+const char*
+Wrapper::callbackName( CallbackType type ){
+    static const char*  names[] = { "accept", "read", "write", "event",
+                                    "timer", "http request", "http response" };
+    return  (type >= 0 && type <= CALLBACK_HTTP_RESPONSE) ? names[type] : "";
+}
+
+void
+Wrapper::setSlowCallbackThreshold( int usec ){
+    _slowNs     = usec < 0 ? -1 : (int64_t)usec * 1000;
+}
+
+void
+Wrapper::callbackDone(  CallbackType        type,
+                        uint64_t            conn,
+                        const std::string&  addr,
+                        uint16_t            port,
+                        int64_t             start,
+                        int64_t             ns,
+                        bool                trace ){
+    if (trace){
+        _tracer->record( callbackName( type ), 'X', conn, start, ns );
+    }
+    if (_metrics.timing() ){
+        _metrics.callbackTime.record( ns );
+    }
+    if (_slowNs >= 0 && ns > _slowNs){
+        _metrics.slowCallbacks.inc();
+        onSlowCallback( type, addr, port, ns / 1000 );
+    }
+}
+
+void
+Wrapper::onSlowCallback(CallbackType        type,
+                        const std::string&  addr,
+                        uint16_t            port,
+                        int64_t             usec ){
+    if (addr.empty() ){
+        fprintf(stderr, "slow %s callback took %.3f ms\n",
+                callbackName( type ), usec / 1000.0 );
+    }
+    else{
+        fprintf(stderr, "slow %s callback of %s:%d took %.3f ms\n",
+                callbackName( type ), addr.c_str(), port, usec / 1000.0 );
+    }
+}
+
+void
+Wrapper::setLagProbe( int ms ){
+    _lagMs  = ms > 0 ? ms : 0;
+    if (_lagMs){
+        scheduleLagProbe( _clock_ns() );
+    }
+    else{
+        evtimer_del( _lagEvent );
+    }
+}
+
+void
+Wrapper::scheduleLagProbe( int64_t now ){
+    struct timeval  tv;
+    tv.tv_sec       = _lagMs / 1000;
+    tv.tv_usec      = (_lagMs % 1000) * 1000;
+    _lagDue         = now + (int64_t)_lagMs * 1000000;
+    evtimer_add( _lagEvent, &tv );
+}
+
+/**
+ *  \note   the connection of an evhttp connection, created on its first
+ *          request, and released when it is closed.
+ * */
+Connection*
+Wrapper::httpServerConnection( struct evhttp_connection* evcon ){
+    HttpConnectionMap::iterator it  = _httpServerConns.find( evcon );
+    if (it != _httpServerConns.end() ){
+        return  it->second;
+    }
+    char*           addr    = nullptr;
+    uint16_t        port    = 0;
+    if (evcon){
+        evhttp_connection_get_peer( evcon, &addr, &port );
+        bufferevent_enable( evhttp_connection_get_bufferevent( evcon ), EV_READ);
+    }
+    Connection*     conn    = new Connection( this,
+        Connection::CONN_HTTP_SERVER, addr ? addr : "", port );
+    if (evcon){
+        struct bufferevent* bev = evhttp_connection_get_bufferevent( evcon );
+        evhttp_connection_set_closecb( evcon, _http_client_close_cb, conn );
+        conn->_httpEvcon    = evcon;
+        conn->_httpCbs[0]   = evbuffer_add_cb( bufferevent_get_input( bev ),
+                                               _http_in_cb, conn );
+        conn->_httpCbs[1]   = evbuffer_add_cb( bufferevent_get_output( bev ),
+                                               _http_out_cb, conn );
+        event_base_gettimeofday_cached( _base, &conn->_httpActive );
+    }
+    _httpServerConns[ evcon ]   = conn;
+    _httpServerConnectionSet.insert( conn );
+    return  conn;
+}
+
+/**
+ *  \note   a connection closed while idle for the timeout is taken as
+ *          closed by it, since evhttp would have closed it by then.
+ * */
+void
+Wrapper::closeHttpServerConnection( struct evhttp_connection* evcon,
+                                    Connection*               conn ){
+    if (conn->_httpCbs[0]){
+        struct bufferevent* bev     = evhttp_connection_get_bufferevent(evcon);
+        struct timeval      now;
+        int64_t             timeout = _httpOptions.timeoutMs > 0 ?
+                                      _httpOptions.timeoutMs : 50 * 1000;
+        event_base_gettimeofday_cached( _base, &now );
+        int64_t             idle    =
+            (now.tv_sec - conn->_httpActive.tv_sec) * 1000LL +
+            (now.tv_usec - conn->_httpActive.tv_usec) / 1000;
+        if (idle >= timeout - 1){
+            _metrics.httpTimeouts.inc();
+        }
+        evbuffer_remove_cb_entry( bufferevent_get_input( bev ),
+                                  conn->_httpCbs[0] );
+        evbuffer_remove_cb_entry( bufferevent_get_output( bev ),
+                                  conn->_httpCbs[1] );
+    }
+    HttpRequestContext*     rc  = conn->_httpCtx;
+    if (rc && rc->stream){
+        http_stream_handler_t   handler = rc->stream;
+        rc->stream  = nullptr;
+        (this->*handler)( conn, nullptr, rc->streamArg );
+        //  evhttp leaves a request failed before its end to the user.
+        if (! evhttp_request_get_connection( rc->req ) ){
+            evhttp_request_free( rc->req );
+        }
+    }
+    if (conn->_httpCtx){
+        releaseHttpContext( conn->_httpCtx );
+    }
+    _httpServerConns.erase( evcon );
+    _httpServerConnectionSet.erase( conn );
+    delete conn;
+}
+
+/**
+ *  \note   the write callback of evhttp, called once the output of the
+ *          connection drains below the low watermark of its bufferevent.
+ * */
+static void
+_http_stream_cb( struct evhttp_connection* evcon, void* arg){
+    HttpRequestContext*     rc  = (HttpRequestContext*)arg;
+    if (rc->stream){
+        Wrapper*        wrapper = rc->conn->owner();
+        CallbackClock   clock( wrapper, Wrapper::CALLBACK_HTTP_REQUEST,
+                               rc->conn );
+        (wrapper->*rc->stream)( rc->conn, rc->req, rc->streamArg );
+    }
+}
+
+static HttpRequestContext*
+_http_stream( Connection* conn ){
+    HttpRequestContext*     rc  = conn ? conn->httpContext() : nullptr;
+    return  (rc && rc->stream) ? rc : nullptr;
+}
+
+/**
+ *  \note   an unlinked file in `dir`, removed once closed.
+ * */
+static int
+_spool_open( const std::string& dir ){
+    std::string     path    = dir + "/lew-spool-XXXXXX";
+    int             fd      = mkstemp( &path[0] );
+    if (fd >= 0){
+        unlink( path.c_str() );
+    }
+    return  fd;
+}
+
+static int
+_spool_write( int fd, const void* data, size_t len ){
+    const char*     p   = (const char*)data;
+    while( len > 0 ){
+        ssize_t     n   = write( fd, p, len );
+        if (n < 0 && EINTR == errno){
+            continue;
+        }
+        if (n <= 0){
+            return  -1;
+        }
+        p   += n;
+        len -= n;
+    }
+    return  0;
+}
+
+/**
+ *  \note   a body which fails to be spooled is kept in memory, but once
+ *          spooled, it fails on a write error rather than be split between
+ *          the file and memory.
+ * */
+void
+Wrapper::onHttpBodyChunk( HttpRequestContext* rc, const Slice& chunk ){
+    if (rc->bodyFailed){
+        return;
+    }
+    if (! rc->body){
+        rc->body    = evbuffer_new();
+    }
+    if (rc->bodyFd < 0 && _httpOptions.spoolThreshold > 0 &&
+        rc->bodyLength > _httpOptions.spoolThreshold ){
+        int             fd      = _spool_open( _httpOptions.spoolDir );
+        size_t          len     = evbuffer_get_length( rc->body );
+        if (fd >= 0 &&
+            0 == _spool_write( fd, evbuffer_pullup( rc->body, len ), len ) ){
+            evbuffer_drain( rc->body, len );
+            rc->bodyFd  = fd;
+        }
+        else if (fd >= 0){
+            close( fd );
+        }
+    }
+    if (rc->bodyFd < 0){
+        evbuffer_add( rc->body, chunk.data, chunk.len );
+    }
+    else if (_spool_write( rc->bodyFd, chunk.data, chunk.len ) < 0){
+        close( rc->bodyFd );
+        rc->bodyFd      = -1;
+        rc->bodyFailed  = true;
+    }
+}
+
+/**
+ *  \note   evhttp of libevent 2.1 reads the body before the request gets
+ *          here, the body is passed to onHttpBodyChunk by the chunks of
+ *          its input buffer then, which are drained one by one.
+ * */
+void
+Wrapper::readHttpBody( HttpRequestContext* rc ){
+    struct evbuffer*        input   = evhttp_request_get_input_buffer( rc->req );
+    struct evbuffer_iovec   vec;
+    while( evbuffer_peek( input, -1, NULL, &vec, 1 ) > 0 ){
+        rc->bodyLength  += vec.iov_len;
+        onHttpBodyChunk( rc, Slice( (const char*)vec.iov_base, vec.iov_len ) );
+        evbuffer_drain( input, vec.iov_len );
+    }
+    if (rc->body){
+        evbuffer_add_buffer( input, rc->body );
+    }
+    if (rc->bodyFd >= 0){
+        lseek( rc->bodyFd, 0, SEEK_SET );
+    }
+}
+
+static struct bufferevent*
+_http_body_bev( Connection* conn ){
+    HttpRequestContext*     rc  = conn->httpContext();
+    if (! rc){
+        return  nullptr;
+    }
+    if (rc->request){
+        return  conn->bev();
+    }
+    struct evhttp_connection*   evcon   = evhttp_request_get_connection(rc->req);
+    return  evcon ? evhttp_connection_get_bufferevent( evcon ) : nullptr;
+}
+
+void    _native_http_pause( Wrapper* wrapper, Connection* conn, bool paused);
+
+/**
+ *  \note   the session of the native http server reads again only when
+ *          its state allows it.
+ * */
+void
+Wrapper::pauseHttpBody( Connection* conn ){
+    struct bufferevent*     bev = _http_body_bev( conn );
+    if (bev && conn->httpContext()->request){
+        _native_http_pause( this, conn, true );
+    }
+    else if (bev){
+        bufferevent_disable( bev, EV_READ );
+    }
+}
+
+void
+Wrapper::resumeHttpBody( Connection* conn ){
+    struct bufferevent*     bev = _http_body_bev( conn );
+    if (bev && conn->httpContext()->request){
+        _native_http_pause( this, conn, false );
+    }
+    else if (bev){
+        bufferevent_enable( bev, EV_READ );
+    }
+}
+
+int
+Wrapper::startHttpStream(   Connection*             conn,
+                            struct evhttp_request*  req,
+                            int                     code,
+                            const char*             reason,
+                            http_stream_handler_t   handler,
+                            void*                   arg,
+                            size_t                  watermark ){
+    HttpRequestContext*     rc  = conn->httpContext();
+    if (! rc || rc->req != req || rc->stream || ! handler){
+        return  -1;
+    }
+    rc->stream      = handler;
+    rc->streamArg   = arg;
+    rc->watermark   = watermark;
+    bufferevent_setwatermark(
+        evhttp_connection_get_bufferevent( evhttp_request_get_connection(req) ),
+        EV_WRITE, watermark, 0 );
+    evhttp_send_reply_start( req, code, reason );
+    return  0;
+}
+
+int
+Wrapper::writeHttpStream( Connection* conn, struct evbuffer* chunk ){
+    HttpRequestContext*     rc  = _http_stream( conn );
+    if (! rc){
+        return  -1;
+    }
+    evhttp_send_reply_chunk_with_cb( rc->req, chunk, _http_stream_cb, rc );
+    return  0;
+}
+
+bool
+Wrapper::httpStreamWritable( Connection* conn ){
+    HttpRequestContext*     rc  = _http_stream( conn );
+    if (! rc){
+        return  false;
+    }
+    struct bufferevent*     bev = evhttp_connection_get_bufferevent(
+                                    evhttp_request_get_connection( rc->req ) );
+    return  evbuffer_get_length( bufferevent_get_output( bev ) ) <
+            rc->watermark;
+}
+
+/**
+ *  \note   evhttp takes the reply as sent once the write callback fires,
+ *          so the watermark is reset to the whole output first.
+ * */
+int
+Wrapper::endHttpStream( Connection* conn ){
+    HttpRequestContext*     rc  = _http_stream( conn );
+    if (! rc){
+        return  -1;
+    }
+    rc->stream  = nullptr;
+    bufferevent_setwatermark(
+        evhttp_connection_get_bufferevent(
+            evhttp_request_get_connection( rc->req ) ),
+        EV_WRITE, 0, 0 );
+    evhttp_send_reply_end( rc->req );
+    return  0;
+}
+
+HttpRequestContext*
+Wrapper::acquireHttpContext( Connection* conn, struct evhttp_request* req ){
+    HttpRequestContext*     rc;
+    if (_httpCtxPool.empty() ){
+        rc  = new HttpRequestContext;
+        rc->body    = nullptr;
+        rc->bodyFd  = -1;
+    }
+    else{
+        rc  = _httpCtxPool.back();
+        _httpCtxPool.pop_back();
+    }
+    rc->conn        = conn;
+    rc->req         = req;
+    rc->start       = _clock_ns();
+    rc->data        = nullptr;
+    rc->fill        = nullptr;
+    rc->stream      = nullptr;
+    rc->streamArg   = nullptr;
+    rc->bodyLength  = 0;
+    rc->bodyFailed  = false;
+    rc->request     = nullptr;
+    conn->_httpCtx  = rc;
+    //  a request of the native http server keeps the buffers of the bev.
+    if (req){
+        conn->setHttpReq( req );
+    }
+    return  rc;
+}
+
+/**
+ *  \note   a request released while filling the cache hands the fill over
+ *          to one of its waiters, which is handled then.
+ * */
+void
+Wrapper::releaseHttpContext( HttpRequestContext* rc ){
+    Connection*             conn    = rc->conn;
+    HttpRequestContext*     next    = nullptr;
+    if (rc->fill){
+        next    = _httpCache->leave( rc );
+    }
+    if (conn->_httpCtx == rc){
+        conn->_httpCtx  = nullptr;
+        if (rc->req){
+            conn->setHttpReq( nullptr );
+        }
+    }
+    if (rc->bodyFd >= 0){
+        close( rc->bodyFd );
+        rc->bodyFd  = -1;
+    }
+    if (rc->body){
+        evbuffer_drain( rc->body, evbuffer_get_length( rc->body ) );
+    }
+    rc->conn    = nullptr;
+    rc->req     = nullptr;
+    rc->data    = nullptr;
+    _httpCtxPool.push_back( rc );
+    if (next){
+        dispatchHttpRequest( next->conn, next->req );
+    }
+}
+
+void
+Wrapper::dispatchNativeHttpRequest( Connection* conn, HttpRequest& req ){
+    CallbackClock   clock( this, Wrapper::CALLBACK_HTTP_REQUEST, conn );
+    onNativeHttpRequest( conn, req );
+}
+
+void
+Wrapper::dispatchHttpRequest( Connection* conn, struct evhttp_request* req ){
+    CallbackClock   clock( this, Wrapper::CALLBACK_HTTP_REQUEST, conn );
+    if (_router.empty() ){
+        onHttpRequest(conn, req);
+    }
+    else{
+        _route_request( this, conn, req );
+    }
+}
+
+void
+Wrapper::sendHttpReply( Connection*             conn,
+                        struct evhttp_request*  req,
+                        int                     code,
+                        const char*             reason,
+                        struct evbuffer*        body ){
+    HttpRequestContext*     rc  = conn->httpContext();
+    if (rc && rc->req == req && rc->fill && rc->fill->filler == rc){
+        std::vector<HttpRequestContext*>    unshared;
+        _httpCache->fill( rc, code, reason, body, unshared );
+        for( auto w : unshared ){
+            dispatchHttpRequest( w->conn, w->req );
+        }
+    }
+    else{
+        evhttp_send_reply( req, code, reason, body );
+    }
+}
+
+size_t
+Wrapper::pendingOutput(){
+    size_t          len     = 0;
+    ConnectionSet*  sets[]  = { &_tcpServerConnectionSet,
+                                &_tcpClientConnectionSet };
+    for( auto cs : sets ){
+        for( auto conn : *cs ){
+            if (conn->writeBuf() ){
+                len += evbuffer_get_length( conn->writeBuf() );
+            }
+        }
+    }
+    return  len;
+}
+
+/**
+ *  \note   events activated during the loop iteration are run at its end,
+ *          after the callbacks which are already active.
+ * */
+void
+Wrapper::scheduleFlush( Connection* conn ){
+    _flushSet.insert( conn );
+    if (evtimer_pending( _flushEvent, NULL) ){
+        return;
+    }
+    if (_flushUsec > 0){
+        struct timeval  tv;
+        tv.tv_sec       = _flushUsec / 1000000;
+        tv.tv_usec      = _flushUsec % 1000000;
+        evtimer_add( _flushEvent, &tv );
+    }
+    else{
+        event_active( _flushEvent, EV_TIMEOUT, 0 );
+    }
+}
+
 bool
 Wrapper::start(){
     int         ret = false;
@@ -315,17 +1132,13 @@ Wrapper::start(){
     }
     if ( ret  && _base ){
         _started    = true;
-        _sig_events[ SIGTERM ] =evsignal_new(_base, SIGTERM, _signal_cb, this);
-        _sig_events[ SIGQUIT ] =evsignal_new(_base, SIGQUIT, _signal_cb, this);
-        _sig_events[ SIGUSR1 ] =evsignal_new(_base, SIGUSR1, _signal_cb, this);
-        _sig_events[ SIGUSR2 ] =evsignal_new(_base, SIGUSR2, _signal_cb, this);
-        _sig_events[ SIGINT  ] =evsignal_new(_base, SIGINT,  _signal_cb, this);
-
-        evsignal_add( _sig_events[ SIGTERM ], NULL);
-        evsignal_add( _sig_events[ SIGQUIT ], NULL);
-        evsignal_add( _sig_events[ SIGUSR1 ], NULL);
-        evsignal_add( _sig_events[ SIGUSR2 ], NULL);
-        evsignal_add( _sig_events[ SIGINT  ], NULL);
+        int     signals[]   = { SIGTERM, SIGQUIT, SIGUSR1, SIGUSR2, SIGINT };
+        for( auto signo : signals ){
+            if (_signals){
+                _sig_events[signo] = evsignal_new(_base, signo, _signal_cb, this);
+                evsignal_add( _sig_events[ signo ], NULL);
+            }
+        }
         event_base_dispatch( _base );
     }
 
@@ -370,6 +1183,29 @@ Wrapper::clean(){
     stopTcpClient();
     stopHttpServer();
     stopHttpClient();
+    stopNativeHttpServer();
+}
+
+/**
+ *  \note   the connection of an accepted socket, in `set`.
+ * */
+Connection*
+Wrapper::acceptConnection( evutil_socket_t fd, ConnectionSet& set ){
+    int                 flag    = BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE;
+    struct bufferevent* bev     = bufferevent_socket_new( _base, fd, flag );
+    //
+    assert( bev );
+    uint16_t        port;
+    string          remote_ip;
+    get_host_port(fd, remote_ip, port);
+    Connection*     conn    = new Connection(
+        this, Connection::CONN_TCP_SERVER, remote_ip.c_str(), port);
+    bufferevent_setcb(bev, _read_cb, _write_cb, _event_cb, conn);
+    bufferevent_enable(bev, EV_READ | EV_WRITE);
+    conn->setBev( bev );
+    set.insert( conn );
+    _metrics.accepts.inc();
+    return  conn;
 }
 
 bool
@@ -401,12 +1237,103 @@ Wrapper::startTcpServer( string  listenAddr, uint16_t    port){
     return ret;
 }
 
+void    _native_http_listen_cb( struct evconnlistener*  listener,
+                                evutil_socket_t         fd,
+                                struct sockaddr*        sock,
+                                int                     socklen,
+                                void*                   ctx);
+
+bool
+Wrapper::startNativeHttpServer( string listenAddr, uint16_t port){
+    unsigned            flag    =
+        LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE | LEV_OPT_THREADSAFE;
+    struct sockaddr_in  sock;
+    //
+    memset(&sock, 0, sizeof(sock) );
+    sock.sin_family     = AF_INET;
+    sock.sin_port       = htons( port );
+    if (inet_pton(AF_INET, listenAddr.c_str(), &sock.sin_addr.s_addr) <= 0){
+        return  false;
+    }
+    struct evconnlistener*  lev     = evconnlistener_new_bind(
+        _base, _native_http_listen_cb, this, flag, -1,
+        (struct sockaddr*)&sock, sizeof(sock) );
+    if (! lev){
+        return  false;
+    }
+    evconnlistener_set_error_cb(lev, _listen_error_cb );
+    _nativeLev.push_back( lev );
+    return  true;
+}
+
+bool
+Wrapper::setSourceAddresses( const std::vector<std::string>& addrs ){
+    std::vector<struct sockaddr_in>     srcs;
+    for( auto& a : addrs ){
+        struct sockaddr_in  sock;
+        memset(&sock, 0, sizeof(sock) );
+        sock.sin_family     = AF_INET;
+        if (inet_pton(AF_INET, a.c_str(), &sock.sin_addr.s_addr) <= 0){
+            errno   = EINVAL;
+            return  false;
+        }
+        srcs.push_back( sock );
+    }
+    _srcAddrs.swap( srcs );
+    _srcNext    = 0;
+    return  true;
+}
+
+/**
+ *  \note   create the socket of a tcp client connection when it needs
+ *          options, otherwise `fd` is -1 and libevent creates it.
+ *  \return 0 on success, or -1 on failure.
+ * */
+int
+Wrapper::tcpClientSocket( evutil_socket_t&  fd ){
+    fd  = -1;
+    if (_srcAddrs.empty() && ! _lingerZero){
+        return  0;
+    }
+    fd  = socket( AF_INET, SOCK_STREAM, 0 );
+    if (fd < 0){
+        return  -1;
+    }
+    evutil_make_socket_nonblocking( fd );
+    evutil_make_socket_closeonexec( fd );
+    if (_lingerZero){
+        struct linger   lg  = { 1, 0 };
+        setsockopt( fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg) );
+    }
+    if (! _srcAddrs.empty() ){
+        const struct sockaddr_in&   src =
+            _srcAddrs[ _srcNext++ % _srcAddrs.size() ];
+#ifdef  IP_BIND_ADDRESS_NO_PORT
+        int     one = 1;
+        setsockopt( fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+#endif
+        if (bind( fd, (const struct sockaddr*)&src, sizeof(src)) != 0){
+            evutil_closesocket( fd );
+            fd  = -1;
+            return  -1;
+        }
+    }
+    return  0;
+}
+
 Connection*
 Wrapper::startTcpClient( string remoteAddr, uint16_t port ){
     int                 ret;
     int                 options = BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE;
-    struct bufferevent* bev     = bufferevent_socket_new(_base, -1, options);
+    evutil_socket_t     fd;
+    struct bufferevent* bev     = nullptr;
     Connection*         conn    = nullptr;
+    if (tcpClientSocket( fd ) == 0){
+        bev     = bufferevent_socket_new(_base, fd, options);
+        if (! bev && fd >= 0){
+            evutil_closesocket( fd );
+        }
+    }
     if ( bev ){
         ret     = bufferevent_socket_connect_hostname(
                       bev, NULL, AF_INET, remoteAddr.c_str(), port);
@@ -420,6 +1347,10 @@ Wrapper::startTcpClient( string remoteAddr, uint16_t port ){
             conn->setBev( bev );
             bufferevent_enable( bev, EV_READ | EV_WRITE );
             bufferevent_setcb( bev, _read_cb, _write_cb, _event_cb, conn);
+            conn->setCodec( _codec );
+            if (_flushUsec >= 0){
+                conn->setAutoFlush( true );
+            }
             _tcpClientConnectionSet.insert( conn );
             onNewConnection( conn );
         }
@@ -432,41 +1363,103 @@ Wrapper::tcpClientReconnect( Connection* conn ){
     int     options = BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE;
     conn->setRetryTimes( conn->retryTimes() - 1);
     conn->_status   = Connection::CONNECTING;
+    _metrics.reconnects.inc();
     if(conn->bev() ){
-        bufferevent_free( conn->bev() );
+        struct bufferevent* old = conn->bev();
         conn->setBev( nullptr );
+        bufferevent_free( old );
+    }
+    evutil_socket_t         fd;
+    struct bufferevent*     bev = nullptr;
+    if (tcpClientSocket( fd ) == 0){
+        bev     = bufferevent_socket_new(_base, fd, options);
+        if (! bev && fd >= 0){
+            evutil_closesocket( fd );
+        }
     }
-    struct bufferevent*     bev = bufferevent_socket_new(_base, -1, options);
     if (bev){
-        ret     = bufferevent_socket_connect_hostname(conn->bev(), NULL,
+        ret     = bufferevent_socket_connect_hostname(bev, NULL,
                      AF_INET, conn->_addr.c_str(), conn->_port );
         if ( ret < 0 ){
-            if ( conn->bev() ){
-                bufferevent_free( conn->bev() );
-            }
+            bufferevent_free( bev );
             conn->setBev( nullptr );
         }
         else{
             bufferevent_setcb( bev,
                               _read_cb, _write_cb, _event_cb, conn);
+            bufferevent_enable( bev, EV_READ | EV_WRITE );
             conn->setBev( bev );
+            if (conn->corked() || conn->autoFlush() ){
+                bufferevent_disable( bev, EV_WRITE );
+            }
         }
     }
     return ret;
 }
 
+void
+Wrapper::setHttpServerOptions( const HttpServerOptions& options ){
+    const char*     names[] = { "GET", "POST", "HEAD", "PUT", "DELETE",
+                                "OPTIONS", "TRACE", "CONNECT", "PATCH" };
+    _httpOptions    = options;
+    _httpAllow.clear();
+    for( int i = 0; i < HttpRouter::METHODS; i++){
+        if (options.allowedMethods & (1 << i) ){
+            _httpAllow  += _httpAllow.empty() ? "" : ", ";
+            _httpAllow  += names[i];
+        }
+    }
+}
+
+struct evhttp*
+Wrapper::newHttpServer(){
+    struct evhttp*  http    = evhttp_new( _base );
+    if (http ){
+        evhttp_set_gencb( http, _http_req_cb, this);
+        evhttp_set_bevcb( http, _http_bev_cb, this);
+        //  every method reaches _http_req_cb, to be replied 405 there.
+        evhttp_set_allowed_methods( http, (1 << HttpRouter::METHODS) - 1 );
+        if (_httpOptions.timeoutMs > 0){
+            struct timeval  tv;
+            tv.tv_sec       = _httpOptions.timeoutMs / 1000;
+            tv.tv_usec      = (_httpOptions.timeoutMs % 1000) * 1000;
+            evhttp_set_timeout_tv( http, &tv );
+        }
+        if (_httpOptions.maxHeadersSize >= 0){
+            evhttp_set_max_headers_size( http, _httpOptions.maxHeadersSize );
+        }
+        if (_httpOptions.maxBodySize >= 0){
+            evhttp_set_max_body_size( http, _httpOptions.maxBodySize );
+        }
+        _http.push_back( http );
+    }
+    return  http;
+}
+
 bool
 Wrapper::startHttpServer( string listenAddr, uint16_t port){
     int             ret     = -1;
-    struct evhttp*  http    = evhttp_new( _base );
+    struct evhttp*  http    = newHttpServer();
     if (http ){
-        evhttp_set_gencb( http, _http_req_cb, this);
         ret     = evhttp_bind_socket( http, listenAddr.c_str(), port);
-        _http.push_back( http );
     }
     return ( 0 == ret );
 }
 
+bool
+Wrapper::startHttpServer( evutil_socket_t fd ){
+    struct evhttp*  http    = newHttpServer();
+    if (! http ){
+        evutil_closesocket( fd );
+        return  false;
+    }
+    if (! evhttp_accept_socket_with_handle( http, fd ) ){
+        evutil_closesocket( fd );
+        return  false;
+    }
+    return  true;
+}
+
 Connection*
 Wrapper::startHttpClient( string remoteAddr, uint16_t port, string localAddr){
     Connection* conn = nullptr;
@@ -510,18 +1503,96 @@ Wrapper::stopTcpClient(){
 
 void
 Wrapper::stopHttpServer(){
+    if (_httpCache){
+        _httpCache->abort();
+    }
     for( auto& h : _http ){
         evhttp_free( h );
     }
     _http.resize( 0 );
+    for( auto bev : _httpAccepted ){
+        bufferevent_decref( bev );
+    }
+    _httpAccepted.clear();
+    for( auto conn : _httpServerConnectionSet ){
+        if (conn->_httpCtx){
+            releaseHttpContext( conn->_httpCtx );
+        }
+    }
+    _httpServerConns.clear();
     _CLEAN_CONNECTION_SET( _httpServerConnectionSet );
 };
 
+void
+Wrapper::stopNativeHttpServer(){
+    for( auto& listener : _nativeLev ){
+        evconnlistener_free( listener );
+    }
+    _nativeLev.resize( 0 );
+    _CLEAN_CONNECTION_SET( _nativeHttpConnectionSet );
+    _CLEAN_CONNECTION_SET( _webSocketConnectionSet );
+}
+
 void
 Wrapper::stopHttpClient(){
     _CLEAN_CONNECTION_SET( _httpClientConnectionSet );
 }
 
+/**
+ *  \note   a connection of the http server is released with its evhttp
+ *          connection, which refers to it until then.
+ * */
+void
+Wrapper::closeConnection( Connection* conn ){
+    struct evhttp_connection*   evcon   = conn->_httpEvcon;
+    if (evcon && _httpServerConnectionSet.count( conn ) ){
+        evhttp_connection_set_closecb( evcon, NULL, NULL );
+        closeHttpServerConnection( evcon, conn );
+        evhttp_connection_free( evcon );
+        return;
+    }
+    ConnectionSet*  sets[]  = { &_tcpServerConnectionSet,
+                                &_tcpClientConnectionSet,
+                                &_httpServerConnectionSet,
+                                &_httpClientConnectionSet,
+                                &_nativeHttpConnectionSet,
+                                &_webSocketConnectionSet };
+    for( auto cs : sets ){
+        if (cs->erase( conn ) ){
+            delete  conn;
+            break;
+        }
+    }
+}
+
+int
+Wrapper::broadcast( ConnectionSet&      group,
+                    SharedBuffer*       buf,
+                    size_t              maxQueued,
+                    SlowConsumerPolicy  policy ){
+    int                         count   = 0;
+    std::vector<Connection*>    slow;
+    for( auto conn : group ){
+        struct evbuffer*    out = conn->writeBuf();
+        if (! out || conn->status() != Connection::CONNECTED){
+            continue;
+        }
+        if (maxQueued && evbuffer_get_length( out ) > maxQueued){
+            if (policy == SLOW_CONSUMER_CLOSE){
+                slow.push_back( conn );
+            }
+            continue;
+        }
+        if (buf->appendTo( out ) == 0){
+            count++;
+        }
+    }
+    for( auto conn : slow ){
+        closeConnection( conn );
+    }
+    return  count;
+}
+
 int
 Wrapper::makeHttpRequest(   Connection*     conn,
                             evhttp_cmd_type cmd,
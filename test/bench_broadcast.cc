@@ -0,0 +1,206 @@
+/**
+ *  \note   broadcast benchmark over loopback.
+ *
+ *          `conns` clients subscribe to the server, which broadcasts
+ *          `count` frames of `size` bytes to all of them, either by copying
+ *          the frame into each writeBuf() or by a lew::SharedBuffer.
+ * */
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lew/wrapper.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double
+_cpu(){
+    struct rusage   ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+static long
+_maxrss(){
+    struct rusage   ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_maxrss;
+}
+
+class   BroadcastBench  : public lew::Wrapper {
+public:
+    BroadcastBench() {
+        sent        = 0;
+        delivered   = 0;
+        skipped     = 0;
+        received    = 0;
+        connected   = 0;
+        next        = evtimer_new( base(), _next_cb, this );
+    };
+    virtual ~BroadcastBench(){
+        event_free( next );
+    };
+    virtual void onNewConnection( lew::Connection* conn);
+    virtual void onConnectionRead( lew::Connection* conn);
+    virtual void onSignal( int signo ){ stop(); };
+    //
+    void        connect(lew::Timer* timer, void* args);
+    void        send();
+    static void _next_cb( evutil_socket_t fd, short what, void* arg);
+public:
+    bool                shared;
+    size_t              size;
+    long                count;
+    long                conns;
+    long                connected;
+    string              host;
+    uint16_t            port;
+    size_t              maxQueued;
+    vector<char>        frame;
+    long                sent;
+    uint64_t            delivered;
+    uint64_t            skipped;
+    uint64_t            received;
+    double              start_time;
+    double              start_cpu;
+    long                start_rss;
+    struct event*       next;
+};
+
+void
+BroadcastBench::_next_cb( evutil_socket_t fd, short what, void* arg){
+    ((BroadcastBench*)arg)->send();
+}
+
+void
+BroadcastBench::connect(lew::Timer* timer, void* args){
+    for( int i = 0; connected < conns && i < 100; connected++, i++){
+        startTcpClient( host, port );
+    }
+    if (connected < conns){
+        addTimer(10, (lew::timer_handler_t)&BroadcastBench::connect, nullptr);
+    }
+}
+
+void
+BroadcastBench::onNewConnection( lew::Connection*  conn){
+    if (conn->type() == lew::Connection::CONN_TCP_SERVER &&
+        (long)tcpServerConnectionSet().size() == conns ){
+        start_time  = _now();
+        start_cpu   = _cpu();
+        start_rss   = _maxrss();
+        send();
+    }
+}
+
+void
+BroadcastBench::send(){
+    lew::ConnectionSet&     group   = tcpServerConnectionSet();
+    if (shared){
+        lew::SharedBuffer*  buf =
+            lew::SharedBuffer::create( frame.data(), frame.size() );
+        int     n   = broadcast( group, buf, maxQueued );
+        buf->unref();
+        delivered   += n;
+        skipped     += group.size() - n;
+    }
+    else{
+        for( auto conn : group ){
+            struct evbuffer*    out = conn->writeBuf();
+            if (evbuffer_get_length( out ) > maxQueued){
+                skipped++;
+                continue;
+            }
+            evbuffer_add( out, frame.data(), frame.size() );
+            delivered++;
+        }
+    }
+    //  let the loop run a round between frames.
+    if (++sent < count){
+        struct timeval  tv  = { 0, 0 };
+        evtimer_add( next, &tv );
+    }
+}
+
+void
+BroadcastBench::onConnectionRead( lew::Connection*  conn){
+    struct evbuffer*    buf = conn->readBuf();
+    size_t              len = evbuffer_get_length( buf );
+    received    += len;
+    evbuffer_drain( buf, len );
+    if (sent == count && received == delivered * size){
+        stop();
+    }
+}
+
+int main(int argc, char* argv[]){
+#define     DEFAULT_HOST        "127.0.0.1"
+#define     DEFAULT_PORT        7002
+
+    int     port        = DEFAULT_PORT;
+    int     size        = 1024;
+    int     count       = 1000;
+    int     conns       = 500;
+    int     max_queued  = 256 * 1024;
+    bool    copy        = false;
+    string  host        = DEFAULT_HOST;
+
+    Flags   opts;
+    opts.Var(host,      'h', "host", string(DEFAULT_HOST),
+             "loopback address, default to " DEFAULT_HOST);
+    opts.Var(port,      'p', "port", int(port), "port, default to 7002");
+    opts.Var(size,      's', "size", int(size),
+             "frame size, default to 1024");
+    opts.Var(count,     'c', "count", int(count),
+             "count of frames, default to 1000");
+    opts.Var(conns,     'n', "conns", int(conns),
+             "count of subscribers, default to 500");
+    opts.Var(max_queued,'q', "max-queued", int(max_queued),
+             "pending bytes of a slow consumer, default to 262144");
+    opts.Bool(copy,     'C', "copy", "copy into each writeBuf() instead");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+
+    unique_ptr<BroadcastBench>  bench( new BroadcastBench() );
+    bench->shared   = ! copy;
+    bench->size     = size;
+    bench->count    = count;
+    bench->conns    = conns;
+    bench->maxQueued= max_queued;
+    bench->frame.assign( size, 'b' );
+    bench->host     = host;
+    bench->port     = (uint16_t)port;
+    if (! bench->startTcpServer( host, (uint16_t)port) ){
+        cerr << "fail to listen on " << host << ":" << port << endl;
+        return 1;
+    }
+    bench->addTimer(10, (lew::timer_handler_t)&BroadcastBench::connect, 0);
+    bench->start();
+    double  elapsed = _now() - bench->start_time;
+    double  cpu     = _cpu() - bench->start_cpu;
+    double  mb      = bench->received / (1024.0 * 1024.0);
+    printf("mode %s size %d frames %ld subscribers %d\n",
+           copy ? "copy" : "shared", size, bench->sent, conns);
+    printf("delivered %llu skipped %llu, %.1f MB in %.3f s, %.1f MB/s\n",
+           (unsigned long long)bench->delivered,
+           (unsigned long long)bench->skipped, mb, elapsed, mb / elapsed);
+    printf("cpu %.3f s, max rss %ld KB (+%ld KB)\n",
+           cpu, _maxrss(), _maxrss() - bench->start_rss);
+    bench->clean();
+    return 0;
+}
@@ -0,0 +1,158 @@
+/**
+ *  \note   framing codec throughput benchmark over loopback.
+ *
+ *          the client writes `count` messages of `size` bytes through the
+ *          codec, the server decodes them in its onMessage callback.
+ * */
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lew/wrapper.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double
+_cpu(){
+    struct rusage   ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+class   CodecBench  : public lew::Wrapper {
+public:
+    CodecBench() {
+        client      = nullptr;
+        sent        = 0;
+        received    = 0;
+    };
+    virtual void onMessage( lew::Connection* conn, const lew::Slice& msg);
+    virtual void onConnectionWrite( lew::Connection* conn);
+    virtual void onSignal( int signo ){ stop(); };
+    //
+    void        onStartTimer(lew::Timer* timer, void* args);
+    void        fill();
+public:
+    long                count;
+    int                 batch;
+    vector<char>        payload;
+    lew::Connection*    client;
+    long                sent;
+    long                received;
+    double              start_time;
+    double              start_cpu;
+};
+
+void
+CodecBench::fill(){
+    for( int i = 0; sent < count && i < batch; i++, sent++){
+        client->writeMessage( payload.data(), payload.size() );
+    }
+}
+
+void
+CodecBench::onMessage( lew::Connection*  conn, const lew::Slice& msg){
+    if (msg.len == payload.size() && ++received == count){
+        stop();
+    }
+}
+
+void
+CodecBench::onConnectionWrite( lew::Connection*  conn){
+    if (conn == client){
+        fill();
+    }
+}
+
+void
+CodecBench::onStartTimer(lew::Timer* timer, void* args){
+    start_time  = _now();
+    start_cpu   = _cpu();
+    fill();
+}
+
+int main(int argc, char* argv[]){
+#define     DEFAULT_HOST        "127.0.0.1"
+#define     DEFAULT_PORT        7003
+
+    int     port        = DEFAULT_PORT;
+    int     size        = 64;
+    int     count       = 5000000;
+    int     batch       = 1024;
+    string  host        = DEFAULT_HOST;
+    string  name        = "length";
+
+    Flags   opts;
+    opts.Var(host,      'h', "host", string(DEFAULT_HOST),
+             "loopback address, default to " DEFAULT_HOST);
+    opts.Var(port,      'p', "port", int(port), "port, default to 7003");
+    opts.Var(size,      's', "size", int(size),
+             "message size, default to 64");
+    opts.Var(count,     'c', "count", int(count),
+             "count of messages, default to 5000000");
+    opts.Var(batch,     'b', "batch", int(batch),
+             "messages written per write callback, default to 1024");
+    opts.Var(name,      'k', "codec", string("length"),
+             "length, varint, delimiter or fixed, default to length");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+
+    unique_ptr<lew::Codec>  codec;
+    if (name == "length"){
+        codec.reset( new lew::LengthCodec( 4 ) );
+    }
+    else if (name == "varint"){
+        codec.reset( new lew::LengthCodec( 0 ) );
+    }
+    else if (name == "delimiter"){
+        codec.reset( new lew::DelimiterCodec( "\n" ) );
+    }
+    else if (name == "fixed"){
+        codec.reset( new lew::FixedCodec( size ) );
+    }
+    else{
+        opts.PrintHelp(argv[0]);
+        return 1;
+    }
+
+    unique_ptr<CodecBench>  bench( new CodecBench() );
+    bench->count    = count;
+    bench->batch    = batch;
+    bench->payload.assign( size, 'm' );
+    bench->setCodec( codec.get() );
+    if (! bench->startTcpServer( host, (uint16_t)port) ){
+        cerr << "fail to listen on " << host << ":" << port << endl;
+        return 1;
+    }
+    bench->client   = bench->startTcpClient( host, (uint16_t)port);
+    if (! bench->client){
+        cerr << "fail to connect" << endl;
+        return 1;
+    }
+    bench->addTimer(100, (lew::timer_handler_t)&CodecBench::onStartTimer, 0);
+    bench->start();
+    double  elapsed = _now() - bench->start_time;
+    double  cpu     = _cpu() - bench->start_cpu;
+    printf("codec %s size %d messages %ld\n",
+           name.c_str(), size, bench->received);
+    printf("%.3f s, %.0f msg/s, %.1f MB/s payload, cpu %.3f s\n",
+           elapsed, bench->received / elapsed,
+           bench->received * (double)size / elapsed / (1024.0 * 1024.0), cpu);
+    bench->clean();
+    return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ *  \note   http server engine benchmark over loopback.
+ *
+ *          the server answers a small body either by evhttp, or by the
+ *          native HTTP/1.1 engine of Wrapper::startNativeHttpServer. a
+ *          client thread keeps `conns` keep-alive connections, making
+ *          requests one after another on each connection, for `duration`
+ *          seconds. the requests per second and the allocations per
+ *          request of the server thread, by operator new and by libevent,
+ *          are reported.
+ * */
+#include <sys/time.h>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include "lew/wrapper.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static  string          _host       = "127.0.0.1";
+static  int             _port       = 7005;
+static  int             _duration   = 5;
+static  const char      _body[]     = "hello, world";
+
+//  allocations are counted on the server thread only.
+static  thread_local bool       _counted    = false;
+static  std::atomic<uint64_t>   _allocs( 0 );
+
+static void*
+_counted_new( size_t size ){
+    if (_counted){
+        _allocs.fetch_add( 1, std::memory_order_relaxed );
+    }
+    void*   p   = malloc( size ? size : 1 );
+    if (! p){
+        throw std::bad_alloc();
+    }
+    return  p;
+}
+
+//  the complete set is replaced, plain and array, unsized and sized, so
+//  that no allocation escapes the count nor is released by another set.
+static void
+_counted_delete( void* p ){
+    free( p );
+}
+
+void*   operator new( size_t size ){                return _counted_new( size ); }
+void*   operator new[]( size_t size ){              return _counted_new( size ); }
+void    operator delete( void* p ) noexcept {       _counted_delete( p ); }
+void    operator delete[]( void* p ) noexcept {     _counted_delete( p ); }
+void    operator delete( void* p, size_t ) noexcept {   _counted_delete( p ); }
+void    operator delete[]( void* p, size_t ) noexcept { _counted_delete( p ); }
+
+static void*
+_event_malloc( size_t size ){
+    if (_counted){
+        _allocs.fetch_add( 1, std::memory_order_relaxed );
+    }
+    return  malloc( size );
+}
+
+static void*
+_event_realloc( void* p, size_t size ){
+    if (_counted){
+        _allocs.fetch_add( 1, std::memory_order_relaxed );
+    }
+    return  realloc( p, size );
+}
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+class   HttpBench  : public lew::Wrapper {
+public:
+    virtual void onHttpRequest( lew::Connection* conn,
+                                struct evhttp_request* req){
+        struct evbuffer*    body    = evbuffer_new();
+        evbuffer_add( body, _body, sizeof(_body) - 1 );
+        evhttp_add_header( evhttp_request_get_output_headers( req ),
+                           "Content-Type", "text/plain" );
+        evhttp_send_reply( req, 200, "OK", body );
+        evbuffer_free( body );
+    };
+    virtual void onNativeHttpRequest( lew::Connection* conn,
+                                      lew::HttpRequest& req){
+        sendNativeHttpResponse( conn, 200,
+                                lew::Slice( _body, sizeof(_body) - 1 ),
+                                "text/plain" );
+    };
+    virtual void onSignal( int signo ){ stop(); };
+    void        onStopTimer( lew::Timer* timer, void* args ){
+        stop();
+    };
+};
+
+/**
+ *  \note   the clients, on a loop of their own.
+ * */
+class   ClientBench  : public lew::Wrapper {
+public:
+    ClientBench(){
+        done    = 0;
+        errors  = 0;
+    };
+    virtual void onNewConnection( lew::Connection* conn ){
+        next( conn );
+    };
+    virtual void onConnectionRead( lew::Connection* conn ){
+        lew::Slice      head;
+        while( (head = conn->peekUntil( "\r\n\r\n", 4 )).data ){
+            size_t      len = head.len + 4 + sizeof(_body) - 1;
+            if (evbuffer_get_length( conn->readBuf() ) < len){
+                break;
+            }
+            if (0 == memcmp( head.data, "HTTP/1.1 200", 12 ) ){
+                done++;
+            }
+            else{
+                errors++;
+            }
+            conn->consume( len );
+            next( conn );
+        }
+    };
+    void        next( lew::Connection* conn ){
+        static const char   req[]   =
+            "GET /bench HTTP/1.1\r\nHost: bench\r\n\r\n";
+        evbuffer_add( conn->writeBuf(), req, sizeof(req) - 1 );
+    };
+    void        onStopTimer( lew::Timer* timer, void* args ){
+        stop();
+    };
+    long        done;
+    long        errors;
+};
+
+static void
+_client_main( ClientBench* client, int conns ){
+    for( int i = 0; i < conns; i++){
+        client->startTcpClient( _host, (uint16_t)_port );
+    }
+    client->addTimer( _duration * 1000,
+                      (lew::timer_handler_t)&ClientBench::onStopTimer, 0 );
+    client->start();
+}
+
+int main(int argc, char* argv[]){
+    int     conns       = 16;
+    bool    native      = false;
+
+    Flags   opts;
+    opts.Var(_host,     'h', "host", string("127.0.0.1"),
+             "loopback address, default to 127.0.0.1");
+    opts.Var(_port,     'p', "port", int(_port), "port, default to 7005");
+    opts.Var(conns,     'n', "conns", int(conns),
+             "client connections, default to 16");
+    opts.Var(_duration, 'd', "duration", int(_duration),
+             "seconds to run, default to 5");
+    opts.Bool(native,   'N', "native", "serve by the native http engine");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+    //  before libevent allocates anything.
+    event_set_mem_functions( _event_malloc, _event_realloc, free );
+
+    unique_ptr<HttpBench>   bench( new HttpBench() );
+    bool    ok  = native ? bench->startNativeHttpServer( _host, _port ) :
+                           bench->startHttpServer( _host, _port );
+    if (! ok){
+        cerr << "fail to listen on " << _host << ":" << _port << endl;
+        return 1;
+    }
+    //  leave the clients a second to finish.
+    bench->addTimer( (_duration + 1) * 1000,
+                     (lew::timer_handler_t)&HttpBench::onStopTimer, 0 );
+    unique_ptr<ClientBench> client( new ClientBench() );
+    std::thread     thread( _client_main, client.get(), conns );
+    double  start   = _now();
+    _counted    = true;
+    bench->start();
+    _counted    = false;
+    thread.join();
+    double  elapsed = min( _now() - start, (double)_duration );
+    uint64_t    requests    = bench->metrics().httpRequests.value();
+    printf("engine %s, %d connections\n", native ? "native" : "evhttp", conns);
+    printf("%ld requests, %ld errors in %.3f s, %.0f req/s\n",
+           client->done, client->errors, elapsed, client->done / elapsed);
+    printf("server: %llu requests, %.2f allocations per request\n",
+           (unsigned long long)requests,
+           requests ? (double)_allocs.load() / requests : 0.0 );
+    client->clean();
+    bench->clean();
+    return 0;
+}
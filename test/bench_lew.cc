@@ -0,0 +1,566 @@
+/**
+ *  \note   microbenchmarks of the hot paths of lew::Wrapper, each against a
+ *          raw libevent baseline doing the same work, to tell the overhead
+ *          of the wrapper. the cost is the cpu time of the loop per
+ *          operation:
+ *
+ *          accept      accept + _listen_cb + Connection construction.
+ *          echo        round trip of a small message over one connection.
+ *          timer       addTimer/delTimer churn.
+ *          event       the connection lookup of _event_cb, with `conns`
+ *                      connections alive.
+ *          http        dispatch of keep-alive requests by _http_req_cb.
+ * */
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <time.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lew/wrapper.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+NS_LEW_BEGIN();
+void    _event_cb( struct bufferevent*  bev, short evt, void* ctx);
+NS_LEW_END();
+
+/**
+ *  \note   cpu time of the calling thread, i.e. of the loop, so that the
+ *          latency of loopback and of the peer thread is left out.
+ * */
+static double
+_now(){
+    struct timespec ts;
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static  string      _host   = "127.0.0.1";
+static  int         _port   = 7003;
+
+/**
+ *  \note   connect `n` times in sequence and reset each connection, so
+ *          that no TIME_WAIT is left behind.
+ * */
+static void
+_connect_loop( long n ){
+    struct sockaddr_in  sock;
+    struct linger       lg  = { 1, 0 };
+    memset( &sock, 0, sizeof(sock) );
+    sock.sin_family     = AF_INET;
+    sock.sin_port       = htons( _port );
+    inet_pton( AF_INET, _host.c_str(), &sock.sin_addr.s_addr );
+    for( long i = 0; i < n; i++){
+        int     fd  = socket( AF_INET, SOCK_STREAM, 0 );
+        if (connect( fd, (struct sockaddr*)&sock, sizeof(sock) ) != 0){
+            perror("connect");
+        }
+        setsockopt( fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg) );
+        close( fd );
+    }
+}
+
+static void
+_break_cb( evutil_socket_t fd, short what, void* arg){
+    event_base_loopbreak( (struct event_base*)arg );
+}
+
+/**
+ *  \note   break the loop of `base` after `secs` seconds in any case.
+ * */
+static struct event*
+_guard( struct event_base* base, int secs ){
+    struct event*   evt = evtimer_new( base, _break_cb, base );
+    struct timeval  tv  = { secs, 0 };
+    evtimer_add( evt, &tv );
+    return  evt;
+}
+
+//////////////////////////////////////////////////////////////////// accept
+
+class   AcceptBench : public lew::Wrapper {
+public:
+    virtual void onNewConnection( lew::Connection* conn){
+        if (++accepted == count){
+            stop();
+        }
+    };
+    long        count;
+    long        accepted;
+};
+
+static double
+bench_accept_lew( long n ){
+    unique_ptr<AcceptBench>     bench( new AcceptBench() );
+    bench->count    = n;
+    bench->accepted = 0;
+    if (! bench->startTcpServer( _host, (uint16_t)_port ) ){
+        return  -1;
+    }
+    struct event*   guard   = _guard( bench->base(), 30 );
+    double          start   = _now();
+    thread          client( _connect_loop, n );
+    bench->start();
+    double          elapsed = _now() - start;
+    client.join();
+    event_free( guard );
+    bench->clean();
+    return  bench->accepted == n ? elapsed : -1;
+}
+
+struct  RawAccept {
+    struct event_base*  base;
+    long                count;
+    long                accepted;
+};
+
+static void
+_raw_conn_event_cb( struct bufferevent* bev, short evt, void* ctx){
+    if (evt & (BEV_EVENT_EOF | BEV_EVENT_ERROR) ){
+        bufferevent_free( bev );
+    }
+}
+
+static void
+_raw_listen_cb( struct evconnlistener*  listener,   evutil_socket_t fd,
+                struct sockaddr*        sock,       int socklen,
+                void*                   ctx){
+    RawAccept*          raw = (RawAccept*)ctx;
+    struct bufferevent* bev = bufferevent_socket_new( raw->base, fd,
+        BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE );
+    bufferevent_setcb( bev, NULL, NULL, _raw_conn_event_cb, raw );
+    bufferevent_enable( bev, EV_READ | EV_WRITE );
+    if (++raw->accepted == raw->count){
+        event_base_loopbreak( raw->base );
+    }
+}
+
+static double
+bench_accept_raw( long n ){
+    RawAccept           raw;
+    struct sockaddr_in  sock;
+    raw.base        = event_base_new();
+    raw.count       = n;
+    raw.accepted    = 0;
+    memset( &sock, 0, sizeof(sock) );
+    sock.sin_family = AF_INET;
+    sock.sin_port   = htons( _port );
+    inet_pton( AF_INET, _host.c_str(), &sock.sin_addr.s_addr );
+    struct evconnlistener*  lev = evconnlistener_new_bind( raw.base,
+        _raw_listen_cb, &raw,
+        LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE | LEV_OPT_THREADSAFE, -1,
+        (struct sockaddr*)&sock, sizeof(sock) );
+    if (! lev){
+        event_base_free( raw.base );
+        return  -1;
+    }
+    struct event*   guard   = _guard( raw.base, 30 );
+    double          start   = _now();
+    thread          client( _connect_loop, n );
+    event_base_dispatch( raw.base );
+    double          elapsed = _now() - start;
+    client.join();
+    event_free( guard );
+    evconnlistener_free( lev );
+    event_base_free( raw.base );
+    return  raw.accepted == n ? elapsed : -1;
+}
+
+////////////////////////////////////////////////////////////////////// echo
+
+class   EchoBench : public lew::Wrapper {
+public:
+    virtual void onConnectionRead( lew::Connection* conn){
+        if (conn->type() == lew::Connection::CONN_TCP_SERVER){
+            evbuffer_add_buffer( conn->writeBuf(), conn->readBuf() );
+            return;
+        }
+        evbuffer_drain( conn->readBuf(), evbuffer_get_length(conn->readBuf()));
+        if (++rounds == count){
+            stop();
+            return;
+        }
+        evbuffer_add( conn->writeBuf(), "ping", 4 );
+    };
+    virtual void onNewConnection( lew::Connection* conn){
+        if (conn->type() == lew::Connection::CONN_TCP_SERVER){
+            evbuffer_add( conn->writeBuf(), "ping", 4 );
+        }
+    };
+    long        count;
+    long        rounds;
+};
+
+static double
+bench_echo_lew( long n ){
+    unique_ptr<EchoBench>   bench( new EchoBench() );
+    bench->count    = n;
+    bench->rounds   = 0;
+    if (! bench->startTcpServer( _host, (uint16_t)_port ) ||
+        ! bench->startTcpClient( _host, (uint16_t)_port ) ){
+        return  -1;
+    }
+    struct event*   guard   = _guard( bench->base(), 30 );
+    double          start   = _now();
+    bench->start();
+    double          elapsed = _now() - start;
+    event_free( guard );
+    bench->clean();
+    return  bench->rounds == n ? elapsed : -1;
+}
+
+struct  RawEcho {
+    struct event_base*  base;
+    struct bufferevent* server;
+    long                count;
+    long                rounds;
+};
+
+static void
+_raw_echo_server_cb( struct bufferevent* bev, void* ctx){
+    bufferevent_write_buffer( bev, bufferevent_get_input( bev ) );
+}
+
+static void
+_raw_echo_client_cb( struct bufferevent* bev, void* ctx){
+    RawEcho*            raw = (RawEcho*)ctx;
+    struct evbuffer*    in  = bufferevent_get_input( bev );
+    evbuffer_drain( in, evbuffer_get_length( in ) );
+    if (++raw->rounds == raw->count){
+        event_base_loopbreak( raw->base );
+        return;
+    }
+    bufferevent_write( bev, "ping", 4 );
+}
+
+static void
+_raw_echo_listen_cb(struct evconnlistener*  listener,   evutil_socket_t fd,
+                    struct sockaddr*        sock,       int socklen,
+                    void*                   ctx){
+    RawEcho*            raw = (RawEcho*)ctx;
+    raw->server = bufferevent_socket_new( raw->base, fd,
+        BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE );
+    bufferevent_setcb( raw->server, _raw_echo_server_cb, NULL, NULL, raw );
+    bufferevent_enable( raw->server, EV_READ | EV_WRITE );
+    bufferevent_write( raw->server, "ping", 4 );
+}
+
+static double
+bench_echo_raw( long n ){
+    RawEcho             raw;
+    struct sockaddr_in  sock;
+    raw.base        = event_base_new();
+    raw.server      = NULL;
+    raw.count       = n;
+    raw.rounds      = 0;
+    memset( &sock, 0, sizeof(sock) );
+    sock.sin_family = AF_INET;
+    sock.sin_port   = htons( _port );
+    inet_pton( AF_INET, _host.c_str(), &sock.sin_addr.s_addr );
+    struct evconnlistener*  lev = evconnlistener_new_bind( raw.base,
+        _raw_echo_listen_cb, &raw,
+        LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE | LEV_OPT_THREADSAFE, -1,
+        (struct sockaddr*)&sock, sizeof(sock) );
+    struct bufferevent*     client  = bufferevent_socket_new( raw.base, -1,
+        BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE );
+    bufferevent_setcb( client, _raw_echo_client_cb, NULL, NULL, &raw );
+    bufferevent_enable( client, EV_READ | EV_WRITE );
+    if (! lev || bufferevent_socket_connect( client,
+                    (struct sockaddr*)&sock, sizeof(sock) ) != 0){
+        return  -1;
+    }
+    struct event*   guard   = _guard( raw.base, 30 );
+    double          start   = _now();
+    event_base_dispatch( raw.base );
+    double          elapsed = _now() - start;
+    event_free( guard );
+    bufferevent_free( client );
+    if (raw.server){
+        bufferevent_free( raw.server );
+    }
+    evconnlistener_free( lev );
+    event_base_free( raw.base );
+    return  raw.rounds == n ? elapsed : -1;
+}
+
+///////////////////////////////////////////////////////////////////// timer
+
+class   TimerBench : public lew::Wrapper {
+public:
+    void        onTimer(lew::Timer* timer, void* args){};
+};
+
+static double
+bench_timer_lew( long n ){
+    unique_ptr<TimerBench>  bench( new TimerBench() );
+    double          start   = _now();
+    for( long i = 0; i < n; i++){
+        lew::Timer* timer   = bench->addTimer( 1000,
+            (lew::timer_handler_t)&TimerBench::onTimer, nullptr );
+        bench->delTimer( timer );
+    }
+    return  _now() - start;
+}
+
+static void
+_raw_timer_cb( evutil_socket_t fd, short what, void* arg){
+}
+
+static double
+bench_timer_raw( long n ){
+    struct event_base*  base    = event_base_new();
+    double              start   = _now();
+    for( long i = 0; i < n; i++){
+        struct event*   evt = evtimer_new( base, _raw_timer_cb, NULL );
+        struct timeval  tv  = { 1, 0 };
+        evtimer_add( evt, &tv );
+        event_del( evt );
+        event_free( evt );
+    }
+    double              elapsed = _now() - start;
+    event_base_free( base );
+    return  elapsed;
+}
+
+///////////////////////////////////////////////////////////////////// event
+
+static  long        _conns  = 10000;
+
+/**
+ *  \note   a tcp client connection is looked up in both connection sets,
+ *          the costlier path, while `_conns` server connections are alive.
+ * */
+static double
+bench_event_lew( long n ){
+    unique_ptr<lew::Wrapper>    bench( new lew::Wrapper() );
+    for( long i = 0; i < _conns; i++){
+        bench->tcpServerConnectionSet().insert( new lew::Connection(
+            bench.get(), lew::Connection::CONN_TCP_SERVER, "127.0.0.1", 0));
+    }
+    lew::Connection*    conn    = new lew::Connection(
+        bench.get(), lew::Connection::CONN_TCP_CLIENT, "127.0.0.1", 0);
+    bench->tcpClientConnectionSet().insert( conn );
+    double          start   = _now();
+    for( long i = 0; i < n; i++){
+        lew::_event_cb( nullptr, BEV_EVENT_CONNECTED, conn );
+    }
+    double          elapsed = _now() - start;
+    bench->clean();
+    return  elapsed;
+}
+
+struct  RawConn {
+    int         status;
+};
+
+static void
+_raw_event_cb( struct bufferevent* bev, short evt, void* ctx){
+    RawConn*    conn    = (RawConn*)ctx;
+    if (evt & BEV_EVENT_CONNECTED){
+        conn->status++;
+    }
+}
+
+static double
+bench_event_raw( long n ){
+    void        (*volatile cb)(struct bufferevent*, short, void*) =
+        _raw_event_cb;
+    RawConn     conn    = { 0 };
+    double      start   = _now();
+    for( long i = 0; i < n; i++){
+        cb( nullptr, BEV_EVENT_CONNECTED, &conn );
+    }
+    return  _now() - start;
+}
+
+////////////////////////////////////////////////////////////////////// http
+
+static void
+_http_reply( struct evhttp_request* req ){
+    struct evbuffer*    body    = evbuffer_new();
+    evbuffer_add( body, "ok", 2 );
+    evhttp_send_reply( req, 200, "OK", body );
+    evbuffer_free( body );
+}
+
+/**
+ *  \note   requests are made one after another over a keep-alive
+ *          connection of the libevent http client, in the same loop.
+ * */
+struct  HttpClient {
+    struct event_base*          base;
+    struct evhttp_connection*   conn;
+    long                        count;
+    long                        done;
+    void                        (*finish)(HttpClient* client);
+    void*                       arg;
+};
+
+static void _http_next( HttpClient* client );
+
+static void
+_http_done_cb( struct evhttp_request* req, void* arg){
+    HttpClient*     client  = (HttpClient*)arg;
+    if (req && evhttp_request_get_response_code( req ) == 200){
+        client->done++;
+    }
+    if (client->done == client->count || ! req){
+        client->finish( client );
+        return;
+    }
+    _http_next( client );
+}
+
+static void
+_http_next( HttpClient* client ){
+    struct evhttp_request*  req = evhttp_request_new( _http_done_cb, client );
+    evhttp_add_header( evhttp_request_get_output_headers( req ),
+                       "Host", _host.c_str() );
+    evhttp_make_request( client->conn, req, EVHTTP_REQ_GET, "/bench" );
+}
+
+class   HttpBench : public lew::Wrapper {
+public:
+    virtual void onHttpRequest( lew::Connection* conn,
+                                struct evhttp_request* req){
+        _http_reply( req );
+    };
+    static void finish( HttpClient* client ){
+        ((HttpBench*)client->arg)->stop();
+    };
+};
+
+static double
+bench_http_lew( long n ){
+    unique_ptr<HttpBench>   bench( new HttpBench() );
+    HttpClient              client;
+    if (! bench->startHttpServer( _host, (uint16_t)_port ) ){
+        return  -1;
+    }
+    client.base     = bench->base();
+    client.conn     = evhttp_connection_base_new( client.base, NULL,
+                                                  _host.c_str(), _port );
+    client.count    = n;
+    client.done     = 0;
+    client.finish   = HttpBench::finish;
+    client.arg      = bench.get();
+    struct event*   guard   = _guard( bench->base(), 30 );
+    double          start   = _now();
+    _http_next( &client );
+    bench->start();
+    double          elapsed = _now() - start;
+    event_free( guard );
+    evhttp_connection_free( client.conn );
+    bench->clean();
+    return  client.done == n ? elapsed : -1;
+}
+
+static void
+_raw_http_cb( struct evhttp_request* req, void* arg){
+    _http_reply( req );
+}
+
+static void
+_raw_http_finish( HttpClient* client ){
+    event_base_loopbreak( client->base );
+}
+
+static double
+bench_http_raw( long n ){
+    HttpClient      client;
+    client.base     = event_base_new();
+    struct evhttp*  http    = evhttp_new( client.base );
+    evhttp_set_gencb( http, _raw_http_cb, NULL );
+    if (evhttp_bind_socket( http, _host.c_str(), _port ) != 0){
+        return  -1;
+    }
+    client.conn     = evhttp_connection_base_new( client.base, NULL,
+                                                  _host.c_str(), _port );
+    client.count    = n;
+    client.done     = 0;
+    client.finish   = _raw_http_finish;
+    client.arg      = nullptr;
+    struct event*   guard   = _guard( client.base, 30 );
+    double          start   = _now();
+    _http_next( &client );
+    event_base_dispatch( client.base );
+    double          elapsed = _now() - start;
+    event_free( guard );
+    evhttp_connection_free( client.conn );
+    evhttp_free( http );
+    event_base_free( client.base );
+    return  client.done == n ? elapsed : -1;
+}
+
+///////////////////////////////////////////////////////////////////////////
+
+struct  Bench {
+    const char*     name;
+    long            count;
+    double          (*lew)(long n);
+    double          (*raw)(long n);
+};
+
+int main(int argc, char* argv[]){
+#define     DEFAULT_HOST        "127.0.0.1"
+#define     DEFAULT_PORT        7003
+
+    int     port        = DEFAULT_PORT;
+    int     count       = 0;
+    int     conns       = _conns;
+    string  host        = DEFAULT_HOST;
+    string  only        = "";
+
+    Flags   opts;
+    opts.Var(host,      'h', "host", string(DEFAULT_HOST),
+             "loopback address, default to " DEFAULT_HOST);
+    opts.Var(port,      'p', "port", int(port), "port, default to 7003");
+    opts.Var(count,     'c', "count", int(count),
+             "iterations of each benchmark, default to its own");
+    opts.Var(conns,     'n', "conns", int(conns),
+             "connections alive in the event benchmark, default to 10000");
+    opts.Var(only,      'b', "bench", string(""),
+             "run only the benchmark: accept, echo, timer, event or http");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+    _host   = host;
+    _port   = port;
+    _conns  = conns;
+    //  as lew::Wrapper does, for the locks of BEV_OPT_THREADSAFE.
+    evthread_use_pthreads();
+
+    Bench   benches[]   = {
+        { "accept", 2000,       bench_accept_lew,   bench_accept_raw    },
+        { "echo",   100000,     bench_echo_lew,     bench_echo_raw      },
+        { "timer",  1000000,    bench_timer_lew,    bench_timer_raw     },
+        { "event",  10000000,   bench_event_lew,    bench_event_raw     },
+        { "http",   20000,      bench_http_lew,     bench_http_raw      },
+    };
+    printf("%-8s %10s %12s %12s %10s\n",
+           "bench", "count", "lew ns/op", "raw ns/op", "overhead");
+    for( auto& b : benches ){
+        if (! only.empty() && only != b.name){
+            continue;
+        }
+        long    n       = count > 0 ? count : b.count;
+        double  raw     = b.raw( n );
+        double  lew     = b.lew( n );
+        if (raw < 0 || lew < 0){
+            printf("%-8s %10ld failed\n", b.name, n);
+            continue;
+        }
+        printf("%-8s %10ld %12.1f %12.1f %9.1f%%\n", b.name, n,
+               lew * 1e9 / n, raw * 1e9 / n, (lew - raw) * 100 / raw);
+    }
+    return 0;
+}
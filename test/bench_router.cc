@@ -0,0 +1,126 @@
+/**
+ *  \note   http router benchmark.
+ *
+ *          `routes` routes like "/api/v1/r<i>/items/:id" are added to a
+ *          lew::HttpRouter and to a linear table compared segment by
+ *          segment, then `count` paths spread over the routes are matched
+ *          by both.
+ * */
+#include <sys/time.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lew/wrapper.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+class   RouterBench  : public lew::Wrapper {
+public:
+    RouterBench(){ hits = 0;};
+    void        onRoute( lew::Connection* conn, struct evhttp_request* req,
+                         const lew::HttpParams& params ){
+        hits    += params.count;
+    };
+    long        hits;
+};
+
+/**
+ *  \note   the linear table, a pattern matches when each static segment
+ *          compares equal, and a ":name" segment takes any segment.
+ * */
+static bool
+_linear_match( const string& pattern, const char* path,
+               lew::HttpParams& params ){
+    const char* p   = pattern.c_str();
+    params.count    = 0;
+    while( *p && *path ){
+        const char* pe  = strchr( p + 1, '/' );
+        const char* se  = strchr( path + 1, '/' );
+        size_t      pl  = pe ? pe - p : strlen( p );
+        size_t      sl  = se ? se - path : strlen( path );
+        if (p[1] == ':'){
+            params.values[ params.count++ ] = lew::Slice( path + 1, sl - 1 );
+        }
+        else if (pl != sl || 0 != strncmp( p, path, pl )){
+            return false;
+        }
+        p       += pl;
+        path    += sl;
+    }
+    return 0 == *p && 0 == *path;
+}
+
+int main(int argc, char* argv[]){
+    int     routes      = 500;
+    int     count       = 200000;
+
+    Flags   opts;
+    opts.Var(routes,    'r', "routes", int(routes),
+             "count of routes, default to 500");
+    opts.Var(count,     'c', "count", int(count),
+             "count of matches, default to 200000");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+
+    unique_ptr<RouterBench>     bench( new RouterBench() );
+    lew::HttpRouter&            router  = bench->router();
+    vector<string>              patterns;
+    vector<string>              paths;
+    char                        buf[128];
+    for( int i = 0; i < routes; i++){
+        snprintf( buf, sizeof(buf), "/api/v1/r%d/items/:id", i );
+        patterns.push_back( buf );
+        router.add( EVHTTP_REQ_GET, buf,
+                    (lew::http_handler_t)&RouterBench::onRoute );
+        snprintf( buf, sizeof(buf), "/api/v1/r%d/items/%d", i, i * 7 );
+        paths.push_back( buf );
+    }
+
+    lew::http_handler_t handler;
+    lew::HttpParams     params;
+    long                found   = 0;
+    double              start   = _now();
+    for( int i = 0; i < count; i++){
+        const string&   path    = paths[ i % routes ];
+        if (200 == router.match( EVHTTP_REQ_GET,
+                lew::Slice( path.data(), path.size() ), handler, params )){
+            (bench.get()->*handler)( nullptr, nullptr, params );
+            found++;
+        }
+    }
+    double  radix   = _now() - start;
+
+    long    linear_found    = 0;
+    start   = _now();
+    for( int i = 0; i < count; i++){
+        const char*     path    = paths[ i % routes ].c_str();
+        for( size_t k = 0; k < patterns.size(); k++){
+            if (_linear_match( patterns[k], path, params )){
+                (bench.get()->*handler)( nullptr, nullptr, params );
+                linear_found++;
+                break;
+            }
+        }
+    }
+    double  linear  = _now() - start;
+
+    printf("routes %d matches %d params %ld\n", routes, count, bench->hits);
+    printf("radix  %ld found, %.3f s, %.1f ns/match\n",
+           found, radix, radix * 1e9 / count);
+    printf("linear %ld found, %.3f s, %.1f ns/match\n",
+           linear_found, linear, linear * 1e9 / count);
+    return 0;
+}
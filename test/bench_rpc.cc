@@ -0,0 +1,169 @@
+/**
+ *  \note   pipelined rpc benchmark over loopback.
+ *
+ *          an echo rpc server and a lew::RpcClient run in one loop, the
+ *          client keeps `inflight` calls outstanding until `count` calls
+ *          are answered.
+ * */
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lew/rpc.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double
+_cpu(){
+    struct rusage   ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+class   RpcBench  : public lew::Wrapper {
+public:
+    RpcBench(): codec(4) {
+        setCodec( &codec );
+        sent        = 0;
+        done        = 0;
+        failed      = 0;
+        latency     = 0;
+    };
+    virtual void onMessage( lew::Connection* conn, const lew::Slice& msg){
+        conn->writeMessage( msg.data, msg.len );
+    };
+    virtual void onSignal( int signo ){ stop(); };
+    //
+    void        onStartTimer(lew::Timer* timer, void* args);
+    void        onResponse( lew::RpcClient* client, int status,
+                            const lew::Slice& resp, void* arg);
+    void        submit();
+public:
+    lew::LengthCodec            codec;
+    unique_ptr<lew::RpcClient>  rpc;
+    long                        count;
+    int                         inflight;
+    int                         batch;
+    vector<char>                payload;
+    vector<double>              sentAt;
+    long                        sent;
+    long                        done;
+    long                        failed;
+    double                      latency;
+    double                      start_time;
+    double                      start_cpu;
+};
+
+void
+RpcBench::submit(){
+    vector<lew::RpcClient::Request>     reqs;
+    while( sent < count && (long)rpc->inflight() + (long)reqs.size() < inflight
+           && (int)reqs.size() < batch ){
+        lew::RpcClient::Request     r;
+        r.data      = payload.data();
+        r.len       = payload.size();
+        r.handler   = (lew::rpc_handler_t)&RpcBench::onResponse;
+        r.arg       = (void*)(intptr_t)(sent % inflight);
+        sentAt[ sent % inflight ]   = _now();
+        reqs.push_back( r );
+        sent++;
+    }
+    if (reqs.size() == 1){
+        rpc->call( reqs[0].data, reqs[0].len, reqs[0].handler, reqs[0].arg );
+    }
+    else if (reqs.size() > 1){
+        rpc->callBatch( reqs.data(), (int)reqs.size() );
+    }
+}
+
+void
+RpcBench::onResponse(   lew::RpcClient* client, int status,
+                        const lew::Slice& resp, void* arg){
+    if (status != 0){
+        failed++;
+    }
+    latency += _now() - sentAt[ (intptr_t)arg ];
+    if (++done == count){
+        stop();
+        return;
+    }
+    submit();
+}
+
+void
+RpcBench::onStartTimer(lew::Timer* timer, void* args){
+    start_time  = _now();
+    start_cpu   = _cpu();
+    submit();
+}
+
+int main(int argc, char* argv[]){
+#define     DEFAULT_HOST        "127.0.0.1"
+#define     DEFAULT_PORT        7004
+
+    int     port        = DEFAULT_PORT;
+    int     size        = 64;
+    int     count       = 1000000;
+    int     inflight    = 16;
+    int     batch       = 16;
+    string  host        = DEFAULT_HOST;
+
+    Flags   opts;
+    opts.Var(host,      'h', "host", string(DEFAULT_HOST),
+             "loopback address, default to " DEFAULT_HOST);
+    opts.Var(port,      'p', "port", int(port), "port, default to 7004");
+    opts.Var(size,      's', "size", int(size),
+             "request size, default to 64");
+    opts.Var(count,     'c', "count", int(count),
+             "count of calls, default to 1000000");
+    opts.Var(inflight,  'i', "inflight", int(inflight),
+             "outstanding calls, default to 16");
+    opts.Var(batch,     'b', "batch", int(batch),
+             "calls submitted at once at most, default to 16");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+
+    unique_ptr<RpcBench>    bench( new RpcBench() );
+    bench->count    = count;
+    bench->inflight = inflight;
+    bench->batch    = batch;
+    bench->payload.assign( size, 'r' );
+    bench->sentAt.resize( inflight );
+    if (! bench->startTcpServer( host, (uint16_t)port) ){
+        cerr << "fail to listen on " << host << ":" << port << endl;
+        return 1;
+    }
+    lew::Connection*    conn    = bench->startTcpClient( host, (uint16_t)port);
+    if (! conn){
+        cerr << "fail to connect" << endl;
+        return 1;
+    }
+    bench->rpc.reset( new lew::RpcClient( bench.get(), conn, 5000 ) );
+    bench->addTimer(100, (lew::timer_handler_t)&RpcBench::onStartTimer, 0);
+    bench->start();
+    double  elapsed = _now() - bench->start_time;
+    double  cpu     = _cpu() - bench->start_cpu;
+    printf("inflight %d batch %d size %d calls %ld failed %ld\n",
+           inflight, batch, size, bench->done, bench->failed);
+    printf("%.3f s, %.0f calls/s, avg latency %.1f us, cpu %.3f s\n",
+           elapsed, bench->done / elapsed,
+           bench->latency / bench->done * 1e6, cpu);
+    bench->rpc.reset();
+    bench->clean();
+    return 0;
+}
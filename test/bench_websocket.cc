@@ -0,0 +1,271 @@
+/**
+ *  \note   WebSocket server benchmark over loopback.
+ *
+ *          a client thread opens `idle` + `hot` connections and upgrades
+ *          them all to WebSocket by the native http server, the idle ones
+ *          only holding their sockets. once all are upgraded, each hot one
+ *          sends masked messages of `size` bytes one after another, echoed
+ *          by the server, for `duration` seconds. the messages per second,
+ *          and the memory of the server per connection are reported.
+ *          <br>
+ *          both ends live in this process, so a connection takes two
+ *          files: the idle ones are scaled down to fit the limit of open
+ *          files, which is raised to its hard limit first.
+ * */
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "lew/websocket.h"
+#include "lew/wrapper.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static  string              _host       = "127.0.0.1";
+static  int                 _port       = 7006;
+static  int                 _duration   = 5;
+static  std::atomic<bool>   _finished( false );
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static long
+_maxrss(){
+    struct rusage   ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_maxrss;
+}
+
+class   WsBench  : public lew::Wrapper {
+public:
+    WsBench(){
+        messages    = 0;
+    };
+    virtual void onNativeHttpRequest( lew::Connection* conn,
+                                      lew::HttpRequest& req){
+        upgradeWebSocket( conn, req );
+    };
+    virtual void onWsMessage(   lew::Connection*    conn,
+                                const lew::Slice&   msg,
+                                bool                binary){
+        messages++;
+        sendWsMessage( conn, msg, binary );
+    };
+    virtual void onSignal( int signo ){ stop(); };
+    void        onCheckTimer( lew::Timer* timer, void* args ){
+        if (_finished.load() ){
+            stop();
+            return;
+        }
+        addTimer( 100, (lew::timer_handler_t)&WsBench::onCheckTimer, 0 );
+    };
+    long        messages;
+};
+
+/**
+ *  \note   the clients, on a loop of their own.
+ * */
+class   ClientBench  : public lew::Wrapper {
+public:
+    enum{   HANDSHAKING = 0, IDLE, HOT };
+    ClientBench(){
+        opened      = 0;
+        upgraded    = 0;
+        done        = 0;
+        errors      = 0;
+        start_time  = 0;
+    };
+    virtual void onNewConnection( lew::Connection* conn ){
+        static const char   req[]   =
+            "GET /bench HTTP/1.1\r\nHost: bench\r\n"
+            "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+            "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+            "Sec-WebSocket-Version: 13\r\n\r\n";
+        states[ conn ]  = HANDSHAKING;
+        evbuffer_add( conn->writeBuf(), req, sizeof(req) - 1 );
+    };
+    virtual void onConnectionRead( lew::Connection* conn ){
+        int&        state   = states[ conn ];
+        if (HANDSHAKING == state){
+            lew::Slice  head    = conn->peekUntil( "\r\n\r\n", 4 );
+            if (! head.data){
+                return;
+            }
+            if (0 != memcmp( head.data, "HTTP/1.1 101", 12 ) ){
+                errors++;
+            }
+            conn->consume( head.len + 4 );
+            state   = (long)hotConns.size() < hot ? HOT : IDLE;
+            if (HOT == state){
+                hotConns.push_back( conn );
+            }
+            if (++upgraded == idle + hot){
+                begin();
+            }
+        }
+        char            head[ lew::WsCodec::MAX_HEADER ];
+        lew::WsFrame    frame;
+        ev_ssize_t      n;
+        int             hl;
+        while( (n = evbuffer_copyout( conn->readBuf(), head, sizeof(head) )) > 0
+               && (hl = lew::WsCodec::parseHeader( head, n, frame )) > 0 ){
+            size_t      len = hl + frame.length;
+            if (evbuffer_get_length( conn->readBuf() ) < len){
+                break;
+            }
+            conn->consume( len );
+            done++;
+            next( conn );
+        }
+    };
+    virtual void onConnectionClose( lew::Connection* conn ){
+        errors++;
+        states.erase( conn );
+    };
+    void        connect( lew::Timer* timer, void* args ){
+        for( int i = 0; opened < idle + hot && i < 500; opened++, i++){
+            startTcpClient( _host, (uint16_t)_port );
+        }
+        if (opened < idle + hot){
+            addTimer( 10, (lew::timer_handler_t)&ClientBench::connect, 0 );
+        }
+    };
+    void        begin(){
+        start_time  = _now();
+        done        = 0;
+        for( auto conn : hotConns ){
+            next( conn );
+        }
+        addTimer( _duration * 1000,
+                  (lew::timer_handler_t)&ClientBench::onStopTimer, 0 );
+    };
+    void        next( lew::Connection* conn ){
+        if (! _finished.load() ){
+            evbuffer_add( conn->writeBuf(), frame.data(), frame.size() );
+        }
+    };
+    void        onStopTimer( lew::Timer* timer, void* args ){
+        elapsed     = _now() - start_time;
+        _finished.store( true );
+        stop();
+    };
+    long        idle;
+    long        hot;
+    long        opened;
+    long        upgraded;
+    long        done;
+    long        errors;
+    string      frame;
+    double      start_time;
+    double      elapsed;
+    vector<lew::Connection*>                hotConns;
+    std::unordered_map<lew::Connection*, int>   states;
+};
+
+static void
+_client_main( ClientBench* client ){
+    client->addTimer( 10, (lew::timer_handler_t)&ClientBench::connect, 0 );
+    client->start();
+    _finished.store( true );
+}
+
+int main(int argc, char* argv[]){
+    int     idle        = 100000;
+    int     hot         = 1000;
+    int     size        = 64;
+    int     isa         = lew::WsCodec::ISA_AVX2;
+
+    Flags   opts;
+    opts.Var(_host,     'h', "host", string("127.0.0.1"),
+             "loopback address, default to 127.0.0.1");
+    opts.Var(_port,     'p', "port", int(_port), "port, default to 7006");
+    opts.Var(idle,      'i', "idle", int(idle),
+             "idle connections, default to 100000");
+    opts.Var(hot,       'n', "hot", int(hot),
+             "connections sending messages, default to 1000");
+    opts.Var(size,      's', "size", int(size),
+             "message size, default to 64");
+    opts.Var(_duration, 'd', "duration", int(_duration),
+             "seconds to run, default to 5");
+    opts.Var(isa,       'I', "isa", int(isa),
+             "unmask by 0 scalar, 1 sse2 or 2 avx2 at most, default to 2");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+    struct rlimit   rl;
+    getrlimit( RLIMIT_NOFILE, &rl );
+    rl.rlim_cur     = rl.rlim_max;
+    setrlimit( RLIMIT_NOFILE, &rl );
+    getrlimit( RLIMIT_NOFILE, &rl );
+    long    room    = ((long)rl.rlim_cur - 64) / 2;
+    if (hot > room){
+        hot     = room;
+    }
+    if (idle > room - hot){
+        printf("note: %d idle connections scaled to %ld for %ld open files\n",
+               idle, room - hot, (long)rl.rlim_cur);
+        idle    = room - hot;
+    }
+    lew::WsCodec::setIsa( (lew::WsCodec::Isa)isa );
+
+    unique_ptr<WsBench>     bench( new WsBench() );
+    if (! bench->startNativeHttpServer( _host, _port ) ){
+        cerr << "fail to listen on " << _host << ":" << _port << endl;
+        return 1;
+    }
+    bench->addTimer( 100, (lew::timer_handler_t)&WsBench::onCheckTimer, 0 );
+    unique_ptr<ClientBench> client( new ClientBench() );
+    string      payload( size, 'w' );
+    char        head[ lew::WsCodec::MAX_HEADER ];
+    uint8_t     key[4]  = { 1, 2, 3, 4 };
+    size_t      hl      = lew::WsCodec::writeHeader( head, lew::WsCodec::TEXT,
+                                                     true, size, key );
+    lew::WsCodec::unmask( &payload[0], payload.size(), key );
+    client->frame.assign( head, hl );
+    client->frame   += payload;
+    client->idle    = idle;
+    client->hot     = hot;
+    //  past the ephemeral ports of one address.
+    if (idle + hot > 25000){
+        vector<string>  srcs;
+        for( long i = 0; i <= (idle + hot) / 25000; i++){
+            srcs.push_back( "127.0.0." + to_string( i + 2 ) );
+        }
+        client->setSourceAddresses( srcs );
+    }
+    long    rss     = _maxrss();
+    std::thread     thread( _client_main, client.get() );
+    bench->start();
+    thread.join();
+    size_t  conns   = bench->webSocketConnectionSet().size();
+    printf("%ld hot and %ld idle connections, %zu upgraded, %d bytes, "
+           "unmask by %s\n", client->hot, client->idle, conns, size,
+           lew::WsCodec::isaName( lew::WsCodec::isa() ) );
+    if (client->start_time > 0){
+        printf("%ld messages, %ld errors in %.3f s, %.0f msg/s\n",
+               client->done, client->errors, client->elapsed,
+               client->done / client->elapsed);
+    }
+    else{
+        printf("%ld of %ld connections upgraded, %ld errors\n",
+               client->upgraded, client->idle + client->hot, client->errors);
+    }
+    printf("max rss %ld KB, %.1f KB per connection of both ends\n",
+           _maxrss(), conns ? (_maxrss() - rss) / (double)conns : 0.0 );
+    client->clean();
+    bench->clean();
+    return 0;
+}
@@ -0,0 +1,182 @@
+/**
+ *  \note   multi-threaded http server benchmark over loopback.
+ *
+ *          the server runs `threads` loop threads by lew::HttpWorkers,
+ *          `clients` client threads keep `conns` keep-alive connections
+ *          each, making requests one after another on each connection, for
+ *          `duration` seconds.
+ * */
+#include <sys/time.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "lew/workers.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static  string      _host       = "127.0.0.1";
+static  int         _port       = 7004;
+static  int         _duration   = 5;
+static  lew::HttpWorkers*   _workers    = nullptr;
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+class   WorkerBench  : public lew::Wrapper {
+public:
+    virtual void onHttpRequest( lew::Connection* conn,
+                                struct evhttp_request* req){
+        struct evbuffer*    body    = evbuffer_new();
+        evbuffer_add( body, "ok", 2 );
+        evhttp_send_reply( req, 200, "OK", body );
+        evbuffer_free( body );
+    };
+    virtual void onSignal( int signo ){ _workers->stop(); };
+    void        onStopTimer( lew::Timer* timer, void* args ){
+        _workers->stop();
+    };
+    static lew::Wrapper*    create( int index, void* arg ){
+        WorkerBench*    bench   = new WorkerBench();
+        if (0 == index){
+            //  leave the clients a second to finish.
+            bench->addTimer( (_duration + 1) * 1000,
+                             (lew::timer_handler_t)&WorkerBench::onStopTimer,
+                             0 );
+        }
+        return  bench;
+    };
+};
+
+/**
+ *  \note   a client thread, with a loop of its own.
+ * */
+struct  ClientThread{
+    struct event_base*      base;
+    long                    done;
+    long                    errors;
+};
+
+struct  ClientConn{
+    ClientThread*               thread;
+    struct evhttp_connection*   conn;
+};
+
+static void _client_next( ClientConn* client );
+
+static void
+_client_done_cb( struct evhttp_request* req, void* arg){
+    ClientConn*     client  = (ClientConn*)arg;
+    if (req && evhttp_request_get_response_code( req ) == 200){
+        client->thread->done++;
+    }
+    else{
+        client->thread->errors++;
+    }
+    _client_next( client );
+}
+
+static void
+_client_next( ClientConn* client ){
+    struct evhttp_request*  req =
+        evhttp_request_new( _client_done_cb, client );
+    evhttp_add_header( evhttp_request_get_output_headers( req ),
+                       "Host", _host.c_str() );
+    evhttp_make_request( client->conn, req, EVHTTP_REQ_GET, "/bench" );
+}
+
+static void
+_client_main( ClientThread* thread, int conns ){
+    vector<ClientConn>  clients( conns );
+    struct timeval      tv  = { _duration, 0 };
+    for( auto& c : clients ){
+        c.thread    = thread;
+        c.conn      = evhttp_connection_base_new( thread->base, NULL,
+                                                  _host.c_str(), _port );
+        _client_next( &c );
+    }
+    event_base_loopexit( thread->base, &tv );
+    event_base_dispatch( thread->base );
+    for( auto& c : clients ){
+        evhttp_connection_free( c.conn );
+    }
+}
+
+int main(int argc, char* argv[]){
+    int     threads     = 4;
+    int     clients     = 4;
+    int     conns       = 16;
+    bool    shared      = false;
+
+    Flags   opts;
+    opts.Var(_host,     'h', "host", string("127.0.0.1"),
+             "loopback address, default to 127.0.0.1");
+    opts.Var(_port,     'p', "port", int(_port), "port, default to 7004");
+    opts.Var(threads,   't', "threads", int(threads),
+             "server loop threads, default to 4");
+    opts.Var(clients,   'c', "clients", int(clients),
+             "client threads, default to 4");
+    opts.Var(conns,     'n', "conns", int(conns),
+             "connections per client thread, default to 16");
+    opts.Var(_duration, 'd', "duration", int(_duration),
+             "seconds to run, default to 5");
+    opts.Bool(shared,   's', "shared", "share one socket, no SO_REUSEPORT");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+
+    unique_ptr<lew::HttpWorkers>    workers(
+        new lew::HttpWorkers( WorkerBench::create ) );
+    _workers    = workers.get();
+    workers->setReusePort( ! shared );
+    if (! workers->listen( _host, (uint16_t)_port, threads ) ){
+        cerr << "fail to listen on " << _host << ":" << _port << endl;
+        return 1;
+    }
+
+    vector<ClientThread>    states( clients );
+    vector<std::thread>     pool;
+    for( auto& s : states ){
+        s.base      = event_base_new();
+        s.done      = 0;
+        s.errors    = 0;
+        pool.push_back( std::thread( _client_main, &s, conns ) );
+    }
+    double  start   = _now();
+    workers->run();
+    for( auto& t : pool ){
+        t.join();
+    }
+    double  elapsed = min( _now() - start, (double)_duration );
+
+    long    done    = 0;
+    long    errors  = 0;
+    for( auto& s : states ){
+        done    += s.done;
+        errors  += s.errors;
+        event_base_free( s.base );
+    }
+    lew::Metrics    total;
+    workers->metrics( total );
+    printf("threads %d %s, clients %d x %d connections\n", threads,
+           shared ? "shared socket" : "SO_REUSEPORT", clients, conns);
+    printf("%ld requests, %ld errors in %.3f s, %.0f req/s\n",
+           done, errors, elapsed, done / elapsed);
+    for( int i = 0; i < workers->size(); i++){
+        printf("thread %d: %llu requests\n", i, (unsigned long long)
+               workers->worker( i )->metrics().httpRequests.value() );
+    }
+    printf("total: %llu requests, %llu 2xx\n",
+           (unsigned long long)total.httpRequests.value(),
+           (unsigned long long)total.httpStatus[2].value() );
+    return 0;
+}
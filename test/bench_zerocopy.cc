@@ -0,0 +1,184 @@
+/**
+ *  \note   zero copy write benchmark over loopback.
+ *
+ *          the server discards everything it reads, the client writes
+ *          `count` payloads of `size` bytes either by copying them into
+ *          writeBuf() or by Connection::writeZeroCopy.
+ * */
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "lew/wrapper.h"
+#include "Flags.hpp"
+
+using   namespace   std;
+
+static double
+_now(){
+    struct timeval  tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static double
+_cpu(){
+    struct rusage   ru;
+    getrusage( RUSAGE_SELF, &ru );
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+class   ZeroCopyBench  : public lew::Wrapper {
+public:
+    ZeroCopyBench() {
+        client      = nullptr;
+        sent        = 0;
+        released    = 0;
+        received    = 0;
+        inflight    = 0;
+        refill      = event_new( base(), -1, 0, _refill_cb, this );
+    };
+    virtual ~ZeroCopyBench(){
+        event_free( refill );
+    };
+    virtual void onConnectionRead( lew::Connection* conn);
+    virtual void onConnectionWrite( lew::Connection* conn);
+    //
+    void        onStartTimer(lew::Timer* timer, void* args);
+    void        fill();
+    static void _refill_cb( evutil_socket_t fd, short what, void* arg);
+    static void _release( const void* data, size_t len, void* arg);
+public:
+    bool                zerocopy;
+    size_t              size;
+    long                count;
+    int                 window;
+    vector<char>        payload;
+    lew::Connection*    client;
+    long                sent;
+    long                released;
+    long                inflight;
+    uint64_t            received;
+    double              start_time;
+    double              start_cpu;
+    struct event*       refill;
+};
+
+void
+ZeroCopyBench::_refill_cb( evutil_socket_t fd, short what, void* arg){
+    ((ZeroCopyBench*)arg)->fill();
+}
+
+void
+ZeroCopyBench::_release( const void* data, size_t len, void* arg){
+    ZeroCopyBench*  bench   = (ZeroCopyBench*)arg;
+    bench->released++;
+    bench->inflight--;
+    event_active( bench->refill, EV_TIMEOUT, 0 );
+}
+
+void
+ZeroCopyBench::fill(){
+    while( client && sent < count && inflight < window ){
+        if (zerocopy){
+            inflight++;
+            client->writeZeroCopy( payload.data(), size, _release, this );
+        }
+        else{
+            if (evbuffer_get_length( client->writeBuf() ) >= window * size){
+                break;
+            }
+            evbuffer_add( client->writeBuf(), payload.data(), size );
+        }
+        sent++;
+    }
+}
+
+void
+ZeroCopyBench::onConnectionRead( lew::Connection*  conn){
+    struct evbuffer*    buf = conn->readBuf();
+    size_t              len = evbuffer_get_length( buf );
+    received    += len;
+    evbuffer_drain( buf, len );
+    if (received >= (uint64_t)count * size){
+        stop();
+    }
+}
+
+void
+ZeroCopyBench::onConnectionWrite( lew::Connection*  conn){
+    if (conn == client){
+        fill();
+    }
+}
+
+void
+ZeroCopyBench::onStartTimer(lew::Timer* timer, void* args){
+    start_time  = _now();
+    start_cpu   = _cpu();
+    fill();
+}
+
+int main(int argc, char* argv[]){
+#define     DEFAULT_HOST        "127.0.0.1"
+#define     DEFAULT_PORT        7001
+
+    int     port        = DEFAULT_PORT;
+    int     size        = 256 * 1024;
+    int     count       = 20000;
+    int     window      = 8;
+    int     threshold   = 64 * 1024;
+    bool    copy        = false;
+    string  host        = DEFAULT_HOST;
+
+    Flags   opts;
+    opts.Var(host,      'h', "host", string(DEFAULT_HOST),
+             "loopback address, default to " DEFAULT_HOST);
+    opts.Var(port,      'p', "port", int(port), "port, default to 7001");
+    opts.Var(size,      's', "size", int(size),
+             "payload size, default to 262144");
+    opts.Var(count,     'c', "count", int(count),
+             "count of payloads, default to 20000");
+    opts.Var(window,    'w', "window", int(window),
+             "payloads in flight, default to 8");
+    opts.Var(threshold, 't', "threshold", int(threshold),
+             "zero copy threshold, default to 65536");
+    opts.Bool(copy,     'C', "copy", "copy into writeBuf() instead");
+    if (!opts.Parse(argc, argv) ){
+        opts.PrintHelp(argv[0]);
+        return 1;
+    };
+
+    unique_ptr<ZeroCopyBench>   bench( new ZeroCopyBench() );
+    bench->zerocopy = ! copy;
+    bench->size     = size;
+    bench->count    = count;
+    bench->window   = window;
+    bench->payload.assign( size, 'z' );
+    if (! bench->startTcpServer( host, (uint16_t)port) ){
+        cerr << "fail to listen on " << host << ":" << port << endl;
+        return 1;
+    }
+    bench->client   = bench->startTcpClient( host, (uint16_t)port);
+    if (! bench->client){
+        cerr << "fail to connect" << endl;
+        return 1;
+    }
+    bench->client->setZeroCopyThreshold( threshold );
+    bench->addTimer(100,(lew::timer_handler_t)&ZeroCopyBench::onStartTimer, 0);
+    bench->start();
+    double  elapsed = _now() - bench->start_time;
+    double  cpu     = _cpu() - bench->start_cpu;
+    double  mb      = bench->received / (1024.0 * 1024.0);
+    printf("mode %s size %d count %ld\n",
+           copy ? "copy" : "zerocopy", size, bench->sent);
+    printf("%.1f MB in %.3f s, %.1f MB/s, cpu %.3f s (%.3f s/GB)\n",
+           mb, elapsed, mb / elapsed, cpu, cpu * 1024.0 / mb);
+    bench->clean();
+    return 0;
+}
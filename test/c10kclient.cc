@@ -2,6 +2,8 @@
  *  \note   C10K test.
  * */
 #include <sys/socket.h>
+#include <time.h>
+#include <algorithm>
 #include <cstdio>
 #include <csignal>
 #include <cstring>
@@ -9,32 +11,83 @@
 #include <iostream>
 #include <memory>
 #include <exception>
+#include <fstream>
+#include <sstream>
 #include <string>
-#include "lew/wrapper.h"
+#include <vector>
+#include "lew/ramp.h"
+#include "lew/histogram.h"
 #include "Flags.hpp"
 
 using   namespace   std;
 
+static int64_t
+_now_ns(){
+    struct timespec     ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ *  \note   without a message rate, the client answers each "ping" of
+ *          c10kserver with a "pong". with a message rate, it sends framed
+ *          messages to `c10kserver --echo` on a fixed schedule, open loop,
+ *          each stamped with the time it was due, and records the round
+ *          trip from that time, so a stalled server is not hidden by a
+ *          stalled sender.
+ * */
 class   C10KClient  : public lew::Wrapper {
 public:
-    C10KClient() {
+    C10KClient(): codec(4), latency(60LL * 1000 * 1000, 3) {
         count_connect   = 0;
         count_connected = 0;
         count_read      = 0;
-        done            = 0;
+        msg_rate        = 0;
+        msg_size        = 64;
+        duration        = 10;
+        sent            = 0;
+        received        = 0;
+        bytes_sent      = 0;
+        bytes_received  = 0;
+        load_start      = 0;
+        load_end        = 0;
+        tick            = nullptr;
+    };
+    virtual ~C10KClient(){
+        if (tick){
+            event_free( tick );
+        }
     };
-    virtual ~C10KClient(){};
     virtual void onConnectionRead( lew::Connection*  conn);
+    virtual void onConnectionClose( lew::Connection* conn);
+    virtual void onMessage( lew::Connection* conn, const lew::Slice& msg);
     virtual void onSignal( int signo );
     //
-    void        makeConnections(lew::Timer* timer, void *args);
+    void        onRampDone(lew::ConnectionRamp* ramp);
+    void        startLoad();
+    void        sendDue();
+    void        onLoadDone(lew::Timer* timer, void* args);
+    string      report(const string& format);
+    static void _tick_cb( evutil_socket_t fd, short what, void* arg);
 public:
     int         count_connect;
-    string      remote_host;
-    int         remote_port;
-    int         done;
     int         count_read;
     int         count_connected;
+    //  open loop load
+    lew::LengthCodec            codec;
+    lew::Histogram              latency;    // microseconds
+    int                         msg_rate;
+    int                         msg_size;
+    int                         duration;
+    vector<lew::Connection*>    conns;
+    vector<char>                msg;
+    long                        sent;
+    long                        received;
+    uint64_t                    bytes_sent;
+    uint64_t                    bytes_received;
+    int64_t                     load_start;
+    int64_t                     load_end;
+    struct event*               tick;
 };
 
 void
@@ -61,21 +114,134 @@ C10KClient::onSignal( int signo ){
 }
 
 void
-C10KClient::makeConnections(lew::Timer* timer, void* args){
-    int         i       = 0;
-    for( ; done < count_connect && i < 1000; done++, i++){
-        startTcpClient( remote_host.c_str(), (unsigned short)remote_port);
-    }
-    cout << done << " connections done" << endl;
-    if (done < count_connect){
-        addTimer(100, (lew::timer_handler_t)&C10KClient::makeConnections, nullptr);
+C10KClient::onRampDone(lew::ConnectionRamp* ramp){
+    cout << ramp->connected() << " connections done, "
+         << ramp->failed() << " failed, "
+         << ramp->retried() << " retried" << endl;
+    cout << "connect time ms p50 " << ramp->connectTime(50)
+         << " p99 " << ramp->connectTime(99)
+         << " p999 " << ramp->connectTime(99.9)
+         << " max " << ramp->connectTime(100) << endl;
+    if (msg_rate > 0){
+        startLoad();
     }
     else{
         cout << "press Ctrl-C to exit" << endl;
     }
 }
 
+void
+C10KClient::onConnectionClose( lew::Connection* conn ){
+    auto    it  = std::find( conns.begin(), conns.end(), conn );
+    if (it != conns.end() ){
+        conns.erase( it );
+    }
+}
 
+void
+C10KClient::startLoad(){
+    for( auto conn : tcpClientConnectionSet() ){
+        if (conn->status() == lew::Connection::CONNECTED){
+            conns.push_back( conn );
+        }
+    }
+    if (conns.empty() ){
+        cerr << "no connection to load" << endl;
+        stop();
+        return;
+    }
+    cout << "sending " << msg_rate << " msg/s of " << msg_size
+         << " bytes over " << conns.size() << " connections for "
+         << duration << " s" << endl;
+    msg.assign( std::max( msg_size, (int)sizeof(int64_t) ), 'x' );
+    load_start  = _now_ns();
+    struct timeval  tv  = { 0, 1000 };
+    tick        = event_new( base(), -1, EV_PERSIST, _tick_cb, this );
+    event_add( tick, &tv );
+    addTimer( duration * 1000, (lew::timer_handler_t)&C10KClient::onLoadDone,
+              nullptr );
+}
+
+void
+C10KClient::_tick_cb( evutil_socket_t fd, short what, void* arg){
+    ((C10KClient*)arg)->sendDue();
+}
+
+void
+C10KClient::sendDue(){
+    int64_t     now     = _now_ns();
+    long        due     = (long)((now - load_start) / 1e9 * msg_rate);
+    for( ; sent < due && ! conns.empty(); sent++){
+        int64_t             stamp   = load_start + sent * 1000000000LL / msg_rate;
+        lew::Connection*    conn    = conns[ sent % conns.size() ];
+        memcpy( msg.data(), &stamp, sizeof(stamp) );
+        conn->writeMessage( msg.data(), msg.size() );
+        bytes_sent  += msg.size() + 4;
+    }
+}
+
+void
+C10KClient::onMessage( lew::Connection* conn, const lew::Slice& m){
+    int64_t     stamp;
+    if (m.len < sizeof(stamp) ){
+        return;
+    }
+    memcpy( &stamp, m.data, sizeof(stamp) );
+    latency.record( (_now_ns() - stamp) / 1000 );
+    received++;
+    bytes_received  += m.len + 4;
+}
+
+void
+C10KClient::onLoadDone(lew::Timer* timer, void* args){
+    load_end    = _now_ns();
+    if (tick){
+        event_free( tick );
+        tick    = nullptr;
+    }
+    stop();
+}
+
+string
+C10KClient::report(const string& format){
+    double          secs    = (load_end - load_start) / 1e9;
+    const char*     keys[]  = {
+        "connections", "msg_rate", "msg_size", "seconds", "sent", "received",
+        "sent_per_sec", "received_per_sec", "bytes_per_sec",
+        "p50_us", "p90_us", "p99_us", "p999_us", "max_us", "mean_us" };
+    double          vals[]  = {
+        (double)conns.size(), (double)msg_rate, (double)msg_size, secs,
+        (double)sent, (double)received, sent / secs, received / secs,
+        (bytes_sent + bytes_received) / secs,
+        (double)latency.percentile(50), (double)latency.percentile(90),
+        (double)latency.percentile(99), (double)latency.percentile(99.9),
+        (double)latency.max(), latency.mean() };
+    size_t          n       = sizeof(keys) / sizeof(keys[0]);
+    ostringstream   out;
+    out.setf( ios::fixed );
+    out.precision( 1 );
+    if (format == "csv"){
+        for( size_t i = 0; i < n; i++){
+            out << keys[i] << (i + 1 < n ? "," : "\n");
+        }
+        for( size_t i = 0; i < n; i++){
+            out << vals[i] << (i + 1 < n ? "," : "\n");
+        }
+    }
+    else if (format == "json"){
+        out << "{";
+        for( size_t i = 0; i < n; i++){
+            out << "\"" << keys[i] << "\": " << vals[i]
+                << (i + 1 < n ? ", " : "}\n");
+        }
+    }
+    else{
+        for( size_t i = 0; i < n; i++){
+            out << keys[i] << " " << vals[i] << "\n";
+        }
+    }
+    return  out.str();
+}
 
 int main(int argc, char* argv[]){
 #define     DEFAULT_HOST        "127.0.0.1"
@@ -85,6 +251,16 @@ int main(int argc, char* argv[]){
     int     port        = DEFAULT_PORT;
     int     count       = DEFAULT_COUNT;
     string  host_addr   = DEFAULT_HOST;
+    string  sources     = "";
+    bool    linger0     = false;
+    int     rate        = 1000;
+    int     inflight    = 1000;
+    int     retries     = 3;
+    int     msg_rate    = 0;
+    int     msg_size    = 64;
+    int     duration    = 10;
+    string  format      = "text";
+    string  output      = "";
 
     Flags   opts;
 
@@ -94,6 +270,26 @@ int main(int argc, char* argv[]){
              "remote port, default to 7000");
     opts.Var(count,     'c', "count", int(count),
              "count of connections to remote, default to 1");
+    opts.Var(rate,      'r', "rate", int(rate),
+             "connects per second, default to 1000");
+    opts.Var(inflight,  'i', "inflight", int(inflight),
+             "pending connects at most, default to 1000");
+    opts.Var(retries,   't', "retries", int(retries),
+             "retries of a failed connect, default to 3");
+    opts.Var(sources,   's', "sources", string(""),
+             "comma separated source addresses, e.g. 127.0.0.2,127.0.0.3");
+    opts.Bool(linger0,  'z', "linger0",
+             "close connections with a reset, leaving no TIME_WAIT");
+    opts.Var(msg_rate,  'm', "msg-rate", int(msg_rate),
+             "messages per second in total, to c10kserver --echo");
+    opts.Var(msg_size,  'b', "msg-size", int(msg_size),
+             "bytes of a message, default to 64");
+    opts.Var(duration,  'd', "duration", int(duration),
+             "seconds to send messages, default to 10");
+    opts.Var(format,    'f', "format", string("text"),
+             "report format: text, csv or json");
+    opts.Var(output,    'o', "output", string(""),
+             "file to append the report to, default to stdout");
     //
     if (!opts.Parse(argc, argv) ){
         opts.PrintHelp(argv[0]);
@@ -101,14 +297,51 @@ int main(int argc, char* argv[]){
     };
 
     unique_ptr<C10KClient>  client( new C10KClient() );
-    client->remote_host     = host_addr;
-    client->remote_port     = port;
     client->count_connect   = count;
+    client->msg_rate        = msg_rate;
+    client->msg_size        = msg_size;
+    client->duration        = duration;
+    if (msg_rate > 0){
+        client->setCodec( &client->codec );
+    }
+    client->setLingerZero( linger0 );
+    vector<string>  addrs;
+    for( size_t pos = 0; pos < sources.size(); ){
+        size_t  end = sources.find( ',', pos );
+        if (end == string::npos){
+            end = sources.size();
+        }
+        if (end > pos){
+            addrs.push_back( sources.substr(pos, end - pos) );
+        }
+        pos = end + 1;
+    }
+    if (! client->setSourceAddresses( addrs ) ){
+        cerr << "invalid source addresses " << sources << endl;
+        return 1;
+    }
     cout << "try to make " << client->count_connect << " connections" << endl;
-    client->addTimer(100, (lew::timer_handler_t)&C10KClient::makeConnections, nullptr);
+    lew::ConnectionRamp     ramp( client.get(), host_addr, (uint16_t)port);
+    ramp.setRate( rate );
+    ramp.setMaxInflight( inflight );
+    ramp.setRetry( retries, 100, 5000 );
+    ramp.setDoneHandler( (lew::ramp_handler_t)&C10KClient::onRampDone );
+    ramp.start( count );
     client->start();
-    cout << "read count " << client->count_read << endl;
-    cout << "connected # " << client->count_connected << endl;
+    ramp.cancel();
+    if (msg_rate > 0 && client->load_end){
+        string  text    = client->report( format );
+        if (output.empty() ){
+            cout << text;
+        }
+        else{
+            ofstream( output.c_str(), ios::app ) << text;
+        }
+    }
+    else{
+        cout << "read count " << client->count_read << endl;
+        cout << "connected # " << client->count_connected << endl;
+    }
     //
     return 0;
 }
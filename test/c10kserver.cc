@@ -11,23 +11,30 @@
 #include <exception>
 #include <string>
 #include "lew/wrapper.h"
+#include "lew/admin.h"
 #include "Flags.hpp"
 
 using   namespace   std;
 
 class   C10KServer  : public lew::Wrapper {
 public:
-    C10KServer() {
+    C10KServer(): codec(4) {
         count_connect   = 0;
         count_read      = 0;
+        bytes           = 0;
+        echo            = false;
     };
     virtual ~C10KServer(){};
     virtual void onNewConnection( lew::Connection*  conn);
     virtual void onConnectionRead( lew::Connection* conn);
+    virtual void onMessage( lew::Connection* conn, const lew::Slice& msg);
     virtual void onSignal( int signo );
 public:
-    int         count_connect;
-    int         count_read;
+    int             count_connect;
+    long            count_read;
+    uint64_t        bytes;
+    bool            echo;
+    lew::LengthCodec    codec;
 };
 
 void
@@ -38,7 +45,9 @@ C10KServer::onNewConnection( lew::Connection*   conn ){
     if ( getsockopt(fd, SOL_SOCKET, SO_RCVBUF, (void*)&buf_size, &socklen)!=0){
         perror("fail to get socket buffer length\n");
     }
-    evbuffer_add_printf( conn->writeBuf(), "ping client %d", count_connect);
+    if (! echo){
+        evbuffer_add_printf( conn->writeBuf(), "ping client %d", count_connect);
+    }
     count_connect++;
 }
 
@@ -53,12 +62,21 @@ C10KServer::onSignal( int signo ){
 
 void
 C10KServer::onConnectionRead( lew::Connection*  conn){
-#define BUF_SIZE    1024
-    char    buf[BUF_SIZE];
-    evbuffer_remove(conn->readBuf(), buf, BUF_SIZE);
-    if (strstr(buf, "pong") == buf){
+    lew::Slice  head    = conn->peek( 4 );
+    if (head.empty()){
+        return;
+    }
+    if (memcmp(head.data, "pong", 4) == 0){
         count_read++;
     }
+    conn->consume( conn->readLength() );
+}
+
+void
+C10KServer::onMessage( lew::Connection*  conn, const lew::Slice& msg){
+    conn->writeMessage( msg.data, msg.len );
+    count_read++;
+    bytes   += msg.len;
 }
 
 int main(int argc, char* argv[]){
@@ -66,6 +84,11 @@ int main(int argc, char* argv[]){
 #define     DEFAULT_PORT        7000
 
     int     port        = DEFAULT_PORT;
+    int     coalesce    = -1;
+    bool    echo        = false;
+    int     admin_port  = 0;
+    int     slow_us     = -1;
+    int     trace       = 0;
     string  listen_addr = DEFAULT_HOST;
 
     Flags   opts;
@@ -73,6 +96,16 @@ int main(int argc, char* argv[]){
     opts.Var(listen_addr, 'l', "listen", string(DEFAULT_HOST),
              "listen address, default to " DEFAULT_HOST);
     opts.Var(port, 'p', "port", int(port), "listen port, default to 7000");
+    opts.Var(coalesce, 'w', "coalesce", int(coalesce),
+             "write coalescing delay in microseconds, default to off (-1)");
+    opts.Bool(echo, 'e', "echo",
+              "echo framed messages, for c10kclient --msg-rate");
+    opts.Var(admin_port, 'a', "admin", int(admin_port),
+             "port of /metrics and /debug/connections, default to none");
+    opts.Var(slow_us, 's', "slow", int(slow_us),
+             "report callbacks slower than it in microseconds, default to off");
+    opts.Var(trace, 't', "trace", int(trace),
+             "trace one connection in it, dumped on SIGUSR2, default to off");
     //
     if (!opts.Parse(argc, argv) ){
         opts.PrintHelp(argv[0]);
@@ -83,10 +116,34 @@ int main(int argc, char* argv[]){
     cout << "press Ctrl-C to exit" << endl;
     //
     unique_ptr<C10KServer>  server( new C10KServer() );
+    server->setWriteCoalescing( coalesce );
+    server->echo    = echo;
+    if (echo){
+        server->setCodec( &server->codec );
+    }
     server->startTcpServer( listen_addr.c_str(), (unsigned short)port);
+    server->setSlowCallbackThreshold( slow_us );
+    lew::Tracer             tracer;
+    if (trace > 0){
+        tracer.setSampling( trace );
+        server->setTracer( &tracer );
+    }
+    lew::AdminServer        admin( server.get() );
+    if (admin_port && ! admin.start( listen_addr, (uint16_t)admin_port) ){
+        cerr << "fail to listen on admin port " << admin_port << endl;
+    }
+    if (admin_port){
+        server->setLagProbe( 100 );
+    }
     server->start();
+    admin.stop();
     cout << "total # of connection is " << server->count_connect << endl;
     cout << "total # of reading is " << server->count_read << endl;
+    if (echo){
+        cout << "total # of echoed bytes is " << server->bytes << endl;
+    }
+    cout << "total # of write syscalls is " << server->writeSyscalls()
+         << " for " << server->writeMessages() << " writes" << endl;
     //
     return 0;
 }
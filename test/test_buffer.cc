@@ -0,0 +1,33 @@
+
+#include    <cstring>
+
+#include    "lew/buffer.h"
+#include    "gtest/gtest.h"
+
+using   namespace   lew;
+
+static  int     _released   = 0;
+static void
+_on_release(const void* data, size_t len, void* arg){
+    _released++;
+}
+
+TEST(SharedBuffer,  ref_by_evbuffers){
+    const char*         text    = "market data";
+    SharedBuffer*       buf     =
+        SharedBuffer::wrap( text, strlen(text), _on_release, nullptr );
+    struct evbuffer*    out1    = evbuffer_new();
+    struct evbuffer*    out2    = evbuffer_new();
+    _released   = 0;
+    EXPECT_EQ( buf->appendTo( out1 ),   0 );
+    EXPECT_EQ( buf->appendTo( out2 ),   0 );
+    EXPECT_EQ( buf->refs(),             3 );
+    EXPECT_EQ( evbuffer_get_length( out2 ), strlen(text) );
+    EXPECT_EQ( evbuffer_pullup( out1, -1 ), (unsigned char*)text );
+    buf->unref();
+    evbuffer_drain( out1, strlen(text) );
+    EXPECT_EQ( _released,               0 );
+    evbuffer_free( out2 );
+    EXPECT_EQ( _released,               1 );
+    evbuffer_free( out1 );
+}
@@ -0,0 +1,259 @@
+
+#include    <map>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/wrapper.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   CacheServer  : public Wrapper{
+public:
+    CacheServer( size_t maxBytes, int ttlMs ): cache( maxBytes, ttlMs ){
+        setHttpCache( &cache );
+        bodySize    = 0;
+    };
+    virtual ~CacheServer(){
+        for( auto evcon : clients ){
+            evhttp_connection_free( evcon );
+        }
+    };
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        string              uri     = evhttp_request_get_uri( req );
+        calls[ uri ]++;
+        if (uri == "/slow"){
+            pending.push_back( make_pair( conn, req ) );
+            return;
+        }
+        struct evbuffer*    body    = evbuffer_new();
+        if (bodySize){
+            evbuffer_add( body, string( bodySize, 'c' ).data(), bodySize );
+        }
+        else{
+            evbuffer_add_printf( body, "%s %d", uri.c_str(), calls[ uri ] );
+        }
+        evhttp_add_header( evhttp_request_get_output_headers( req ),
+                           "Content-Type", "text/plain" );
+        if (uri == "/plain"){
+            evhttp_send_reply( req, 200, "OK", body );
+        }
+        else{
+            sendHttpReply( conn, req, 200, "OK", body );
+        }
+        evbuffer_free( body );
+    };
+    static void     onResponse( struct evhttp_request* req, void* arg){
+        CacheServer*    to  = (CacheServer*)arg;
+        if (! req){
+            to->replies.push_back( "error" );
+            return;
+        }
+        struct evbuffer*    buf     = evhttp_request_get_input_buffer( req );
+        const char*         etag    = evhttp_find_header(
+                                evhttp_request_get_input_headers( req ), "ETag" );
+        const char*         type    = evhttp_find_header(
+                                evhttp_request_get_input_headers( req ),
+                                "Content-Type" );
+        to->replies.push_back( std::to_string(
+            evhttp_request_get_response_code( req ) ) + " " +
+            string( (char*)evbuffer_pullup( buf, -1 ),
+                    evbuffer_get_length( buf ) ) );
+        const char*         cookie  = evhttp_find_header(
+                                evhttp_request_get_input_headers( req ),
+                                "Set-Cookie" );
+        to->etags.push_back( etag ? etag : "" );
+        to->types.push_back( type ? type : "" );
+        to->cookies.push_back( cookie ? cookie : "" );
+    };
+    void    get( const char* uri, const char* ifNoneMatch = nullptr ){
+        struct evhttp_connection*   evcon   = evhttp_connection_base_new(
+                                        base(), NULL, "127.0.0.1", 9988 );
+        struct evhttp_request*      req     =
+                                        evhttp_request_new( onResponse, this );
+        evhttp_add_header( evhttp_request_get_output_headers( req ),
+                           "Host", "127.0.0.1" );
+        if (ifNoneMatch){
+            evhttp_add_header( evhttp_request_get_output_headers( req ),
+                               "If-None-Match", ifNoneMatch );
+        }
+        clients.push_back( evcon );
+        evhttp_make_request( evcon, req, EVHTTP_REQ_GET, uri );
+    };
+    void    onSlow( Timer*  tmr,    void*   arg){
+        for( auto& p : pending ){
+            struct evbuffer*    body    = evbuffer_new();
+            evbuffer_add_printf( body, "slow" );
+            evhttp_add_header( evhttp_request_get_output_headers( p.second ),
+                               "Content-Type", "text/slow" );
+            sendHttpReply( p.first, p.second, 200, "OK", body );
+            evbuffer_free( body );
+        }
+        pending.clear();
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    HttpCache                               cache;
+    size_t                                  bodySize;
+    map<string, int>                        calls;
+    vector< pair<Connection*, struct evhttp_request*> > pending;
+    vector<struct evhttp_connection*>       clients;
+    vector<string>                          replies;
+    vector<string>                          etags;
+    vector<string>                          types;
+    vector<string>                          cookies;
+};
+
+class   CacheFillServer  : public CacheServer{
+public:
+    CacheFillServer(): CacheServer( 1024 * 1024, 60 * 1000 ){};
+    void    onFirst( Timer*  tmr,    void*   arg){
+        for( int i = 0; i < 3; i++){
+            get( "/slow" );
+        }
+        get( "/plain" );
+        get( "/plain" );
+    }
+    void    onSecond( Timer*  tmr,    void*   arg){
+        get( "/slow", etags[2].c_str() );
+        get( "/slow", "\"0000000000000000\"" );
+        get( "/slow?x=1" );
+    }
+};
+
+TEST(HttpCache,     fill){
+    std::unique_ptr<CacheFillServer>    to(new CacheFillServer());
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(50,   (timer_handler_t)&CacheFillServer::onFirst, 0);
+    to->addTimer(200,  (timer_handler_t)&CacheServer::onSlow, 0);
+    to->addTimer(400,  (timer_handler_t)&CacheFillServer::onSecond, 0);
+    to->addTimer(800,  (timer_handler_t)&CacheServer::onStopTimer, 0);
+    to->start();
+    to->clean();
+    //
+    ASSERT_EQ(  to->replies.size(),     8u );
+    //  the handler ran once for the coalesced requests, and once for each
+    //  request not replied by sendHttpReply.
+    EXPECT_EQ(  to->calls["/slow"],     1 );
+    EXPECT_EQ(  to->calls["/plain"],    2 );
+    EXPECT_EQ(  to->calls["/slow?x=1"], 1 );
+    EXPECT_EQ(  to->replies[0],         "200 /plain 1" );
+    EXPECT_EQ(  to->replies[1],         "200 /plain 2" );
+    for( int i = 2; i < 5; i++){
+        EXPECT_EQ(  to->replies[i],     "200 slow" );
+        EXPECT_EQ(  to->etags[i],       to->etags[2] );
+        EXPECT_EQ(  to->types[i],       "text/slow" );
+    }
+    EXPECT_EQ(  to->etags[2].size(),    18u );
+    EXPECT_EQ(  to->replies[5],         "304 " );
+    EXPECT_EQ(  to->etags[5],           to->etags[2] );
+    EXPECT_EQ(  to->replies[6],         "200 slow" );
+    EXPECT_EQ(  to->types[6],           "text/slow" );
+    EXPECT_EQ(  to->replies[7],         "200 /slow?x=1 1" );
+    EXPECT_EQ(  to->cache.misses.value(),       3u );
+    EXPECT_EQ(  to->cache.coalesced.value(),    3u );
+    EXPECT_EQ(  to->cache.hits.value(),         2u );
+    EXPECT_EQ(  to->cache.notModified.value(),  1u );
+    EXPECT_EQ(  to->cache.size(),               2u );
+}
+
+class   CacheEvictServer  : public CacheServer{
+public:
+    CacheEvictServer(): CacheServer( 3000, 200 ){ bodySize = 1000; };
+    void    onGet( Timer*  tmr,    void*   arg){
+        get( (const char*)arg );
+    }
+};
+
+TEST(HttpCache,     evict){
+    std::unique_ptr<CacheEvictServer>   to(new CacheEvictServer());
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    const char*     uris[]  = { "/1", "/2", "/3", "/3", "/3" };
+    int             ms[]    = { 50, 100, 150, 200, 450 };
+    for( int i = 0; i < 5; i++){
+        to->addTimer(ms[i], (timer_handler_t)&CacheEvictServer::onGet,
+                     (void*)uris[i]);
+    }
+    to->addTimer(600,  (timer_handler_t)&CacheServer::onStopTimer, 0);
+    to->start();
+    to->clean();
+    //
+    ASSERT_EQ(  to->replies.size(),     5u );
+    EXPECT_EQ(  to->replies[3].size(),  1004u );
+    //  /1 is evicted for /3, which expires before the last request.
+    EXPECT_EQ(  to->calls["/3"],        2 );
+    EXPECT_EQ(  to->cache.hits.value(),         1u );
+    EXPECT_EQ(  to->cache.evictions.value(),    2u );
+    EXPECT_EQ(  to->cache.size(),               2u );
+    EXPECT_LE(  to->cache.bytes(),              3000u );
+}
+
+class   CachePrivateServer  : public CacheServer{
+public:
+    CachePrivateServer(): CacheServer( 1024 * 1024, 60 * 1000 ){};
+    //  replied later, /private as private, /cookie with a cookie.
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        string              uri     = evhttp_request_get_uri( req );
+        calls[ uri ]++;
+        pending.push_back( make_pair( conn, req ) );
+        addTimer(50, (timer_handler_t)&CachePrivateServer::onReply, 0);
+    };
+    void    onReply( Timer*  tmr,    void*   arg){
+        vector< pair<Connection*, struct evhttp_request*> >  reqs;
+        reqs.swap( pending );
+        for( auto& p : reqs ){
+            string              uri     = evhttp_request_get_uri( p.second );
+            struct evkeyvalq*   out     =
+                                evhttp_request_get_output_headers( p.second );
+            struct evbuffer*    body    = evbuffer_new();
+            evbuffer_add_printf( body, "%s %d", uri.c_str(), calls[ uri ] );
+            if (uri == "/private"){
+                evhttp_add_header( out, "Cache-Control", "max-age=5, private" );
+            }
+            else{
+                evhttp_add_header( out, "Set-Cookie", "session=1" );
+            }
+            sendHttpReply( p.first, p.second, 200, "OK", body );
+            evbuffer_free( body );
+        }
+    }
+    void    onFirst( Timer*  tmr,    void*   arg){
+        get( "/private" );
+        get( "/private" );
+        get( "/cookie" );
+        get( "/cookie" );
+    }
+    void    onSecond( Timer*  tmr,    void*   arg){
+        get( "/private" );
+        get( "/cookie" );
+    }
+};
+
+TEST(HttpCache,     private_reply){
+    std::unique_ptr<CachePrivateServer> to(new CachePrivateServer());
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(20,   (timer_handler_t)&CachePrivateServer::onFirst, 0);
+    to->addTimer(300,  (timer_handler_t)&CachePrivateServer::onSecond, 0);
+    to->addTimer(600,  (timer_handler_t)&CacheServer::onStopTimer, 0);
+    to->start();
+    to->clean();
+    //
+    ASSERT_EQ(  to->replies.size(),     6u );
+    //  the waiter of a private reply is handled on its own, and nothing is
+    //  stored for it.
+    EXPECT_EQ(  to->calls["/private"],  3 );
+    EXPECT_EQ(  to->calls["/cookie"],   1 );
+    int     cookies     = 0;
+    for( size_t i = 0; i < to->replies.size(); i++){
+        if (to->replies[i] == "200 /cookie 1"){
+            cookies     += to->cookies[i].empty() ? 0 : 1;
+        }
+    }
+    //  only the request handled gets the cookie.
+    EXPECT_EQ(  cookies,                1 );
+    EXPECT_EQ(  to->cache.hits.value(),     1u );
+    EXPECT_EQ(  to->cache.size(),           1u );
+}
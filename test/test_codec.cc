@@ -0,0 +1,164 @@
+
+#include    <cstring>
+#include    <memory>
+#include    <stdexcept>
+#include    <string>
+
+#include    "lew/codec.h"
+#include    "lew/wrapper.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+static  void
+_codec_round_trip(Codec& codec, const char* msgs[], int count){
+    struct evbuffer*    buf     = evbuffer_new();
+    for( int i = 0; i < count; i++){
+        EXPECT_EQ( codec.encode( buf, msgs[i], strlen(msgs[i]) ), 0 );
+    }
+    Slice               frame;
+    size_t              len;
+    for( int i = 0; i < count; i++){
+        ASSERT_EQ( codec.decode( buf, frame, len ),  1 );
+        EXPECT_EQ( frame.str(),                     msgs[i] );
+        evbuffer_drain( buf, len );
+    }
+    EXPECT_EQ( codec.decode( buf, frame, len ),      0 );
+    evbuffer_free( buf );
+}
+
+TEST(Codec,     round_trip){
+    const char*     msgs[]  = { "hello", "", "lew codec" };
+    LengthCodec     len2( 2 );
+    LengthCodec     len4( 4 );
+    LengthCodec     varint( 0 );
+    DelimiterCodec  delim( "\r\n" );
+    _codec_round_trip( len2,    msgs,   3 );
+    _codec_round_trip( len4,    msgs,   3 );
+    _codec_round_trip( varint,  msgs,   3 );
+    _codec_round_trip( delim,   msgs,   3 );
+    FixedCodec      fixed( 5 );
+    _codec_round_trip( fixed,   msgs,   1 );
+}
+
+TEST(Codec,     partial_and_split_frame){
+    LengthCodec         codec( 0 );
+    string              msg( 300, 'v' );
+    struct evbuffer*    enc     = evbuffer_new();
+    struct evbuffer*    buf     = evbuffer_new();
+    codec.encode( enc, msg.data(), msg.size() );
+    Slice               frame;
+    size_t              len;
+    //  a two bytes varint header, then the payload in two chunks.
+    evbuffer_remove_buffer( enc, buf, 1 );
+    EXPECT_EQ( codec.decode( buf, frame, len ),  0 );
+    evbuffer_remove_buffer( enc, buf, 100 );
+    EXPECT_EQ( codec.decode( buf, frame, len ),  0 );
+    evbuffer_add_buffer( buf, enc );
+    ASSERT_EQ( codec.decode( buf, frame, len ),  1 );
+    EXPECT_EQ( len,                             302u );
+    EXPECT_EQ( frame.str(),                     msg );
+    evbuffer_free( enc );
+    evbuffer_free( buf );
+}
+
+TEST(Codec,     delimiter_resume){
+    DelimiterCodec      delim( "\r\n" );
+    struct evbuffer*    buf     = evbuffer_new();
+    Slice               frame;
+    size_t              len;
+    size_t              scanned = 0;
+    evbuffer_add( buf, "abcd", 4 );
+    EXPECT_EQ( delim.decodeFrom( buf, frame, len, scanned ),    0 );
+    EXPECT_EQ( scanned,                         3u );
+    //  the delimiter split over two reads.
+    evbuffer_add( buf, "ef\r", 3 );
+    EXPECT_EQ( delim.decodeFrom( buf, frame, len, scanned ),    0 );
+    EXPECT_EQ( scanned,                         6u );
+    evbuffer_add( buf, "\ngh\r\n", 5 );
+    ASSERT_EQ( delim.decodeFrom( buf, frame, len, scanned ),    1 );
+    EXPECT_EQ( frame.str(),                     "abcdef" );
+    EXPECT_EQ( len,                             8u );
+    EXPECT_EQ( scanned,                         0u );
+    evbuffer_drain( buf, len );
+    ASSERT_EQ( delim.decodeFrom( buf, frame, len, scanned ),    1 );
+    EXPECT_EQ( frame.str(),                     "gh" );
+    evbuffer_free( buf );
+}
+
+TEST(Codec,     max_frame_size){
+    LengthCodec         codec( 4 );
+    DelimiterCodec      delim( "\n" );
+    struct evbuffer*    buf     = evbuffer_new();
+    string              msg( 100, 'm' );
+    Slice               frame;
+    size_t              len;
+    codec.setMaxFrameSize( 64 );
+    delim.setMaxFrameSize( 64 );
+    LengthCodec( 4 ).encode( buf, msg.data(), msg.size() );
+    EXPECT_EQ( codec.decode( buf, frame, len ),  -1 );
+    evbuffer_drain( buf, evbuffer_get_length(buf) );
+    evbuffer_add( buf, msg.data(), msg.size() );
+    EXPECT_EQ( delim.decode( buf, frame, len ),  -1 );
+    evbuffer_drain( buf, evbuffer_get_length(buf) );
+    //  not sent at all, over the limit or the header.
+    EXPECT_EQ( codec.encode( buf, msg.data(), msg.size() ), -1 );
+    EXPECT_EQ( errno,                           EMSGSIZE );
+    LengthCodec         len1( 1 );
+    string              big( 300, 'b' );
+    EXPECT_EQ( len1.encode( buf, big.data(), 255 ),         0 );
+    evbuffer_drain( buf, evbuffer_get_length(buf) );
+    EXPECT_EQ( len1.encode( buf, big.data(), big.size() ),  -1 );
+    EXPECT_EQ( evbuffer_get_length( buf ),      0u );
+    evbuffer_free( buf );
+}
+
+TEST(Codec,     header_size){
+    int     bad[]   = { -1, 3, 5, 9, 16 };
+    for( auto size : bad ){
+        EXPECT_THROW( LengthCodec codec( size ),   std::invalid_argument );
+    }
+    int     good[]  = { 0, 1, 2, 4, 8 };
+    for( auto size : good ){
+        EXPECT_NO_THROW( LengthCodec codec( size ) );
+    }
+}
+
+class   CodecCloseServer  : public Wrapper{
+public:
+    CodecCloseServer(): codec(4){
+        setCodec( &codec );
+        messages    = 0;
+    };
+    virtual void    onNewConnection(Connection*      conn){
+        if (conn->type() == Connection::CONN_TCP_CLIENT){
+            //  both frames arrive in one read.
+            codec.encode( conn->writeBuf(), "quit", 4 );
+            codec.encode( conn->writeBuf(), "more", 4 );
+        }
+    };
+    virtual void    onMessage( Connection* conn, const Slice& msg){
+        messages++;
+        closeConnection( conn );
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    LengthCodec     codec;
+    int             messages;
+};
+
+TEST(Codec,     close_in_handler){
+    std::unique_ptr<CodecCloseServer>   to( new CodecCloseServer() );
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    to->addTimer(300, (timer_handler_t)&CodecCloseServer::onStopTimer, 0);
+    Connection*     client  = to->startTcpClient("127.0.0.1", 9988);
+    ASSERT_TRUE( client != nullptr );
+    client->setRetryTimes( 0 );
+    to->start();
+    //
+    EXPECT_EQ(  to->messages,                           1 );
+    EXPECT_EQ(  to->tcpServerConnectionSet().size(),    0u );
+    to->clean();
+}
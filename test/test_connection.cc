@@ -0,0 +1,266 @@
+
+#include    <unistd.h>
+#include    <algorithm>
+#include    <cstdio>
+#include    <cstring>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/wrapper.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   ZeroCopyServer  : public Wrapper{
+public:
+    ZeroCopyServer(){
+        received    = 0;
+        released    = 0;
+        releasedRead= 0;
+        pending     = -1;
+        client      = nullptr;
+    };
+    virtual void    onConnectionRead(     Connection*      conn){
+        size_t      len = evbuffer_get_length( conn->readBuf() );
+        received    += len;
+        evbuffer_drain( conn->readBuf(), len );
+        if (received == 3 * payload.size() + 5){
+            onDrain( nullptr, nullptr );
+        }
+    };
+    //  the kernel reports completions after the bytes are read.
+    void    onDrain( Timer* tmr, void* arg){
+        if (client->zeroCopyPending() ){
+            addTimer(10, (timer_handler_t)&ZeroCopyServer::onDrain, 0);
+            return;
+        }
+        pending     = client->zeroCopyPending();
+        releasedRead= released;
+        stop();
+    }
+    static void     onRelease( const void* data, size_t len, void* arg){
+        ((ZeroCopyServer*)arg)->released++;
+    }
+    void    onSend( Timer* tmr, void* arg){
+        client->writeZeroCopy( payload.data(), payload.size(), onRelease, this);
+        client->writeZeroCopy( "small", 5, onRelease, this);
+        client->writeZeroCopy( payload.data(), payload.size(), onRelease, this);
+        client->writeZeroCopy( payload.data(), payload.size(), onRelease, this);
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    size_t              received;
+    int                 released;
+    int                 releasedRead;   // before clean().
+    int                 pending;
+    vector<char>        payload;
+    Connection*         client;
+};
+
+TEST(Connection,    write_zero_copy){
+    std::unique_ptr<ZeroCopyServer>  to(new ZeroCopyServer());
+    to->payload.assign( 1024 * 1024, 'x' );
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    to->client  = to->startTcpClient("127.0.0.1", 9988);
+    ASSERT_TRUE( to->client != nullptr );
+    to->addTimer(5000, (timer_handler_t)&ZeroCopyServer::onStopTimer, 0);
+    to->addTimer(100,  (timer_handler_t)&ZeroCopyServer::onSend, 0);
+    to->start();
+    EXPECT_EQ(  to->pending,        0 );
+    EXPECT_EQ(  to->releasedRead,   4 );
+    to->clean();
+    //
+    EXPECT_EQ(  to->received,   3 * to->payload.size() + 5 );
+    EXPECT_EQ(  to->released,   4 );
+}
+
+class   CoalesceServer  : public Wrapper{
+public:
+    CoalesceServer(){
+        received    = 0;
+        syscalls    = 0;
+        messages    = 0;
+    };
+    virtual void    onNewConnection(Connection*      conn){
+        if (conn->type() == Connection::CONN_TCP_SERVER){
+            for( int i = 0; i < 10; i++){
+                evbuffer_add_printf( conn->writeBuf(), "msg %d;", i );
+            }
+        }
+    };
+    virtual void    onConnectionRead(     Connection*      conn){
+        size_t      len = evbuffer_get_length( conn->readBuf() );
+        received    += len;
+        evbuffer_drain( conn->readBuf(), len );
+        if (received == 60){
+            for( auto c : tcpServerConnectionSet() ){
+                syscalls    = c->writeSyscalls();
+                messages    = c->writeMessages();
+            }
+            stop();
+        }
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    size_t              received;
+    uint64_t            syscalls;
+    uint64_t            messages;
+};
+
+TEST(Connection,    write_coalescing){
+    std::unique_ptr<CoalesceServer>  to(new CoalesceServer());
+    to->setWriteCoalescing( 0 );
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    to->addTimer(2000, (timer_handler_t)&CoalesceServer::onStopTimer, 0);
+    ASSERT_TRUE( to->startTcpClient("127.0.0.1", 9988) != nullptr );
+    to->start();
+    to->clean();
+    //
+    EXPECT_EQ(  to->received,   60u );
+    EXPECT_EQ(  to->messages,   10u );
+    EXPECT_EQ(  to->syscalls,   1u );
+}
+
+class   CorkServer  : public Wrapper{
+public:
+    CorkServer(){
+        received    = 0;
+        uncorked    = 0;
+        flushed     = 0;
+        server      = nullptr;
+    };
+    virtual void    onNewConnection(Connection*      conn){
+        if (conn->type() == Connection::CONN_TCP_SERVER){
+            server  = conn;
+            addTimer(10, (timer_handler_t)&CorkServer::onWrite, 0);
+        }
+    };
+    void    onWrite( Timer*  tmr,    void*   arg){
+        Connection*     conn    = server;
+        conn->cork();
+        for( int i = 0; i < 5; i++){
+            evbuffer_add_printf( conn->writeBuf(), "msg %d;", i );
+        }
+        EXPECT_EQ(  conn->writeSyscalls(),  0u );
+        EXPECT_EQ(  conn->uncork(),         0 );
+        uncorked    = conn->writeSyscalls();
+        //  flushed while still corked, nothing left for uncork().
+        conn->cork();
+        evbuffer_add_printf( conn->writeBuf(), "msg 5;" );
+        evbuffer_add_printf( conn->writeBuf(), "msg 6;" );
+        EXPECT_EQ(  conn->flush(),          0 );
+        flushed     = conn->writeSyscalls();
+        EXPECT_EQ(  conn->uncork(),         0 );
+    }
+    virtual void    onConnectionRead(     Connection*      conn){
+        size_t      len = evbuffer_get_length( conn->readBuf() );
+        received    += len;
+        evbuffer_drain( conn->readBuf(), len );
+        if (received == 42){
+            stop();
+        }
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    size_t              received;
+    uint64_t            uncorked;
+    uint64_t            flushed;
+    Connection*         server;
+};
+
+TEST(Connection,    cork_uncork_flush){
+    std::unique_ptr<CorkServer>  to(new CorkServer());
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    to->addTimer(2000, (timer_handler_t)&CorkServer::onStopTimer, 0);
+    ASSERT_TRUE( to->startTcpClient("127.0.0.1", 9988) != nullptr );
+    to->start();
+    //
+    EXPECT_EQ(  to->received,                   42u );
+    EXPECT_EQ(  to->uncorked,                   1u );
+    EXPECT_EQ(  to->flushed,                    2u );
+    EXPECT_EQ(  to->server->writeSyscalls(),    2u );
+    EXPECT_EQ(  to->server->writeMessages(),    7u );
+    to->clean();
+}
+
+class   PeekServer  : public Wrapper{
+public:
+    virtual void    onNewConnection(Connection*      conn){
+        if (conn->type() == Connection::CONN_TCP_CLIENT){
+            evbuffer_add_printf( conn->writeBuf(), "first\r\n" );
+            evbuffer_add_printf( conn->writeBuf(), "sec" );
+            evbuffer_add_printf( conn->writeBuf(), "ond\r\n" );
+        }
+    };
+    virtual void    onConnectionRead(     Connection*      conn){
+        Slice   line;
+        while( (line = conn->peekUntil("\r\n", 2)).data ){
+            lines.push_back( line.str() );
+            conn->consume( line.len + 2 );
+        }
+        if (lines.size() == 2){
+            stop();
+        }
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    vector<string>      lines;
+};
+
+TEST(Connection,    peek_consume){
+    std::unique_ptr<PeekServer>  to(new PeekServer());
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    to->addTimer(2000, (timer_handler_t)&PeekServer::onStopTimer, 0);
+    ASSERT_TRUE( to->startTcpClient("127.0.0.1", 9988) != nullptr );
+    to->start();
+    to->clean();
+    //
+    ASSERT_EQ(  to->lines.size(),   2u );
+    EXPECT_EQ(  to->lines[0],       "first" );
+    EXPECT_EQ(  to->lines[1],       "second" );
+}
+
+class   SourceServer  : public Wrapper{
+public:
+    virtual void    onNewConnection(Connection*      conn){
+        if (conn->type() == Connection::CONN_TCP_SERVER){
+            peers.push_back( conn->addr() );
+            if (peers.size() == 3){
+                stop();
+            }
+        }
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    vector<string>      peers;
+};
+
+TEST(Connection,    source_addresses){
+    std::unique_ptr<SourceServer>  to(new SourceServer());
+    vector<string>      srcs;
+    srcs.push_back( "127.0.0.2" );
+    srcs.push_back( "127.0.0.3" );
+    EXPECT_FALSE( to->setSourceAddresses( vector<string>(1, "localhost") ) );
+    EXPECT_TRUE( to->setSourceAddresses( srcs ) );
+    to->setLingerZero( true );
+    EXPECT_TRUE( to->startTcpServer("0.0.0.0", 9988) );
+    to->addTimer(2000, (timer_handler_t)&SourceServer::onStopTimer, 0);
+    for( int i = 0; i < 3; i++){
+        ASSERT_TRUE( to->startTcpClient("127.0.0.1", 9988) != nullptr );
+    }
+    to->start();
+    to->clean();
+    //
+    ASSERT_EQ(  to->peers.size(),   3u );
+    std::sort( to->peers.begin(), to->peers.end() );
+    EXPECT_EQ(  to->peers[0],       "127.0.0.2" );
+    EXPECT_EQ(  to->peers[1],       "127.0.0.2" );
+    EXPECT_EQ(  to->peers[2],       "127.0.0.3" );
+}
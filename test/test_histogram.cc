@@ -0,0 +1,35 @@
+
+#include    "lew/histogram.h"
+#include    "gtest/gtest.h"
+
+using   namespace   lew;
+
+TEST(Histogram,     percentiles){
+    Histogram   h( 3600LL * 1000 * 1000, 3 );
+    for( int64_t v = 1; v <= 100000; v++){
+        h.record( v );
+    }
+    EXPECT_EQ(  h.count(),              100000 );
+    EXPECT_EQ(  h.min(),                1 );
+    EXPECT_EQ(  h.max(),                100000 );
+    EXPECT_NEAR( h.mean(),              50000.5,    0.1 );
+    EXPECT_NEAR( h.percentile(50),      50000,      50 );
+    EXPECT_NEAR( h.percentile(99),      99000,      99 );
+    EXPECT_NEAR( h.percentile(99.9),    99900,      100 );
+    EXPECT_EQ(  h.percentile(100),      100000 );
+    EXPECT_EQ(  h.percentile(0),        1 );
+}
+
+TEST(Histogram,     merge_and_clamp){
+    Histogram   a( 1000, 2 );
+    Histogram   b( 1000, 2 );
+    a.record( 10, 3 );
+    b.record( 5000 );
+    a.merge( b );
+    EXPECT_EQ(  a.count(),              4 );
+    EXPECT_EQ(  a.max(),                1000 );
+    EXPECT_EQ(  a.percentile(50),       10 );
+    a.reset();
+    EXPECT_EQ(  a.count(),              0 );
+    EXPECT_EQ(  a.percentile(99),       0 );
+}
@@ -0,0 +1,364 @@
+
+#include    <map>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/http1.h"
+#include    "lew/wrapper.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+static int
+_parse( const string& raw, HttpRequest& req ){
+    return  HttpParser::parse( raw.data(), raw.size(), req );
+}
+
+TEST(HttpParser,    parse){
+    HttpRequest     req;
+    string          raw =   "GET /a/b?x=1&y=2 HTTP/1.1\r\n"
+                            "Host: example.com\r\n"
+                            "X-Empty:\r\n"
+                            "Accept:  */*  \r\n"
+                            "\r\nbody";
+    EXPECT_EQ(  _parse( raw, req ),         (int)raw.size() - 4 );
+    EXPECT_EQ(  req.method,                 EVHTTP_REQ_GET );
+    EXPECT_EQ(  req.uri.str(),              "/a/b?x=1&y=2" );
+    EXPECT_EQ(  req.path.str(),             "/a/b" );
+    EXPECT_EQ(  req.query.str(),            "x=1&y=2" );
+    EXPECT_EQ(  req.minorVersion,           1 );
+    EXPECT_TRUE( req.keepAlive );
+    EXPECT_EQ(  req.contentLength,          -1 );
+    ASSERT_EQ(  req.headerCount,            3 );
+    EXPECT_EQ(  req.header("host").str(),   "example.com" );
+    EXPECT_EQ(  req.header("X-Empty").len,  0u );
+    EXPECT_EQ(  req.header("accept").str(), "*/*" );
+    EXPECT_TRUE( req.header("Cookie").data == nullptr );
+    //  every prefix needs more bytes.
+    for( size_t i = 0; i < raw.size() - 4; i++){
+        EXPECT_EQ(  HttpParser::parse( raw.data(), i, req ),    0 ) << i;
+    }
+    EXPECT_GT(  _parse( "POST / HTTP/1.0\nContent-Length: 12\n"
+                        "Connection: keep-alive\n\n", req ),    0 );
+    EXPECT_EQ(  req.contentLength,          12 );
+    EXPECT_TRUE( req.keepAlive );
+    EXPECT_GT(  _parse( "GET / HTTP/1.1\r\nConnection: Upgrade, close\r\n\r\n",
+                        req ),              0 );
+    EXPECT_FALSE( req.keepAlive );
+    EXPECT_GT(  _parse( "BREW /pot HTTP/1.1\r\n\r\n", req ),    0 );
+    EXPECT_EQ(  (int)req.method,            0 );
+}
+
+TEST(HttpParser,    malformed){
+    HttpRequest     req;
+    const char*     bad[]   = {
+        "GET  / HTTP/1.1\r\n\r\n",
+        "GET / HTTP/2.0\r\n\r\n",
+        "GET /\x01 HTTP/1.1\r\n\r\n",
+        "GET / HTTP/1.1\r\nno colon\r\n\r\n",
+        "GET / HTTP/1.1\r\nBad Name: v\r\n\r\n",
+        "GET / HTTP/1.1\r\nA: b\r\n folded\r\n\r\n",
+        "GET / HTTP/1.1\r\nA: b\rc\r\n\r\n",
+        "GET / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n",
+        "GET / HTTP/1.1\r\nContent-Length: 1\r\nContent-Length: 2\r\n\r\n",
+        "GET / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+            "Content-Length: 3\r\n\r\n",
+    };
+    for( auto raw : bad ){
+        EXPECT_EQ(  _parse( raw, req ),     -1 ) << raw;
+    }
+    string  many    = "GET / HTTP/1.1\r\n";
+    for( int i = 0; i <= HttpRequest::MAX_HEADERS; i++){
+        many    += "A: b\r\n";
+    }
+    EXPECT_EQ(  _parse( many + "\r\n", req ),   -1 );
+    EXPECT_GT(  _parse( "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked"
+                        "\r\n\r\n", req ),  0 );
+    EXPECT_TRUE( req.chunked );
+}
+
+TEST(HttpParser,    isa){
+    //  long values, with the stop byte at every offset of the vectors.
+    HttpParser::Isa     best    = HttpParser::isa();
+    for( int i = HttpParser::ISA_SCALAR; i <= best; i++){
+        EXPECT_EQ(  HttpParser::setIsa( (HttpParser::Isa)i ),   i );
+        for( size_t n = 0; n < 70; n++){
+            HttpRequest     req;
+            string          value( n, 'v' );
+            value   += "-\t\x80\xff";
+            string          raw = "GET /" + string( n, 'u' ) + " HTTP/1.1\r\n"
+                                  "X-Long: " + value + "\r\n\r\n";
+            ASSERT_EQ(  _parse( raw, req ),     (int)raw.size() )
+                << HttpParser::isaName( (HttpParser::Isa)i ) << " " << n;
+            EXPECT_EQ(  req.uri.len,            n + 1 );
+            EXPECT_EQ(  req.header("x-long").str(), value );
+            raw[ raw.size() - 6 ]   = '\x7f';
+            EXPECT_EQ(  _parse( raw, req ),     -1 );
+        }
+    }
+    EXPECT_EQ(  HttpParser::setIsa( HttpParser::ISA_AVX2 ),     best );
+}
+
+TEST(HttpResponseWriter,    write_head){
+    struct evbuffer*    out     = evbuffer_new();
+    HttpHeader          h;
+    h.name  = Slice( "X-A", 3 );
+    h.value = Slice( "1", 1 );
+    EXPECT_EQ(  HttpResponseWriter::writeHead( out, 404, 123, "text/plain",
+                                               &h, 1, false ),  0 );
+    string  head( (char*)evbuffer_pullup( out, -1 ), evbuffer_get_length(out));
+    EXPECT_EQ(  head.substr( 0, 24 ),   "HTTP/1.1 404 Not Found\r\n" );
+    EXPECT_NE(  head.find( "\r\nDate: " ),                  string::npos );
+    EXPECT_NE(  head.find( "\r\nContent-Length: 123\r\n" ), string::npos );
+    EXPECT_NE(  head.find( "\r\nContent-Type: text/plain\r\n" ), string::npos);
+    EXPECT_NE(  head.find( "\r\nX-A: 1\r\n" ),              string::npos );
+    EXPECT_EQ(  head.substr( head.size() - 21 ),
+                "Connection: close\r\n\r\n" );
+    evbuffer_free( out );
+}
+
+//  the raw clients and their replies are those of OptionsServer.
+class   NativeServer  : public OptionsServer{
+public:
+    NativeServer(){
+        later       = nullptr;
+    };
+    virtual void    onNativeHttpRequest(Connection* conn, HttpRequest& req){
+        string      body    = req.path.str() + " " + req.body.str();
+        uris.push_back( req.uri.str() );
+        if (req.path.str() == "/later"){
+            later   = conn;
+            addTimer(50, (timer_handler_t)&NativeServer::onLater, 0);
+            return;
+        }
+        sendNativeHttpResponse( conn, 200, Slice( body.data(), body.size() ),
+                                "text/plain" );
+    };
+    void    onLater( Timer*  tmr,    void*   arg){
+        sendNativeHttpResponse( later, 202, Slice( "later", 5 ) );
+    }
+    size_t  count( const string& name, const string& what ){
+        string      r   = reply( name );
+        size_t      n   = 0;
+        for( size_t pos = 0; (pos = r.find( what, pos )) != string::npos;
+             pos += what.size() ){
+            n++;
+        }
+        return  n;
+    }
+    Connection*                     later;
+    vector<string>                  uris;
+};
+
+TEST(NativeHttpServer,  serve){
+    std::unique_ptr<NativeServer>   to( new NativeServer() );
+    HttpServerOptions   options;
+    options.timeoutMs               = 300;
+    options.maxHeadersSize          = 256;
+    options.maxBodySize             = 16;
+    options.allowedMethods          = EVHTTP_REQ_GET | EVHTTP_REQ_POST |
+                                      EVHTTP_REQ_HEAD;
+    options.maxKeepAliveRequests    = 3;
+    to->setHttpServerOptions( options );
+    EXPECT_TRUE( to->startNativeHttpServer("127.0.0.1", 9988) );
+    to->addTimer(1000, (timer_handler_t)&NativeServer::onStopTimer, 0);
+    string  get     = "GET /g HTTP/1.1\r\nHost: a\r\n\r\n";
+    to->send( "keepalive",  get + "GET /later HTTP/1.1\r\n\r\n" + get + get );
+    to->send( "head",       "HEAD /h HTTP/1.1\r\n\r\n" );
+    to->send( "post",       "POST /p HTTP/1.1\r\nContent-Length: 5\r\n\r\nhello"
+                            "GET /after HTTP/1.0\r\n\r\n" );
+    to->send( "method",     "PUT / HTTP/1.1\r\nContent-Length: 0\r\n\r\n" );
+    to->send( "bad",        "GET / HTTP/1.1\r\nno colon here\r\n\r\n" );
+    to->send( "headers",    "GET / HTTP/1.1\r\nX-Pad: " + string( 300, 'x' ) );
+    to->send( "body",       "POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\n" );
+    to->send( "chunked",    "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n"
+                            "\r\n" );
+    to->send( "slow",       "GET / HTTP/1.1\r\nHo" );
+    to->start();
+    //
+    string      keepalive   = to->reply("keepalive");
+    EXPECT_EQ(  to->count("keepalive", "HTTP/1.1 200 OK\r\n"),  2u );
+    EXPECT_EQ(  to->count("keepalive", "HTTP/1.1 202 "),        1u );
+    EXPECT_EQ(  to->count("keepalive", "Connection: close"),    1u );
+    //  replied in order, the one served later in between.
+    EXPECT_LT(  keepalive.find("later"),    keepalive.rfind("HTTP/1.1 200") );
+    EXPECT_NE(  keepalive.find("Content-Type: text/plain\r\n"),  string::npos );
+    EXPECT_NE(  to->reply("head").find("Content-Length: 3\r\n"), string::npos );
+    EXPECT_EQ(  to->reply("head").find("/h"),       string::npos );
+    string      post        = to->reply("post");
+    EXPECT_NE(  post.find("\r\n\r\n/p hello"),      string::npos );
+    EXPECT_NE(  post.find("Connection: close\r\n\r\n/after "), string::npos );
+    EXPECT_EQ(  to->reply("method").substr(0, 12),  "HTTP/1.1 405" );
+    EXPECT_NE(  to->reply("method").find("Allow: GET, POST, HEAD"),
+                string::npos );
+    EXPECT_EQ(  to->reply("bad").substr(0, 12),     "HTTP/1.1 400" );
+    EXPECT_EQ(  to->reply("headers").substr(0, 12), "HTTP/1.1 431" );
+    EXPECT_EQ(  to->reply("body").substr(0, 12),    "HTTP/1.1 413" );
+    EXPECT_EQ(  to->reply("chunked").substr(0, 12), "HTTP/1.1 411" );
+    EXPECT_EQ(  to->reply("slow"),                  "" );
+    EXPECT_EQ(  to->uris.size(),                    6u );
+    //
+    Metrics&    m   = to->metrics();
+    EXPECT_EQ(  m.httpRequests.value(),         9u );
+    EXPECT_EQ(  m.httpHeadersTooLarge.value(),  1u );
+    EXPECT_EQ(  m.httpBodyTooLarge.value(),     1u );
+    EXPECT_EQ(  m.httpBadRequests.value(),      2u );   // bad, chunked.
+    EXPECT_EQ(  m.httpBadMethods.value(),       1u );
+    EXPECT_EQ(  m.httpKeepAliveLimits.value(),  1u );
+    EXPECT_EQ(  m.httpTimeouts.value(),         2u );   // slow, head.
+    EXPECT_EQ(  m.httpStatus[2].value(),        6u );
+    EXPECT_EQ(  m.httpStatus[4].value(),        5u );
+    EXPECT_EQ(  to->nativeHttpConnectionSet().size(),   0u );
+    to->clean();
+}
+
+class   DripServer  : public NativeServer{
+public:
+    void    onDrip( Timer*  tmr,    void*   arg){
+        const char*     piece   = (const char*)arg;
+        evbuffer_add( names["drip"]->writeBuf(), piece, strlen( piece ) );
+    }
+};
+
+TEST(NativeHttpServer,  head_limit){
+    std::unique_ptr<DripServer>     to( new DripServer() );
+    EXPECT_TRUE( to->startNativeHttpServer("127.0.0.1", 9988) );
+    to->addTimer(500, (timer_handler_t)&NativeServer::onStopTimer, 0);
+    to->send( "huge",   "GET / HTTP/1.1\r\nX-Pad: " + string( 20000, 'x' ) );
+    //  the blank line over three reads, the last a bare LF.
+    to->send( "drip",   "GET /drip HTTP/1.1\r\nHost: a\r\nX-A: 1\r" );
+    to->addTimer(50,  (timer_handler_t)&DripServer::onDrip,
+                 (void*)"\nX-B: 2\n\r" );
+    to->addTimer(100, (timer_handler_t)&DripServer::onDrip, (void*)"\n" );
+    to->start();
+    //
+    EXPECT_EQ(  to->reply("huge").substr(0, 12),    "HTTP/1.1 431" );
+    EXPECT_EQ(  to->reply("drip").substr(0, 15),    "HTTP/1.1 200 OK" );
+    EXPECT_NE(  to->reply("drip").find("/drip "),   string::npos );
+    EXPECT_EQ(  to->metrics().httpHeadersTooLarge.value(),  1u );
+    to->clean();
+}
+
+class   PipelineServer  : public NativeServer{
+public:
+    PipelineServer(){
+        replied     = 0;
+        firstReply  = -1;
+    };
+    //  /d/N is replied N * 30 ms later.
+    virtual void    onNativeHttpRequest(Connection* conn, HttpRequest& req){
+        int     delay   = atoi( req.path.data + 3 );
+        uris.push_back( req.uri.str() );
+        pending.push_back( make_pair( conn, &req ) );
+        addTimer( delay * 30, (timer_handler_t)&PipelineServer::onReply,
+                  (void*)(pending.size() - 1) );
+    };
+    void    onReply( Timer*  tmr,    void*   arg){
+        Connection*     conn    = pending[ (size_t)arg ].first;
+        HttpRequest&    req     = *pending[ (size_t)arg ].second;
+        string          body    = req.path.str();
+        if (firstReply < 0){
+            firstReply  = uris.size();
+        }
+        replied++;
+        EXPECT_EQ(  sendNativeHttpResponse( conn, req, 200,
+                        Slice( body.data(), body.size() ) ),    0 );
+        EXPECT_EQ(  sendNativeHttpResponse( conn, req, 200, Slice() ),  -1 );
+    }
+    vector< pair<Connection*, HttpRequest*> >   pending;
+    int     replied;
+    int     firstReply;     // requests dispatched then.
+};
+
+TEST(NativeHttpServer,  pipeline){
+    std::unique_ptr<PipelineServer> to( new PipelineServer() );
+    HttpServerOptions   options;
+    options.pipelineDepth   = 3;
+    to->setHttpServerOptions( options );
+    EXPECT_TRUE( to->startNativeHttpServer("127.0.0.1", 9988) );
+    to->addTimer(1000, (timer_handler_t)&NativeServer::onStopTimer, 0);
+    to->send( "pipeline",   "GET /d/4 HTTP/1.1\r\n\r\n"
+                            "GET /d/1 HTTP/1.1\r\n\r\n"
+                            "POST /d/3 HTTP/1.1\r\nContent-Length: 2\r\n\r\nab"
+                            "GET /d/2 HTTP/1.1\r\n\r\n"
+                            "GET /d/1 HTTP/1.1\r\nConnection: close\r\n\r\n" );
+    to->start();
+    //
+    ASSERT_EQ(  to->uris.size(),    5u );
+    //  parsed ahead of the responses, up to the depth.
+    EXPECT_EQ(  to->firstReply,     3 );
+    string      reply   = to->reply("pipeline");
+    size_t      pos     = 0;
+    const char* order[] = { "/d/4", "/d/1", "/d/3", "/d/2", "/d/1" };
+    for( auto path : order ){
+        size_t  next    = reply.find( string("\r\n\r\n") + path, pos );
+        ASSERT_NE(  next,   string::npos ) << path;
+        pos     = next + 4;
+    }
+    EXPECT_EQ(  to->count("pipeline", "HTTP/1.1 200 OK\r\n"),   5u );
+    //  only the last one closes.
+    EXPECT_GT(  reply.find( "Connection: close" ),  reply.rfind( "HTTP/1.1" ) );
+    EXPECT_EQ(  to->nativeHttpConnectionSet().size(),   0u );
+    to->clean();
+}
+
+class   ResumeServer  : public NativeServer{
+public:
+    ResumeServer(){
+        resumed     = 0;
+        reading     = 0;
+    };
+    //  /d/N is replied N * 30 ms later.
+    virtual void    onNativeHttpRequest(Connection* conn, HttpRequest& req){
+        int     delay   = atoi( req.path.data + 3 );
+        pending.push_back( make_pair( conn, &req ) );
+        addTimer( delay * 30, (timer_handler_t)&ResumeServer::onReply,
+                  (void*)(pending.size() - 1) );
+    };
+    void    onReply( Timer*  tmr,    void*   arg){
+        Connection*     conn    = pending[ (size_t)arg ].first;
+        HttpRequest&    req     = *pending[ (size_t)arg ].second;
+        EXPECT_EQ(  sendNativeHttpResponse( conn, req, 200, Slice() ),  0 );
+    }
+    //  resumed while not to be read, for the pipeline or the state.
+    void    onResume( Timer*  tmr,    void*   arg){
+        for( auto& p : pending ){
+            resumeHttpBody( p.first );
+            resumed++;
+            if (bufferevent_get_enabled( p.first->bev() ) & EV_READ){
+                reading++;
+            }
+        }
+    }
+    vector< pair<Connection*, HttpRequest*> >   pending;
+    int     resumed;
+    int     reading;
+};
+
+TEST(NativeHttpServer,  resume_body){
+    std::unique_ptr<ResumeServer>   to( new ResumeServer() );
+    HttpServerOptions   options;
+    options.pipelineDepth   = 1;
+    to->setHttpServerOptions( options );
+    EXPECT_TRUE( to->startNativeHttpServer("127.0.0.1", 9988) );
+    to->addTimer(40,   (timer_handler_t)&ResumeServer::onResume, 0);
+    to->addTimer(500,  (timer_handler_t)&NativeServer::onStopTimer, 0);
+    to->send( "stopped",    "GET /d/2 HTTP/1.1\r\nConnection: close\r\n\r\n" );
+    to->send( "upgrading",  "GET /d/2 HTTP/1.1\r\nConnection: Upgrade\r\n"
+                            "Upgrade: foo\r\n\r\n"
+                            "GET /d/1 HTTP/1.1\r\nConnection: close\r\n\r\n" );
+    to->send( "full",       "GET /d/2 HTTP/1.1\r\n\r\n"
+                            "GET /d/1 HTTP/1.1\r\nConnection: close\r\n\r\n" );
+    to->start();
+    //
+    EXPECT_EQ(  to->resumed,    3 );
+    EXPECT_EQ(  to->reading,    0 );
+    //  read again once replied.
+    EXPECT_EQ(  to->count("stopped",   "HTTP/1.1 200 OK\r\n"),  1u );
+    EXPECT_EQ(  to->count("upgrading", "HTTP/1.1 200 OK\r\n"),  2u );
+    EXPECT_EQ(  to->count("full",      "HTTP/1.1 200 OK\r\n"),  2u );
+    to->clean();
+}
@@ -2,6 +2,19 @@
 #include    "src/gtest-all.cc"
 
 #include    "test_tcp_http.cc"
+#include    "test_connection.cc"
+#include    "test_buffer.cc"
+#include    "test_codec.cc"
+#include    "test_rpc.cc"
+#include    "test_pool.cc"
+#include    "test_ramp.cc"
+#include    "test_histogram.cc"
+#include    "test_metrics.cc"
+#include    "test_router.cc"
+#include    "test_workers.cc"
+#include    "test_cache.cc"
+#include    "test_http1.cc"
+#include    "test_websocket.cc"
 
 static  int
 _run_all_tests(int  argc, char* argv[]){
@@ -0,0 +1,258 @@
+
+#include    <unistd.h>
+#include    <algorithm>
+#include    <csignal>
+#include    <cstdio>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/admin.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   MetricsServer  : public Wrapper{
+public:
+    MetricsServer(){
+        output      = 0;
+        timers      = 0;
+    };
+    virtual void    onNewConnection(Connection*      conn){
+        if (conn->type() == Connection::CONN_TCP_CLIENT){
+            evbuffer_add( conn->writeBuf(), "hello", 5 );
+        }
+    };
+    virtual void    onConnectionRead(     Connection*      conn){
+        struct evbuffer*    buf = conn->readBuf();
+        if (conn->type() == Connection::CONN_TCP_SERVER){
+            evbuffer_add_buffer( conn->writeBuf(), buf );
+            return;
+        }
+        if (evbuffer_get_length( buf ) == 5){
+            output  = pendingOutput();
+            timers  = pendingTimers();
+            stop();
+        }
+    };
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        evhttp_send_reply( req, 404, "Not Found", nullptr );
+    };
+    virtual void    onHttpResponse(Connection* conn, struct evhttp_request* req){
+        stop();
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    size_t              output;
+    size_t              timers;
+};
+
+TEST(Metrics,   tcp_counters){
+    std::unique_ptr<MetricsServer>  to(new MetricsServer());
+    to->metrics().setTiming( true );
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    to->addTimer(2000, (timer_handler_t)&MetricsServer::onStopTimer, 0);
+    ASSERT_TRUE( to->startTcpClient("127.0.0.1", 9988) != nullptr );
+    to->start();
+    //
+    Metrics&    m   = to->metrics();
+    EXPECT_EQ(  m.accepts.value(),      1u );
+    EXPECT_EQ(  m.bytesIn.value(),      10u );
+    EXPECT_EQ(  m.bytesOut.value(),     10u );
+    EXPECT_GE(  m.readCallbacks.value(),2u );
+    EXPECT_EQ(  m.timersFired.value(),  0u );
+    EXPECT_EQ(  to->output,             0u );
+    EXPECT_EQ(  to->timers,             1u );
+    EXPECT_GE(  m.callbackTime.count(), 3 );
+    to->clean();
+    EXPECT_EQ(  m.closes.value(),       2u );
+    m.reset();
+    EXPECT_EQ(  m.accepts.value(),      0u );
+    EXPECT_EQ(  m.callbackTime.count(), 0 );
+}
+
+TEST(Metrics,   http_status){
+    std::unique_ptr<MetricsServer>  to(new MetricsServer());
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(2000, (timer_handler_t)&MetricsServer::onStopTimer, 0);
+    Connection* conn = to->startHttpClient("127.0.0.1", 9988, "127.0.0.1");
+    ASSERT_TRUE( conn != nullptr );
+    EXPECT_EQ(  to->makeHttpRequest(conn, EVHTTP_REQ_GET, "/none"), 0 );
+    to->start();
+    to->clean();
+    //
+    Metrics&    m   = to->metrics();
+    EXPECT_EQ(  m.httpRequests.value(), 1u );
+    EXPECT_EQ(  m.httpStatus[4].value(),1u );
+    EXPECT_EQ(  m.httpStatus[2].value(),0u );
+    EXPECT_EQ(  m.callbackTime.count(), 0 );
+}
+
+class   AdminClient  : public Wrapper{
+public:
+    virtual void    onHttpResponse(Connection* conn, struct evhttp_request* req){
+        struct evbuffer*    buf = evhttp_request_get_input_buffer( req );
+        bodies.push_back( string( (char*)evbuffer_pullup( buf, -1 ),
+                                  evbuffer_get_length( buf ) ) );
+        if (bodies.size() == 2){
+            stop();
+        }
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    vector<string>      bodies;
+};
+
+TEST(Metrics,   admin_server){
+    std::unique_ptr<AdminClient>    to(new AdminClient());
+    AdminServer                     admin( to.get() );
+    admin.setChunkSize( 2 );
+    EXPECT_TRUE( admin.start("127.0.0.1", 9989) );
+    EXPECT_FALSE( admin.start("127.0.0.1", 9989) );
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    for( int i = 0; i < 3; i++){
+        ASSERT_TRUE( to->startTcpClient("127.0.0.1", 9988) != nullptr );
+    }
+    to->addTimer(2000, (timer_handler_t)&AdminClient::onStopTimer, 0);
+    const char*     uris[]  = { "/metrics", "/debug/connections" };
+    for( auto uri : uris ){
+        Connection* conn = to->startHttpClient("127.0.0.1", 9989, "127.0.0.1");
+        ASSERT_TRUE( conn != nullptr );
+        EXPECT_EQ(  to->makeHttpRequest(conn, EVHTTP_REQ_GET, uri), 0 );
+    }
+    to->start();
+    //
+    ASSERT_EQ(  to->bodies.size(),  2u );
+    string      metrics = to->bodies[0].find("# HELP") == 0 ?
+        to->bodies[0] : to->bodies[1];
+    string      conns   = to->bodies[0].find("# HELP") == 0 ?
+        to->bodies[1] : to->bodies[0];
+    EXPECT_NE(  metrics.find("lew_accepts_total 3\n"),  string::npos );
+    EXPECT_NE(  metrics.find("lew_connections{set=\"tcp_client\"} 3\n"),
+                string::npos );
+    EXPECT_EQ(  conns.find("{\"connections\": ["),      0u );
+    //  the 3 tcp clients and servers, and the 2 http clients.
+    EXPECT_EQ(  std::count( conns.begin(), conns.end(), '{' ),  9 );
+    EXPECT_NE(  conns.find("\"set\": \"tcp_server\""),  string::npos );
+    EXPECT_NE(  conns.find("\"set\": \"http_client\""), string::npos );
+    EXPECT_NE(  metrics.find("lew_connections{set=\"websocket\"} 0\n"),
+                string::npos );
+    EXPECT_NE(  conns.find("]}"),                       string::npos );
+    admin.stop();
+    to->clean();
+}
+
+class   SlowServer  : public Wrapper{
+public:
+    SlowServer(){
+        slowest     = 0;
+    };
+    virtual void    onSlowCallback( CallbackType        type,
+                                    const std::string&  addr,
+                                    uint16_t            port,
+                                    int64_t             usec ){
+        types.push_back( type );
+        slowest = std::max( slowest, usec );
+    };
+    void    onSlowTimer( Timer*  tmr,    void*   arg){
+        usleep( 30 * 1000 );
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    vector<CallbackType>    types;
+    int64_t                 slowest;
+};
+
+TEST(Metrics,   slow_callbacks){
+    std::unique_ptr<SlowServer>     to(new SlowServer());
+    to->setSlowCallbackThreshold( 10 * 1000 );
+    to->setLagProbe( 5 );
+    to->addTimer(20,  (timer_handler_t)&SlowServer::onSlowTimer, 0);
+    to->addTimer(100, (timer_handler_t)&SlowServer::onStopTimer, 0);
+    to->start();
+    to->clean();
+    //
+    Metrics&    m   = to->metrics();
+    ASSERT_EQ(  to->types.size(),       1u );
+    EXPECT_EQ(  to->types[0],           Wrapper::CALLBACK_TIMER );
+    EXPECT_GE(  to->slowest,            30 * 1000 );
+    EXPECT_EQ(  m.slowCallbacks.value(),1u );
+    EXPECT_GE(  m.loopLag.count(),      5 );
+    EXPECT_GE(  m.loopLag.max(),        20 * 1000 * 1000 );
+    EXPECT_EQ(  m.callbackTime.count(), 0 );
+}
+
+class   TraceServer  : public Wrapper{
+public:
+    virtual void    onNewConnection(Connection*      conn){
+        if (conn->type() == Connection::CONN_TCP_CLIENT){
+            evbuffer_add( conn->writeBuf(), "hello", 5 );
+        }
+    };
+    virtual void    onConnectionRead(     Connection*      conn){
+        evbuffer_drain( conn->readBuf(), evbuffer_get_length(conn->readBuf()));
+        closeConnection( conn );
+        addTimer(10, (timer_handler_t)&TraceServer::onDumpTimer, 0);
+    };
+    void    onDumpTimer( Timer*  tmr,    void*   arg){
+        raise( SIGUSR2 );
+        addTimer(10, (timer_handler_t)&TraceServer::onStopTimer, 0);
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+};
+
+TEST(Metrics,   tracer){
+    std::unique_ptr<TraceServer>    to(new TraceServer());
+    Tracer                          tracer( 1000 );
+    string                          path    = "/tmp/lew-test-trace.json";
+    unlink( path.c_str() );
+    tracer.setDumpPath( path );
+    to->setTracer( &tracer );
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    to->addTimer(2000, (timer_handler_t)&TraceServer::onStopTimer, 0);
+    ASSERT_TRUE( to->startTcpClient("127.0.0.1", 9988) != nullptr );
+    to->start();
+    to->clean();
+    //
+    string      json    = tracer.toJson();
+    EXPECT_EQ(  json.find("{\"displayTimeUnit\": \"ns\", \"traceEvents\": ["),
+                0u );
+    EXPECT_NE(  json.find("\"name\": \"accept\", \"cat\": \"lew\", \"ph\": \"X\""),
+                string::npos );
+    EXPECT_NE(  json.find("\"name\": \"read\""),    string::npos );
+    EXPECT_NE(  json.find("\"name\": \"timer\""),   string::npos );
+    EXPECT_NE(  json.find("\"name\": \"close\", \"cat\": \"lew\", \"ph\": \"i\""),
+                string::npos );
+    FILE*       fp      = fopen( path.c_str(), "r" );
+    ASSERT_TRUE( fp != nullptr );
+    fclose( fp );
+    unlink( path.c_str() );
+}
+
+TEST(Metrics,   tracer_ring){
+    Tracer      tracer( 3 );
+    for( int i = 1; i <= 10; i++){
+        tracer.record( "read", 'X', i, i * 1000, 500 );
+    }
+    EXPECT_EQ(  tracer.size(),      4u );
+    EXPECT_EQ(  tracer.recorded(),  10u );
+    string      json    = tracer.toJson();
+    EXPECT_EQ(  json.find("\"conn\": 6}"),  string::npos );
+    EXPECT_NE(  json.find("\"ts\": 7.000, \"dur\": 0.500"),   string::npos );
+    EXPECT_NE(  json.find("\"conn\": 10}"), string::npos );
+    //
+    tracer.setSampling( 4 );
+    EXPECT_TRUE(    tracer.sampled( 8 ) );
+    EXPECT_FALSE(   tracer.sampled( 9 ) );
+    int         timers  = 0;
+    for( int i = 0; i < 8; i++){
+        timers  += tracer.sampled( 0 );
+    }
+    EXPECT_EQ(  timers,     2 );
+}
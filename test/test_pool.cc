@@ -0,0 +1,122 @@
+
+#include    <arpa/inet.h>
+#include    <cstring>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/pool.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   PoolServer  : public Wrapper{
+public:
+    struct  Reply{
+        Connection*     conn;
+        string          msg;
+    };
+    PoolServer(): codec(4){
+        setCodec( &codec );
+        ok          = 0;
+        failed      = 0;
+        calls       = 0;
+    };
+    static uint16_t localPort( Connection* conn ){
+        struct sockaddr_in  addr;
+        socklen_t           len = sizeof(addr);
+        getsockname( bufferevent_getfd(conn->bev()),
+                     (struct sockaddr*)&addr, &len );
+        return  ntohs( addr.sin_port );
+    }
+    //  the listener on 9989 answers 150ms late.
+    virtual void    onMessage( Connection* conn, const Slice& msg){
+        if (localPort( conn ) == 9989){
+            Reply*      r   = new Reply();
+            r->conn     = conn;
+            r->msg      = msg.str();
+            replies.push_back( unique_ptr<Reply>(r) );
+            addTimer(150, (timer_handler_t)&PoolServer::onReply, r);
+        }
+        else{
+            conn->writeMessage( msg.data, msg.len );
+        }
+    }
+    void    onReply( Timer* tmr, void* arg){
+        Reply*      r   = (Reply*)arg;
+        if (tcpServerConnectionSet().count( r->conn ) ){
+            r->conn->writeMessage( r->msg.data(), r->msg.size() );
+        }
+    }
+    void    onResponse( RpcClient* client, int status, const Slice& resp,
+                        void* arg){
+        (status == 0) ? ok++ : failed++;
+    }
+    void    onCall( Timer* tmr, void* arg){
+        pool->call( "ping", 4, (rpc_handler_t)&PoolServer::onResponse, 0 );
+        if (++calls < 60){
+            addTimer(20, (timer_handler_t)&PoolServer::onCall, 0);
+        }
+        else{
+            stop();
+        }
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    LengthCodec                 codec;
+    unique_ptr<ClientPool>      pool;
+    vector< unique_ptr<Reply> > replies;
+    int                         ok;
+    int                         failed;
+    int                         calls;
+};
+
+TEST(ClientPool,    eject_slow_endpoint){
+    std::unique_ptr<PoolServer>  to(new PoolServer());
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9989) );
+    vector<ClientPool::Endpoint>    eps(2);
+    eps[0].addr = "127.0.0.1";  eps[0].port = 9988;
+    eps[1].addr = "127.0.0.1";  eps[1].port = 9989;
+    to->pool.reset( new ClientPool( to.get(), eps, 2,
+                                    ClientPool::ROUND_ROBIN, 100 ) );
+    to->pool->setEjection( 2, 0, 10000 );
+    EXPECT_EQ( to->pool->start(), 0 );
+    to->addTimer(100, (timer_handler_t)&PoolServer::onCall, 0);
+    to->start();
+    //
+    EXPECT_FALSE(   to->pool->ejected( 0 ) );
+    EXPECT_TRUE(    to->pool->ejected( 1 ) );
+    EXPECT_GT(      to->ok,         45 );
+    EXPECT_LE(      to->failed,     10 );
+    to->pool.reset();
+    to->clean();
+}
+
+TEST(ClientPool,    consistent_hash){
+    std::unique_ptr<PoolServer>  to(new PoolServer());
+    vector<ClientPool::Endpoint>    eps(3);
+    for( int i = 0; i < 3; i++){
+        eps[i].addr = "127.0.0.1";
+        eps[i].port = 9988 + i;
+        EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988 + i) );
+    }
+    ClientPool      pool( to.get(), eps, 1, ClientPool::CONSISTENT_HASH );
+    pool.start();
+    to->addTimer(100, (timer_handler_t)&PoolServer::onStopTimer, 0);
+    to->start();
+    int     first[16];
+    for( int k = 0; k < 16; k++){
+        string  key     = "key-" + to_string(k);
+        first[k]    = pool.endpointOf( pool.pick(key.data(), key.size()) );
+        EXPECT_GE( first[k], 0 );
+    }
+    for( int k = 0; k < 16; k++){
+        string  key     = "key-" + to_string(k);
+        EXPECT_EQ( pool.endpointOf( pool.pick(key.data(), key.size()) ),
+                   first[k] );
+    }
+    to->clean();
+}
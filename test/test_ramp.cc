@@ -0,0 +1,45 @@
+
+#include    <memory>
+
+#include    "lew/ramp.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   RampClient  : public Wrapper{
+public:
+    RampClient(){ finished = 0; };
+    void    onRampDone( ConnectionRamp* ramp ){
+        if (++finished == 2){
+            stop();
+        }
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    int     finished;
+};
+
+TEST(ConnectionRamp,    paced_connects_and_retries){
+    std::unique_ptr<RampClient>  to(new RampClient());
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    ConnectionRamp      good( to.get(), "127.0.0.1", 9988 );
+    ConnectionRamp      bad(  to.get(), "127.0.0.1", 9987 );
+    good.setRate( 200 );
+    good.setMaxInflight( 4 );
+    good.setDoneHandler( (ramp_handler_t)&RampClient::onRampDone );
+    bad.setRetry( 2, 10, 20 );
+    bad.setDoneHandler( (ramp_handler_t)&RampClient::onRampDone );
+    EXPECT_EQ( good.start( 20 ),  0 );
+    EXPECT_EQ( bad.start( 3 ),    0 );
+    to->addTimer(3000, (timer_handler_t)&RampClient::onStopTimer, 0);
+    to->start();
+    to->clean();
+    //
+    EXPECT_EQ(  to->finished,           2 );
+    EXPECT_EQ(  good.connected(),       20 );
+    EXPECT_GT(  good.connectTime(99),   0.0 );
+    EXPECT_EQ(  bad.failed(),           3 );
+    EXPECT_EQ(  bad.retried(),          6 );
+}
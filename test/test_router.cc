@@ -0,0 +1,140 @@
+
+#include    <algorithm>
+#include    <cstring>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/wrapper.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   RouterServer  : public Wrapper{
+public:
+    void    onUser( Connection* conn, struct evhttp_request* req,
+                    const HttpParams& params){
+        hits.push_back( "user " + params.get("id").str() );
+    }
+    void    onUserPost( Connection* conn, struct evhttp_request* req,
+                        const HttpParams& params){
+        hits.push_back( "post " + params.get("id").str() + " " +
+                        params.get("post").str() );
+    }
+    void    onMe(   Connection* conn, struct evhttp_request* req,
+                    const HttpParams& params){
+        hits.push_back( "me" );
+    }
+    void    onFile( Connection* conn, struct evhttp_request* req,
+                    const HttpParams& params){
+        hits.push_back( "file " + params.get("path").str() );
+    }
+    void    onReply(Connection* conn, struct evhttp_request* req,
+                    const HttpParams& params){
+        struct evbuffer*    body    = evbuffer_new();
+        evbuffer_add_printf( body, "user %s", params.get("id").str().c_str() );
+        evhttp_send_reply( req, 200, "OK", body );
+        evbuffer_free( body );
+    }
+    virtual void    onHttpResponse(Connection* conn, struct evhttp_request* req){
+        if (req){
+            struct evbuffer*    buf = evhttp_request_get_input_buffer( req );
+            bodies.push_back( std::to_string(
+                evhttp_request_get_response_code( req ) ) + " " +
+                string( (char*)evbuffer_pullup( buf, -1 ),
+                        evbuffer_get_length( buf ) ) );
+        }
+        if (bodies.size() == 3){
+            stop();
+        }
+    };
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    string  route( evhttp_cmd_type method, const char* path ){
+        http_handler_t  handler;
+        HttpParams      params;
+        int             status  = router().match( method,
+            Slice( path, strlen(path) ), handler, params );
+        if (200 == status){
+            hits.clear();
+            (this->*handler)( nullptr, nullptr, params );
+            return  hits.empty() ? "" : hits[0];
+        }
+        return  std::to_string( status );
+    }
+    vector<string>      hits;
+    vector<string>      bodies;
+};
+
+TEST(Router,    match){
+    std::unique_ptr<RouterServer>   to(new RouterServer());
+    HttpRouter&     r   = to->router();
+    EXPECT_TRUE( r.empty() );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET, "/users/:id",
+                       (http_handler_t)&RouterServer::onUser ),         0 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET, "/users/me",
+                       (http_handler_t)&RouterServer::onMe ),           0 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET | EVHTTP_REQ_POST,
+                       "/users/:id/posts/:post",
+                       (http_handler_t)&RouterServer::onUserPost ),     0 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET, "/static/*path",
+                       (http_handler_t)&RouterServer::onFile ),         0 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_POST, "/users/you",
+                       (http_handler_t)&RouterServer::onMe ),           0 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_POST, "/static/upload",
+                       (http_handler_t)&RouterServer::onMe ),           0 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET, "/users/:name",
+                       (http_handler_t)&RouterServer::onUser ),         -1 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET, "/users/me",
+                       (http_handler_t)&RouterServer::onMe ),           -1 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET, "/a/*rest/b",
+                       (http_handler_t)&RouterServer::onMe ),           -1 );
+    EXPECT_EQ(  r.add( EVHTTP_REQ_GET, "nope",
+                       (http_handler_t)&RouterServer::onMe ),           -1 );
+    EXPECT_FALSE( r.empty() );
+    //
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/users/42" ),       "user 42" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/users/me" ),       "me" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/users/mel" ),      "user mel" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_POST, "/users/me/posts/7" ),
+                "post me 7" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/static/css/a.css" ),
+                "file css/a.css" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/static/" ),        "file " );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/users/" ),         "404" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/users/42/posts" ), "404" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/user" ),           "404" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_DELETE, "/users/42" ),    "405" );
+    //  a static route of another method falls back to the parameter.
+    EXPECT_EQ(  to->route( EVHTTP_REQ_POST, "/users/you" ),     "me" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/users/you" ),      "user you" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_PUT, "/users/you" ),      "405" );
+    EXPECT_EQ(  to->route( EVHTTP_REQ_GET, "/static/upload" ),
+                "file upload" );
+}
+
+TEST(Router,    dispatch){
+    std::unique_ptr<RouterServer>   to(new RouterServer());
+    to->router().add( EVHTTP_REQ_GET, "/users/:id",
+                      (http_handler_t)&RouterServer::onReply );
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(2000, (timer_handler_t)&RouterServer::onStopTimer, 0);
+    const char*     uris[]  = { "/users/7?x=1", "/none", "/users/7" };
+    evhttp_cmd_type cmds[]  = { EVHTTP_REQ_GET, EVHTTP_REQ_GET,
+                                EVHTTP_REQ_PUT };
+    for( int i = 0; i < 3; i++){
+        Connection* conn = to->startHttpClient("127.0.0.1", 9988, "127.0.0.1");
+        ASSERT_TRUE( conn != nullptr );
+        EXPECT_EQ(  to->makeHttpRequest(conn, cmds[i], uris[i]), 0 );
+    }
+    to->start();
+    to->clean();
+    //
+    ASSERT_EQ(  to->bodies.size(),  3u );
+    std::sort( to->bodies.begin(), to->bodies.end() );
+    EXPECT_EQ(  to->bodies[0],      "200 user 7" );
+    EXPECT_EQ(  to->bodies[1].substr(0, 4),     "404 " );
+    EXPECT_EQ(  to->bodies[2].substr(0, 4),     "405 " );
+}
@@ -0,0 +1,231 @@
+
+#include    <cstring>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/rpc.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   RpcEcho  : public Wrapper{
+public:
+    RpcEcho(): codec(4){
+        setCodec( &codec );
+        timeouts    = 0;
+    };
+    //  echo everything but "drop".
+    virtual void    onMessage( Connection* conn, const Slice& msg){
+        if (msg.len != 8 + 4 || memcmp(msg.data + 8, "drop", 4) != 0){
+            conn->writeMessage( msg.data, msg.len );
+        }
+    }
+    void    onResponse( RpcClient* client, int status, const Slice& resp,
+                        void* arg){
+        if (status == ETIMEDOUT){
+            timeouts++;
+        }
+        else if (status == 0){
+            responses.push_back( resp.str() );
+        }
+        if (responses.size() + timeouts == 4){
+            stop();
+        }
+    }
+    void    onSend( Timer* tmr, void* arg){
+        RpcClient::Request  reqs[3];
+        const char*         bodies[]    = { "one", "two", "three" };
+        for( int i = 0; i < 3; i++){
+            reqs[i].data    = bodies[i];
+            reqs[i].len     = strlen( bodies[i] );
+            reqs[i].handler = (rpc_handler_t)&RpcEcho::onResponse;
+            reqs[i].arg     = nullptr;
+        }
+        EXPECT_EQ( rpc->callBatch( reqs, 3 ), 3 );
+        EXPECT_NE( rpc->call( "drop", 4,
+                              (rpc_handler_t)&RpcEcho::onResponse,
+                              nullptr, 100 ), 0u );
+        EXPECT_EQ( rpc->inflight(), 4u );
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    LengthCodec             codec;
+    unique_ptr<RpcClient>   rpc;
+    vector<string>          responses;
+    int                     timeouts;
+};
+
+TEST(RpcClient,     pipeline_and_deadline){
+    std::unique_ptr<RpcEcho>  to(new RpcEcho());
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    Connection*     conn    = to->startTcpClient("127.0.0.1", 9988);
+    ASSERT_TRUE( conn != nullptr );
+    to->rpc.reset( new RpcClient( to.get(), conn ) );
+    to->addTimer(2000, (timer_handler_t)&RpcEcho::onStopTimer, 0);
+    to->addTimer(100,  (timer_handler_t)&RpcEcho::onSend, 0);
+    to->start();
+    EXPECT_EQ( to->rpc->inflight(), 0u );
+    to->rpc.reset();
+    to->clean();
+    //
+    ASSERT_EQ(  to->responses.size(),   3u );
+    EXPECT_EQ(  to->responses[0],       "one" );
+    EXPECT_EQ(  to->responses[2],       "three" );
+    EXPECT_EQ(  to->timeouts,           1 );
+}
+
+class   RpcReset  : public RpcEcho{
+public:
+    RpcReset(){
+        resets  = 0;
+    };
+    //  the server drops everything, and closes on "close".
+    virtual void    onMessage( Connection* conn, const Slice& msg){
+        if (msg.len == 8 + 5 && memcmp(msg.data + 8, "close", 5) == 0){
+            closeConnection( conn );
+        }
+    }
+    //  the client is released on the first reset.
+    void    onReset( RpcClient* client, int status, const Slice& resp,
+                     void* arg){
+        EXPECT_EQ(  status,     ECONNRESET );
+        resets++;
+        rpc.reset();
+    }
+    void    onCall( Timer* tmr, void* arg){
+        for( int i = 0; i < 3; i++){
+            rpc->call( i < 2 ? "hold" : "close", i < 2 ? 4 : 5,
+                       (rpc_handler_t)&RpcReset::onReset, nullptr );
+        }
+    }
+    int     resets;
+};
+
+TEST(RpcClient,     delete_on_close){
+    std::unique_ptr<RpcReset>   to(new RpcReset());
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    Connection*     conn    = to->startTcpClient("127.0.0.1", 9988);
+    ASSERT_TRUE( conn != nullptr );
+    conn->setRetryTimes( 0 );
+    to->rpc.reset( new RpcClient( to.get(), conn ) );
+    to->addTimer(500,  (timer_handler_t)&RpcEcho::onStopTimer, 0);
+    to->addTimer(100,  (timer_handler_t)&RpcReset::onCall, 0);
+    to->start();
+    to->clean();
+    //
+    EXPECT_EQ(  to->resets,     3 );
+    EXPECT_TRUE( to->rpc == nullptr );
+}
+
+class   RpcDelete  : public RpcEcho{
+public:
+    RpcDelete(){
+        deleted     = 0;
+    };
+    //  the client is released by the first handler called, the calls
+    //  expired with it are still handled.
+    void    onDelete( RpcClient* client, int status, const Slice& resp,
+                      void* arg){
+        deleted++;
+        rpc.reset();
+    }
+    //  two responses, read at once.
+    void    onEcho( Timer* tmr, void* arg){
+        RpcClient::Request  reqs[2];
+        for( int i = 0; i < 2; i++){
+            reqs[i].data    = "echo";
+            reqs[i].len     = 4;
+            reqs[i].handler = (rpc_handler_t)&RpcDelete::onDelete;
+            reqs[i].arg     = nullptr;
+        }
+        EXPECT_EQ( rpc->callBatch( reqs, 2 ), 2 );
+    }
+    //  two calls expiring at once.
+    void    onDrop( Timer* tmr, void* arg){
+        for( int i = 0; i < 2; i++){
+            EXPECT_NE( rpc->call( "drop", 4,
+                                  (rpc_handler_t)&RpcDelete::onDelete,
+                                  nullptr, 50 ), 0u );
+        }
+    }
+    int     deleted;
+};
+
+TEST(RpcClient,     delete_in_handler){
+    timer_handler_t     sends[] = { (timer_handler_t)&RpcDelete::onEcho,
+                                    (timer_handler_t)&RpcDelete::onDrop };
+    int                 deleted[]   = { 1, 2 };
+    for( int i = 0; i < 2; i++){
+        std::unique_ptr<RpcDelete>  to(new RpcDelete());
+        EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+        Connection*     conn    = to->startTcpClient("127.0.0.1", 9988);
+        ASSERT_TRUE( conn != nullptr );
+        to->rpc.reset( new RpcClient( to.get(), conn ) );
+        to->addTimer(300,  (timer_handler_t)&RpcEcho::onStopTimer, 0);
+        to->addTimer(100,  sends[i], 0);
+        to->start();
+        to->clean();
+        //
+        EXPECT_EQ(  to->deleted,    deleted[i] );
+        EXPECT_TRUE( to->rpc == nullptr );
+    }
+}
+
+class   RpcReconnect  : public RpcEcho{
+public:
+    RpcReconnect(){
+        resets      = 0;
+    };
+    //  the server holds "hold", closes on "close", and echoes the others.
+    virtual void    onMessage( Connection* conn, const Slice& msg){
+        if (msg.len == 8 + 5 && memcmp(msg.data + 8, "close", 5) == 0){
+            closeConnection( conn );
+        }
+        else if (msg.len != 8 + 4 || memcmp(msg.data + 8, "hold", 4) != 0){
+            conn->writeMessage( msg.data, msg.len );
+        }
+    }
+    void    onReset( RpcClient* client, int status, const Slice& resp,
+                     void* arg){
+        EXPECT_EQ(  status,     ECONNRESET );
+        resets++;
+    }
+    void    onCall( Timer* tmr, void* arg){
+        for( int i = 0; i < 3; i++){
+            rpc->call( i < 2 ? "hold" : "close", i < 2 ? 4 : 5,
+                       (rpc_handler_t)&RpcReconnect::onReset, nullptr );
+        }
+    }
+    //  once connected again.
+    void    onAgain( Timer* tmr, void* arg){
+        EXPECT_NE(  rpc->call( "again", 5,
+                               (rpc_handler_t)&RpcEcho::onResponse,
+                               nullptr ), 0u );
+    }
+    int     resets;
+};
+
+TEST(RpcClient,     reconnect){
+    std::unique_ptr<RpcReconnect>   to(new RpcReconnect());
+    EXPECT_TRUE( to->startTcpServer("127.0.0.1", 9988) );
+    Connection*     conn    = to->startTcpClient("127.0.0.1", 9988);
+    ASSERT_TRUE( conn != nullptr );
+    conn->setRetryTimes( 1 );
+    to->rpc.reset( new RpcClient( to.get(), conn ) );
+    to->addTimer(100,  (timer_handler_t)&RpcReconnect::onCall, 0);
+    to->addTimer(300,  (timer_handler_t)&RpcReconnect::onAgain, 0);
+    to->addTimer(500,  (timer_handler_t)&RpcEcho::onStopTimer, 0);
+    to->start();
+    //
+    //  failed at once, not after the deadline of the calls.
+    EXPECT_EQ(  to->resets,             3 );
+    ASSERT_EQ(  to->responses.size(),   1u );
+    EXPECT_EQ(  to->responses[0],       "again" );
+    EXPECT_EQ(  to->rpc->connection(),  conn );
+    EXPECT_EQ(  to->rpc->inflight(),    0u );
+    to->rpc.reset();
+    to->clean();
+}
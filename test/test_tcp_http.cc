@@ -1,7 +1,13 @@
 #include    <unistd.h>
+#include    <signal.h>
+#include    <sys/resource.h>
+#include    <algorithm>
 #include    <cstdio>
 #include    <cstring>
 #include    <memory>
+#include    <map>
+#include    <string>
+#include    <vector>
 
 #include    "lew/wrapper.h"
 #include    "gtest/gtest.h"
@@ -190,3 +196,349 @@ TEST(HttpServer,   start_http){
 }
 
 
+
+class   KeepAliveServer  : public Wrapper{
+public:
+    KeepAliveServer(){
+        requests    = 0;
+        responses   = 0;
+        conns       = 0;
+        contexts    = 0;
+        last        = nullptr;
+        evcon       = nullptr;
+    };
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        requests++;
+        conns   = std::max( conns, httpServerConnectionSet().size() );
+        if (conn->httpContext() != last){
+            contexts++;
+            last    = conn->httpContext();
+        }
+        evhttp_send_reply( req, 200, "OK", nullptr );
+    };
+    static void     onResponse( struct evhttp_request* req, void* arg){
+        KeepAliveServer*    to  = (KeepAliveServer*)arg;
+        if (req && evhttp_request_get_response_code( req ) == 200){
+            to->responses++;
+        }
+        if (! req || to->responses == 1000){
+            to->stop();
+            return;
+        }
+        to->request();
+    }
+    void    request(){
+        struct evhttp_request*  req = evhttp_request_new( onResponse, this );
+        evhttp_add_header( evhttp_request_get_output_headers( req ),
+                           "Host", "127.0.0.1" );
+        evhttp_make_request( evcon, req, EVHTTP_REQ_GET, "/keep-alive" );
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    int                         requests;
+    int                         responses;
+    size_t                      conns;
+    int                         contexts;
+    HttpRequestContext*         last;
+    struct evhttp_connection*   evcon;
+};
+
+TEST(HttpServer,   keep_alive_connection){
+    std::unique_ptr<KeepAliveServer>    to( new KeepAliveServer() );
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(5000, (timer_handler_t)&KeepAliveServer::onStopTimer, 0);
+    to->evcon   = evhttp_connection_base_new( to->base(), NULL,
+                                              "127.0.0.1", 9988 );
+    to->request();
+    to->start();
+    //
+    EXPECT_EQ(  to->requests,       1000 );
+    EXPECT_EQ(  to->responses,      1000 );
+    EXPECT_EQ(  to->conns,          1u );
+    EXPECT_EQ(  to->contexts,       1 );
+    ASSERT_EQ(  to->httpServerConnectionSet().size(),   1u );
+    Connection* conn    = *to->httpServerConnectionSet().begin();
+    EXPECT_TRUE( conn->httpContext() == nullptr );
+    EXPECT_TRUE( conn->httpReq() == nullptr );
+    evhttp_connection_free( to->evcon );
+    to->clean();
+    EXPECT_EQ(  to->httpServerConnectionSet().size(),   0u );
+}
+
+class   OptionsServer  : public Wrapper{
+public:
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        evhttp_send_reply( req, 200, "OK", nullptr );
+    };
+    virtual void    onConnectionRead(   Connection* conn){
+        struct evbuffer*    buf = conn->readBuf();
+        replies[ conn ].append( (char*)evbuffer_pullup( buf, -1 ),
+                                evbuffer_get_length( buf ) );
+        evbuffer_drain( buf, evbuffer_get_length( buf ) );
+    };
+    void    send( const string& name, const string& raw ){
+        Connection*     conn    = startTcpClient("127.0.0.1", 9988);
+        conn->setRetryTimes( 0 );
+        evbuffer_add( conn->writeBuf(), raw.data(), raw.size() );
+        names[ name ]   = conn;
+    }
+    string  reply( const string& name ){
+        return  replies[ names[ name ] ];
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        stop();
+    }
+    std::map<Connection*, string>   replies;
+    std::map<string, Connection*>   names;
+};
+
+class   CloseHttpServer  : public OptionsServer{
+public:
+    CloseHttpServer(){
+        requests    = 0;
+        served      = nullptr;
+    };
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        requests++;
+        evhttp_send_reply( req, 200, "OK", nullptr );
+        served  = conn;
+        addTimer(50, (timer_handler_t)&CloseHttpServer::onCloseTimer, 0);
+    };
+    void    onCloseTimer( Timer*  tmr,    void*   arg){
+        closeConnection( served );
+        addTimer(50, (timer_handler_t)&CloseHttpServer::onAgain, 0);
+    }
+    void    onAgain( Timer*  tmr,    void*   arg){
+        Connection*     conn    = names["keepalive"];
+        if (tcpClientConnectionSet().count( conn ) ){
+            evbuffer_add_printf( conn->writeBuf(),
+                                 "GET / HTTP/1.1\r\nHost: a\r\n\r\n" );
+        }
+    }
+    int             requests;
+    Connection*     served;
+};
+
+TEST(HttpServer,   close_connection){
+    std::unique_ptr<CloseHttpServer>    to( new CloseHttpServer() );
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(400, (timer_handler_t)&OptionsServer::onStopTimer, 0);
+    to->send( "keepalive",  "GET / HTTP/1.1\r\nHost: a\r\n\r\n" );
+    to->start();
+    //
+    EXPECT_EQ(  to->requests,   1 );
+    EXPECT_EQ(  to->reply("keepalive").substr(0, 12),   "HTTP/1.1 200" );
+    EXPECT_EQ(  to->reply("keepalive").find("HTTP/1.1", 12),    string::npos );
+    EXPECT_EQ(  to->httpServerConnectionSet().size(),   0u );
+    EXPECT_EQ(  to->tcpClientConnectionSet().size(),    0u );
+    to->clean();
+}
+
+TEST(HttpServer,   server_options){
+    std::unique_ptr<OptionsServer>  to( new OptionsServer() );
+    HttpServerOptions   options;
+    options.timeoutMs               = 300;
+    options.maxHeadersSize          = 256;
+    options.maxBodySize             = 16;
+    options.allowedMethods          = EVHTTP_REQ_GET | EVHTTP_REQ_POST;
+    options.maxKeepAliveRequests    = 2;
+    to->setHttpServerOptions( options );
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(1000, (timer_handler_t)&OptionsServer::onStopTimer, 0);
+    string  get     = "GET / HTTP/1.1\r\nHost: a\r\n\r\n";
+    to->send( "headers", "GET / HTTP/1.1\r\nHost: a\r\nX-Pad: " +
+                         string( 300, 'x' ) + "\r\n\r\n" );
+    to->send( "body",   "POST / HTTP/1.1\r\nHost: a\r\n"
+                        "Content-Length: 100\r\n\r\n" + string( 100, 'b' ) );
+    to->send( "method", "PUT / HTTP/1.1\r\nHost: a\r\n"
+                        "Content-Length: 0\r\n\r\n" );
+    to->send( "bad",    "GET / HTTP/1.1\r\nno colon here\r\n\r\n" );
+    to->send( "keepalive", get + get + get );
+    to->send( "slow",   "GET / HTTP/1.1\r\nHo" );
+    to->start();
+    //
+    EXPECT_EQ(  to->reply("headers").substr(0, 12),     "HTTP/1.1 400" );
+    EXPECT_EQ(  to->reply("body").substr(0, 12),        "HTTP/1.1 413" );
+    EXPECT_EQ(  to->reply("method").substr(0, 12),      "HTTP/1.1 405" );
+    EXPECT_NE(  to->reply("method").find("Allow: GET, POST"),   string::npos );
+    EXPECT_EQ(  to->reply("bad").substr(0, 12),         "HTTP/1.1 400" );
+    string      keepalive   = to->reply("keepalive");
+    EXPECT_EQ(  keepalive.find("HTTP/1.1 200", 12) == string::npos,  false );
+    EXPECT_EQ(  keepalive.find("HTTP/1.1 200", keepalive.find(
+                "HTTP/1.1 200", 12) + 12),      string::npos );
+    EXPECT_NE(  keepalive.find("Connection: close"),    string::npos );
+    EXPECT_EQ(  to->reply("slow"),  "" );
+    //
+    Metrics&    m   = to->metrics();
+    EXPECT_EQ(  m.httpHeadersTooLarge.value(),  1u );
+    EXPECT_EQ(  m.httpBodyTooLarge.value(),     1u );
+    EXPECT_EQ(  m.httpBadRequests.value(),      1u );
+    EXPECT_EQ(  m.httpBadMethods.value(),       1u );
+    EXPECT_EQ(  m.httpKeepAliveLimits.value(),  1u );
+    EXPECT_EQ(  m.httpTimeouts.value(),         2u );   // slow, method.
+    to->clean();
+}
+
+class   StreamServer  : public OptionsServer{
+public:
+    StreamServer(){
+        chunk.assign( 16 * 1024, 's' );
+        written     = 0;
+        readies     = 0;
+        aborted     = 0;
+        maxPending  = 0;
+    };
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        startHttpStream( conn, req, 200, "OK",
+                         (http_stream_handler_t)&StreamServer::onReady,
+                         (void*)evhttp_request_get_uri( req ), 64 * 1024 );
+        onReady( conn, req, nullptr );
+    };
+    void    onReady( Connection* conn, struct evhttp_request* req, void* arg){
+        if (! req){
+            aborted++;
+            return;
+        }
+        readies++;
+        string              uri     = evhttp_request_get_uri( req );
+        struct evbuffer*    out     = bufferevent_get_output(
+            evhttp_connection_get_bufferevent(
+                evhttp_request_get_connection( req ) ) );
+        while( httpStreamWritable( conn ) ){
+            if (uri == "/big" && written >= 4 * 1024 * 1024){
+                endHttpStream( conn );
+                return;
+            }
+            struct evbuffer*    buf = evbuffer_new();
+            evbuffer_add( buf, chunk.data(), chunk.size() );
+            writeHttpStream( conn, buf );
+            evbuffer_free( buf );
+            if (uri == "/big"){
+                written += chunk.size();
+            }
+            maxPending  = std::max( maxPending, evbuffer_get_length( out ) );
+        }
+    };
+    void    onClose( Timer*  tmr,    void*   arg){
+        closeConnection( names["endless"] );
+    }
+    string      chunk;
+    size_t      written;
+    int         readies;
+    int         aborted;
+    size_t      maxPending;
+};
+
+TEST(HttpServer,   stream){
+    std::unique_ptr<StreamServer>   to( new StreamServer() );
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(300,  (timer_handler_t)&StreamServer::onClose, 0);
+    to->addTimer(1000, (timer_handler_t)&StreamServer::onStopTimer, 0);
+    to->send( "big",        "GET /big HTTP/1.1\r\nHost: a\r\n\r\n" );
+    to->send( "endless",    "GET /endless HTTP/1.1\r\nHost: a\r\n\r\n" );
+    to->start();
+    //
+    string      big     = to->reply("big");
+    EXPECT_EQ(  big.substr(0, 12),      "HTTP/1.1 200" );
+    EXPECT_NE(  big.find("Transfer-Encoding: chunked"),     string::npos );
+    EXPECT_GT(  big.size(),             to->written );
+    EXPECT_EQ(  big.substr( big.size() - 5 ),   "0\r\n\r\n" );
+    EXPECT_GT(  to->readies,            2 );
+    EXPECT_EQ(  to->aborted,            1 );
+    //  the output stays about one chunk over the watermark.
+    EXPECT_LE(  to->maxPending,         64 * 1024 + to->chunk.size() + 64 );
+    to->clean();
+}
+
+class   BodyServer  : public OptionsServer{
+public:
+    BodyServer(){
+        chunks  = 0;
+    };
+    virtual void    onHttpBodyChunk(HttpRequestContext* ctx, const Slice& chunk){
+        chunks++;
+        Wrapper::onHttpBodyChunk( ctx, chunk );
+    };
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        HttpRequestContext* rc      = conn->httpContext();
+        struct evbuffer*    input   = evhttp_request_get_input_buffer( req );
+        string              body( evbuffer_get_length( input ), '\0' );
+        evbuffer_remove( input, &body[0], body.size() );
+        if (rc->bodyFd >= 0){
+            char    buf[4096];
+            ssize_t n;
+            while( (n = read( rc->bodyFd, buf, sizeof(buf) )) > 0 ){
+                spooled.append( buf, n );
+            }
+        }
+        bodies.push_back( body );
+        lengths.push_back( rc->bodyLength );
+        evhttp_send_reply( req, 200, "OK", nullptr );
+    };
+    int                 chunks;
+    vector<string>      bodies;
+    vector<uint64_t>    lengths;
+    string              spooled;
+};
+
+TEST(HttpServer,   stream_body){
+    std::unique_ptr<BodyServer>     to( new BodyServer() );
+    HttpServerOptions   options;
+    options.streamBodies    = true;
+    options.spoolThreshold  = 64 * 1024;
+    to->setHttpServerOptions( options );
+    EXPECT_TRUE( to->startHttpServer("127.0.0.1", 9988) );
+    to->addTimer(500, (timer_handler_t)&BodyServer::onStopTimer, 0);
+    to->send( "small",  "POST / HTTP/1.1\r\nHost: a\r\n"
+                        "Content-Length: 5\r\n\r\nhello" );
+    to->send( "large",  "POST / HTTP/1.1\r\nHost: a\r\n"
+                        "Content-Length: 1048576\r\n\r\n" +
+                        string( 1024 * 1024, 'u' ) );
+    to->start();
+    //
+    EXPECT_EQ(  to->reply("small").substr(0, 12),       "HTTP/1.1 200" );
+    EXPECT_EQ(  to->reply("large").substr(0, 12),       "HTTP/1.1 200" );
+    ASSERT_EQ(  to->bodies.size(),      2u );
+    EXPECT_GE(  to->chunks,             3 );
+    //  the small body is in the input buffer, the large one in the file.
+    std::sort( to->lengths.begin(), to->lengths.end() );
+    std::sort( to->bodies.begin(), to->bodies.end() );
+    EXPECT_EQ(  to->lengths[0],         5u );
+    EXPECT_EQ(  to->lengths[1],         1024u * 1024 );
+    EXPECT_EQ(  to->bodies[0],          "" );
+    EXPECT_EQ(  to->bodies[1],          "hello" );
+    EXPECT_EQ(  to->spooled,            string( 1024 * 1024, 'u' ) );
+    to->clean();
+}
+
+TEST(HttpServer,   stream_body_spool_error){
+    //  writes to the spool file fail past 256 KB.
+    struct rlimit   saved, rl;
+    getrlimit( RLIMIT_FSIZE, &saved );
+    rl.rlim_cur     = 256 * 1024;
+    rl.rlim_max     = saved.rlim_max;
+    signal( SIGXFSZ, SIG_IGN );
+    ASSERT_EQ(  setrlimit( RLIMIT_FSIZE, &rl ),     0 );
+    for( int native = 0; native < 2; native++){
+        std::unique_ptr<BodyServer>     to( new BodyServer() );
+        HttpServerOptions   options;
+        options.streamBodies    = true;
+        options.spoolThreshold  = 64 * 1024;
+        to->setHttpServerOptions( options );
+        EXPECT_TRUE( native ? to->startNativeHttpServer("127.0.0.1", 9988) :
+                              to->startHttpServer("127.0.0.1", 9988) );
+        to->addTimer(500, (timer_handler_t)&BodyServer::onStopTimer, 0);
+        to->send( "large",  "POST / HTTP/1.1\r\nHost: a\r\n"
+                            "Content-Length: 1048576\r\n\r\n" +
+                            string( 1024 * 1024, 'u' ) );
+        to->start();
+        //
+        EXPECT_EQ(  to->reply("large").substr(0, 12),   "HTTP/1.1 500" )
+            << native;
+        EXPECT_EQ(  to->bodies.size(),      0u );
+        to->clean();
+    }
+    setrlimit( RLIMIT_FSIZE, &saved );
+    signal( SIGXFSZ, SIG_DFL );
+}
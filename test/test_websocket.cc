@@ -0,0 +1,234 @@
+#include    <cstring>
+#include    <map>
+#include    <memory>
+#include    <string>
+#include    <vector>
+
+#include    "lew/websocket.h"
+#include    "lew/wrapper.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+static const uint8_t    _key[4] = { 0x37, 0xfa, 0x21, 0x3d };
+
+//  a frame as sent by a client, masked.
+static string
+_ws_frame( int opcode, const string& payload, bool fin = true ){
+    char        head[ WsCodec::MAX_HEADER ];
+    size_t      n   = WsCodec::writeHeader( head, opcode, fin, payload.size(),
+                                            _key );
+    string      body    = payload;
+    WsCodec::unmask( &body[0], body.size(), _key );
+    return  string( head, n ) + body;
+}
+
+TEST(WsCodec,   header){
+    uint64_t    lengths[]   = { 0, 125, 126, 65535, 65536, 1ULL << 40 };
+    for( auto len : lengths ){
+        char        head[ WsCodec::MAX_HEADER ];
+        WsFrame     frame;
+        size_t      n   = WsCodec::writeHeader( head, WsCodec::BINARY, false,
+                                                len, _key );
+        EXPECT_EQ(  WsCodec::parseHeader( head, n - 1, frame ),  0 );
+        EXPECT_EQ(  WsCodec::parseHeader( head, n, frame ),  (int)n );
+        EXPECT_FALSE(   frame.fin );
+        EXPECT_TRUE(    frame.masked );
+        EXPECT_EQ(  frame.opcode,   WsCodec::BINARY );
+        EXPECT_EQ(  frame.length,   len );
+        EXPECT_EQ(  memcmp( frame.key, _key, 4 ),   0 );
+    }
+    WsFrame     frame;
+    EXPECT_EQ(  WsCodec::parseHeader( "\xc1\x00", 2, frame ),   -1 );
+    EXPECT_EQ(  WsCodec::parseHeader( "\x81\x7f\x80\0\0\0\0\0\0\0", 10,
+                                      frame ),  -1 );
+}
+
+TEST(WsCodec,   unmask){
+    //  every length and offset against a byte by byte XOR.
+    WsCodec::Isa    best    = WsCodec::isa();
+    for( int i = WsCodec::ISA_SCALAR; i <= best; i++){
+        EXPECT_EQ(  WsCodec::setIsa( (WsCodec::Isa)i ),     i );
+        for( size_t n = 0; n < 100; n++){
+            for( size_t offset = 0; offset < 4; offset++){
+                string  data, expect;
+                for( size_t j = 0; j < n; j++){
+                    data    += (char)(j * 7 + n);
+                    expect  += (char)(data[j] ^ _key[ (offset + j) & 3 ]);
+                }
+                WsCodec::unmask( &data[0], n, _key, offset );
+                ASSERT_EQ(  data,   expect )
+                    << WsCodec::isaName( (WsCodec::Isa)i ) << " " << n;
+            }
+        }
+    }
+    EXPECT_EQ(  WsCodec::setIsa( WsCodec::ISA_AVX2 ),   best );
+}
+
+TEST(WsCodec,   utf8){
+    const char*     good[]  = { "", "plain ascii text", "caf\xc3\xa9",
+                                "\xe2\x82\xac", "\xf0\x9f\x98\x80",
+                                "\xf4\x8f\xbf\xbf", "\xed\x9f\xbf" };
+    const char*     bad[]   = { "\x80", "\xc3\x28", "\xc0\xaf",
+                                "\xe0\x80\xaf", "\xed\xa0\x80",
+                                "\xf4\x90\x80\x80", "\xf8\x88\x80\x80\x80",
+                                "ascii then \xe2\x82", "\xff" };
+    for( auto text : good ){
+        EXPECT_TRUE(    WsCodec::validUtf8( text, strlen(text) ) ) << text;
+    }
+    for( auto text : bad ){
+        EXPECT_FALSE(   WsCodec::validUtf8( text, strlen(text) ) ) << text;
+    }
+    int             codes[] = { 999, 1000, 1003, 1004, 1005, 1006, 1007,
+                                1014, 1015, 2999, 3000, 4999, 5000 };
+    bool            valid[] = { false, true, true, false, false, false, true,
+                                true, false, false, true, true, false };
+    for( int i = 0; i < 13; i++){
+        EXPECT_EQ(  WsCodec::validCloseCode( codes[i] ),    valid[i] )
+            << codes[i];
+    }
+}
+
+TEST(WsCodec,   accept){
+    char        out[29];
+    WsCodec::accept( "dGhlIHNhbXBsZSBub25jZQ==", 24, out );
+    EXPECT_STREQ(   out,    "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=" );
+    SharedBuffer*   buf = WsCodec::frame( "hi", 2 );
+    ASSERT_TRUE( buf != nullptr );
+    EXPECT_EQ(  string( (const char*)buf->data(), buf->len() ),  "\x81\x02hi" );
+    buf->unref();
+}
+
+class   WsServer  : public NativeServer{
+public:
+    virtual void    onNativeHttpRequest(Connection* conn, HttpRequest& req){
+        upgradeWebSocket( conn, req, "chat" );
+    };
+    virtual void    onWsMessage(Connection*     conn,
+                                const Slice&    msg,
+                                bool            binary){
+        messages.push_back( msg.str() );
+        EXPECT_EQ(  sendWsMessage( conn, msg, binary ),     0 );
+        if (msg.str() == "bye"){
+            EXPECT_EQ(  closeWebSocket( conn ),     0 );
+            EXPECT_EQ(  sendWsMessage( conn, msg ),         -1 );
+        }
+    };
+    //  the frames after the head of the reply, as opcode and payload.
+    vector< pair<int, string> >     frames( const string& name ){
+        vector< pair<int, string> >     out;
+        string      r       = reply( name );
+        size_t      pos     = r.find( "\r\n\r\n" );
+        WsFrame     frame;
+        int         n;
+        pos     = pos == string::npos ? r.size() : pos + 4;
+        while( (n = WsCodec::parseHeader( r.data() + pos, r.size() - pos,
+                                          frame )) > 0 ){
+            out.push_back( make_pair( frame.opcode,
+                                      r.substr( pos + n, frame.length ) ) );
+            pos     += n + frame.length;
+        }
+        return  out;
+    }
+    vector<string>                  messages;
+};
+
+TEST(WebSocket, serve){
+    std::unique_ptr<WsServer>   to( new WsServer() );
+    HttpServerOptions   options;
+    options.timeoutMs           = 300;
+    options.maxWsMessageSize    = 1000;
+    to->setHttpServerOptions( options );
+    EXPECT_TRUE( to->startNativeHttpServer("127.0.0.1", 9988) );
+    to->addTimer(1000, (timer_handler_t)&WsServer::onStopTimer, 0);
+    string  hello   = "GET /ws HTTP/1.1\r\nHost: a\r\n"
+                      "Upgrade: websocket\r\n"
+                      "Connection: keep-alive, Upgrade\r\n"
+                      "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n";
+    string  v13     = "Sec-WebSocket-Version: 13\r\n\r\n";
+    string  close   = _ws_frame( WsCodec::CLOSE, string( "\x03\xe8", 2 ) );
+    to->send( "echo",       hello + v13 +
+                            _ws_frame( WsCodec::TEXT, "hello" ) +
+                            _ws_frame( WsCodec::TEXT, "frag", false ) +
+                            _ws_frame( WsCodec::PING, "p" ) +
+                            _ws_frame( WsCodec::CONTINUATION, "ment" ) +
+                            _ws_frame( WsCodec::BINARY, string( 300, 'b' ) ) +
+                            close +
+                            _ws_frame( WsCodec::TEXT, "ignored" ) );
+    to->send( "version",    hello + "Sec-WebSocket-Version: 8\r\n\r\n" );
+    to->send( "plain",      "GET /ws HTTP/1.1\r\n\r\n" );
+    to->send( "unmasked",   hello + v13 + "\x81\x02hi" );
+    to->send( "large",      hello + v13 +
+                            _ws_frame( WsCodec::TEXT, string( 600, 'x' ),
+                                       false ) +
+                            _ws_frame( WsCodec::CONTINUATION,
+                                       string( 600, 'x' ) ) );
+    to->send( "bye",        hello + v13 + _ws_frame( WsCodec::TEXT, "bye" ) );
+    to->send( "utf8",       hello + v13 +
+                            _ws_frame( WsCodec::TEXT, "\xe2\x82", false ) +
+                            _ws_frame( WsCodec::CONTINUATION, "\xac" ) +
+                            _ws_frame( WsCodec::TEXT, "bad \xc3\x28" ) );
+    to->send( "code",       hello + v13 +
+                            _ws_frame( WsCodec::CLOSE,
+                                       string( "\x03\xed", 2 ) ) );
+    to->send( "short",      hello + v13 + _ws_frame( WsCodec::CLOSE, "\x03" ) );
+    to->send( "reason",     hello + v13 +
+                            _ws_frame( WsCodec::CLOSE, string( "\x03\xe8", 2 ) +
+                                                       "\xc3\x28" ) );
+    to->start();
+    //
+    string      echo    = to->reply("echo");
+    EXPECT_EQ(  echo.substr(0, 32), "HTTP/1.1 101 Switching Protocols" );
+    EXPECT_NE(  echo.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo="
+                          "\r\n"),  string::npos );
+    EXPECT_NE(  echo.find("Sec-WebSocket-Protocol: chat\r\n"),  string::npos );
+    auto        frames  = to->frames("echo");
+    ASSERT_EQ(  frames.size(),  5u );
+    EXPECT_EQ(  frames[0],  make_pair( (int)WsCodec::TEXT, string("hello") ) );
+    EXPECT_EQ(  frames[1],  make_pair( (int)WsCodec::PONG, string("p") ) );
+    EXPECT_EQ(  frames[2],  make_pair( (int)WsCodec::TEXT, string("fragment")));
+    EXPECT_EQ(  frames[3],  make_pair( (int)WsCodec::BINARY, string(300, 'b')));
+    EXPECT_EQ(  frames[4],  make_pair( (int)WsCodec::CLOSE,
+                                       string( "\x03\xe8", 2 ) ) );
+    EXPECT_EQ(  to->reply("version").substr(0, 12),     "HTTP/1.1 426" );
+    EXPECT_NE(  to->reply("version").find("Sec-WebSocket-Version: 13\r\n"),
+                string::npos );
+    EXPECT_EQ(  to->reply("plain").substr(0, 12),       "HTTP/1.1 400" );
+    frames  = to->frames("unmasked");
+    ASSERT_EQ(  frames.size(),  1u );
+    EXPECT_EQ(  frames[0],  make_pair( (int)WsCodec::CLOSE,
+                                       string( "\x03\xea", 2 ) ) );
+    frames  = to->frames("large");
+    ASSERT_EQ(  frames.size(),  1u );
+    EXPECT_EQ(  frames[0],  make_pair( (int)WsCodec::CLOSE,
+                                       string( "\x03\xf1", 2 ) ) );
+    //  closed by the server, the close never answered.
+    frames  = to->frames("bye");
+    ASSERT_EQ(  frames.size(),  2u );
+    EXPECT_EQ(  frames[0],  make_pair( (int)WsCodec::TEXT, string("bye") ) );
+    EXPECT_EQ(  frames[1],  make_pair( (int)WsCodec::CLOSE,
+                                       string( "\x03\xe8", 2 ) ) );
+    //  a valid text fragmented, then an invalid one.
+    frames  = to->frames("utf8");
+    ASSERT_EQ(  frames.size(),  2u );
+    EXPECT_EQ(  frames[0],  make_pair( (int)WsCodec::TEXT,
+                                       string("\xe2\x82\xac") ) );
+    EXPECT_EQ(  frames[1],  make_pair( (int)WsCodec::CLOSE,
+                                       string( "\x03\xef", 2 ) ) );
+    //  1005 may not be sent, nor a close of one byte, nor a bad reason.
+    const char* closes[]    = { "code", "short", "reason" };
+    const char* codes[]     = { "\x03\xea", "\x03\xea", "\x03\xef" };
+    for( int i = 0; i < 3; i++){
+        frames  = to->frames( closes[i] );
+        ASSERT_EQ(  frames.size(),  1u ) << closes[i];
+        EXPECT_EQ(  frames[0],  make_pair( (int)WsCodec::CLOSE,
+                                           string( codes[i], 2 ) ) );
+    }
+    //  hello, frag, 300 b, bye, and the valid text.
+    EXPECT_EQ(  to->messages.size(),    5u );
+    EXPECT_EQ(  to->webSocketConnectionSet().size(),    0u );
+    EXPECT_EQ(  to->nativeHttpConnectionSet().size(),   0u );
+    EXPECT_EQ(  to->metrics().httpStatus[1].value(),    8u );
+    to->clean();
+}
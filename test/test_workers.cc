@@ -0,0 +1,66 @@
+
+#include    <memory>
+#include    <string>
+
+#include    "lew/workers.h"
+#include    "gtest/gtest.h"
+
+using   namespace   std;
+using   namespace   lew;
+
+class   WorkerServer  : public Wrapper{
+public:
+    WorkerServer( HttpWorkers* workers ){
+        group       = workers;
+        responses   = 0;
+    };
+    virtual void    onHttpRequest(Connection* conn, struct evhttp_request* req){
+        evhttp_send_reply( req, 200, "OK", NULL );
+    };
+    virtual void    onHttpResponse(Connection* conn, struct evhttp_request* req){
+        if (req && evhttp_request_get_response_code( req ) == 200){
+            responses++;
+        }
+        if (responses == 6){
+            group->stop();
+        }
+    };
+    void    onRequest( Timer*  tmr,    void*   arg){
+        for( int i = 0; i < 6; i++){
+            Connection* conn = startHttpClient("127.0.0.1", 9988, "127.0.0.1");
+            makeHttpRequest( conn, EVHTTP_REQ_GET, "/" );
+        }
+    }
+    void    onStopTimer( Timer*  tmr,    void*   arg){
+        group->stop();
+    }
+    static Wrapper* create( int index, void* arg ){
+        WorkerServer*   server  = new WorkerServer( *(HttpWorkers**)arg );
+        if (0 == index){
+            server->addTimer(50, (timer_handler_t)&WorkerServer::onRequest, 0);
+            server->addTimer(2000,
+                             (timer_handler_t)&WorkerServer::onStopTimer, 0);
+        }
+        return  server;
+    }
+    HttpWorkers*        group;
+    int                 responses;
+};
+
+TEST(HttpWorkers,   reuse_port){
+    for( int shared = 0; shared < 2; shared++){
+        HttpWorkers*    group   = nullptr;
+        std::unique_ptr<HttpWorkers>    workers(
+            group = new HttpWorkers( WorkerServer::create, &group ) );
+        workers->setReusePort( ! shared );
+        ASSERT_TRUE( workers->listen("127.0.0.1", 9988, 3) );
+        EXPECT_EQ(  workers->size(),    3 );
+        EXPECT_TRUE( workers->run() );
+        //
+        Metrics     total;
+        workers->metrics( total );
+        EXPECT_EQ(  ((WorkerServer*)workers->worker(0))->responses, 6 );
+        EXPECT_EQ(  total.httpRequests.value(),     6u );
+        EXPECT_EQ(  total.httpStatus[2].value(),    6u );
+    }
+}